@@ -12,7 +12,7 @@ bool OpenImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32
 	ofn.lpstrFile = filenameBuffer;
 	ofn.lpstrFile[0] = L'\0';
 	ofn.nMaxFile = filenameBufferLength;
-	ofn.lpstrFilter = L"All supported image formats\0*.png;*.jpg;*.bmp\0PNG (*.png)\0*.png\0JPEG (*.jpg)\0*.jpg\0BMP (*.bmp)\0*.bmp\0\0";
+	ofn.lpstrFilter = L"All supported formats\0*.panter;*.png;*.jpg;*.bmp\0Panter project (*.panter)\0*.panter\0PNG (*.png)\0*.png\0JPEG (*.jpg)\0*.jpg\0BMP (*.bmp)\0*.bmp\0\0";
 	ofn.nFilterIndex = 1;
 	ofn.lpstrFileTitle = nullptr;
 	ofn.nMaxFileTitle = 0;
@@ -28,7 +28,7 @@ bool SaveImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32
 {
 	*format = ImageFormat::None;
 
-	const wchar *extensions[] = { L".png", L".jpg", L".bmp" };
+	const wchar *extensions[] = { L".png", L".jpg", L".bmp", L".panter" };
 
 	OPENFILENAME ofn = {};
 	ofn.lStructSize = sizeof(ofn);
@@ -36,7 +36,7 @@ bool SaveImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32
 	ofn.lpstrFile = filenameBuffer;
 	ofn.lpstrFile[0] = L'\0';
 	ofn.nMaxFile = filenameBufferLength;
-	ofn.lpstrFilter = L"PNG (*.png)\0*.png\0JPEG (*.jpg)\0*.jpg\0BMP (*.bmp)\0*.bmp\0";
+	ofn.lpstrFilter = L"PNG (*.png)\0*.png\0JPEG (*.jpg)\0*.jpg\0BMP (*.bmp)\0*.bmp\0Panter project (*.panter)\0*.panter\0";
 	ofn.nFilterIndex = 1;
 	ofn.lpstrFileTitle = nullptr;
 	ofn.nMaxFileTitle = 0;
@@ -69,6 +69,10 @@ bool SaveImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32
 		case 2:
 			*format = ImageFormat::Bmp;
 			break;
+
+		case 3:
+			*format = ImageFormat::Panter;
+			break;
 	}
 
 	return result != 0;
@@ -1,9 +1,24 @@
+#ifdef _WIN32
 #include <wincodec.h>
+#endif
 #include <string.h>
 
+#include <XLib.Memory.h>
+#include <XLib.System.File.h>
+#ifdef _WIN32
 #include <XLib.Platform.COMPtr.h>
+#endif
 
 #include "FileUtil.h"
+#include "Panter.PngCodec.h"
+
+using namespace XLib;
+using namespace Panter;
+
+// PNG goes through own codec, other formats through WIC where it is available. Pixels are
+// straight alpha RGBA like layer storage.
+
+#ifdef _WIN32
 
 using namespace XLib::Platform;
 
@@ -19,7 +34,9 @@ inline void checkWICInitialization()
 	}
 }
 
-bool LoadImageFromFile(const wchar* filename, XLib::HeapPtr<byte>& data,
+static constexpr uint32 WICBandSize = 1 << 22;	// Pixel bytes per band read through WIC.
+
+static bool OpenImageWithWIC(const wchar* filename, void*& source,
 	uint32& _width, uint32& _height, ImageFormat& _format)
 {
 	checkWICInitialization();
@@ -57,27 +74,32 @@ bool LoadImageFromFile(const wchar* filename, XLib::HeapPtr<byte>& data,
 	hResult = wicFactory->CreateFormatConverter(wicFormatConverter.initRef());
 	if (FAILED(hResult)) return false;
 
-	hResult = wicFormatConverter->Initialize(wicFrameDecode, GUID_WICPixelFormat32bppPRGBA,
+	hResult = wicFormatConverter->Initialize(wicFrameDecode, GUID_WICPixelFormat32bppRGBA,
 		WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeMedianCut);
 	if (FAILED(hResult)) return false;
 
 	UINT width = 0, height = 0;
 	hResult = wicFormatConverter->GetSize(&width, &height);
-	if (FAILED(hResult)) return false;
+	if (FAILED(hResult) || !width || !height) return false;
 
 	_width = width;
 	_height = height;
 	_format = format;
 
-	data.resize(width * height * 4);
-
-	hResult = wicFormatConverter->CopyPixels(nullptr, width * 4, width * height * 4, data);
-	if (FAILED(hResult)) return false;
-
+	// Converter holds frame and decoder.
+	source = wicFormatConverter.moveToPtr();
 	return true;
 }
 
-bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data, uint32 width, uint32 height)
+static bool ReadImageRowsWithWIC(void* source, uint32 width, uint32 firstRow, uint32 rowCount, void* pixels)
+{
+	WICRect wicRect = { 0, int(firstRow), int(width), int(rowCount) };
+	HRESULT hResult = ((IWICBitmapSource*)source)->CopyPixels(&wicRect,
+		width * 4, width * rowCount * 4, (BYTE*)pixels);
+	return SUCCEEDED(hResult);
+}
+
+static bool SaveImageWithWIC(const wchar* filename, ImageFormat format, const void* data, uint32 width, uint32 height)
 {
 	GUID wicImageFormat;
 
@@ -131,15 +153,15 @@ bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data
 	if (FAILED(hResult)) return false;
 
 	wicFrameEncode->SetSize(width, height);
-	GUID wicDstPixelFormat = GUID_WICPixelFormat32bppPRGBA;
+	GUID wicDstPixelFormat = GUID_WICPixelFormat32bppRGBA;
 	wicFrameEncode->SetPixelFormat(&wicDstPixelFormat);
 
-	if (wicDstPixelFormat != GUID_WICPixelFormat32bppPRGBA)
+	if (wicDstPixelFormat != GUID_WICPixelFormat32bppRGBA)
 	{
 		hResult = wicFactory->CreateFormatConverter(wicFormatConverter.initRef());
 		if (FAILED(hResult)) return false;
 
-		hResult = wicFactory->CreateBitmapFromMemory(width, height, GUID_WICPixelFormat32bppPRGBA,
+		hResult = wicFactory->CreateBitmapFromMemory(width, height, GUID_WICPixelFormat32bppRGBA,
 			width * 4, width * height * 4, (BYTE*) data, wicSourceBitmap.initRef());
 		if (FAILED(hResult)) return false;
 
@@ -167,4 +189,160 @@ bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data
 	if (FAILED(hResult)) return false;
 
 	return true;
+}
+
+#endif
+
+// ImageBandReader ==========================================================================//
+
+bool ImageBandReader::open(const wchar* filename)
+{
+	close();
+
+	if (fileMapping.open(filename))
+	{
+		if (PngCodec::IsPng(fileMapping.getData(), uintptr(fileMapping.getSize())))
+		{
+			if (fileMapping.getSize() > uintptr(-1) ||
+				!pngDecoder.open(fileMapping.getData(), uintptr(fileMapping.getSize())))
+			{
+				close();
+				return false;
+			}
+
+			// Decoder reads file front to back.
+			fileMapping.prefetch(0, fileMapping.getSize());
+
+			width = pngDecoder.getWidth();
+			height = pngDecoder.getHeight();
+			format = ImageFormat::Png;
+			return true;
+		}
+
+		fileMapping.close();
+	}
+
+#ifdef _WIN32
+	if (!OpenImageWithWIC(filename, wicSource, width, height, format))
+		return false;
+
+	wicBandRowCount = clamp<uint32>(WICBandSize / (width * 4), 1, height);
+	wicBandPixels = HeapPtr<uint32>(uintptr(width) * wicBandRowCount);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ImageBandReader::close()
+{
+	pngDecoder.destroy();
+	fileMapping.close();
+
+#ifdef _WIN32
+	if (wicSource)
+	{
+		Internal::IUnknown_Release(wicSource);
+		wicSource = nullptr;
+	}
+#endif
+	wicBandPixels.release();
+
+	width = 0;
+	height = 0;
+	readRowCount = 0;
+	format = ImageFormat::None;
+}
+
+bool ImageBandReader::readBand(BandSink sink, void* sinkContext)
+{
+	if (pngDecoder.isOpen())
+	{
+		if (!pngDecoder.decodeBand(sink, sinkContext))
+			return false;
+
+		readRowCount = pngDecoder.getDecodedRowCount();
+		return true;
+	}
+
+#ifdef _WIN32
+	uint32 rowCount = min(wicBandRowCount, height - readRowCount);
+	if (!ReadImageRowsWithWIC(wicSource, width, readRowCount, rowCount, wicBandPixels))
+		return false;
+
+	sink(sinkContext, readRowCount, rowCount, wicBandPixels);
+	readRowCount += rowCount;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Image functions ==========================================================================//
+
+struct CopyImageBandContext
+{
+	byte *data;
+	uint32 width;
+};
+
+static void CopyImageBand(void* _context, uint32 firstRow, uint32 rowCount, const uint32* pixels)
+{
+	CopyImageBandContext &context = *(CopyImageBandContext*)_context;
+	uintptr rowSize = uintptr(context.width) * 4;
+	Memory::Copy(context.data + rowSize * firstRow, pixels, rowSize * rowCount);
+}
+
+void InitializeImageFileIO()
+{
+#ifdef _WIN32
+	checkWICInitialization();
+#endif
+}
+
+bool LoadImageFromFile(const wchar* filename, HeapPtr<byte>& data,
+	uint32& width, uint32& height, ImageFormat& format)
+{
+	ImageBandReader reader;
+	if (!reader.open(filename))
+		return false;
+
+	data.resize(uintptr(reader.getWidth()) * reader.getHeight() * 4);
+
+	CopyImageBandContext context = { data, reader.getWidth() };
+	while (!reader.isFinished())
+	{
+		if (!reader.readBand(CopyImageBand, &context))
+			return false;
+	}
+
+	width = reader.getWidth();
+	height = reader.getHeight();
+	format = reader.getFormat();
+	return true;
+}
+
+bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data, uint32 width, uint32 height,
+	PngEncodeProgress* progress)
+{
+	if (format == ImageFormat::Png)
+	{
+		HeapPtr<byte> fileData;
+		uintptr fileDataSize = 0;
+		if (!PngCodec::Encode(data, width * 4, width, height, fileData, fileDataSize, true, progress) ||
+			fileDataSize > uint32(-1))
+		{
+			return false;
+		}
+
+		File file;
+		return file.open(filename, FileAccessMode::Write, FileOpenMode::Override) &&
+			file.write(fileData, uint32(fileDataSize));
+	}
+
+#ifdef _WIN32
+	return SaveImageWithWIC(filename, format, data, width, height);
+#else
+	return false;
+#endif
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include <XLib.Types.h>
 #include <XLib.Heap.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.System.File.h>
+
+#include "Panter.PngCodec.h"
 
 enum class ImageFormat
 {
@@ -9,10 +13,54 @@ enum class ImageFormat
 	Png,
 	Jpeg,
 	Bmp,
+	Panter,		// Native layered project, see Panter.ProjectFile.h.
 };
 
 bool OpenImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32 filenameBufferLength);
 bool SaveImageFileDialog(void* parentWindowHandle, wchar* filenameBuffer, uint32 filenameBufferLength, ImageFormat* format);
 
+// Reads image band by band, so whole image never has to be held in memory. PNG is decoded by
+// own stream decoder from mapped file, other formats are read through WIC by row rectangles.
+
+class ImageBandReader : public XLib::NonCopyable
+{
+public:
+	using BandSink = Panter::PngStreamDecoder::BandSink;
+
+private:
+	XLib::FileMapping fileMapping;
+	Panter::PngStreamDecoder pngDecoder;
+	void *wicSource = nullptr;			// IWICBitmapSource converting to RGBA.
+	XLib::HeapPtr<uint32> wicBandPixels;
+	uint32 wicBandRowCount = 0;
+	uint32 width = 0, height = 0;
+	uint32 readRowCount = 0;
+	ImageFormat format = ImageFormat::None;
+
+public:
+	ImageBandReader() = default;
+	inline ~ImageBandReader() { close(); }
+
+	bool open(const wchar* filename);
+	void close();
+
+	// Passes next band to sink. Returns false on read error.
+	bool readBand(BandSink sink, void* sinkContext);
+
+	inline uint32 getWidth() const { return width; }
+	inline uint32 getHeight() const { return height; }
+	inline uint32 getReadRowCount() const { return readRowCount; }
+	inline ImageFormat getFormat() const { return format; }
+	inline bool isOpen() const { return format != ImageFormat::None; }
+	inline bool isFinished() const { return readRowCount == height; }
+};
+
+// Creates shared codec state up front, so images can be loaded and saved from several threads.
+// Such threads have to initialize COM themselves on Windows.
+void InitializeImageFileIO();
+
 bool LoadImageFromFile(const wchar* filename, XLib::HeapPtr<byte>& data, uint32& width, uint32& height, ImageFormat& format);
-bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data, uint32 width, uint32 height);
\ No newline at end of file
+// Progress is reported and cancellation is possible only for PNG, file is not touched if
+// saving is cancelled.
+bool SaveImageToFile(const wchar* filename, ImageFormat format, const void* data, uint32 width, uint32 height,
+	Panter::PngEncodeProgress* progress = nullptr);
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include <XLib.Memory.h>
+#include <XLib.Util.h>
+#include <XLib.Debug.h>
+#include <XLib.Crypto.CRC.h>
+#include <XLib.System.Profiler.h>
+
+#include "Panter.AutosaveJournal.h"
+
+#include "Panter.CanvasManager.h"
+#include "Panter.TileCodec.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+static constexpr uint32 AutosaveRecordMagic = 0x4C4E'524A;	// "JRNL"
+
+// AutosaveChangeSet ========================================================================//
+
+void AutosaveChangeSet::release()
+{
+	for (ChangedTile &changedTile : tiles)
+		pool->release(changedTile.tile);
+
+	tiles.clear();
+	layerOps.clear();
+	canvasReset = false;
+}
+
+// AutosaveJournal ==========================================================================//
+
+uint32 __stdcall AutosaveJournal::ThreadMain(AutosaveJournal* self)
+{
+	ProfileThreadName("Autosave journal");
+
+	for (;;)
+	{
+		Batch *batch = self->filledBatches.dequeue();
+		if (!batch)
+			break;
+
+		self->writeBatch(*batch);
+		self->freeBatches.enqueue(batch);
+	}
+	return 0;
+}
+
+byte* AutosaveJournal::allocateRecord(uintptr maxPayloadSize)
+{
+	uintptr requiredCapacity = writeBufferSize + sizeof(AutosaveRecordHeader) + maxPayloadSize;
+	if (requiredCapacity > writeBufferCapacity)
+	{
+		writeBufferCapacity = max(requiredCapacity, writeBufferCapacity * 2);
+		writeBuffer.resize(writeBufferCapacity);
+	}
+	return writeBuffer + writeBufferSize + sizeof(AutosaveRecordHeader);
+}
+
+void AutosaveJournal::finishRecord(AutosaveRecordType type, uint16 layerIndex, uint32 argument, uint32 payloadSize)
+{
+	byte *record = writeBuffer + writeBufferSize;
+	AutosaveRecordHeader header = { AutosaveRecordMagic, session, type, layerIndex, argument, payloadSize, 0 };
+
+	CRC32 crc;
+	crc.process(header);
+	crc.process(record + sizeof(AutosaveRecordHeader), payloadSize);
+	header.crc = crc.getValue();
+
+	Memory::Copy(record, &header, sizeof(AutosaveRecordHeader));
+	writeBufferSize += sizeof(AutosaveRecordHeader) + payloadSize;
+}
+
+// Whole batch is serialized to memory and written at once. Records of canvas reset start
+// new session, so reader can tell them from leftovers of interrupted journal.
+void AutosaveJournal::writeBatch(Batch& batch)
+{
+	ProfileFunction();
+
+	if (batch.restart)
+	{
+		file.close();
+		if (!file.open(filename, FileAccessMode::Write, FileOpenMode::Override, FileAccessHint::Sequential))
+		{
+			Debug::Warning(DbgMsgFmt("can't open autosave journal file"));
+			failed = true;
+		}
+	}
+
+	// After failure batches are dropped until journal is restarted.
+	if (!file.isInitialized())
+		return;
+
+	writeBufferSize = 0;
+
+	if (batch.hasCanvasRecord)
+	{
+		session++;
+		Memory::Copy(allocateRecord(sizeof(AutosaveCanvasRecord)), &batch.canvas, sizeof(AutosaveCanvasRecord));
+		finishRecord(AutosaveRecordType::Canvas, 0, 0, sizeof(AutosaveCanvasRecord));
+	}
+
+	for (const AutosaveLayerOp &op : batch.layerOps)
+	{
+		allocateRecord(0);
+		finishRecord(op.type, op.layerIndex, op.argument, 0);
+	}
+
+	for (uint32 i = 0; i < batch.tileCount; i++)
+	{
+		const BatchTile &tile = batch.tiles[i];
+
+		if (tile.isUniform)
+		{
+			Memory::Copy(allocateRecord(sizeof(Color)), &tile.uniformColor, sizeof(Color));
+			finishRecord(AutosaveRecordType::UniformTile, tile.layerIndex, tile.tileIndex, sizeof(Color));
+			continue;
+		}
+
+		byte *payload = allocateRecord(TileCodec::MaxCompressedSize);
+		uint32 payloadSize = TileCodec::Compress(batch.pixels + uintptr(i) * TileCodec::TilePixelCount, payload);
+		finishRecord(AutosaveRecordType::Tile, tile.layerIndex, tile.tileIndex, payloadSize);
+	}
+
+	if (!file.write(writeBuffer, writeBufferSize))
+	{
+		Debug::Warning(DbgMsgFmt("autosave journal write failed"));
+		file.close();
+		failed = true;
+		return;
+	}
+
+	if (batch.last)
+		file.flush();
+}
+
+void AutosaveJournal::initialize(CanvasManager& canvasManager, const wchar* _filename, float32 _interval,
+	uint64 appendOffset, uint32 lastSession)
+{
+	Debug::CrashCondition(thread.isInitialized(), DbgMsgFmt("autosave journal is already initialized"));
+
+	filename = _filename;
+	interval = _interval;
+	session = lastSession;
+	failed = false;
+
+	bool opened = appendOffset ?
+		file.open(_filename, FileAccessMode::Write, FileOpenMode::OpenExisting, FileAccessHint::Sequential) &&
+			file.setPosition(sint64(appendOffset)) == appendOffset :
+		file.open(_filename, FileAccessMode::Write, FileOpenMode::Override, FileAccessHint::Sequential);
+
+	// Journal is restarted by next update.
+	if (!opened)
+	{
+		file.close();
+		failed = true;
+	}
+
+	filledBatches.initialize();
+	freeBatches.initialize();
+	for (Batch &batch : batches)
+	{
+		batch.pixels = HeapPtr<uint32>(uintptr(batchTileLimit) * TileCodec::TilePixelCount);
+		freeBatches.enqueue(&batch);
+	}
+
+	collecting = false;
+	appendPending = opened && appendOffset;
+	lastAutosaveTime = Timer::GetRecord();
+	canvasManager.resetAutosaveChanges();
+
+	thread.create(ThreadMain, this);
+}
+
+void AutosaveJournal::destroy()
+{
+	if (!thread.isInitialized())
+		return;
+
+	changes.release();
+	collecting = false;
+
+	filledBatches.enqueue(nullptr);
+	thread.wait();
+	thread.destroy();
+
+	for (Batch &batch : batches)
+	{
+		batch.layerOps.clear();
+		batch.pixels.release();
+	}
+	writeBuffer.release();
+	writeBufferCapacity = 0;
+
+	file.close();
+	if (file.open(filename, FileAccessMode::Write, FileOpenMode::Override))
+		file.close();
+}
+
+void AutosaveJournal::update(CanvasManager& canvasManager)
+{
+	if (!thread.isInitialized())
+		return;
+
+	if (!collecting)
+	{
+		if (failed)
+		{
+			failed = false;
+			appendPending = false;
+			canvasManager.resetAutosaveChanges();
+		}
+
+		if (Timer::GetTimeDelta(lastAutosaveTime) < interval)
+			return;
+		lastAutosaveTime = Timer::GetRecord();
+
+		canvasManager.collectAutosaveChanges(changes);
+		if (changes.isEmpty())
+			return;
+
+		collecting = true;
+		layerOpsSent = false;
+		readTileCount = 0;
+	}
+
+	// Batch is filled only after journal thread returns one, so slow disk delays autosave
+	// instead of painting.
+	if (freeBatches.isEmpty())
+		return;
+
+	Batch &batch = *freeBatches.dequeue();
+	batch.layerOps.clear();
+	batch.tileCount = 0;
+	batch.hasCanvasRecord = false;
+	batch.restart = false;
+
+	if (!layerOpsSent)
+	{
+		batch.hasCanvasRecord = changes.canvasReset;
+		batch.canvas = changes.canvas;
+		// Previous sessions are made obsolete by canvas record.
+		batch.restart = changes.canvasReset && !appendPending;
+		if (changes.canvasReset)
+			appendPending = false;
+
+		for (const AutosaveLayerOp &op : changes.layerOps)
+			batch.layerOps.pushBack(op);
+		layerOpsSent = true;
+	}
+
+	Device &device = changes.pool->getDevice();
+	uint32 changedTileCount = changes.tiles.getSize();
+
+	while (readTileCount < changedTileCount && batch.tileCount < batchTileLimit)
+	{
+		AutosaveChangeSet::ChangedTile &changedTile = changes.tiles[readTileCount++];
+		BatchTile &tile = batch.tiles[batch.tileCount];
+		tile.tileIndex = changedTile.tileIndex;
+		tile.layerIndex = changedTile.layerIndex;
+		tile.isUniform = !changedTile.tile || changedTile.tile->isUniform;
+		tile.uniformColor = changedTile.tile ? changedTile.tile->uniformColor : Color(0);
+
+		if (!tile.isUniform)
+		{
+			device.downloadTexture(changedTile.tile->texture, rectu32(0, 0, LayerTileSize, LayerTileSize),
+				batch.pixels + uintptr(batch.tileCount) * TileCodec::TilePixelCount);
+		}
+
+		// Read back tile is no longer held, so canvas does not have to unshare it.
+		changes.pool->release(changedTile.tile);
+		changedTile.tile = nullptr;
+		batch.tileCount++;
+	}
+
+	batch.last = readTileCount == changedTileCount;
+	if (batch.last)
+	{
+		changes.release();
+		collecting = false;
+	}
+
+	filledBatches.enqueue(&batch);
+}
+
+void AutosaveJournal::restart(CanvasManager& canvasManager)
+{
+	if (!thread.isInitialized())
+		return;
+
+	changes.release();
+	collecting = false;
+	appendPending = false;
+	canvasManager.resetAutosaveChanges();
+}
+
+// AutosaveJournalReader ====================================================================//
+
+bool AutosaveJournalReader::open(const wchar* filename)
+{
+	close();
+
+	if (!mapping.open(filename))
+		return false;
+
+	AutosaveRecordHeader header;
+	const byte *payload = nullptr;
+	if (!readRecord(header, payload) || header.type != AutosaveRecordType::Canvas)
+	{
+		close();
+		return false;
+	}
+
+	position = 0;
+	session = 0;
+	return true;
+}
+
+void AutosaveJournalReader::close()
+{
+	mapping.close();
+	position = 0;
+	session = 0;
+}
+
+// Session may change only to greater one and only at canvas record.
+bool AutosaveJournalReader::readRecord(AutosaveRecordHeader& header, const byte*& payload)
+{
+	uint64 size = mapping.getSize();
+	if (size - position < sizeof(AutosaveRecordHeader))
+		return false;
+
+	const byte *record = to<const byte*>(mapping.getData()) + position;
+	Memory::Copy(&header, record, sizeof(AutosaveRecordHeader));
+
+	if (header.magic != AutosaveRecordMagic ||
+		header.payloadSize > size - position - sizeof(AutosaveRecordHeader))
+	{
+		return false;
+	}
+
+	bool sessionValid = header.session == session ||
+		(header.session > session && header.type == AutosaveRecordType::Canvas);
+	if (!sessionValid)
+		return false;
+
+	AutosaveRecordHeader zeroedHeader = header;
+	zeroedHeader.crc = 0;
+
+	CRC32 crc;
+	crc.process(zeroedHeader);
+	crc.process(record + sizeof(AutosaveRecordHeader), header.payloadSize);
+	if (crc.getValue() != header.crc)
+		return false;
+
+	payload = record + sizeof(AutosaveRecordHeader);
+	position += sizeof(AutosaveRecordHeader) + header.payloadSize;
+	session = header.session;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Heap.h>
+#include <XLib.Containers.Vector.h>
+#include <XLib.System.File.h>
+#include <XLib.System.Timer.h>
+#include <XLib.System.Threading.h>
+#include <XLib.System.Threading.CyclicQueue.h>
+
+#include "Panter.TiledLayer.h"
+
+namespace Panter
+{
+	class CanvasManager;
+
+	// Append-only crash recovery journal of canvas. Journal is a sequence of records:
+	//   header | payload
+	// Every header holds CRC32 of itself and payload. Session starts with canvas record and
+	// all layer tiles, following autosaves append only layer operations and tiles changed
+	// since previous autosave, so their cost is proportional to edits, not to canvas size.
+	// Recovery replays records up to the first invalid one, which is where crash interrupted
+	// writing. Records written after recovery start new session with greater number, so
+	// leftovers of interrupted session behind them are never replayed. Canvas record empties
+	// journal, so it holds only one session, except for recovered one which is kept until
+	// first session after it is written.
+
+	enum class AutosaveRecordType : uint16
+	{
+		None = 0,
+
+		Canvas,				// Resets canvas to empty layers. Payload is AutosaveCanvasRecord.
+		Tile,				// Payload is compressed tile.
+		UniformTile,		// Payload is color. Transparent color means missing tile.
+		LayerInsert,		// Empty layer, argument is visibility.
+		LayerRemove,
+		LayerSwap,			// Argument is other layer index.
+		LayerVisibility,	// Argument is visibility.
+	};
+
+	struct AutosaveRecordHeader
+	{
+		uint32 magic;
+		uint32 session;
+		AutosaveRecordType type;
+		uint16 layerIndex;
+		uint32 argument;		// Tile index for tile records.
+		uint32 payloadSize;
+		uint32 crc;				// Of header with this field zeroed and of payload.
+	};
+
+	struct AutosaveCanvasRecord
+	{
+		uint32x2 canvasSize;
+		uint16 layerCount;
+		uint16 currentLayer;
+		uint16 visibleLayerFlags;	// Bit per layer.
+		uint16 reserved;
+	};
+
+	struct AutosaveLayerOp
+	{
+		AutosaveRecordType type;
+		uint16 layerIndex;
+		uint32 argument;
+	};
+
+	// Canvas changes collected since previous autosave. Tiles are shared with canvas like in
+	// snapshot, so they can be read back over several frames while painting continues. Has
+	// to be released on the thread owning canvas and before canvas is destroyed.
+
+	class AutosaveChangeSet : public XLib::NonCopyable
+	{
+		friend class CanvasManager;
+		friend class AutosaveJournal;
+
+	private:
+		struct ChangedTile
+		{
+			LayerTile *tile;	// nullptr means transparent tile.
+			uint32 tileIndex;
+			uint16 layerIndex;
+		};
+
+		LayerTilePool *pool = nullptr;
+		XLib::Vector<AutosaveLayerOp> layerOps;
+		XLib::Vector<ChangedTile> tiles;
+		AutosaveCanvasRecord canvas = {};
+		bool canvasReset = false;	// Tiles are all non-empty tiles of canvas.
+
+	public:
+		AutosaveChangeSet() = default;
+		~AutosaveChangeSet() = default;
+
+		void release();
+
+		inline bool isEmpty() const { return !canvasReset && layerOps.isEmpty() && tiles.isEmpty(); }
+	};
+
+	// Autosave is collected on canvas thread when interval passes. Changed tiles are read back
+	// few per frame into batches, which are compressed and written on journal thread. Journal
+	// is flushed to disk after last batch of every autosave. If writing fails, canvas is
+	// reset for autosave, so next autosave starts new journal.
+
+	class AutosaveJournal : public XLib::NonCopyable
+	{
+	private:
+		static constexpr uint32 batchTileLimit = 16;
+
+		struct BatchTile
+		{
+			uint32 tileIndex;
+			uint16 layerIndex;
+			XLib::Color uniformColor;
+			bool isUniform;
+		};
+
+		struct Batch
+		{
+			XLib::Vector<AutosaveLayerOp> layerOps;
+			XLib::HeapPtr<uint32> pixels;
+			BatchTile tiles[batchTileLimit];
+			AutosaveCanvasRecord canvas;
+			uint32 tileCount;
+			bool hasCanvasRecord;
+			bool restart;			// Journal is emptied before batch.
+			bool last;				// File is flushed after batch.
+		};
+
+		using BatchQueue = XLib::ThreadSafeCyclicQueue<Batch*, 1, XLib::ThreadSafeQueueType::SingleProducerSingleConsumer>;
+
+		// Journal thread state.
+		XLib::File file;
+		XLib::HeapPtr<byte> writeBuffer;
+		uintptr writeBufferCapacity = 0;
+		uintptr writeBufferSize = 0;
+		uint32 session = 0;
+
+		// Shared state.
+		const wchar *filename = nullptr;
+		Batch batches[2];
+		BatchQueue filledBatches;	// nullptr stops thread.
+		BatchQueue freeBatches;
+		XLib::Thread thread;
+		volatile bool failed = false;
+
+		// Canvas thread state.
+		AutosaveChangeSet changes;
+		XLib::TimerRecord lastAutosaveTime = 0;
+		float32 interval = 0.0f;
+		uint32 readTileCount = 0;
+		bool collecting = false;
+		bool layerOpsSent = false;
+		bool appendPending = false;	// Next canvas record follows recovered session.
+
+		static uint32 __stdcall ThreadMain(AutosaveJournal* self);
+		// Payload is written to returned pointer, then record is completed with its size.
+		byte* allocateRecord(uintptr maxPayloadSize);
+		void finishRecord(AutosaveRecordType type, uint16 layerIndex, uint32 argument, uint32 payloadSize);
+		void writeBatch(Batch& batch);
+
+	public:
+		AutosaveJournal() = default;
+		inline ~AutosaveJournal() { destroy(); }
+
+		// Previous journal contents are discarded, unless append offset of recovered journal is
+		// given. Next autosave writes whole canvas. File name is referenced, not copied.
+		void initialize(CanvasManager& canvasManager, const wchar* filename, float32 interval,
+			uint64 appendOffset = 0, uint32 lastSession = 0);
+		// Journal is emptied, so there is nothing to recover after clean exit.
+		void destroy();
+
+		// Called every frame on thread owning canvas.
+		void update(CanvasManager& canvasManager);
+		// Discards journal and starts new one with whole canvas, e.g. after project is saved.
+		void restart(CanvasManager& canvasManager);
+
+		inline bool isCollecting() const { return collecting; }
+		inline bool isInitialized() { return thread.isInitialized(); }
+	};
+
+	class AutosaveJournalReader : public XLib::NonCopyable
+	{
+	private:
+		XLib::FileMapping mapping;
+		uint64 position = 0;
+		uint32 session = 0;
+
+	public:
+		AutosaveJournalReader() = default;
+		~AutosaveJournalReader() = default;
+
+		// Returns false if journal does not start with valid canvas record.
+		bool open(const wchar* filename);
+		void close();
+
+		// Returns false at end of journal or at first invalid record.
+		bool readRecord(AutosaveRecordHeader& header, const byte*& payload);
+
+		// End of records read so far, new session is appended there.
+		inline uint64 getValidSize() const { return position; }
+		inline uint32 getSession() const { return session; }
+		inline bool isOpen() { return mapping.isInitialized(); }
+	};
+}
\ No newline at end of file
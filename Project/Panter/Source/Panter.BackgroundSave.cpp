@@ -0,0 +1,128 @@
+#include "Panter.BackgroundSave.h"
+
+#include <XLib.System.Profiler.h>
+
+using namespace XLib;
+using namespace Panter;
+
+uint32 __stdcall BackgroundImageSave::ThreadMain(BackgroundImageSave* self)
+{
+	ProfileThreadName("Background save");
+
+	for (;;)
+	{
+		self->encodeEvent.wait();
+		if (self->threadStopping)
+			break;
+
+		{
+			ProfileScope("Background save");
+			SaveImageToFile(self->filename.c_str(), self->format,
+				self->pixels, self->size.x, self->size.y, &self->encodeProgress);
+		}
+
+		self->threadFinished = true;
+	}
+
+	return 0;
+}
+
+BackgroundImageSave::~BackgroundImageSave()
+{
+	cancel();
+
+	if (thread.isInitialized())
+	{
+		// Save in progress, if any, is finished before thread sees stop request.
+		threadStopping = true;
+		encodeEvent.set();
+		thread.wait();
+		thread.destroy();
+		encodeEvent.destroy();
+	}
+}
+
+bool BackgroundImageSave::start(CanvasManager& canvasManager, const wchar* _filename, ImageFormat _format)
+{
+	if (state != BackgroundSaveState::Idle)
+		return false;
+
+	canvasManager.captureSnapshot(snapshot);
+	size = snapshot.getCanvasSize();
+	pixels = HeapPtr<byte>(uintptr(size.x) * size.y * 4);
+	mergedTileRowCount = 0;
+	filename.assign(_filename);
+	format = _format;
+
+	state = BackgroundSaveState::ReadingCanvas;
+	return true;
+}
+
+void BackgroundImageSave::update(CanvasManager& canvasManager)
+{
+	switch (state)
+	{
+		case BackgroundSaveState::ReadingCanvas:
+		{
+			uint32 tileRowCount = snapshot.getTileRowCount();
+			uint32 endTileRow = min(mergedTileRowCount + tileRowsPerUpdate, tileRowCount);
+			canvasManager.downloadMergedSnapshot(snapshot, mergedTileRowCount, endTileRow, pixels);
+			mergedTileRowCount = endTileRow;
+
+			if (mergedTileRowCount < tileRowCount)
+				break;
+
+			// Everything is read back, so shared tiles are no longer held.
+			snapshot.release();
+
+			encodeProgress.encodedRowCount = 0;
+			encodeProgress.cancelled = false;
+			threadFinished = false;
+			state = BackgroundSaveState::Encoding;
+
+			if (!thread.isInitialized())
+			{
+				encodeEvent.initialize(false, false);
+				thread.create(ThreadMain, this);
+			}
+			encodeEvent.set();
+			break;
+		}
+
+		case BackgroundSaveState::Encoding:
+			if (!threadFinished)
+				break;
+
+			pixels.release();
+			state = BackgroundSaveState::Idle;
+			break;
+	}
+}
+
+void BackgroundImageSave::cancel()
+{
+	switch (state)
+	{
+		case BackgroundSaveState::ReadingCanvas:
+			snapshot.release();
+			pixels.release();
+			state = BackgroundSaveState::Idle;
+			break;
+
+		// Save is finished by update() after encoder notices cancellation.
+		case BackgroundSaveState::Encoding:
+			encodeProgress.cancelled = true;
+			break;
+	}
+}
+
+// Reading back and encoding are counted as equal halves of work.
+float32 BackgroundImageSave::getProgress() const
+{
+	if (state == BackgroundSaveState::Idle || !size.y)
+		return 0.0f;
+
+	uint32 mergedRowCount = min(mergedTileRowCount << LayerTileSizeLog2, size.y);
+	uint32 encodedRowCount = state == BackgroundSaveState::Encoding ? encodeProgress.encodedRowCount : 0;
+	return float32(mergedRowCount + encodedRowCount) / float32(size.y * 2);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Heap.h>
+#include <XLib.System.Threading.h>
+#include <XLib.System.Threading.Event.h>
+
+#include "Panter.CanvasManager.h"
+#include "Panter.PngCodec.h"
+
+#include "FileUtil.h"
+
+namespace Panter
+{
+	enum class BackgroundSaveState : uint8
+	{
+		Idle = 0,
+		ReadingCanvas,	// Snapshot is merged on canvas thread, few tile rows per frame.
+		Encoding,		// Image is encoded and written on save thread.
+	};
+
+	// Saves merged canvas image without blocking painting. Canvas snapshot is read back by
+	// update() calls over several frames, then image is encoded and written on own thread.
+	// Encoding can be cancelled only for PNG, other formats are always written once started.
+	// Save thread is created by first save and waits for next one after it, so worker pool
+	// and profiler keep seeing the same thread during session.
+
+	class BackgroundImageSave : public XLib::NonCopyable
+	{
+	private:
+		static constexpr uint32 tileRowsPerUpdate = 2;
+
+		CanvasSnapshot snapshot;
+		XLib::HeapPtr<byte> pixels;
+		uint32x2 size = { 0, 0 };
+		uint32 mergedTileRowCount = 0;
+		std::wstring filename;
+		ImageFormat format = ImageFormat::None;
+
+		XLib::Thread thread;
+		XLib::Event encodeEvent;		// Set when image is ready to be encoded.
+		PngEncodeProgress encodeProgress = {};
+		volatile bool threadFinished = false;
+		volatile bool threadStopping = false;
+		BackgroundSaveState state = BackgroundSaveState::Idle;
+
+		static uint32 __stdcall ThreadMain(BackgroundImageSave* self);
+
+	public:
+		BackgroundImageSave() = default;
+		~BackgroundImageSave();
+
+		// Returns false if previous save is still in progress.
+		bool start(CanvasManager& canvasManager, const wchar* filename, ImageFormat format);
+		// Called every frame on thread owning canvas.
+		void update(CanvasManager& canvasManager);
+		void cancel();
+
+		float32 getProgress() const;
+		inline BackgroundSaveState getState() const { return state; }
+		inline bool isActive() const { return state != BackgroundSaveState::Idle; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include <immintrin.h>
+
+#include <XLib.Debug.h>
+#include <XLib.Memory.h>
+#include <XLib.Vectors.Arithmetics.h>
+#include <XLib.Vectors.Math.h>
+#include <XLib.System.Profiler.h>
+
+#include "Panter.BrushEngine.h"
+
+using namespace XLib;
+using namespace Panter;
+
+// (x + 128 + ((x + 128) >> 8)) >> 8 is exact rounded x / 255 for products of two bytes.
+static inline __m128i DivideBy255(__m128i value)
+{
+	value = _mm_add_epi16(value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+uint8* BrushEngine::getCoverageTile(uint32 tileIndex)
+{
+	uint8 *&tile = coverageTiles[tileIndex];
+	if (!tile)
+	{
+		tile = freeCoverageTiles.isEmpty() ?
+			Heap::Allocate<uint8>(coverageTileSize) : freeCoverageTiles.popBack();
+		Memory::Set(tile, 0, coverageTileSize);
+		strokeTiles.pushBack(tileIndex);
+	}
+	return tile;
+}
+
+void BrushEngine::drawDab(float32x2 center, float32 radius, const rectu32& clipRect)
+{
+	// Coverage falls from one to zero across one pixel wide band centered on dab edge.
+
+	float32 extent = radius + 1.0f;
+	rectu32 dabRect = IntersectRects(clipRect, rectu32(
+		uint32(max(center.x - extent, 0.0f)), uint32(max(center.y - extent, 0.0f)),
+		uint32(min(max(center.x + extent + 1.0f, 0.0f), 1.0e9f)),
+		uint32(min(max(center.y + extent + 1.0f, 0.0f), 1.0e9f))));
+
+	if (IsEmptyRect(dabRect))
+		return;
+
+	dirtyRegion.add(dabRect);
+	strokeDabCount++;
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 centerX = _mm_set1_ps(center.x);
+	const __m128 edge = _mm_set1_ps(radius + 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+
+	rectu32 tileRange(dabRect.left >> LayerTileSizeLog2, dabRect.top >> LayerTileSizeLog2,
+		((dabRect.right - 1) >> LayerTileSizeLog2) + 1, ((dabRect.bottom - 1) >> LayerTileSizeLog2) + 1);
+
+	for (uint32 tileY = tileRange.top; tileY < tileRange.bottom; tileY++)
+	{
+		for (uint32 tileX = tileRange.left; tileX < tileRange.right; tileX++)
+		{
+			uint32x2 tileLeftTop = uint32x2(tileX, tileY) << LayerTileSizeLog2;
+			rectu32 rect = IntersectRects(dabRect,
+				rectu32(tileLeftTop, tileLeftTop + uint32x2(LayerTileSize, LayerTileSize)));
+			if (IsEmptyRect(rect))
+				continue;
+
+			uint8 *coverage = getCoverageTile(tileY * gridSize.x + tileX);
+
+			// Groups of 16 pixels start at aligned offsets inside tile, pixels of group outside
+			// of rect get zero coverage and keep their values.
+			uint32 groupsLeft = rect.left & ~15u;
+			const __m128 rectLeft = _mm_set1_ps(float32(rect.left));
+			const __m128 rectRight = _mm_set1_ps(float32(rect.right));
+
+			for (uint32 y = rect.top; y < rect.bottom; y++)
+			{
+				float32 dy = float32(y) + 0.5f - center.y;
+				const __m128 dySquared = _mm_set1_ps(dy * dy);
+				uint8 *row = coverage + (y - tileLeftTop.y) * LayerTileSize;
+
+				for (uint32 x = groupsLeft; x < rect.right; x += 16)
+				{
+					__m128i quads[4];
+					for (uint32 i = 0; i < 4; i++)
+					{
+						__m128 px = _mm_add_ps(_mm_set1_ps(float32(x + i * 4)), laneOffsets);
+						__m128 dx = _mm_sub_ps(px, centerX);
+						__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), dySquared));
+						__m128 value = _mm_min_ps(_mm_max_ps(_mm_sub_ps(edge, distance), zero), one);
+						__m128 inside = _mm_and_ps(_mm_cmpgt_ps(px, rectLeft), _mm_cmplt_ps(px, rectRight));
+						quads[i] = _mm_cvtps_epi32(_mm_mul_ps(_mm_and_ps(value, inside), scale));
+					}
+
+					__m128i values = _mm_packus_epi16(
+						_mm_packs_epi32(quads[0], quads[1]), _mm_packs_epi32(quads[2], quads[3]));
+
+					__m128i *dst = (__m128i*)(row + x - tileLeftTop.x);
+					_mm_storeu_si128(dst, _mm_max_epu8(_mm_loadu_si128(dst), values));
+				}
+			}
+		}
+	}
+}
+
+void BrushEngine::initialize(uint32x2 canvasSize)
+{
+	endStroke();
+
+	this->canvasSize = canvasSize;
+	gridSize =
+	{
+		(canvasSize.x + LayerTileSize - 1) >> LayerTileSizeLog2,
+		(canvasSize.y + LayerTileSize - 1) >> LayerTileSizeLog2,
+	};
+
+	uint32 tileCount = gridSize.x * gridSize.y;
+	coverageTiles = HeapPtr<uint8*>(tileCount);
+	for (uint32 i = 0; i < tileCount; i++)
+		coverageTiles[i] = nullptr;
+
+	if (!resolveBuffer.isAllocated())
+		resolveBuffer = HeapPtr<uint32>(LayerTileSize * LayerTileSize);
+
+	dirtyRegion.initialize(canvasSize);
+}
+
+void BrushEngine::destroy()
+{
+	endStroke();
+
+	for (uint8 *tile : freeCoverageTiles)
+		Heap::Release(tile);
+	freeCoverageTiles.clear();
+
+	coverageTiles.release();
+	resolveBuffer.release();
+	canvasSize = { 0, 0 };
+	gridSize = { 0, 0 };
+}
+
+void BrushEngine::addSample(float32x2 position, float32 pressure)
+{
+	pendingSamples.pushBack({ position, saturate<float32>(pressure) });
+	strokeInProgress = true;
+}
+
+void BrushEngine::update(float32 width, const rectu32& clipRect)
+{
+	if (pendingSamples.isEmpty())
+		return;
+
+	ProfileFunction();
+
+	rectu32 dabClipRect = IntersectRects(clipRect, rectu32(0, 0, canvasSize));
+	float32 fullPressureRadius = width * 0.5f;
+	uint32 prevStrokeDabCount = strokeDabCount;
+
+	auto getDabRadius = [&](float32 pressure) -> float32
+		{ return max(fullPressureRadius * pressure, MinDabRadius); };
+	auto getDabSpacing = [&](float32 radius) -> float32
+		{ return max(radius * 2.0f * DabSpacing, MinDabSpacing); };
+
+	for (const BrushSample &sample : pendingSamples)
+	{
+		if (!hasLastSample)
+		{
+			float32 radius = getDabRadius(sample.pressure);
+			drawDab(sample.position, radius, dabClipRect);
+
+			lastSample = sample;
+			nextDabDistance = getDabSpacing(radius);
+			hasLastSample = true;
+			continue;
+		}
+
+		// Spacing is never zero, so segment is not empty when loop is entered.
+		float32x2 delta = sample.position - lastSample.position;
+		float32 length = VectorMath::Length(delta);
+		float32 distance = nextDabDistance;
+
+		while (distance <= length)
+		{
+			float32 t = distance / length;
+			float32 radius = getDabRadius(lastSample.pressure + (sample.pressure - lastSample.pressure) * t);
+			drawDab(lastSample.position + delta * t, radius, dabClipRect);
+			distance += getDabSpacing(radius);
+		}
+
+		nextDabDistance = distance - length;
+		lastSample = sample;
+	}
+
+	pendingSamples.clear();
+
+	ProfileCounter("Brush dabs", strokeDabCount - prevStrokeDabCount);
+}
+
+void BrushEngine::resolve(TiledLayer& target, Color color)
+{
+	if (dirtyRegion.isEmpty())
+		return;
+
+	ProfileFunction();
+
+	// Target is straight alpha. Color channels of pixels without coverage are zeroed, so
+	// untouched regions stay recognizable as transparent.
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi16(color.a);
+	const __m128i rgb = _mm_set1_epi32(sint32(color.rgba & 0x00FF'FFFF));
+
+	for (uint32 tileIndex : dirtyRegion.getDirtyTiles())
+	{
+		const rectu32 &rect = dirtyRegion.getTileDirtyRect(tileIndex);
+		uint32x2 tileLeftTop = uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x) << LayerTileSizeLog2;
+		const uint8 *coverage = coverageTiles[tileIndex];
+		uint32 width = rect.getWidth();
+		uint32 stride = (width + 15) & ~15u;
+
+		for (uint32 y = rect.top; y < rect.bottom; y++)
+		{
+			const uint8 *srcRow = coverage + (y - tileLeftTop.y) * LayerTileSize + (rect.left - tileLeftTop.x);
+			uint32 *dstRow = resolveBuffer + (y - rect.top) * stride;
+
+			for (uint32 x = 0; x < width; x += 16)
+			{
+				__m128i values = _mm_loadu_si128((const __m128i*)(srcRow + x));
+				__m128i alphas = _mm_packus_epi16(
+					DivideBy255(_mm_mullo_epi16(_mm_unpacklo_epi8(values, zero), alpha)),
+					DivideBy255(_mm_mullo_epi16(_mm_unpackhi_epi8(values, zero), alpha)));
+
+				// Interleaving with zeros twice moves every alpha to top byte of its pixel.
+				__m128i alphaPairs[2] =
+				{
+					_mm_unpacklo_epi8(zero, alphas),
+					_mm_unpackhi_epi8(zero, alphas),
+				};
+
+				__m128i *dst = (__m128i*)(dstRow + x);
+				for (uint32 i = 0; i < 4; i++)
+				{
+					__m128i pixels = (i & 1) ?
+						_mm_unpackhi_epi16(zero, alphaPairs[i >> 1]) :
+						_mm_unpacklo_epi16(zero, alphaPairs[i >> 1]);
+					__m128i uncovered = _mm_cmpeq_epi32(pixels, zero);
+					_mm_storeu_si128(dst + i, _mm_or_si128(pixels, _mm_andnot_si128(uncovered, rgb)));
+				}
+			}
+		}
+
+		target.upload(rect, resolveBuffer, stride * 4);
+	}
+
+	dirtyRegion.clear();
+}
+
+void BrushEngine::endStroke()
+{
+	for (uint32 tileIndex : strokeTiles)
+	{
+		uint8 *tile = coverageTiles[tileIndex];
+		coverageTiles[tileIndex] = nullptr;
+
+		if (freeCoverageTiles.getSize() < freeCoverageTileCountLimit)
+			freeCoverageTiles.pushBack(tile);
+		else
+			Heap::Release(tile);
+	}
+
+	strokeTiles.clear();
+	pendingSamples.clear();
+	dirtyRegion.clear();
+
+	strokeDabCount = 0;
+	strokeInProgress = false;
+	hasLastSample = false;
+}
\ No newline at end of file
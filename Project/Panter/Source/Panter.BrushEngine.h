@@ -0,0 +1,80 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Heap.h>
+#include <XLib.Containers.Vector.h>
+
+#include "Panter.TiledLayer.h"
+
+namespace Panter
+{
+	struct BrushSample
+	{
+		float32x2 position;		// Canvas space.
+		float32 pressure;		// Zero to one, scales dab radius.
+	};
+
+	// Brush stroke as round dabs stamped at even distance along polyline through pointer
+	// samples. Pressure is interpolated between samples, so sparse samples of fast strokes
+	// still give smooth outline and cost depends on stroke length, not on sample count.
+	//
+	// Dab coverage is accumulated on CPU to sparse per tile buffers as maximum of overlapping
+	// dabs, so translucent stroke is blended with layer once and does not darken where dabs
+	// overlap. Coverage changed since last resolve is expanded to stroke color and uploaded to
+	// target layer, which is done once per frame.
+
+	class BrushEngine : public XLib::NonCopyable
+	{
+	public:
+		static constexpr float32 DabSpacing = 0.1f;		// Of dab diameter.
+		static constexpr float32 MinDabSpacing = 0.5f;
+		static constexpr float32 MinDabRadius = 0.5f;
+
+	private:
+		static constexpr uint32 coverageTileSize = LayerTileSize * LayerTileSize + 16;	// SIMD reads may pass last row.
+		static constexpr uint32 freeCoverageTileCountLimit = 64;
+
+		XLib::HeapPtr<uint8*> coverageTiles;		// Per layer tile, nullptr if stroke does not touch it.
+		XLib::Vector<uint32> strokeTiles;
+		XLib::Vector<uint8*> freeCoverageTiles;
+		XLib::Vector<BrushSample> pendingSamples;
+		XLib::HeapPtr<uint32> resolveBuffer;
+		DirtyRegion dirtyRegion;					// Coverage changed since last resolve.
+		uint32x2 canvasSize = { 0, 0 };
+		uint32x2 gridSize = { 0, 0 };
+
+		BrushSample lastSample = {};
+		float32 nextDabDistance = 0.0f;				// From last sample along next segment.
+		uint32 strokeDabCount = 0;
+		bool strokeInProgress = false;
+		bool hasLastSample = false;
+
+		uint8* getCoverageTile(uint32 tileIndex);
+		void drawDab(float32x2 center, float32 radius, const rectu32& clipRect);
+
+	public:
+		BrushEngine() = default;
+		inline ~BrushEngine() { destroy(); }
+
+		// Stroke in progress is dropped.
+		void initialize(uint32x2 canvasSize);
+		void destroy();
+
+		// Starts stroke if there is none in progress.
+		void addSample(float32x2 position, float32 pressure = 1.0f);
+		// Stamps dabs along samples added since previous update. Width is dab diameter at
+		// full pressure, dabs are clipped to rect.
+		void update(float32 width, const rectu32& clipRect);
+		// Writes color with alpha scaled by coverage to pixels changed since previous resolve.
+		void resolve(TiledLayer& target, XLib::Color color);
+		// Drops coverage. Buffers are kept for next stroke.
+		void endStroke();
+
+		inline DirtyRegion& getDirtyRegion() { return dirtyRegion; }
+		inline uint32 getStrokeDabCount() const { return strokeDabCount; }
+		inline bool isStrokeInProgress() const { return strokeInProgress; }
+	};
+}
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include <XLib.Debug.h>
+#include <XLib.Memory.h>
 #include <XLib.Vectors.Arithmetics.h>
 #include <XLib.Vectors.Math.h>
+#include <XLib.System.Profiler.h>
 
 #include "Panter.CanvasManager.h"
 
 #include "Panter.Constants.h"
+#include "Panter.InputTrace.h"
+#include "Panter.GaussianBlur.h"
 
 using namespace XLib;
 using namespace XLib::Graphics;
@@ -63,49 +67,94 @@ void CanvasManager::updateInstrument_selection()
 
 void CanvasManager::updateInstrument_pencil()
 {
-	InstrumentState_Pencil &state = instrumentState.pencil;
 	PencilSettings &settings = instrumentSettings.pencil;
 
-	if (!pointerIsActive)
-		return;
-	if (prevPointerPosition == pointerPosition)
-		return;
+	if (pencilStroke.getSize() != pencilStrokeDrawnPointCount)
+	{
+		// Stroke is single polyline, so segments do not blend over each other at joins. Tiles
+		// around new points and previous stroke end are cleared, and whole stroke is drawn again
+		// clipped to them, which takes single flush per frame.
 
-	device->setRenderTarget(layerTextures[currentLayer]);
-	device->setViewport(rectu32(0, 0, canvasSize));
-	device->setScissorRect(selection);
-	device->setTransform2D(Matrix2x3::Identity());
+		const float32 width = 1.0f;
+		const float32 margin = width * 0.5f * GeometryGenerator::MiterLimit + 1.0f;
+
+		uint32 firstChangedPoint = pencilStrokeDrawnPointCount ? pencilStrokeDrawnPointCount - 1 : 0;
+		rectf32 bounds(pencilStroke[firstChangedPoint], pencilStroke[firstChangedPoint]);
+		for (uint32 i = firstChangedPoint + 1; i < pencilStroke.getSize(); i++)
+		{
+			float32x2 point = pencilStroke[i];
+			bounds.left   = min(bounds.left, point.x);
+			bounds.top    = min(bounds.top, point.y);
+			bounds.right  = max(bounds.right, point.x);
+			bounds.bottom = max(bounds.bottom, point.y);
+		}
+
+		rectu32 changedRect = IntersectRects(selection, rectu32(
+			uint32(max(bounds.left - margin, 0.0f)), uint32(max(bounds.top - margin, 0.0f)),
+			uint32(min(max(bounds.right + margin + 1.0f, 0.0f), 1.0e9f)),
+			uint32(min(max(bounds.bottom + margin + 1.0f, 0.0f), 1.0e9f))));
+
+		if (!IsEmptyRect(changedRect))
+		{
+			rectu32 tileRange = tempLayer.getTileRange(changedRect);
+			for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+			{
+				for (uint32 x = tileRange.left; x < tileRange.right; x++)
+					tempLayer.setTile(uint32x2(x, y), nullptr);
+			}
 
-	float32x2 segmentBegin = float32x2(prevPointerPosition) * viewToCanvasTransform;
-	float32x2 segmentEnd = float32x2(pointerPosition) * viewToCanvasTransform;
+			rectu32 clearedRect(tempLayer.getTileRect(tileRange.leftTop).leftTop,
+				tempLayer.getTileRect(tileRange.rightBottom - uint32x2(1, 1)).rightBottom);
 
-	geometryGenerator.drawLine(segmentBegin, segmentEnd, 1.0f, settings.color);
-	geometryGenerator.flush();
+			beginLayerGeometry(tempLayer, IntersectRects(selection, clearedRect));
+			geometryGenerator.drawPolyline(pencilStroke, pencilStroke.getSize(), width, settings.color);
+			endLayerGeometry();
+		}
+
+		pencilStrokeDrawnPointCount = pencilStroke.getSize();
+		enableTempLayerRendering = true;
+	}
+
+	if (!pointerIsActive)
+	{
+		// Whole stroke is single history entry.
+		if (!pencilStroke.isEmpty())
+			mergeCurrentLayerWithTemp();
+
+		pencilStroke.clear();
+		pencilStrokeDrawnPointCount = 0;
+		enableTempLayerRendering = false;
+	}
 }
 
 void CanvasManager::updateInstrument_brush()
 {
-	InstrumentState_Brush &state = instrumentState.brush;
 	BrushSettings &settings = instrumentSettings.brush;
 
-	if (!pointerIsActive)
-		return;
-	if (prevPointerPosition == pointerPosition)
+	if (!brushEngine.isStrokeInProgress())
 		return;
 
-	device->setRenderTarget(layerTextures[currentLayer]);
-	device->setViewport(rectu32(0, 0, canvasSize));
-	device->setScissorRect(selection);
-	device->setTransform2D(Matrix2x3::Identity());
-
-	float32x2 segmentBegin = float32x2(prevPointerPosition) * viewToCanvasTransform;
-	float32x2 segmentEnd = float32x2(pointerPosition) * viewToCanvasTransform;
-
 	if (!settings.blendEnabled)
 		settings.color.a = 255;
 
-	geometryGenerator.drawLine(segmentBegin, segmentEnd, settings.width, settings.color, true, true);
-	geometryGenerator.flush();
+	// Dabs of samples received since previous frame are stamped to stroke coverage, and
+	// changed coverage is resolved to temp layer once.
+	brushEngine.update(settings.width, selection);
+
+	DirtyRegion &strokeDirtyRegion = brushEngine.getDirtyRegion();
+	for (uint32 tileIndex : strokeDirtyRegion.getDirtyTiles())
+		markTempLayerDirty(strokeDirtyRegion.getTileDirtyRect(tileIndex));
+	brushEngine.resolve(tempLayer, settings.color);
+
+	enableTempLayerRendering = true;
+
+	if (!pointerIsActive)
+	{
+		// Whole stroke is single history entry.
+		mergeCurrentLayerWithTemp();
+		brushEngine.endStroke();
+		enableTempLayerRendering = false;
+	}
 }
 
 void CanvasManager::updateInstrument_line()
@@ -123,15 +172,14 @@ void CanvasManager::updateInstrument_line()
 
 	auto render = [&]()
 	{
-		device->clear(tempTexture, 0xFFFFFF00_rgba);
-		device->setRenderTarget(tempTexture);
-		device->setViewport(rectu32(0, 0, canvasSize));
-		device->setScissorRect(selection);
-		device->setTransform2D(Matrix2x3::Identity());
-
-		geometryGenerator.drawLine(state.startPosition, state.endPosition, settings.width,
-			settings.color, settings.roundedStart, settings.roundedEnd);
-		geometryGenerator.flush();
+		clearTempLayer();
+		beginLayerGeometry(tempLayer, selection);
+
+		float32x2 points[2] = { state.startPosition, state.endPosition };
+		geometryGenerator.drawPolyline(points, 2, settings.width, settings.color, LineJoin::Miter,
+			settings.roundedStart ? LineCap::Round : LineCap::Butt,
+			settings.roundedEnd ? LineCap::Round : LineCap::Butt);
+		endLayerGeometry();
 	};
 
 	if (state.apply)
@@ -271,11 +319,7 @@ void CanvasManager::updateInstrument_shape()
 
 	auto render = [&]()
 	{
-		device->clear(tempTexture, 0xFFFFFF00_rgba);
-		device->setRenderTarget(tempTexture);
-		device->setViewport(rectu32(0, 0, canvasSize));
-		device->setScissorRect(selection);
-		device->setTransform2D(Matrix2x3::Identity());
+		clearTempLayer();
 
 		rectf32 rect;
 		if (state.startPosition.x < state.endPosition.x)
@@ -300,10 +344,53 @@ void CanvasManager::updateInstrument_shape()
 			rect.bottom = state.startPosition.y;
 		}
 
+		// Fill and border are rasterized to buffer covering border bounds inside selection,
+		// which is then uploaded to temp layer. Paths are relative to buffer.
+		float32 w = settings.borderWidth * 0.5f;
+		rectu32 bufferRect = IntersectRects(selection, rectu32(
+			uint32(max(rect.left - w, 0.0f)), uint32(max(rect.top - w, 0.0f)),
+			uint32(min(max(rect.right + w + 1.0f, 0.0f), 1.0e9f)),
+			uint32(min(max(rect.bottom + w + 1.0f, 0.0f), 1.0e9f))));
+
+		if (IsEmptyRect(bufferRect))
+			return;
+
+		uint32x2 bufferSize = bufferRect.getSize();
+		uint32 pixelCount = bufferSize.x * bufferSize.y;
+		if (shapeBufferSize < pixelCount)
+		{
+			shapeBuffer.resize(pixelCount);
+			shapeBufferSize = pixelCount;
+		}
+		Memory::Set(shapeBuffer, 0, pixelCount * 4);
+
+		float32x2 origin(bufferRect.leftTop);
+		rect.leftTop -= origin;
+		rect.rightBottom -= origin;
+
 		if (settings.shape == Shape::Rectangle)
 		{
-			geometryGenerator.drawFilledRectWithBorder(rect,
-				settings.fillColor, settings.borderColor, settings.borderWidth);
+			rectf32 outer(rect.left - w, rect.top - w, rect.right + w, rect.bottom + w);
+			rectf32 inner(rect.left + w, rect.top + w, rect.right - w, rect.bottom - w);
+
+			// Border covers whole shape if there is no room for fill.
+			if (outer.getWidth() > settings.borderWidth * 2.0f &&
+				outer.getHeight() > settings.borderWidth * 2.0f)
+			{
+				shapeRasterizer.reset();
+				shapeRasterizer.addRect(inner);
+				shapeRasterizer.fill(shapeBuffer, 0, bufferSize, settings.fillColor);
+
+				shapeRasterizer.reset();
+				shapeRasterizer.addRect(outer);
+				shapeRasterizer.addRect(inner, true);
+			}
+			else
+			{
+				shapeRasterizer.reset();
+				shapeRasterizer.addRect(outer);
+			}
+			shapeRasterizer.fill(shapeBuffer, 0, bufferSize, settings.borderColor);
 		}
 		else if (settings.shape == Shape::Circle)
 		{
@@ -312,11 +399,17 @@ void CanvasManager::updateInstrument_shape()
 			float32x2 center((rect.left + rect.right) * 0.5f, (rect.top + rect.bottom) * 0.5f);
 			float32x2 radius = rect.getSize() * 0.5f;
 
-			geometryGenerator.drawFilledEllipse(center, radius, settings.fillColor);
-			geometryGenerator.drawEllipseBorder(center, radius, settings.borderColor, settings.borderWidth);
+			shapeRasterizer.reset();
+			shapeRasterizer.addEllipse(center, radius);
+			shapeRasterizer.fill(shapeBuffer, 0, bufferSize, settings.fillColor);
+
+			shapeRasterizer.reset();
+			shapeRasterizer.addEllipseBorder(center, radius, settings.borderWidth);
+			shapeRasterizer.fill(shapeBuffer, 0, bufferSize, settings.borderColor);
 		}
 
-		geometryGenerator.flush();
+		tempLayer.upload(bufferRect, shapeBuffer, bufferSize.x * 4);
+		markTempLayerDirty(bufferRect);
 	};
 
 	if (state.apply)
@@ -444,75 +537,364 @@ void CanvasManager::updateInstrument_shape()
 void CanvasManager::updateInstrument_filter(XLib::Graphics::CustomEffect& filterEffect,
 	const void* settings, uint32 settingsSize)
 {
+	ProfileFunction();
+
 	InstrumentState_Filter &state = instrumentState.filter;
 
 	if (state.outOfDate)
 	{
 		state.outOfDate = false;
 
+		clearTempLayer();
+		filterSourceDirtyRegion.addAll();
+	}
+
+	if (!filterSourceDirtyRegion.isEmpty())
+	{
+		// Filter is evaluated per tile. Source of each tile is assembled together with apron
+		// from neighbour tiles, so filter kernel can read across tile borders. Only pixels
+		// within apron of changed source pixels are reevaluated.
+
+		TiledLayer &layer = layers[currentLayer];
+		uint32x2 gridSize = layer.getGridSize();
+
+		for (uint32 tileIndex : filterSourceDirtyRegion.getDirtyTiles())
+		{
+			rectu32 dirtyRect = filterSourceDirtyRegion.getTileDirtyRect(tileIndex);
+			filterTargetDirtyRegion.add(IntersectRects(selection, InflateRect(dirtyRect, filterApronSize)));
+		}
+
+		filterSourceDirtyRegion.clear();
+
+		uploadQuadVertices(rectf32(0.0f, 0.0f, float32(filterTextureSize), float32(filterTextureSize)));
+
+		for (uint32 tileIndex : filterTargetDirtyRegion.getDirtyTiles())
 		{
-			float32x2 canvasSizeF(canvasSize);
+			uint32 x = tileIndex % gridSize.x;
+			uint32 y = tileIndex / gridSize.x;
+			uint32x2 tileCoords(x, y);
+			rectu32 tileRect = layer.getTileRect(tileCoords);
+			rectu32 dirtyRect = filterTargetDirtyRegion.getTileDirtyRect(tileIndex);
+			rectu32 neighbourRange(x ? x - 1 : 0, y ? y - 1 : 0,
+				min(x + 2, gridSize.x), min(y + 2, gridSize.y));
+
+			markTempLayerDirty(dirtyRect);
+
+			// Filters keep transparent pixels transparent, so empty surroundings can be skipped.
+			bool sourceEmpty = true;
+			for (uint32 ny = neighbourRange.top; ny < neighbourRange.bottom; ny++)
+			{
+				for (uint32 nx = neighbourRange.left; nx < neighbourRange.right; nx++)
+				{
+					if (layer.getTile(uint32x2(nx, ny)))
+						sourceEmpty = false;
+				}
+			}
+
+			if (sourceEmpty)
+			{
+				tempLayer.setTile(tileCoords, nullptr);
+				continue;
+			}
+
+			rectu32 sourceRegion = InflateRect(tileRect, filterApronSize);
 
-			VertexTexturedUnorm2D vertices[6];
-			vertices[0] = { { 0.0f,          0.0f          }, { 0,      0      } };
-			vertices[1] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-			vertices[2] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-			vertices[3] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-			vertices[4] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-			vertices[5] = { { canvasSizeF.x, canvasSizeF.y }, { 0xFFFF, 0xFFFF } };
+			device->clear(filterSourceTexture, 0);
 
-			device->uploadBuffer(quadVertexBuffer, vertices, 0, sizeof(vertices));
+			for (uint32 ny = neighbourRange.top; ny < neighbourRange.bottom; ny++)
+			{
+				for (uint32 nx = neighbourRange.left; nx < neighbourRange.right; nx++)
+				{
+					uint32x2 neighbourCoords(nx, ny);
+					LayerTile *neighbourTile = layer.getTile(neighbourCoords);
+					if (!neighbourTile)
+						continue;
+
+					rectu32 neighbourRect = layer.getTileRect(neighbourCoords);
+					rectu32 copiedRegion = IntersectRects(neighbourRect, sourceRegion);
+					if (IsEmptyRect(copiedRegion))
+						continue;
+
+					uint32x2 dstLocation(
+						copiedRegion.left + filterApronSize - tileRect.left,
+						copiedRegion.top + filterApronSize - tileRect.top);
+
+					device->copyTexture(filterSourceTexture, neighbourTile->texture,
+						dstLocation, MakeRectRelative(copiedRegion, neighbourRect.leftTop));
+				}
+			}
+
+			rectu32 filteredRegion = MakeRectRelative(dirtyRect, tileRect.leftTop);
+			filteredRegion.leftTop += uint32x2(filterApronSize, filterApronSize);
+			filteredRegion.rightBottom += uint32x2(filterApronSize, filterApronSize);
+
+			device->setRenderTarget(filterTargetTexture);
+			device->setViewport(rectu32(0, 0, filterTextureSize, filterTextureSize));
+			device->setScissorRect(filteredRegion);
+			device->setTransform2D(Matrix2x3::Identity());
+			device->setTexture(filterSourceTexture);
+			if (settingsSize)
+				device->setCustomEffectConstants(settings, settingsSize);
+
+			device->clear(filterTargetTexture, 0);
+			device->draw2D(PrimitiveType::TriangleList, filterEffect,
+				quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+
+			// Missing temp tile means that all its filtered pixels were transparent,
+			// so new tile is copied whole. Otherwise only reevaluated pixels are updated.
+			if (tempLayer.getTile(tileCoords))
+			{
+				LayerTile *tempTile = tempLayer.getWritableTile(tileCoords);
+				device->copyTexture(tempTile->texture, filterTargetTexture,
+					filteredRegion.leftTop - uint32x2(filterApronSize, filterApronSize), filteredRegion);
+			}
+			else
+			{
+				LayerTile *tempTile = tilePool.allocate();
+				device->copyTexture(tempTile->texture, filterTargetTexture, { 0, 0 },
+					rectu32(filterApronSize, filterApronSize,
+						filterApronSize + LayerTileSize, filterApronSize + LayerTileSize));
+				tempLayer.setTile(tileCoords, tempTile);
+			}
 		}
 
-		device->setRenderTarget(tempTexture);
-		device->setViewport(rectu32(0, 0, canvasSize));
-		device->setScissorRect(selection);
-		device->setTransform2D(Matrix2x3::Identity());
-		device->setTexture(layerTextures[currentLayer]);
-		if (settingsSize)
-			device->setCustomEffectConstants(settings, settingsSize);
+		filterTargetDirtyRegion.clear();
+	}
 
-		device->clear(tempTexture, 0);
-		device->draw2D(PrimitiveType::TriangleList, filterEffect,
-			quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+	if (state.apply)
+		applyFilterPreview();
+}
+
+void CanvasManager::updateInstrument_brightnessContrastGammaFilter()
+{
+	InstrumentState_Filter &state = instrumentState.filter;
+
+	if (state.outOfDate)
+	{
+		state.outOfDate = false;
+
+		clearTempLayer();
+		filterSourceDirtyRegion.addAll();
+	}
+
+	if (!filterSourceDirtyRegion.isEmpty())
+	{
+		// Filter is per pixel, so just changed pixels inside selection are remapped.
+
+		rectu32 filteredRegion = IntersectRects(selection, filterSourceDirtyRegion.getBounds());
+
+		filterSourceDirtyRegion.clear();
+
+		if (!IsEmptyRect(filteredRegion))
+		{
+			uint32x2 filteredSize = filteredRegion.getSize();
+			HeapPtr<uint32> buffer(uintptr(filteredSize.x) * filteredSize.y);
+
+			layers[currentLayer].download(filteredRegion, buffer);
+			ColorLookup::Apply(brightnessContrastGammaTable, buffer, 0, filteredSize, buffer);
+			tempLayer.upload(filteredRegion, buffer);
+			markTempLayerDirty(filteredRegion);
+		}
 	}
 
 	if (state.apply)
+		applyFilterPreview();
+}
+
+void CanvasManager::updateInstrument_gaussianBlurFilter()
+{
+	InstrumentState_Filter &state = instrumentState.filter;
+
+	if (state.outOfDate)
+	{
+		state.outOfDate = false;
+
+		clearTempLayer();
+		filterSourceDirtyRegion.addAll();
+	}
+
+	if (!filterSourceDirtyRegion.isEmpty())
 	{
-		device->copyTexture(layerTextures[currentLayer], tempTexture, selection.leftTop, selection);
+		// Blur is done on CPU over bounding rect of changed pixels expanded by blur support.
+		// Source is read with additional support border, so pixels near region edges are
+		// blurred same way as if whole layer was processed.
 
-		resetInstrument();
+		float32 sigma = min(float32(instrumentSettings.gaussianBlur.radius) * 0.5f, GaussianBlur::MaxSigma);
+		uint32 supportRadius = GaussianBlur::GetSupportRadius(sigma);
+
+		rectu32 blurredRegion = IntersectRects(selection,
+			InflateRect(filterSourceDirtyRegion.getBounds(), supportRadius));
+		rectu32 sourceRegion = IntersectRects(rectu32(0, 0, canvasSize),
+			InflateRect(blurredRegion, supportRadius));
+
+		filterSourceDirtyRegion.clear();
+
+		if (!IsEmptyRect(blurredRegion))
+		{
+			uint32x2 sourceSize = sourceRegion.getSize();
+			uint32 stride = sourceSize.x * 4;
+
+			HeapPtr<byte> buffer(uintptr(stride) * sourceSize.y);
+			layers[currentLayer].download(sourceRegion, buffer, stride);
+
+			GaussianBlur::Apply(buffer, stride, sourceSize, buffer, stride, sigma);
+
+			uint32x2 blurredOffset = blurredRegion.leftTop - sourceRegion.leftTop;
+			tempLayer.upload(blurredRegion,
+				buffer + uintptr(blurredOffset.y) * stride + blurredOffset.x * 4, stride);
+			markTempLayerDirty(blurredRegion);
+		}
 	}
+
+	if (state.apply)
+		applyFilterPreview();
 }
 
-void CanvasManager::mergeCurrentLayerWithTemp()
+void CanvasManager::applyFilterPreview()
 {
+	ProfileFunction();
+
+	TiledLayer &layer = layers[currentLayer];
+	uint32x2 gridSize = tempLayer.getGridSize();
+	HeapPtr<byte> transparentPixels;
+
+	history.commit();
+
+	// Filtered range is taken from temp layer dirty region, not from temp tiles, because
+	// filter result that is fully transparent is stored as null tile.
+	for (uint32 tileIndex : tempLayerDirtyRegion.getDirtyTiles())
 	{
-		float32x2 canvasSizeF(canvasSize);
+		uint32x2 tileCoords(tileIndex % gridSize.x, tileIndex / gridSize.x);
+		rectu32 filteredRegion = IntersectRects(tempLayerDirtyRegion.getTileDirtyRect(tileIndex), selection);
+		if (IsEmptyRect(filteredRegion))
+			continue;
+
+		history.recordTile(currentLayer, layer, tileCoords);
+		markLayerDirty(currentLayer, filteredRegion);
+
+		rectu32 tileRect = layer.getTileRect(tileCoords);
+		LayerTile *tempTile = tempLayer.getTile(tileCoords);
+
+		if (filteredRegion.leftTop == tileRect.leftTop && filteredRegion.rightBottom == tileRect.rightBottom)
+		{
+			// Whole tile is replaced, so filtered tile is just shared.
+			if (tempTile)
+				tilePool.addReference(tempTile);
+			layer.setTile(tileCoords, tempTile);
+			continue;
+		}
 
-		VertexTexturedUnorm2D vertices[6];
-		vertices[0] = { { 0.0f,          0.0f          }, { 0,      0      } };
-		vertices[1] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-		vertices[2] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-		vertices[3] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-		vertices[4] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-		vertices[5] = { { canvasSizeF.x, canvasSizeF.y }, { 0xFFFF, 0xFFFF } };
+		if (!tempTile)
+		{
+			if (!transparentPixels)
+			{
+				transparentPixels.resize(LayerTileSize * LayerTileSize * 4);
+				Memory::Set(transparentPixels, 0, LayerTileSize * LayerTileSize * 4);
+			}
+			layer.upload(filteredRegion, transparentPixels, LayerTileSize * 4);
+			continue;
+		}
 
-		device->uploadBuffer(quadVertexBuffer, vertices, 0, sizeof(vertices));
+		filteredRegion = MakeRectRelative(filteredRegion, tileRect.leftTop);
+		LayerTile *tile = layer.getWritableTile(tileCoords);
+		device->copyTexture(tile->texture, tempTile->texture, filteredRegion.leftTop, filteredRegion);
 	}
 
-	device->setRenderTarget(layerTextures[currentLayer]);
-	device->setViewport(rectu32(0, 0, canvasSize));
-	device->setScissorRect(selection);
+	history.commit();
+
+	clearTempLayer();
+	resetInstrument();
+}
+
+void CanvasManager::mergeCurrentLayerWithTemp()
+{
+	ProfileFunction();
+
+	// Only pixels drawn to temp layer since it was cleared are merged.
+
+	TiledLayer &layer = layers[currentLayer];
+	uint32x2 gridSize = tempLayer.getGridSize();
+
+	history.commit();
+
+	uploadQuadVertices(rectf32(0.0f, 0.0f, float32(LayerTileSize), float32(LayerTileSize)));
+
+	device->setViewport(rectu32(0, 0, LayerTileSize, LayerTileSize));
 	device->setTransform2D(Matrix2x3::Identity());
-	device->setTexture(tempTexture);
 
-	device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
-		quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+	for (uint32 tileIndex : tempLayerDirtyRegion.getDirtyTiles())
+	{
+		uint32x2 tileCoords(tileIndex % gridSize.x, tileIndex / gridSize.x);
+		LayerTile *tempTile = tempLayer.getTile(tileCoords);
+		if (!tempTile)
+			continue;
+
+		rectu32 mergedRegion = IntersectRects(tempLayerDirtyRegion.getTileDirtyRect(tileIndex), selection);
+		if (IsEmptyRect(mergedRegion))
+			continue;
+
+		history.recordTile(currentLayer, layer, tileCoords);
+		markLayerDirty(currentLayer, mergedRegion);
+
+		rectu32 tileRect = layer.getTileRect(tileCoords);
+		LayerTile *tile = layer.getWritableTile(tileCoords);
+
+		device->setRenderTarget(tile->texture);
+		device->setScissorRect(MakeRectRelative(mergedRegion, tileRect.leftTop));
+		device->setTexture(tempTile->texture);
+		device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
+			quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+	}
+
+	history.commit();
+
+	clearTempLayer();
+}
+
+void CanvasManager::discardInstrumentPreview()
+{
+	// Pending line or shape is dropped. Filter preview catches up with restored contents
+	// through current layer dirty region.
+
+	switch (currentInstrument)
+	{
+		case Instrument::Line:
+			instrumentState.line.userState = InstrumentState_Line::UserState::Standby;
+			instrumentState.line.notEmpty = false;
+			instrumentState.line.outOfDate = false;
+			instrumentState.line.apply = false;
+			clearTempLayer();
+			enableTempLayerRendering = false;
+			break;
+
+		case Instrument::Shape:
+			instrumentState.shape.userState = InstrumentState_Shape::UserState::Standby;
+			instrumentState.shape.notEmpty = false;
+			instrumentState.shape.outOfDate = false;
+			instrumentState.shape.apply = false;
+			clearTempLayer();
+			enableTempLayerRendering = false;
+			break;
+
+		case Instrument::Pencil:
+			pencilStroke.clear();
+			pencilStrokeDrawnPointCount = 0;
+			clearTempLayer();
+			enableTempLayerRendering = false;
+			break;
+
+		case Instrument::Brush:
+			brushEngine.endStroke();
+			clearTempLayer();
+			enableTempLayerRendering = false;
+			break;
+	}
 }
 
 void CanvasManager::resetInstrument()
 {
+	recordInputTraceEvent(InputTraceEventType::ResetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
@@ -521,6 +903,8 @@ void CanvasManager::resetInstrument()
 
 void CanvasManager::setInstrument_selection()
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
@@ -530,9 +914,19 @@ void CanvasManager::setInstrument_selection()
 
 PencilSettings& CanvasManager::setInstrument_pencil(Color color)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
+	// Unfinished stroke is dropped.
+	if (!pencilStroke.isEmpty())
+	{
+		pencilStroke.clear();
+		pencilStrokeDrawnPointCount = 0;
+		clearTempLayer();
+	}
+
 	instrumentSettings.pencil.color = color;
 	currentInstrument = Instrument::Pencil;
 
@@ -541,9 +935,18 @@ PencilSettings& CanvasManager::setInstrument_pencil(Color color)
 
 BrushSettings& CanvasManager::setInstrument_brush(Color color, float32 width, bool blendEnabled)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
+	// Unfinished stroke is dropped.
+	if (brushEngine.isStrokeInProgress())
+	{
+		brushEngine.endStroke();
+		clearTempLayer();
+	}
+
 	instrumentSettings.brush.color = color;
 	instrumentSettings.brush.width = width;
 	instrumentSettings.brush.blendEnabled = blendEnabled;
@@ -555,6 +958,8 @@ BrushSettings& CanvasManager::setInstrument_brush(Color color, float32 width, bo
 LineSettings& CanvasManager::setInstrument_line(XLib::Color color, float32 width,
 	bool roundedStart, bool roundedEnd)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
@@ -574,6 +979,8 @@ LineSettings& CanvasManager::setInstrument_line(XLib::Color color, float32 width
 ShapeSettings& CanvasManager::setInstrument_shape(XLib::Color fillColor,
 	XLib::Color borderColor, float32 borderWidth, Shape shape)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = false;
 	enableTempLayerRendering = false;
 
@@ -593,12 +1000,15 @@ ShapeSettings& CanvasManager::setInstrument_shape(XLib::Color fillColor,
 BrightnessContrastGammaFilterSettings& CanvasManager::setInstrument_brightnessContrastGammaFilter(
 	float32 brightness, float32 contrast, float32 gamma)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = true;
 	enableTempLayerRendering = true;
 
 	instrumentSettings.brightnessContrastGamma.brightness = brightness;
 	instrumentSettings.brightnessContrastGamma.contrast = contrast;
 	instrumentSettings.brightnessContrastGamma.gamma = gamma;
+	ColorLookup::BuildBrightnessContrastGamma(brightnessContrastGammaTable, brightness, contrast, gamma);
 	instrumentState.filter.outOfDate = true;
 	instrumentState.filter.apply = false;
 	currentInstrument = Instrument::BrightnessContrastGammaFilter;
@@ -608,6 +1018,8 @@ BrightnessContrastGammaFilterSettings& CanvasManager::setInstrument_brightnessCo
 
 GaussianBlurFilterSettings& CanvasManager::setInstrument_gaussianBlurFilter(uint32 radius)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = true;
 	enableTempLayerRendering = true;
 
@@ -621,6 +1033,8 @@ GaussianBlurFilterSettings& CanvasManager::setInstrument_gaussianBlurFilter(uint
 
 SharpenFilterSettings& CanvasManager::setInstrument_sharpenFilter(float32 intensity)
 {
+	recordInputTraceEvent(InputTraceEventType::SetInstrument);
+
 	disableCurrentLayerRendering = true;
 	enableTempLayerRendering = true;
 
@@ -634,6 +1048,8 @@ SharpenFilterSettings& CanvasManager::setInstrument_sharpenFilter(float32 intens
 
 void CanvasManager::updateInstrumentSettings()
 {
+	recordInputTraceEvent(InputTraceEventType::InstrumentSettings);
+
 	switch (currentInstrument)
 	{
 		case Instrument::Line:
@@ -645,6 +1061,14 @@ void CanvasManager::updateInstrumentSettings()
 			break;
 
 		case Instrument::BrightnessContrastGammaFilter:
+		{
+			BrightnessContrastGammaFilterSettings &settings = instrumentSettings.brightnessContrastGamma;
+			ColorLookup::BuildBrightnessContrastGamma(brightnessContrastGammaTable,
+				settings.brightness, settings.contrast, settings.gamma);
+			instrumentState.filter.outOfDate = true;
+			break;
+		}
+
 		case Instrument::GaussianBlurFilter:
 		case Instrument::SharpenFilter:
 			instrumentState.filter.outOfDate = true;
@@ -654,6 +1078,8 @@ void CanvasManager::updateInstrumentSettings()
 
 void CanvasManager::applyInstrument()
 {
+	recordInputTraceEvent(InputTraceEventType::ApplyInstrument);
+
 	switch (currentInstrument)
 	{
 		case Instrument::Line:
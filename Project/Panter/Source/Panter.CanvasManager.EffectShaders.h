@@ -14,8 +14,6 @@ namespace Panter
 	{
 	public:
 		static const ShaderData CheckerboardPS;
-		static const ShaderData BrightnessContrastGammaPS;
-		static const ShaderData BlurPS;
 		static const ShaderData SharpenPS;
 	};
 }
\ No newline at end of file
@@ -1,19 +1,518 @@
 #include <XLib.Debug.h>
 #include <XLib.Memory.h>
 #include <XLib.Vectors.Arithmetics.h>
+#include <XLib.System.Threading.WorkerPool.h>
+#include <XLib.System.Profiler.h>
 
 #include "Panter.CanvasManager.h"
 
+#include "Panter.Compositor.h"
 #include "Panter.Constants.h"
+#include "Panter.InputTrace.h"
 #include "Panter.CanvasManager.EffectShaders.h"
+#include "Panter.TileCodec.h"
 
 using namespace XLib;
 using namespace XLib::Graphics;
 using namespace Panter;
 
+// Returns false if rect lies completely on the opposite to triangle side of any triangle edge.
+static bool CheckTriangleRectOverlap(const float32x2* triangle, const rectf32& rect)
+{
+	for (uint32 i = 0; i < 3; i++)
+	{
+		float32x2 a = triangle[i];
+		float32x2 b = triangle[(i + 1) % 3];
+		float32x2 c = triangle[(i + 2) % 3];
+
+		auto edge = [a, b](float32 x, float32 y) { return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x); };
+		float32 side = edge(c.x, c.y);
+
+		if (side > 0.0f)
+		{
+			if (edge(rect.left, rect.top) < 0.0f && edge(rect.right, rect.top) < 0.0f &&
+				edge(rect.left, rect.bottom) < 0.0f && edge(rect.right, rect.bottom) < 0.0f)
+				return false;
+		}
+		else if (side < 0.0f)
+		{
+			if (edge(rect.left, rect.top) > 0.0f && edge(rect.right, rect.top) > 0.0f &&
+				edge(rect.left, rect.bottom) > 0.0f && edge(rect.right, rect.bottom) > 0.0f)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// Tiled rendering ==============================================================================//
+
+void CanvasManager::FlushGeometryToTargetLayer(void* context)
+{
+	ProfileFunction();
+
+	CanvasManager &self = *(CanvasManager*)context;
+	TiledLayer &layer = *self.geometryTargetLayer;
+	Device &device = *self.device;
+	GeometryGenerator &geometryGenerator = self.geometryGenerator;
+
+	// Binning triangles to tiles, so only tiles actually covered by geometry are allocated.
+
+	const VertexColor2D *vertices = geometryGenerator.getVertices();
+	const uint16 *indices = geometryGenerator.getIndices();
+	uint32 triangleCount = geometryGenerator.getIndexCount() / 3;
+	rectu32 clipTileRange = layer.getTileRange(self.geometryClipRect);
+	uint32x2 gridSize = layer.getGridSize();
+	bool tempLayerTarget = &layer == &self.tempLayer;
+	uint16 layerIndex = tempLayerTarget ? 0 : uint16(&layer - self.layers);
+
+	for (uint32 i = 0; i < triangleCount; i++)
+	{
+		float32x2 triangle[3] =
+		{
+			vertices[indices[i * 3 + 0]].position,
+			vertices[indices[i * 3 + 1]].position,
+			vertices[indices[i * 3 + 2]].position,
+		};
+
+		float32 left   = min(min(triangle[0].x, triangle[1].x), triangle[2].x);
+		float32 top    = min(min(triangle[0].y, triangle[1].y), triangle[2].y);
+		float32 right  = max(max(triangle[0].x, triangle[1].x), triangle[2].x);
+		float32 bottom = max(max(triangle[0].y, triangle[1].y), triangle[2].y);
+
+		if (right <= 0.0f || bottom <= 0.0f)
+			continue;
+
+		// Triangle bounds are marked dirty, so only pixels near geometry are recomposited later.
+		rectu32 dirtyRect = IntersectRects(self.geometryClipRect, rectu32(
+			uint32(max(left - 1.0f, 0.0f)), uint32(max(top - 1.0f, 0.0f)),
+			uint32(min(right + 2.0f, 1.0e9f)), uint32(min(bottom + 2.0f, 1.0e9f))));
+
+		if (IsEmptyRect(dirtyRect))
+			continue;
+
+		if (tempLayerTarget)
+			self.markTempLayerDirty(dirtyRect);
+		else
+			self.markLayerDirty(layerIndex, dirtyRect);
+
+		// Tile bounds are extended by one pixel to stay conservative with rasterization rules.
+		rectu32 tileRange(
+			max(uint32(max(left - 1.0f, 0.0f)) >> LayerTileSizeLog2, clipTileRange.left),
+			max(uint32(max(top - 1.0f, 0.0f)) >> LayerTileSizeLog2, clipTileRange.top),
+			min((uint32(min(right + 1.0f, 1.0e9f)) >> LayerTileSizeLog2) + 1, clipTileRange.right),
+			min((uint32(min(bottom + 1.0f, 1.0e9f)) >> LayerTileSizeLog2) + 1, clipTileRange.bottom));
+
+		for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+		{
+			for (uint32 x = tileRange.left; x < tileRange.right; x++)
+			{
+				uint32 tileIndex = y * gridSize.x + x;
+				if (self.geometryTargetTileFlags[tileIndex])
+					continue;
+
+				rectf32 tileRect(layer.getTileRect(uint32x2(x, y)));
+				tileRect.left -= 1.0f;
+				tileRect.top -= 1.0f;
+				tileRect.right += 1.0f;
+				tileRect.bottom += 1.0f;
+
+				if (CheckTriangleRectOverlap(triangle, tileRect))
+				{
+					self.geometryTargetTileFlags[tileIndex] = true;
+					self.geometryTargetTiles.pushBack(tileIndex);
+				}
+			}
+		}
+	}
+
+	for (uint32 tileIndex : self.geometryTargetTiles)
+	{
+		uint32x2 tileCoords(tileIndex % gridSize.x, tileIndex / gridSize.x);
+		rectu32 tileRect = layer.getTileRect(tileCoords);
+
+		if (!tempLayerTarget)
+			self.history.recordTile(layerIndex, layer, tileCoords);
+
+		LayerTile *tile = layer.getWritableTile(tileCoords);
+		device.setRenderTarget(tile->texture);
+		device.setViewport(rectu32(0, 0, LayerTileSize, LayerTileSize));
+		device.setScissorRect(MakeRectRelative(IntersectRects(tileRect, self.geometryClipRect), tileRect.leftTop));
+		device.setTransform2D(Matrix2x3::Translation(-float32x2(tileRect.leftTop)));
+
+		geometryGenerator.draw();
+
+		self.geometryTargetTileFlags[tileIndex] = false;
+	}
+
+	self.geometryTargetTiles.clear();
+}
+
+void CanvasManager::resetLayerStorage(uint32x2 newCanvasSize)
+{
+	tempLayer.initialize(tilePool, newCanvasSize);
+	brushEngine.initialize(newCanvasSize);
+	belowLayersCache.initialize(tilePool, newCanvasSize);
+	aboveLayersCache.initialize(tilePool, newCanvasSize);
+
+	for (uint32 i = 0; i < countof(layerDirtyRegions); i++)
+		layerDirtyRegions[i].initialize(newCanvasSize);
+	tempLayerFrameDirtyRegion.initialize(newCanvasSize);
+	tempLayerDirtyRegion.initialize(newCanvasSize);
+	filterSourceDirtyRegion.initialize(newCanvasSize);
+	filterTargetDirtyRegion.initialize(newCanvasSize);
+	belowLayersCacheDirtyRegion.initialize(newCanvasSize);
+	aboveLayersCacheDirtyRegion.initialize(newCanvasSize);
+	invalidateLayersCaches();
+
+	uint32x2 gridSize = tempLayer.getGridSize();
+	uint32 tileCount = tempLayer.getTileCount();
+
+	geometryTargetTileFlags = HeapPtr<bool>(tileCount);
+	Memory::Set(geometryTargetTileFlags, 0, tileCount * sizeof(bool));
+
+	history.setLayerTileCount(tileCount);
+
+	autosaveTileLayerFlags = HeapPtr<uint16>(tileCount);
+	Memory::Set(autosaveTileLayerFlags, 0, tileCount * sizeof(uint16));
+	autosaveDirtyTiles.clear();
+	autosaveLayerOps.clear();
+	autosaveCanvasReset = true;
+
+	// Canvas space quad per tile. Edge tiles are only partially covered with canvas.
+
+	HeapPtr<VertexTexturedUnorm2D> vertices(tileCount * 6);
+	for (uint32 y = 0; y < gridSize.y; y++)
+	{
+		for (uint32 x = 0; x < gridSize.x; x++)
+		{
+			rectu32 tileRect = tempLayer.getTileRect(uint32x2(x, y));
+			rectf32 rect(tileRect);
+			uint16 u = uint16(tileRect.getWidth() * 0xFFFF / LayerTileSize);
+			uint16 v = uint16(tileRect.getHeight() * 0xFFFF / LayerTileSize);
+
+			VertexTexturedUnorm2D *quad = vertices + (y * gridSize.x + x) * 6;
+			quad[0] = { { rect.left,  rect.top    }, { 0, 0 } };
+			quad[1] = { { rect.right, rect.top    }, { u, 0 } };
+			quad[2] = { { rect.left,  rect.bottom }, { 0, v } };
+			quad[3] = { { rect.left,  rect.bottom }, { 0, v } };
+			quad[4] = { { rect.right, rect.top    }, { u, 0 } };
+			quad[5] = { { rect.right, rect.bottom }, { u, v } };
+		}
+	}
+
+	device->createBuffer(tileQuadsVertexBuffer, tileCount * 6 * sizeof(VertexTexturedUnorm2D), vertices);
+}
+
+void CanvasManager::uploadQuadVertices(const rectf32& rect)
+{
+	VertexTexturedUnorm2D vertices[6];
+	vertices[0] = { { rect.left,  rect.top    }, { 0,      0      } };
+	vertices[1] = { { rect.right, rect.top    }, { 0xFFFF, 0      } };
+	vertices[2] = { { rect.left,  rect.bottom }, { 0,      0xFFFF } };
+	vertices[3] = { { rect.left,  rect.bottom }, { 0,      0xFFFF } };
+	vertices[4] = { { rect.right, rect.top    }, { 0xFFFF, 0      } };
+	vertices[5] = { { rect.right, rect.bottom }, { 0xFFFF, 0xFFFF } };
+
+	device->uploadBuffer(quadVertexBuffer, vertices, 0, sizeof(vertices));
+}
+
+void CanvasManager::beginLayerGeometry(TiledLayer& layer, const rectu32& clipRect)
+{
+	geometryTargetLayer = &layer;
+	geometryClipRect = clipRect;
+	geometryGenerator.setFlushHandler(FlushGeometryToTargetLayer, this);
+}
+
+void CanvasManager::endLayerGeometry()
+{
+	geometryGenerator.flush();
+	geometryGenerator.setFlushHandler(nullptr, nullptr);
+	geometryTargetLayer = nullptr;
+}
+
+void CanvasManager::drawLayer(TiledLayer& layer)
+{
+	// Expects canvas to view transform to be set.
+
+	uint32 tileCount = layer.getTileCount();
+	uint32x2 gridSize = layer.getGridSize();
+
+	for (uint32 i = 0; i < tileCount; i++)
+	{
+		LayerTile *tile = layer.getTile(uint32x2(i % gridSize.x, i / gridSize.x));
+		if (!tile)
+			continue;
+
+		device->setTexture(tile->texture);
+		device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm, tileQuadsVertexBuffer,
+			i * 6 * sizeof(VertexTexturedUnorm2D), sizeof(VertexTexturedUnorm2D), 6);
+	}
+}
+
+void CanvasManager::markLayerDirty(uint16 layerIndex, const rectu32& rect)
+{
+	layerDirtyRegions[layerIndex].add(rect);
+
+	if (layerIndex < layersCacheCurrentLayer)
+		belowLayersCacheDirtyRegion.add(rect);
+	else if (layerIndex > layersCacheCurrentLayer)
+		aboveLayersCacheDirtyRegion.add(rect);
+
+	if (layerIndex == currentLayer)
+		filterSourceDirtyRegion.add(rect);
+
+	if (autosaveCanvasReset)
+		return;
+
+	uint32 gridWidth = tempLayer.getGridSize().x;
+	rectu32 tileRange = tempLayer.getTileRange(rect);
+	for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+	{
+		for (uint32 x = tileRange.left; x < tileRange.right; x++)
+		{
+			uint32 tileIndex = y * gridWidth + x;
+			if (!autosaveTileLayerFlags[tileIndex])
+				autosaveDirtyTiles.pushBack(tileIndex);
+			autosaveTileLayerFlags[tileIndex] |= uint16(1 << layerIndex);
+		}
+	}
+}
+
+// Layer inserted by undo brings its contents, so all its non-empty tiles are autosaved.
+void CanvasManager::markLayerTilesForAutosave(uint16 layerIndex)
+{
+	if (autosaveCanvasReset)
+		return;
+
+	TiledLayer &layer = layers[layerIndex];
+	uint32x2 gridSize = layer.getGridSize();
+	uint32 tileCount = layer.getTileCount();
+
+	for (uint32 tileIndex = 0; tileIndex < tileCount; tileIndex++)
+	{
+		if (!layer.getTile(uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x)))
+			continue;
+
+		if (!autosaveTileLayerFlags[tileIndex])
+			autosaveDirtyTiles.pushBack(tileIndex);
+		autosaveTileLayerFlags[tileIndex] |= uint16(1 << layerIndex);
+	}
+}
+
+// Operation is recorded and dirty tile bits are moved with layers, so journal replays all
+// operations first and then tiles at their final positions.
+void CanvasManager::recordAutosaveLayerOp(AutosaveRecordType type, uint16 layerIndex, uint32 argument)
+{
+	if (autosaveCanvasReset)
+		return;
+
+	autosaveLayerOps.pushBack({ type, layerIndex, argument });
+
+	if (type == AutosaveRecordType::LayerVisibility)
+		return;
+
+	uint16 lowerLayersMask = uint16((1 << layerIndex) - 1);
+	for (uint32 tileIndex : autosaveDirtyTiles)
+	{
+		uint16 &flags = autosaveTileLayerFlags[tileIndex];
+		switch (type)
+		{
+			case AutosaveRecordType::LayerInsert:
+				flags = uint16((flags & lowerLayersMask) | ((flags & ~lowerLayersMask) << 1));
+				break;
+
+			case AutosaveRecordType::LayerRemove:
+				flags = uint16((flags & lowerLayersMask) | ((flags >> 1) & ~lowerLayersMask));
+				break;
+
+			case AutosaveRecordType::LayerSwap:
+			{
+				uint32 difference = ((flags >> layerIndex) ^ (flags >> argument)) & 1;
+				flags ^= uint16((difference << layerIndex) | (difference << argument));
+				break;
+			}
+		}
+	}
+}
+
+void CanvasManager::markTempLayerDirty(const rectu32& rect)
+{
+	tempLayerFrameDirtyRegion.add(rect);
+	tempLayerDirtyRegion.add(rect);
+}
+
+void CanvasManager::clearTempLayer()
+{
+	tempLayer.clear(0);
+	tempLayerDirtyRegion.clear();
+}
+
+void CanvasManager::invalidateLayersCaches()
+{
+	// Layer order changed, so every pixel of caches and filter source may be different.
+
+	belowLayersCacheDirtyRegion.addAll();
+	aboveLayersCacheDirtyRegion.addAll();
+	filterSourceDirtyRegion.addAll();
+}
+
+void CanvasManager::invalidateLayersCaches(uint16 layerIndex)
+{
+	if (layerIndex < layersCacheCurrentLayer)
+		belowLayersCacheDirtyRegion.addAll();
+	else if (layerIndex > layersCacheCurrentLayer)
+		aboveLayersCacheDirtyRegion.addAll();
+}
+
+void CanvasManager::flattenLayers(TiledLayer& target, DirtyRegion& region,
+	uint16 beginLayerIndex, uint16 endLayerIndex)
+{
+	// Straight alpha layers are blended over transparent tile with premultiplying blend state,
+	// so result can be drawn with premultiplied blend state instead of every layer.
+	// Only dirty rects of tiles are rebuilt, rest of cached tile stays intact.
+
+	uploadQuadVertices(rectf32(0.0f, 0.0f, float32(LayerTileSize), float32(LayerTileSize)));
+
+	device->setViewport(rectu32(0, 0, LayerTileSize, LayerTileSize));
+	device->setTransform2D(Matrix2x3::Identity());
+	device->setBlendState(BlendState::StraightToPremultiplied);
+
+	uint32x2 gridSize = target.getGridSize();
+	for (uint32 tileIndex : region.getDirtyTiles())
+	{
+		uint32x2 tileCoords(tileIndex % gridSize.x, tileIndex / gridSize.x);
+		rectu32 tileRect = target.getTileRect(tileCoords);
+		rectu32 dirtyRect = region.getTileDirtyRect(tileIndex);
+		bool wholeTileDirty = dirtyRect.leftTop == tileRect.leftTop && dirtyRect.rightBottom == tileRect.rightBottom;
+
+		// Layers below opaque uniform tile are invisible.
+		uint16 firstLayerIndex = beginLayerIndex;
+		uint16 tileCount = 0;
+		LayerTile *lastTile = nullptr;
+		for (uint16 i = beginLayerIndex; i < endLayerIndex; i++)
+		{
+			LayerTile *tile = layerRenderingFlags[i] ? layers[i].getTile(tileCoords) : nullptr;
+			if (!tile)
+				continue;
+
+			if (tile->isUniform && tile->uniformColor.a == 0xFF)
+			{
+				firstLayerIndex = i;
+				tileCount = 0;
+			}
+			tileCount++;
+			lastTile = tile;
+		}
+
+		if (!tileCount)
+		{
+			target.setTile(tileCoords, nullptr);
+			continue;
+		}
+
+		if (tileCount == 1 && lastTile->isUniform)
+		{
+			Color color = lastTile->uniformColor;
+			color.r = uint8((uint32(color.r) * color.a + 127) / 255);
+			color.g = uint8((uint32(color.g) * color.a + 127) / 255);
+			color.b = uint8((uint32(color.b) * color.a + 127) / 255);
+			target.setTile(tileCoords, tilePool.getUniform(color));
+			continue;
+		}
+
+		rectu32 localDirtyRect = MakeRectRelative(dirtyRect, tileRect.leftTop);
+		LayerTile *flattenedTile = nullptr;
+		if (wholeTileDirty)
+		{
+			flattenedTile = tilePool.allocate();
+			device->clear(flattenedTile->texture, 0);
+			target.setTile(tileCoords, flattenedTile);
+		}
+		else
+		{
+			flattenedTile = target.getWritableTile(tileCoords);
+			device->copyTexture(flattenedTile->texture, tilePool.getTransparentTexture(),
+				localDirtyRect.leftTop, localDirtyRect);
+		}
+
+		device->setRenderTarget(flattenedTile->texture);
+		device->setScissorRect(localDirtyRect);
+
+		for (uint16 i = firstLayerIndex; i < endLayerIndex; i++)
+		{
+			LayerTile *tile = layerRenderingFlags[i] ? layers[i].getTile(tileCoords) : nullptr;
+			if (!tile)
+				continue;
+
+			device->setTexture(tile->texture);
+			device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
+				quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+		}
+
+		recompositedPixelCount += uint64(dirtyRect.getWidth()) * dirtyRect.getHeight();
+	}
+
+	device->setBlendState(BlendState::Default);
+	region.clear();
+}
+
+void CanvasManager::updateLayersCaches()
+{
+	ProfileFunction();
+
+	if (layersCacheCurrentLayer != currentLayer)
+	{
+		layersCacheCurrentLayer = currentLayer;
+		invalidateLayersCaches();
+	}
+
+	uint16 splitIndex = min(currentLayer, layerCount);
+
+	if (!belowLayersCacheDirtyRegion.isEmpty())
+		flattenLayers(belowLayersCache, belowLayersCacheDirtyRegion, 0, splitIndex);
+
+	if (!aboveLayersCacheDirtyRegion.isEmpty())
+	{
+		flattenLayers(aboveLayersCache, aboveLayersCacheDirtyRegion,
+			min<uint16>(splitIndex + 1, layerCount), layerCount);
+	}
+}
+
+void CanvasManager::updateFrameStats()
+{
+	lastFrameStats.layerDirtyPixelCount = 0;
+	for (uint16 i = 0; i < countof(layerDirtyRegions); i++)
+	{
+		lastFrameStats.layerDirtyPixelCount += layerDirtyRegions[i].getPixelCount();
+		layerDirtyRegions[i].clear();
+	}
+
+	lastFrameStats.tempLayerDirtyPixelCount = tempLayerFrameDirtyRegion.getPixelCount();
+	tempLayerFrameDirtyRegion.clear();
+
+	lastFrameStats.recompositedPixelCount = recompositedPixelCount;
+	recompositedPixelCount = 0;
+
+	const GeometryGeneratorStats &geometryStats = geometryGenerator.getStats();
+	lastFrameStats.geometryVertexCount = geometryStats.vertexCount;
+	lastFrameStats.geometryIndexCount = geometryStats.indexCount;
+	lastFrameStats.geometryFlushCount = geometryStats.flushCount;
+	lastFrameStats.geometryDrawCount = geometryStats.drawCount;
+	geometryGenerator.resetStats();
+
+	ProfileCounter("Layer dirty pixels", lastFrameStats.layerDirtyPixelCount);
+	ProfileCounter("Temp layer dirty pixels", lastFrameStats.tempLayerDirtyPixelCount);
+	ProfileCounter("Recomposited pixels", lastFrameStats.recompositedPixelCount);
+	ProfileCounter("Geometry vertices", lastFrameStats.geometryVertexCount);
+	ProfileCounter("Geometry indices", lastFrameStats.geometryIndexCount);
+	ProfileCounter("Geometry flushes", lastFrameStats.geometryFlushCount);
+	ProfileCounter("Geometry draws", lastFrameStats.geometryDrawCount);
+}
+
 // Public interface =============================================================================//
 
-void CanvasManager::initialize(Device& device, uint32x2 canvasSize)
+void CanvasManager::initialize(Device& device, uint32x2 canvasSize, const char* historyJournalFileName)
 {
 	this->canvasSize = canvasSize;
 	this->layerCount = 0;
@@ -22,12 +521,15 @@ void CanvasManager::initialize(Device& device, uint32x2 canvasSize)
 	device.createBuffer(quadVertexBuffer, sizeof(VertexTexturedUnorm2D) * 6);
 	geometryGenerator.initialize(device);
 
+	device.createTextureRenderTarget(filterSourceTexture, filterTextureSize, filterTextureSize);
+	device.createTextureRenderTarget(filterTargetTexture, filterTextureSize, filterTextureSize);
+
+	tilePool.initialize(device);
+	history.initialize(tilePool, DefaultHistoryMemoryBudget, historyJournalFileName);
+	resetLayerStorage(canvasSize);
+
 	device.createCustomEffect(checkerboardEffect, Effect::TexturedUnorm,
 		EffectShaders::CheckerboardPS.data, EffectShaders::CheckerboardPS.size);
-	device.createCustomEffect(brightnessContrastGammaEffect, Effect::TexturedUnorm,
-		EffectShaders::BrightnessContrastGammaPS.data, EffectShaders::BrightnessContrastGammaPS.size);
-	device.createCustomEffect(blurEffect, Effect::TexturedUnorm,
-		EffectShaders::BlurPS.data, EffectShaders::BlurPS.size);
 	device.createCustomEffect(sharpenEffect, Effect::TexturedUnorm,
 		EffectShaders::SharpenPS.data, EffectShaders::SharpenPS.size);
 
@@ -37,19 +539,30 @@ void CanvasManager::initialize(Device& device, uint32x2 canvasSize)
 
 void CanvasManager::destroy()
 {
-
+	history.destroy();
+	for (uint32 i = 0; i < layerCount; i++)
+		layers[i].destroy();
+	tempLayer.destroy();
+	brushEngine.destroy();
+	shapeRasterizer.reset();
+	shapeBuffer.release();
+	shapeBufferSize = 0;
+	belowLayersCache.destroy();
+	aboveLayersCache.destroy();
+	tilePool.destroy();
 }
 
 void CanvasManager::resizeDiscardingContents(uint32x2 newCanvasSize)
 {
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::ResizeDiscardingContents))
+		event->size = newCanvasSize;
+
+	history.clear();
+
 	for (uint32 i = 0; i < layerCount; i++)
-	{
-		layerTextures[i].destroy();
-		device->createTextureRenderTarget(layerTextures[i], newCanvasSize.x, newCanvasSize.y);
-	}
+		layers[i].initialize(tilePool, newCanvasSize);
 
-	tempTexture.destroy();
-	device->createTextureRenderTarget(tempTexture, newCanvasSize.x, newCanvasSize.y);
+	resetLayerStorage(newCanvasSize);
 
 	canvasSize = newCanvasSize;
 	resetSelection();
@@ -63,130 +576,101 @@ void CanvasManager::resizeSavingContents(const rects32& newCanvasRect, Color fil
 		return;
 	}
 
-	uint32x2 newCanvasSize = newCanvasRect.getSize();
-
-	rects32 copiedContentsRegion =
-	{
-		max<sint32>(newCanvasRect.left, 0),
-		max<sint32>(newCanvasRect.top, 0),
-		min<sint32>(newCanvasRect.right, canvasSize.x),
-		min<sint32>(newCanvasRect.bottom, canvasSize.y)
-	};
-	uint32x2 copiedContentsLocation =
-	{
-		uint32(max<sint32>(-newCanvasRect.left, 0)),
-		uint32(max<sint32>(-newCanvasRect.top, 0)),
-	};
-
-	if (copiedContentsRegion.getWidth() <= 0 || copiedContentsRegion.getHeight() <= 0)
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::ResizeSavingContents))
 	{
-		for (uint32 i = 0; i < layerCount; i++)
-		{
-			layerTextures[i].destroy();
-			device->createTextureRenderTarget(layerTextures[i], newCanvasSize.x, newCanvasSize.y);
-			device->clear(layerTextures[i], fillColor);
-		}
+		event->canvasRect = { newCanvasRect.left, newCanvasRect.top,
+			newCanvasRect.right, newCanvasRect.bottom, fillColor };
 	}
-	else
-	{
-		uint32x2 copiedContentsSize = uint32x2(copiedContentsRegion.getSize());
 
-		bool blankSpaceLeft = copiedContentsSize != newCanvasSize;
+	uint32x2 newCanvasSize = newCanvasRect.getSize();
 
-		for (uint32 i = 0; i < layerCount; i++)
-		{
-			device->copyTexture(tempTexture, layerTextures[i],
-				{ 0, 0 }, rectu32(copiedContentsRegion));
-			layerTextures[i].destroy();
+	history.commit();
 
-			device->createTextureRenderTarget(layerTextures[i], newCanvasSize.x, newCanvasSize.y);
+	for (uint16 i = 0; i < layerCount; i++)
+	{
+		TiledLayer previousLayer;
+		previousLayer.initializeShared(layers[i]);
+		history.recordLayerReplace(i, move(previousLayer));
 
-			if (blankSpaceLeft)
-				device->clear(layerTextures[i], fillColor);
-			device->copyTexture(layerTextures[i], tempTexture,
-				copiedContentsLocation, { 0, 0, copiedContentsSize });
-		}
+		layers[i].resize(newCanvasRect, fillColor);
 	}
 
-	tempTexture.destroy();
-	device->createTextureRenderTarget(tempTexture, newCanvasSize.x, newCanvasSize.y);
+	history.recordCanvasSize(canvasSize);
+	history.commit();
+
+	resetLayerStorage(newCanvasSize);
 
 	canvasSize = newCanvasSize;
 	resetSelection();
 }
 
-void CanvasManager::updateAndDraw(RenderTarget& target, const rectu32& viewport)
+void CanvasManager::updateInstrument()
 {
-	if (pointerPanViewModeEnabled)
-	{
-		panView(float32x2(pointerPosition - prevPointerPosition));
-	}
-	else
+	ProfileFunction();
+
+	switch (currentInstrument)
 	{
-		// update instrument state
-		switch (currentInstrument)
-		{
-			case Instrument::None:
-				break;
+		case Instrument::None:
+			break;
 
-			case Instrument::Selection:
-				updateInstrument_selection();
-				break;
+		case Instrument::Selection:
+			updateInstrument_selection();
+			break;
 
-			case Instrument::Pencil:
-				updateInstrument_pencil();
-				break;
+		case Instrument::Pencil:
+			updateInstrument_pencil();
+			break;
 
-			case Instrument::Brush:
-				updateInstrument_brush();
-				break;
+		case Instrument::Brush:
+			updateInstrument_brush();
+			break;
 
-			case Instrument::Line:
-				updateInstrument_line();
-				break;
+		case Instrument::Line:
+			updateInstrument_line();
+			break;
 
-			case Instrument::Shape:
-				updateInstrument_shape();
-				break;
+		case Instrument::Shape:
+			updateInstrument_shape();
+			break;
 
-			case Instrument::BrightnessContrastGammaFilter:
-				updateInstrument_filter(brightnessContrastGammaEffect, instrumentSettings.brightnessContrastGamma);
-				break;
+		case Instrument::BrightnessContrastGammaFilter:
+			updateInstrument_brightnessContrastGammaFilter();
+			break;
+
+		case Instrument::GaussianBlurFilter:
+			updateInstrument_gaussianBlurFilter();
+			break;
 
-			case Instrument::GaussianBlurFilter:
+		case Instrument::SharpenFilter:
+		{
+			struct Settings
 			{
-				struct Settings
-				{
-					uint32 radius;
-					float32 multiplier;
-				};
+				float32 intensity;
+			};
 
-				Settings settings;
-				settings.radius = clamp<uint32>(instrumentSettings.gaussianBlur.radius, 1, 16);
-				settings.multiplier = 1.0f / float32(sqr(settings.radius * 2 + 1));
+			Settings settings;
+			settings.intensity = saturate<float32>(instrumentSettings.sharpen.intensity);
 
-				updateInstrument_filter(blurEffect, settings);
-				break;
-			}
+			updateInstrument_filter(sharpenEffect, settings);
+			break;
+		}
 
-			case Instrument::SharpenFilter:
-			{
-				struct Settings
-				{
-					float32 intensity;
-				};
+		default:
+			Debug::Crash("invalid instrument");
+	}
+}
 
-				Settings settings;
-				settings.intensity = saturate<float32>(instrumentSettings.sharpen.intensity);
+void CanvasManager::updateAndDraw(RenderTarget& target, const rectu32& viewport)
+{
+	ProfileFunction();
 
-				updateInstrument_filter(sharpenEffect, settings);
-				break;
-			}
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::Frame))
+		event->size = viewport.getSize();
 
-			default:
-				Debug::Crash("invalid instrument");
-		}
-	}
+	if (pointerPanViewModeEnabled)
+		panView(float32x2(pointerPosition - prevPointerPosition));
+	else
+		updateInstrument();
 
 	uint32x2 viewportSize = viewport.getSize();
 	float32 viewportAspect = float32(viewportSize.x) / float32(viewportSize.y);
@@ -226,21 +710,14 @@ void CanvasManager::updateAndDraw(RenderTarget& target, const rectu32& viewport)
 		Matrix2x3::Translation(inertCanvasPosition) *
 		Matrix2x3::Scale(inertCanvasScale);
 
+	updateLayersCaches();
+	updateFrameStats();
+
 	rectf32 viewCanvasRect = {};
 	viewCanvasRect.leftTop = inertCanvasPosition;
 	viewCanvasRect.rightBottom = inertCanvasPosition + float32x2(canvasSize) * inertCanvasScale;
 
-	{
-		VertexTexturedUnorm2D vertices[6];
-		vertices[0] = { { viewCanvasRect.left,  viewCanvasRect.top    }, { 0,      0      } };
-		vertices[1] = { { viewCanvasRect.right, viewCanvasRect.top    }, { 0xFFFF, 0      } };
-		vertices[2] = { { viewCanvasRect.left,  viewCanvasRect.bottom }, { 0,      0xFFFF } };
-		vertices[3] = { { viewCanvasRect.left,  viewCanvasRect.bottom }, { 0,      0xFFFF } };
-		vertices[4] = { { viewCanvasRect.right, viewCanvasRect.top    }, { 0xFFFF, 0      } };
-		vertices[5] = { { viewCanvasRect.right, viewCanvasRect.bottom }, { 0xFFFF, 0xFFFF } };
-
-		device->uploadBuffer(quadVertexBuffer, vertices, 0, sizeof(vertices));
-	}
+	uploadQuadVertices(viewCanvasRect);
 
 	device->setRenderTarget(target);
 	device->setViewport(viewport);
@@ -256,25 +733,24 @@ void CanvasManager::updateAndDraw(RenderTarget& target, const rectu32& viewport)
 		quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
 
 	// canvas
-	for (uint16 i = 0; i < layerCount; i++)
+	device->setTransform2D(canvasToViewTransform);
+
+	device->setBlendState(BlendState::Premultiplied);
+	drawLayer(belowLayersCache);
+	device->setBlendState(BlendState::Default);
+
+	if (currentLayer < layerCount && layerRenderingFlags[currentLayer])
 	{
-		if (!layerRenderingFlags[i])
-			continue;
+		if (!disableCurrentLayerRendering)
+			drawLayer(layers[currentLayer]);
 
-		if (i != currentLayer || !disableCurrentLayerRendering)
-		{
-			device->setTexture(layerTextures[i]);
-			device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
-				quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
-		}
+		if (enableTempLayerRendering)
+			drawLayer(tempLayer);
+	}
 
-		if (i == currentLayer && enableTempLayerRendering)
-		{
-			device->setTexture(tempTexture);
-			device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
-				quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
-		}
-	}
+	device->setBlendState(BlendState::Premultiplied);
+	drawLayer(aboveLayersCache);
+	device->setBlendState(BlendState::Default);
 
 	// canvas space foreground
 	{
@@ -327,11 +803,24 @@ void CanvasManager::updateAndDraw(RenderTarget& target, const rectu32& viewport)
 
 void CanvasManager::resetSelection()
 {
+	recordInputTraceEvent(InputTraceEventType::ResetSelection);
 	selection = { 0, 0, canvasSize };
 }
 
-void CanvasManager::setPointerState(sint16x2 position, bool isActive)
+void CanvasManager::setPointerState(sint16x2 position, bool isActive, float32 pressure)
 {
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::PointerState))
+		event->pointer = { position, isActive, pressure };
+
+	// Brush and pencil take every sample, not just the last one of frame.
+	if (isActive && !pointerPanViewModeEnabled)
+	{
+		if (currentInstrument == Instrument::Brush)
+			brushEngine.addSample(float32x2(position) * viewToCanvasTransform, pressure);
+		else if (currentInstrument == Instrument::Pencil)
+			pencilStroke.pushBack(float32x2(position) * viewToCanvasTransform);
+	}
+
 	pointerPosition = position;
 	pointerIsActive = isActive;
 }
@@ -340,6 +829,9 @@ void CanvasManager::setCurrentLayer(uint16 layerIndex)
 {
 	Debug::CrashCondition(layerIndex >= layerCount, DbgMsgFmt("invalid layer index"));
 
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::SetCurrentLayer))
+		event->layerIndex = layerIndex;
+
 	currentLayer = layerIndex;
 }
 
@@ -347,11 +839,16 @@ void CanvasManager::setCurrentLayer(uint16 layerIndex)
 
 uint16 CanvasManager::createLayer(uint16 insertAtIndex)
 {
-	device->createTextureRenderTarget(layerTextures[layerCount], canvasSize.x, canvasSize.y);
-	layerRenderingFlags[layerCount] = true;
+	recordInputTraceEvent(InputTraceEventType::CreateLayer);
 
-	if (!layerCount)
-		device->createTextureRenderTarget(tempTexture, canvasSize.x, canvasSize.y);
+	history.commit();
+	history.recordLayerInsert(layerCount);
+	history.commit();
+
+	layers[layerCount].initialize(tilePool, canvasSize);
+	layerRenderingFlags[layerCount] = true;
+	invalidateLayersCaches();
+	recordAutosaveLayerOp(AutosaveRecordType::LayerInsert, layerCount, true);
 
 	return layerCount++;
 }
@@ -360,7 +857,13 @@ void CanvasManager::removeLayer(uint16 index)
 {
 	Debug::CrashCondition(index >= layerCount, DbgMsgFmt("invalid layer index"));
 
-	layerTextures[index].destroy();
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::RemoveLayer))
+		event->layerIndex = index;
+
+	history.commit();
+	history.recordLayerRemove(index, move(layers[index]), layerRenderingFlags[index]);
+	history.commit();
+
 	--layerCount;
 	if (index == currentLayer && currentLayer == layerCount) 
 	{
@@ -369,30 +872,52 @@ void CanvasManager::removeLayer(uint16 index)
 
 	for (uint16 i = index + 1; i <= layerCount; i++)
 	{
-		layerTextures[i - 1] = move(layerTextures[i]);
+		layers[i - 1] = move(layers[i]);
 		layerRenderingFlags[i - 1] = layerRenderingFlags[i];
 	}
+
+	invalidateLayersCaches();
+	recordAutosaveLayerOp(AutosaveRecordType::LayerRemove, index);
 }
 
 void Panter::CanvasManager::moveLayer(uint16 fromIndex, uint16 toIndex) {
 	Debug::CrashCondition(fromIndex >= layerCount || toIndex >= layerCount, DbgMsgFmt("invalid layer index"));
 
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::MoveLayer))
+	{
+		event->layerIndex = fromIndex;
+		event->otherLayerIndex = toIndex;
+	}
+
+	history.commit();
+	history.recordLayerSwap(fromIndex, toIndex);
+	history.commit();
 
-	XLib::Graphics::TextureRenderTarget tmpTexture = move(layerTextures[fromIndex]);
-	layerTextures[fromIndex] = move(layerTextures[toIndex]);
-	layerTextures[toIndex] = move(tmpTexture);
+	TiledLayer tmpLayer = move(layers[fromIndex]);
+	layers[fromIndex] = move(layers[toIndex]);
+	layers[toIndex] = move(tmpLayer);
 
 	bool tmpLayerFlag = layerRenderingFlags[fromIndex];
 	layerRenderingFlags[fromIndex] = layerRenderingFlags[toIndex];
 	layerRenderingFlags[toIndex] = tmpLayerFlag;
 
+	invalidateLayersCaches();
+	recordAutosaveLayerOp(AutosaveRecordType::LayerSwap, fromIndex, toIndex);
 }
 
 void CanvasManager::enableLayer(uint16 index, bool enabled)
 {
 	Debug::CrashCondition(index >= layerCount, DbgMsgFmt("invalid layer index"));
 
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::EnableLayer))
+	{
+		event->layerIndex = index;
+		event->enabled = enabled;
+	}
+
 	layerRenderingFlags[index] = enabled;
+	invalidateLayersCaches(index);
+	recordAutosaveLayerOp(AutosaveRecordType::LayerVisibility, index, enabled);
 }
 
 void CanvasManager::uploadLayerRegion(uint16 dstLayerIndex, const rectu32& dstRegion,
@@ -400,7 +925,21 @@ void CanvasManager::uploadLayerRegion(uint16 dstLayerIndex, const rectu32& dstRe
 {
 	Debug::CrashCondition(dstLayerIndex >= layerCount, DbgMsgFmt("invalid layer index"));
 
-	device->uploadTexture(layerTextures[dstLayerIndex], dstRegion, srcData, srcDataStride);
+	TiledLayer &layer = layers[dstLayerIndex];
+
+	history.commit();
+
+	rectu32 tileRange = layer.getTileRange(dstRegion);
+	for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+	{
+		for (uint32 x = tileRange.left; x < tileRange.right; x++)
+			history.recordTile(dstLayerIndex, layer, uint32x2(x, y));
+	}
+
+	history.commit();
+
+	layer.upload(dstRegion, srcData, srcDataStride);
+	markLayerDirty(dstLayerIndex, dstRegion);
 }
 
 void CanvasManager::downloadLayerRegion(uint16 srcLayerIndex, const rectu32& srcRegion,
@@ -408,93 +947,655 @@ void CanvasManager::downloadLayerRegion(uint16 srcLayerIndex, const rectu32& src
 {
 	Debug::CrashCondition(srcLayerIndex >= layerCount, DbgMsgFmt("invalid layer index"));
 
-	device->downloadTexture(layerTextures[srcLayerIndex], srcRegion, dstData, dstDataStride);
+	layers[srcLayerIndex].download(srcRegion, dstData, dstDataStride);
 }
 
-void CanvasManager::downloadMergedLayers(void* dstData, uint32 dstDataStride)
-{
-	applyInstrument();
-	resetInstrument();
+// Merging visible layers on CPU. Layer tiles are read back in groups of adjacent tiles
+// and composited straight to destination.
 
+void CanvasManager::downloadMergedTileRows(TiledLayer* const* sourceLayers, uint16 sourceLayerCount,
+	uint32x2 size, uint32 beginTileRow, uint32 endTileRow, void* dstData, uint32 dstDataStride)
+{
 	if (!dstDataStride)
-		dstDataStride = canvasSize.x * 4;
+		dstDataStride = size.x * 4;
+
+	uint32 rowsTop = min(beginTileRow << LayerTileSizeLog2, size.y);
+	uint32 rowsBottom = min(endTileRow << LayerTileSizeLog2, size.y);
+
+	if (sourceLayerCount == 0)
+	{
+		for (uint32 i = rowsTop; i < rowsBottom; i++)
+			Memory::Set(to<byte*>(dstData) + uintptr(dstDataStride) * i, 0, size.x * 4);
+		return;
+	}
+
+	if (sourceLayerCount == 1)
+	{
+		byte *rowsDstData = to<byte*>(dstData) + uintptr(dstDataStride) * rowsTop;
+		sourceLayers[0]->download(rectu32(0, rowsTop, size.x, rowsBottom), rowsDstData, dstDataStride);
+		return;
+	}
+
+	TiledLayer &gridLayer = *sourceLayers[0];
+	uint32x2 gridSize = gridLayer.getGridSize();
+	uint32 groupTileCount = max<uint32>(MergeScratchTileLimit / sourceLayerCount, 1);
+	groupTileCount = min(groupTileCount, gridSize.x);
+	uint32 groupDataStride = groupTileCount * LayerTileSize * 4;
+	uintptr groupPixelCount = uintptr(groupTileCount) * LayerTileSize * LayerTileSize;
+	HeapPtr<uint32> groupData(groupPixelCount * sourceLayerCount);
+
+	for (uint32 y = beginTileRow; y < min(endTileRow, gridSize.y); y++)
+	{
+		for (uint32 groupBegin = 0; groupBegin < gridSize.x; groupBegin += groupTileCount)
+		{
+			uint32 groupEnd = min(groupBegin + groupTileCount, gridSize.x);
+			rectu32 groupRect = gridLayer.getTileRect(uint32x2(groupBegin, y));
+			groupRect.right = gridLayer.getTileRect(uint32x2(groupEnd - 1, y)).right;
+
+			CompositorLayer compositorLayers[Compositor::MaxLayerCount];
+			uint32 compositorLayerCount = 0;
+
+			for (uint16 i = 0; i < sourceLayerCount; i++)
+			{
+				TiledLayer &layer = *sourceLayers[i];
+
+				bool groupEmpty = true;
+				bool groupOpaque = true;
+				for (uint32 x = groupBegin; x < groupEnd; x++)
+				{
+					LayerTile *tile = layer.getTile(uint32x2(x, y));
+					if (tile)
+						groupEmpty = false;
+					if (!tile || !tile->isUniform || tile->uniformColor.a != 0xFF)
+						groupOpaque = false;
+				}
+
+				if (groupEmpty)
+					continue;
+
+				// Layers below opaque group are invisible.
+				if (groupOpaque)
+					compositorLayerCount = 0;
+
+				uint32 *layerData = groupData + groupPixelCount * compositorLayerCount;
+				for (uint32 x = groupBegin; x < groupEnd; x++)
+				{
+					uint32x2 tileCoords(x, y);
+					rectu32 tileRect = gridLayer.getTileRect(tileCoords);
+					uint32 *tileData = layerData + (tileRect.left - groupRect.left);
+
+					LayerTile *tile = layer.getTile(tileCoords);
+					if (tile && !tile->isUniform)
+					{
+						device->downloadTexture(tile->texture, rectu32(0, 0, tileRect.getSize()),
+							tileData, groupDataStride);
+						continue;
+					}
+
+					uint32 color = tile ? tile->uniformColor.rgba : 0;
+					for (uint32 row = 0; row < tileRect.getHeight(); row++)
+					{
+						uint32 *rowData = to<uint32*>(to<byte*>(tileData) + uintptr(groupDataStride) * row);
+						for (uint32 column = 0; column < tileRect.getWidth(); column++)
+							rowData[column] = color;
+					}
+				}
+
+				compositorLayers[compositorLayerCount].data = layerData;
+				compositorLayers[compositorLayerCount].dataStride = groupDataStride;
+				compositorLayerCount++;
+			}
+
+			byte *groupDstData = to<byte*>(dstData) + uintptr(groupRect.top) * dstDataStride + groupRect.left * 4;
+			Compositor::Composite(compositorLayers, compositorLayerCount, groupRect.getSize(),
+				groupDstData, dstDataStride);
+		}
+	}
+}
 
+void CanvasManager::downloadMergedLayers(void* dstData, uint32 dstDataStride)
+{
+	TiledLayer *visibleLayers[Compositor::MaxLayerCount];
 	uint16 visibleLayerCount = 0;
-	uint16 lastVisibleLayerIndex = 0;
 	for (uint16 i = 0; i < layerCount; i++)
 	{
 		if (layerRenderingFlags[i])
+			visibleLayers[visibleLayerCount++] = &layers[i];
+	}
+
+	downloadMergedTileRows(visibleLayers, visibleLayerCount, canvasSize,
+		0, tempLayer.getGridSize().y, dstData, dstDataStride);
+}
+
+void CanvasManager::captureSnapshot(CanvasSnapshot& snapshot)
+{
+	snapshot.release();
+
+	for (uint16 i = 0; i < layerCount; i++)
+	{
+		if (layerRenderingFlags[i])
+			snapshot.layers[snapshot.layerCount++].initializeShared(layers[i]);
+	}
+	snapshot.canvasSize = canvasSize;
+}
+
+void CanvasManager::downloadMergedSnapshot(CanvasSnapshot& snapshot,
+	uint32 beginTileRow, uint32 endTileRow, void* dstData, uint32 dstDataStride)
+{
+	TiledLayer *snapshotLayers[Compositor::MaxLayerCount];
+	for (uint16 i = 0; i < snapshot.layerCount; i++)
+		snapshotLayers[i] = &snapshot.layers[i];
+
+	downloadMergedTileRows(snapshotLayers, snapshot.layerCount, snapshot.canvasSize,
+		beginTileRow, endTileRow, dstData, dstDataStride);
+}
+
+void CanvasManager::clearLayer(uint16 layerIndex, Color color)
+{
+	Debug::CrashCondition(layerIndex >= layerCount, DbgMsgFmt("invalid layer index"));
+
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::ClearLayer))
+	{
+		event->layerIndex = layerIndex;
+		event->color = color;
+	}
+
+	TiledLayer &layer = layers[layerIndex];
+
+	// Clearing empty layer with transparent color changes nothing.
+	if (color.a != 0 || layer.getAllocatedTileCount())
+	{
+		TiledLayer previousLayer;
+		previousLayer.initializeShared(layer);
+
+		history.commit();
+		history.recordLayerReplace(layerIndex, move(previousLayer));
+		history.commit();
+	}
+
+	layer.clear(color);
+	markLayerDirty(layerIndex, rectu32(0, 0, canvasSize));
+}
+
+// Project files ================================================================================//
+
+struct ProjectLoadBatch
+{
+	ProjectFileReader *reader;
+	uint32 *pixels;
+	uint32 *tileIndices;
+	uint16 *layerIndices;
+	bool *results;
+};
+
+static void ReadProjectTiles(void* _batch, uint32 begin, uint32 end)
+{
+	ProjectLoadBatch &batch = *(ProjectLoadBatch*)_batch;
+
+	for (uint32 i = begin; i < end; i++)
+	{
+		batch.results[i] = batch.reader->readTile(batch.layerIndices[i], batch.tileIndices[i],
+			batch.pixels + uintptr(i) * TileCodec::TilePixelCount);
+	}
+}
+
+void CanvasManager::writeProject(ProjectFileWriter& writer)
+{
+	uint32x2 gridSize = tempLayer.getGridSize();
+	uint32 tileCount = tempLayer.getTileCount();
+
+	for (uint16 i = 0; i < layerCount; i++)
+	{
+		for (uint32 tileIndex = 0; tileIndex < tileCount; tileIndex++)
 		{
-			visibleLayerCount++;
-			lastVisibleLayerIndex = i;
+			LayerTile *tile = layers[i].getTile(uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x));
+			if (!tile || tile->isUniform)
+			{
+				writer.writeUniformTile(i, tileIndex, tile ? tile->uniformColor : Color(0));
+				continue;
+			}
+
+			device->downloadTexture(tile->texture, rectu32(0, 0, LayerTileSize, LayerTileSize),
+				writer.allocateTile(i, tileIndex));
 		}
 	}
+}
 
-	if (visibleLayerCount == 0)
+bool CanvasManager::readProject(ProjectFileReader& reader)
+{
+	resetInstrument();
+	history.clear();
+
+	for (uint16 i = 0; i < layerCount; i++)
+		layers[i].destroy();
+
+	canvasSize = reader.getCanvasSize();
+	layerCount = reader.getLayerCount();
+	currentLayer = reader.getCurrentLayer();
+
+	for (uint16 i = 0; i < layerCount; i++)
 	{
-		for (uint32 i = 0; i < canvasSize.y; i++)
-			Memory::Set(to<byte*>(dstData) + dstDataStride * i, 0, dstDataStride);
-		return;
+		layers[i].initialize(tilePool, canvasSize);
+		layerRenderingFlags[i] = reader.getLayerInfo(i).visible;
 	}
 
-	if (visibleLayerCount == 1)
+	resetLayerStorage(canvasSize);
+	resetSelection();
+
+	// Uniform tiles come straight from index. Other tiles are decoded from mapped file
+	// in parallel batches and then uploaded.
+
+	uint32x2 gridSize = tempLayer.getGridSize();
+	uint32 tileCount = tempLayer.getTileCount();
+
+	HeapPtr<uint32> batchPixels(ProjectLoadBatchTileCount * TileCodec::TilePixelCount);
+	uint32 batchTileIndices[ProjectLoadBatchTileCount];
+	uint16 batchLayerIndices[ProjectLoadBatchTileCount];
+	bool batchResults[ProjectLoadBatchTileCount];
+	uint32 batchTileCount = 0;
+	bool result = true;
+
+	ProjectLoadBatch batch = { &reader, batchPixels, batchTileIndices, batchLayerIndices, batchResults };
+
+	auto flushBatch = [&]()
 	{
-		device->downloadTexture(layerTextures[lastVisibleLayerIndex],
-			rectu32(0, 0, canvasSize), dstData, dstDataStride);
-		return;
+		WorkerPool::Global.parallelFor(batchTileCount, 1, ReadProjectTiles, &batch);
+
+		for (uint32 i = 0; i < batchTileCount; i++)
+		{
+			if (!batchResults[i])
+			{
+				result = false;
+				continue;
+			}
+
+			uint32 tileIndex = batchTileIndices[i];
+			uint32x2 tileCoords(tileIndex % gridSize.x, tileIndex / gridSize.x);
+			LayerTile *tile = layers[batchLayerIndices[i]].getWritableTile(tileCoords);
+			device->uploadTexture(tile->texture, rectu32(0, 0, LayerTileSize, LayerTileSize),
+				batchPixels + uintptr(i) * TileCodec::TilePixelCount);
+		}
+
+		batchTileCount = 0;
+	};
+
+	for (uint16 i = 0; i < layerCount; i++)
+	{
+		for (uint32 tileIndex = 0; tileIndex < tileCount; tileIndex++)
+		{
+			Color color;
+			if (reader.isTileUniform(i, tileIndex, color))
+			{
+				layers[i].setTile(uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x), tilePool.getUniform(color));
+				continue;
+			}
+
+			batchTileIndices[batchTileCount] = tileIndex;
+			batchLayerIndices[batchTileCount] = i;
+			batchTileCount++;
+
+			if (batchTileCount == ProjectLoadBatchTileCount)
+				flushBatch();
+		}
 	}
 
-	// Merging visible layers in temp texture.
+	if (batchTileCount)
+		flushBatch();
+
+	return result;
+}
+
+// Autosave =====================================================================================//
 
+void CanvasManager::collectAutosaveChanges(AutosaveChangeSet& changes)
+{
+	changes.release();
+	changes.pool = &tilePool;
+
+	uint32x2 gridSize = tempLayer.getGridSize();
+	uint32 tileCount = tempLayer.getTileCount();
+
+	auto addTile = [&](uint16 layerIndex, uint32 tileIndex)
 	{
-		float32x2 canvasSizeF(canvasSize);
+		LayerTile *tile = layers[layerIndex].getTile(uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x));
+		if (tile)
+			tilePool.addReference(tile);
+		changes.tiles.pushBack({ tile, tileIndex, layerIndex });
+	};
+
+	if (autosaveCanvasReset)
+	{
+		uint16 visibleLayerFlags = 0;
+		for (uint16 i = 0; i < layerCount; i++)
+			visibleLayerFlags |= uint16(layerRenderingFlags[i] << i);
 
-		VertexTexturedUnorm2D vertices[6];
-		vertices[0] = { { 0.0f,          0.0f          }, { 0,      0      } };
-		vertices[1] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-		vertices[2] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-		vertices[3] = { { 0.0f,          canvasSizeF.y }, { 0,      0xFFFF } };
-		vertices[4] = { { canvasSizeF.x, 0.0f          }, { 0xFFFF, 0      } };
-		vertices[5] = { { canvasSizeF.x, canvasSizeF.y }, { 0xFFFF, 0xFFFF } };
+		changes.canvasReset = true;
+		changes.canvas = { canvasSize, layerCount, currentLayer, visibleLayerFlags, 0 };
 
-		device->uploadBuffer(quadVertexBuffer, vertices, 0, sizeof(vertices));
+		// Canvas record leaves layers empty, so only non-empty tiles are needed.
+		for (uint16 i = 0; i < layerCount; i++)
+		{
+			for (uint32 tileIndex = 0; tileIndex < tileCount; tileIndex++)
+			{
+				if (layers[i].getTile(uint32x2(tileIndex % gridSize.x, tileIndex / gridSize.x)))
+					addTile(i, tileIndex);
+			}
+		}
 	}
+	else
+	{
+		for (const AutosaveLayerOp &op : autosaveLayerOps)
+			changes.layerOps.pushBack(op);
 
-	device->setRenderTarget(tempTexture);
-	device->setViewport(rectu32(0, 0, canvasSize));
-	device->setScissorRect(rectu32(0, 0, canvasSize));
-	device->setTransform2D(Matrix2x3::Identity());
+		for (uint32 tileIndex : autosaveDirtyTiles)
+		{
+			uint16 flags = autosaveTileLayerFlags[tileIndex];
+			for (uint16 i = 0; i < layerCount; i++)
+			{
+				if (flags & (1 << i))
+					addTile(i, tileIndex);
+			}
+			autosaveTileLayerFlags[tileIndex] = 0;
+		}
+	}
 
-	device->clear(tempTexture, 0xFFFFFF00_rgba);
+	autosaveDirtyTiles.clear();
+	autosaveLayerOps.clear();
+	autosaveCanvasReset = false;
+}
 
-	for (uint16 i = 0; i < layerCount; i++)
+void CanvasManager::resetAutosaveChanges()
+{
+	for (uint32 tileIndex : autosaveDirtyTiles)
+		autosaveTileLayerFlags[tileIndex] = 0;
+
+	autosaveDirtyTiles.clear();
+	autosaveLayerOps.clear();
+	autosaveCanvasReset = true;
+}
+
+bool CanvasManager::readAutosaveJournal(AutosaveJournalReader& reader)
+{
+	resetInstrument();
+	history.clear();
+
+	HeapPtr<uint32> pixels(TileCodec::TilePixelCount);
+	AutosaveRecordHeader header;
+	const byte *payload = nullptr;
+	bool result = true;
+
+	while (reader.readRecord(header, payload))
 	{
-		if (!layerRenderingFlags[i])
-			continue;
+		uint16 index = header.layerIndex;
+		bool valid = true;
+
+		switch (header.type)
+		{
+			case AutosaveRecordType::Canvas:
+			{
+				AutosaveCanvasRecord canvas = {};
+				valid = header.payloadSize == sizeof(AutosaveCanvasRecord);
+				if (valid)
+					Memory::Copy(&canvas, payload, sizeof(AutosaveCanvasRecord));
+
+				valid = valid && canvas.canvasSize.x && canvas.canvasSize.y && canvas.layerCount <= countof(layers);
+				if (!valid)
+					break;
+
+				for (uint16 i = 0; i < layerCount; i++)
+					layers[i].destroy();
+
+				canvasSize = canvas.canvasSize;
+				layerCount = canvas.layerCount;
+				currentLayer = canvas.currentLayer;
 
-		device->setTexture(layerTextures[i]);
-		device->draw2D(PrimitiveType::TriangleList, Effect::TexturedUnorm,
-			quadVertexBuffer, 0, sizeof(VertexTexturedUnorm2D), 6);
+				for (uint16 i = 0; i < layerCount; i++)
+				{
+					layers[i].initialize(tilePool, canvasSize);
+					layerRenderingFlags[i] = ((canvas.visibleLayerFlags >> i) & 1) != 0;
+				}
+
+				resetLayerStorage(canvasSize);
+				break;
+			}
+
+			case AutosaveRecordType::Tile:
+			case AutosaveRecordType::UniformTile:
+			{
+				valid = index < layerCount && header.argument < tempLayer.getTileCount();
+				if (!valid)
+					break;
+
+				uint32x2 gridSize = tempLayer.getGridSize();
+				uint32x2 tileCoords(header.argument % gridSize.x, header.argument / gridSize.x);
+
+				if (header.type == AutosaveRecordType::UniformTile)
+				{
+					Color color = 0;
+					valid = header.payloadSize == sizeof(Color);
+					if (valid)
+					{
+						Memory::Copy(&color, payload, sizeof(Color));
+						layers[index].setTile(tileCoords, tilePool.getUniform(color));
+					}
+					break;
+				}
+
+				valid = TileCodec::Decompress(payload, header.payloadSize, pixels);
+				if (valid)
+				{
+					LayerTile *tile = layers[index].getWritableTile(tileCoords);
+					device->uploadTexture(tile->texture, rectu32(0, 0, LayerTileSize, LayerTileSize), pixels);
+				}
+				break;
+			}
+
+			case AutosaveRecordType::LayerInsert:
+				valid = layerCount < countof(layers) && index <= layerCount;
+				if (!valid)
+					break;
+
+				for (uint16 i = layerCount; i > index; i--)
+				{
+					layers[i] = move(layers[i - 1]);
+					layerRenderingFlags[i] = layerRenderingFlags[i - 1];
+				}
+				layers[index].initialize(tilePool, canvasSize);
+				layerRenderingFlags[index] = header.argument != 0;
+				layerCount++;
+				break;
+
+			case AutosaveRecordType::LayerRemove:
+				valid = index < layerCount;
+				if (!valid)
+					break;
+
+				layers[index].destroy();
+				layerCount--;
+				for (uint16 i = index; i < layerCount; i++)
+				{
+					layers[i] = move(layers[i + 1]);
+					layerRenderingFlags[i] = layerRenderingFlags[i + 1];
+				}
+				break;
+
+			case AutosaveRecordType::LayerSwap:
+				valid = index < layerCount && header.argument < layerCount;
+				if (valid)
+				{
+					swap(layers[index], layers[header.argument]);
+					swap(layerRenderingFlags[index], layerRenderingFlags[header.argument]);
+				}
+				break;
+
+			case AutosaveRecordType::LayerVisibility:
+				valid = index < layerCount;
+				if (valid)
+					layerRenderingFlags[index] = header.argument != 0;
+				break;
+
+			default:
+				valid = false;
+				break;
+		}
+
+		if (!valid)
+		{
+			result = false;
+			break;
+		}
 	}
 
-	device->downloadTexture(tempTexture,
-		rectu32(0, 0, canvasSize), dstData, dstDataStride);
+	if (currentLayer >= layerCount)
+		currentLayer = layerCount ? layerCount - 1 : 0;
+
+	invalidateLayersCaches();
+	resetSelection();
+
+	// Replayed contents are not tracked, so next autosave writes whole canvas.
+	resetAutosaveChanges();
+
+	return result;
 }
 
-void CanvasManager::clearLayer(uint16 layerIndex, Color color)
+// History ======================================================================================//
+
+void CanvasManager::applyHistoryRecord(HistoryRecord& record)
+{
+	switch (record.type)
+	{
+		case HistoryRecordType::Tile:
+		{
+			TiledLayer &layer = layers[record.layerIndex];
+			uint32x2 gridSize = layer.getGridSize();
+			uint32x2 tileCoords(record.tileIndex % gridSize.x, record.tileIndex / gridSize.x);
+
+			LayerTile *tile = history.takeTile(record);
+			history.putTile(record, layer.exchangeTile(tileCoords, tile));
+			markLayerDirty(record.layerIndex, layer.getTileRect(tileCoords));
+			break;
+		}
+
+		case HistoryRecordType::LayerPresence:
+		{
+			// Layer moves are swaps, so empty layers stay in the end of array.
+			uint16 index = record.layerIndex;
+
+			if (record.layer->isInitialized())
+			{
+				for (uint16 i = layerCount; i > index; i--)
+				{
+					layers[i] = move(layers[i - 1]);
+					layerRenderingFlags[i] = layerRenderingFlags[i - 1];
+				}
+				layerCount++;
+
+				swap(layers[index], *record.layer);
+				swap(layerRenderingFlags[index], record.layerRenderingFlag);
+
+				recordAutosaveLayerOp(AutosaveRecordType::LayerInsert, index, layerRenderingFlags[index]);
+				markLayerTilesForAutosave(index);
+			}
+			else
+			{
+				swap(layers[index], *record.layer);
+				swap(layerRenderingFlags[index], record.layerRenderingFlag);
+
+				layerCount--;
+				for (uint16 i = index; i < layerCount; i++)
+				{
+					layers[i] = move(layers[i + 1]);
+					layerRenderingFlags[i] = layerRenderingFlags[i + 1];
+				}
+
+				recordAutosaveLayerOp(AutosaveRecordType::LayerRemove, index);
+			}
+			invalidateLayersCaches();
+			break;
+		}
+
+		case HistoryRecordType::LayerSwap:
+			swap(layers[record.layerIndex], layers[record.otherLayerIndex]);
+			swap(layerRenderingFlags[record.layerIndex], layerRenderingFlags[record.otherLayerIndex]);
+			invalidateLayersCaches();
+			recordAutosaveLayerOp(AutosaveRecordType::LayerSwap, record.layerIndex, record.otherLayerIndex);
+			break;
+
+		case HistoryRecordType::LayerReplace:
+			swap(layers[record.layerIndex], *record.layer);
+			markLayerDirty(record.layerIndex, rectu32(0, 0, canvasSize));
+			break;
+
+		case HistoryRecordType::CanvasSize:
+			swap(canvasSize, record.canvasSize);
+			resetLayerStorage(canvasSize);
+			resetSelection();
+			break;
+	}
+}
+
+void CanvasManager::undo()
+{
+	recordInputTraceEvent(InputTraceEventType::Undo);
+
+	history.commit();
+
+	HistoryEntry *entry = history.stepBack();
+	if (!entry)
+		return;
+
+	discardInstrumentPreview();
+
+	for (uint32 i = entry->recordCount; i > 0; i--)
+		applyHistoryRecord(entry->records[i - 1]);
+
+	if (currentLayer >= layerCount)
+		currentLayer = layerCount ? layerCount - 1 : 0;
+}
+
+void CanvasManager::redo()
 {
-	device->clear(layerTextures[layerIndex], color);
+	recordInputTraceEvent(InputTraceEventType::Redo);
+
+	history.commit();
+
+	HistoryEntry *entry = history.stepForward();
+	if (!entry)
+		return;
+
+	discardInstrumentPreview();
+
+	for (uint32 i = 0; i < entry->recordCount; i++)
+		applyHistoryRecord(entry->records[i]);
+
+	if (currentLayer >= layerCount)
+		currentLayer = layerCount ? layerCount - 1 : 0;
+}
+
+void CanvasManager::clearHistory()
+{
+	recordInputTraceEvent(InputTraceEventType::ClearHistory);
+	history.clear();
+}
+
+void CanvasManager::setHistoryMemoryBudget(uint64 memoryBudget)
+{
+	history.setMemoryBudget(memoryBudget);
 }
 
 // View handling ================================================================================//
 
 void CanvasManager::centerView()
 {
+	recordInputTraceEvent(InputTraceEventType::CenterView);
 	viewCentered = true;
 }
 
 void CanvasManager::enablePointerPanViewMode(bool enabled)
 {
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::PointerPanViewMode))
+		event->enabled = enabled;
+
 	pointerPanViewModeEnabled = enabled;
 }
 
@@ -506,6 +1607,9 @@ void CanvasManager::panView(float32x2 offset)
 
 void CanvasManager::scaleView(float32 scaleFactor)
 {
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::ScaleView))
+		event->scale = scaleFactor;
+
 	viewCentered = false;
 
 	float32 newCanvasScale = canvasScale * scaleFactor;
@@ -516,6 +1620,75 @@ void CanvasManager::scaleView(float32 scaleFactor)
 
 void CanvasManager::setAbsoluteCanvasScale(float32 scale)
 {
+	if (InputTraceEvent *event = recordInputTraceEvent(InputTraceEventType::SetCanvasScale))
+		event->scale = scale;
+
 	viewCentered = false;
 	canvasScale = scale;
 }
+
+// Input trace recording ========================================================================//
+
+InputTraceEvent* CanvasManager::recordInputTraceEvent(InputTraceEventType type)
+{
+	if (!inputTrace)
+		return nullptr;
+
+	// Settings of selected instrument are stored with selection event.
+	if (type == InputTraceEventType::InstrumentSettings &&
+		pendingInputTraceInstrumentEvent == InputTraceEventType::SetInstrument)
+	{
+		return nullptr;
+	}
+
+	// Instrument settings are stored once they can't be changed through reference any more.
+	if (pendingInputTraceInstrumentEvent != InputTraceEventType::None)
+	{
+		InputTraceEvent &instrumentEvent = inputTrace->addEvent(pendingInputTraceInstrumentEvent);
+		instrumentEvent.instrument = currentInstrument;
+		instrumentEvent.layerIndex = currentLayer;
+		instrumentEvent.instrumentSettings = instrumentSettings;
+		pendingInputTraceInstrumentEvent = InputTraceEventType::None;
+	}
+
+	switch (type)
+	{
+		case InputTraceEventType::None:
+			return nullptr;
+
+		case InputTraceEventType::SetInstrument:
+		case InputTraceEventType::InstrumentSettings:
+			pendingInputTraceInstrumentEvent = type;
+			return nullptr;
+	}
+
+	InputTraceEvent &event = inputTrace->addEvent(type);
+	event.instrument = currentInstrument;
+	event.layerIndex = currentLayer;
+	return &event;
+}
+
+void CanvasManager::startInputTraceRecording(InputTrace& trace)
+{
+	uint16 visibleLayerFlags = 0;
+	for (uint16 i = 0; i < layerCount; i++)
+		visibleLayerFlags |= layerRenderingFlags[i] ? uint16(1 << i) : 0;
+
+	trace.begin(canvasSize, layerCount, currentLayer, visibleLayerFlags);
+	inputTrace = &trace;
+	pendingInputTraceInstrumentEvent = InputTraceEventType::None;
+
+	// Replay starts without instrument, so current one is recorded first.
+	if (currentInstrument != Instrument::None)
+		recordInputTraceEvent(InputTraceEventType::SetInstrument);
+}
+
+void CanvasManager::stopInputTraceRecording()
+{
+	if (!inputTrace)
+		return;
+
+	// Flushes pending instrument event.
+	recordInputTraceEvent(InputTraceEventType::None);
+	inputTrace = nullptr;
+}
@@ -2,11 +2,20 @@
 
 #include <XLib.Types.h>
 #include <XLib.NonCopyable.h>
-//#include <XLib.Containers.Vector.h>
+#include <XLib.Containers.Vector.h>
 #include <XLib.Color.h>
 #include <XLib.Vectors.h>
 #include <XLib.Graphics.h>
 #include <XLib.Graphics.GeometryGenerator.h>
+#include <XLib.Graphics.PathRasterizer.h>
+
+#include "Panter.Constants.h"
+#include "Panter.TiledLayer.h"
+#include "Panter.History.h"
+#include "Panter.ColorLookup.h"
+#include "Panter.ProjectFile.h"
+#include "Panter.AutosaveJournal.h"
+#include "Panter.BrushEngine.h"
 
 // TODO: Handle current layer change during filter preview.
 
@@ -80,11 +89,68 @@ namespace Panter
 		float32 intensity;
 	};
 
+	union InstrumentSettings
+	{
+		PencilSettings pencil;
+		BrushSettings brush;
+		LineSettings line;
+		ShapeSettings shape;
+		BrightnessContrastGammaFilterSettings brightnessContrastGamma;
+		GaussianBlurFilterSettings gaussianBlur;
+		SharpenFilterSettings sharpen;
+	};
+
+	struct CanvasFrameStats
+	{
+		uint64 layerDirtyPixelCount;		// Layer pixels modified, summed over layers.
+		uint64 tempLayerDirtyPixelCount;	// Instrument preview pixels modified.
+		uint64 recompositedPixelCount;		// Pixels of flattened layer stacks rebuilt.
+		uint32 geometryVertexCount;			// Generated for view and layers since previous frame.
+		uint32 geometryIndexCount;
+		uint32 geometryFlushCount;
+		uint32 geometryDrawCount;
+	};
+
+	// Visible layers of canvas at the moment of capture. Tiles are shared with canvas, so
+	// capture costs only reference counting and canvas modifications made after it unshare
+	// touched tiles (copy on write). Snapshot has to be released on the thread owning canvas
+	// and before canvas is destroyed.
+
+	class CanvasSnapshot : public XLib::NonCopyable
+	{
+		friend class CanvasManager;
+
+	private:
+		TiledLayer layers[16];
+		uint32x2 canvasSize = { 0, 0 };
+		uint16 layerCount = 0;
+
+	public:
+		CanvasSnapshot() = default;
+		~CanvasSnapshot() = default;
+
+		inline void release()
+		{
+			for (uint16 i = 0; i < layerCount; i++)
+				layers[i].destroy();
+			layerCount = 0;
+		}
+
+		inline uint32x2 getCanvasSize() const { return canvasSize; }
+		inline uint32 getTileRowCount() const { return (canvasSize.y + LayerTileSize - 1) >> LayerTileSizeLog2; }
+	};
+
+	class InputTrace;
+	struct InputTraceEvent;
+	enum class InputTraceEventType : uint8;
+
 	class CanvasManager : public XLib::NonCopyable
 	{
 	private: // meta
 		static constexpr float32 centeredViewMarginRelativeWidth = 0.1f;
 		static constexpr float32 viewIntertiaFactor = 0.15f;
+		static constexpr uint32 filterApronSize = 16; // max filter kernel radius
+		static constexpr uint32 filterTextureSize = LayerTileSize + filterApronSize * 2;
 
 		//using Layers = XLib::Vector<XLib::Graphics::TextureRenderTarget>;
 
@@ -153,20 +219,47 @@ namespace Panter
 		// graphics resources
 		XLib::Graphics::Device *device = nullptr;
 		XLib::Graphics::Buffer quadVertexBuffer;
+		XLib::Graphics::Buffer tileQuadsVertexBuffer;
 		XLib::Graphics::GeometryGenerator geometryGenerator;
+		XLib::Graphics::TextureRenderTarget filterSourceTexture;
+		XLib::Graphics::TextureRenderTarget filterTargetTexture;
 
 		XLib::Graphics::CustomEffect checkerboardEffect;
-		XLib::Graphics::CustomEffect brightnessContrastGammaEffect;
-		XLib::Graphics::CustomEffect blurEffect;
 		XLib::Graphics::CustomEffect sharpenEffect;
 
 		// canvas data
-		XLib::Graphics::TextureRenderTarget layerTextures[16];
+		LayerTilePool tilePool;
+		TiledLayer layers[16];
 		bool layerRenderingFlags[16] = {};
-		XLib::Graphics::TextureRenderTarget tempTexture;
+		TiledLayer tempLayer;
 		uint32x2 canvasSize = { 0, 0 };
 		uint16 layerCount = 0;
 
+		// Premultiplied flattens of visible layers below and above current layer.
+		TiledLayer belowLayersCache;
+		TiledLayer aboveLayersCache;
+		DirtyRegion belowLayersCacheDirtyRegion;
+		DirtyRegion aboveLayersCacheDirtyRegion;
+		uint16 layersCacheCurrentLayer = 0;
+
+		// Dirty regions of layers are collected for frame stats and cleared every frame.
+		DirtyRegion layerDirtyRegions[16];
+		DirtyRegion tempLayerFrameDirtyRegion;
+		DirtyRegion tempLayerDirtyRegion;		// Since last temp layer clear.
+		DirtyRegion filterSourceDirtyRegion;	// Current layer changes since last filter preview update.
+		DirtyRegion filterTargetDirtyRegion;
+		CanvasFrameStats lastFrameStats = {};
+		uint64 recompositedPixelCount = 0;
+
+		History history;
+
+		// Changes since last autosave collection. Dirty tile keeps bit per layer. Layer
+		// operations remap bits, so tiles are collected at their final layer positions.
+		XLib::HeapPtr<uint16> autosaveTileLayerFlags;
+		XLib::Vector<uint32> autosaveDirtyTiles;
+		XLib::Vector<AutosaveLayerOp> autosaveLayerOps;
+		bool autosaveCanvasReset = true;	// Whole canvas is collected next time.
+
 		// canvas modification state
 		rectu32 selection = {};
 		uint16 currentLayer = 0;
@@ -174,16 +267,27 @@ namespace Panter
 		bool disableCurrentLayerRendering = false;
 		bool enableTempLayerRendering = false;
 
-		union
-		{
-			PencilSettings pencil;
-			BrushSettings brush;
-			LineSettings line;
-			ShapeSettings shape;
-			BrightnessContrastGammaFilterSettings brightnessContrastGamma;
-			GaussianBlurFilterSettings gaussianBlur;
-			SharpenFilterSettings sharpen;
-		} instrumentSettings;
+		// geometry generator flush target
+		TiledLayer *geometryTargetLayer = nullptr;
+		rectu32 geometryClipRect = {};
+		XLib::Vector<uint32> geometryTargetTiles;
+		XLib::HeapPtr<bool> geometryTargetTileFlags;
+
+		// Pencil stroke in progress is drawn to temp layer as single polyline and merged on release.
+		XLib::Vector<float32x2> pencilStroke;
+		uint32 pencilStrokeDrawnPointCount = 0;
+
+		// Brush stroke in progress is resolved to temp layer every frame and merged on release.
+		BrushEngine brushEngine;
+
+		// Shapes are rasterized with analytic coverage on CPU and uploaded to temp layer.
+		XLib::Graphics::PathRasterizer shapeRasterizer;
+		XLib::HeapPtr<uint32> shapeBuffer;
+		uint32 shapeBufferSize = 0;		// In pixels.
+
+		InstrumentSettings instrumentSettings;
+
+		ColorLookupTable brightnessContrastGammaTable;	// Rebuilt when filter settings change.
 
 		union
 		{
@@ -212,7 +316,38 @@ namespace Panter
 		bool pointerIsActive = false;
 		bool pointerPanViewModeEnabled = false;
 
+		// Input trace being recorded. Instrument event waits for next recorded call, so its
+		// settings include changes made through returned settings reference.
+		InputTrace *inputTrace = nullptr;
+		InputTraceEventType pendingInputTraceInstrumentEvent = {};
+
 	private: // code
+		static void FlushGeometryToTargetLayer(void* context);
+
+		void resetLayerStorage(uint32x2 newCanvasSize);
+		void uploadQuadVertices(const rectf32& rect);
+		void beginLayerGeometry(TiledLayer& layer, const rectu32& clipRect);
+		void endLayerGeometry();
+		void drawLayer(TiledLayer& layer);
+
+		void markLayerDirty(uint16 layerIndex, const rectu32& rect);
+		void markLayerTilesForAutosave(uint16 layerIndex);
+		void recordAutosaveLayerOp(AutosaveRecordType type, uint16 layerIndex, uint32 argument = 0);
+		void markTempLayerDirty(const rectu32& rect);
+		void clearTempLayer();
+		void invalidateLayersCaches();
+		void invalidateLayersCaches(uint16 layerIndex);
+		void flattenLayers(TiledLayer& target, DirtyRegion& region,
+			uint16 beginLayerIndex, uint16 endLayerIndex);
+		void updateLayersCaches();
+		void updateFrameStats();
+
+		void downloadMergedTileRows(TiledLayer* const* sourceLayers, uint16 sourceLayerCount,
+			uint32x2 size, uint32 beginTileRow, uint32 endTileRow, void* dstData, uint32 dstDataStride);
+
+		void applyHistoryRecord(HistoryRecord& record);
+		void discardInstrumentPreview();
+
 		void updateInstrument_selection();
 		void updateInstrument_pencil();
 		void updateInstrument_brush();
@@ -225,22 +360,35 @@ namespace Panter
 		inline void updateInstrument_filter(XLib::Graphics::CustomEffect& filterEffect, const SettingsType& settings)
 			{ updateInstrument_filter(filterEffect, &settings, sizeof(SettingsType)); }
 
+		void updateInstrument_brightnessContrastGammaFilter();
+		void updateInstrument_gaussianBlurFilter();
+		void applyFilterPreview();
+
 		void mergeCurrentLayerWithTemp();
 
+		// Returns event to be filled or nullptr if trace is not recorded.
+		InputTraceEvent* recordInputTraceEvent(InputTraceEventType type);
+
 	public:
 		CanvasManager() = default;
 		~CanvasManager() = default;
 
-		void initialize(XLib::Graphics::Device& device, uint32x2 canvasSize);
+		// History spills to journal file only if its name is given, several canvases must not
+		// share one.
+		void initialize(XLib::Graphics::Device& device, uint32x2 canvasSize,
+			const char* historyJournalFileName = HistoryJournalFileName);
 		void destroy();
 
 		void resizeDiscardingContents(uint32x2 newCanvasSize);
 		void resizeSavingContents(const rects32& newCanvasRect, XLib::Color fillColor = 0);
 		void updateAndDraw(XLib::Graphics::RenderTarget& target, const rectu32& viewport /* TODO: move from here */);
+		// Advances current instrument without drawing, so canvas can be processed without view.
+		// Applied filter is finished by single call.
+		void updateInstrument();
 		//void setViewport();
 
 		void resetSelection();
-		void setPointerState(sint16x2 position, bool isActive);
+		void setPointerState(sint16x2 position, bool isActive, float32 pressure = 1.0f);
 		void setCurrentLayer(uint16 layerIndex);
 
 		void resetInstrument();
@@ -265,17 +413,45 @@ namespace Panter
 			const void* srcData, uint32 srcDataStride = 0);
 		void downloadLayerRegion(uint16 srcLayerIndex, const rectu32& srcRegion,
 			void* dstData, uint32 dstDataStride = 0);
+		// Straight alpha merge of visible layers. Instrument preview is not included.
 		void downloadMergedLayers(void* dstData, uint32 dstDataStride = 0);
 		void clearLayer(uint16 layerIndex, XLib::Color color);
 
+		void captureSnapshot(CanvasSnapshot& snapshot);
+		// Merges range of snapshot tile rows, so large snapshot can be read back over several
+		// frames. Destination is whole snapshot sized image.
+		void downloadMergedSnapshot(CanvasSnapshot& snapshot, uint32 beginTileRow, uint32 endTileRow,
+			void* dstData, uint32 dstDataStride = 0);
+
+		// Layer names are not known to canvas, caller writes and reads them.
+		void writeProject(ProjectFileWriter& writer);
+		// Replaces canvas contents and clears history. Returns false if some tiles are
+		// corrupted, those are left transparent.
+		bool readProject(ProjectFileReader& reader);
+
+		// Moves changes made since previous collection to change set.
+		void collectAutosaveChanges(AutosaveChangeSet& changes);
+		// Next collection gets whole canvas.
+		void resetAutosaveChanges();
+		// Replays journal over canvas and clears history. Returns false if replay stopped at
+		// record that does not match canvas state.
+		bool readAutosaveJournal(AutosaveJournalReader& reader);
+
 		void centerView();
 		void enablePointerPanViewMode(bool enabled);
 		void panView(float32x2 offset);
 		void scaleView(float32 scaleFactor); // TODO: add scaleViewToPointer
 		void setAbsoluteCanvasScale(float32 scale);
 
-		//void undo();
-		//void redo();
+		void undo();
+		void redo();
+		void clearHistory();
+		void setHistoryMemoryBudget(uint64 memoryBudget);
+
+		// Canvas calls are recorded to trace until recording is stopped. Trace has to outlive
+		// recording.
+		void startInputTraceRecording(InputTrace& trace);
+		void stopInputTraceRecording();
 
         inline Instrument getCanvasInstrument() const { return currentInstrument; }
 		inline PencilSettings&	getInstrumentSettings_pencil()	{ return instrumentSettings.pencil; }
@@ -291,12 +467,19 @@ namespace Panter
 		inline uint32 getCanvasHeight() const { return canvasSize.y; }
 		
 		inline uint16 getLayerCount() const { return layerCount; }
+		inline bool isLayerEnabled(uint16 index) const { return layerRenderingFlags[index]; }
+		inline uint32 getAllocatedTileCount() const { return tilePool.getAllocatedTileCount(); }
+		inline uint64 getHistoryMemoryUsage() const { return history.getMemoryUsage(); }
+		inline bool canUndo() const { return history.canUndo() || history.hasPendingRecords(); }
+		inline bool canRedo() const { return history.canRedo() && !history.hasPendingRecords(); }
+		inline const CanvasFrameStats& getLastFrameStats() const { return lastFrameStats; }
         inline uint16 getCurrentLayerId() const { return currentLayer; }
 		inline const rectu32& getSelection() const { return selection; }
 
 		inline float32 getCanvasScale() const { return inertCanvasScale; }
 		inline float32x2 getCanvasSpacePointerPosition() const { return float32x2(pointerPosition) * viewToCanvasTransform; }
 		
+		inline bool isRecordingInputTrace() const { return inputTrace != nullptr; }
 		inline bool isInitialized() const { return device != nullptr; }
 	};
 }
@@ -0,0 +1,155 @@
+#include <immintrin.h>
+#include <math.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Debug.h>
+#include <XLib.System.CPU.h>
+#include <XLib.Benchmark.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "Panter.ColorLookup.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr uint32 minBandHeight = 16;
+static constexpr uint32 minBandPixelCount = 256 * 256;
+
+struct LookupContext
+{
+	uint32 table[256];	// Widened, so it can be used with 32 bit gathers.
+	const byte *srcData;
+	byte *dstData;
+	uint32 srcDataStride;
+	uint32 dstDataStride;
+	uint32 width;
+	bool useAVX2;
+};
+
+// Kernels ==================================================================================//
+
+static inline uint32 LookupPixel(const uint32* table, uint32 pixel)
+{
+	if (!(pixel >> 24))
+		return 0;
+
+	return table[pixel & 0xFF] |
+		(table[(pixel >> 8) & 0xFF] << 8) |
+		(table[(pixel >> 16) & 0xFF] << 16) |
+		(pixel & 0xFF000000);
+}
+
+static void LookupRow_Scalar(const uint32* table, const uint32* src, uint32* dst, uint32 begin, uint32 end)
+{
+	for (uint32 x = begin; x < end; x++)
+		dst[x] = LookupPixel(table, src[x]);
+}
+
+static void LookupRow_AVX2(const uint32* table, const uint32* src, uint32* dst, uint32 width)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256i alphaMask = _mm256_set1_epi32(sint32(0xFF000000));
+	const __m256i zero = _mm256_setzero_si256();
+	const int* gatherBase = to<const int*>(table);
+
+	uint32 x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i pixels = _mm256_loadu_si256(to<const __m256i*>(src + x));
+
+		__m256i r = _mm256_i32gather_epi32(gatherBase, _mm256_and_si256(pixels, byteMask), 4);
+		__m256i g = _mm256_i32gather_epi32(gatherBase, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), 4);
+		__m256i b = _mm256_i32gather_epi32(gatherBase, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), 4);
+		__m256i alpha = _mm256_and_si256(pixels, alphaMask);
+
+		__m256i result = _mm256_or_si256(
+			_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+			_mm256_or_si256(_mm256_slli_epi32(b, 16), alpha));
+		result = _mm256_andnot_si256(_mm256_cmpeq_epi32(alpha, zero), result);
+
+		_mm256_storeu_si256(to<__m256i*>(dst + x), result);
+	}
+
+	LookupRow_Scalar(table, src, dst, x, width);
+}
+
+static void LookupRows(void* context, uint32 begin, uint32 end)
+{
+	const LookupContext &lookup = *to<LookupContext*>(context);
+
+	for (uint32 y = begin; y < end; y++)
+	{
+		const uint32 *srcRow = to<const uint32*>(lookup.srcData + uintptr(lookup.srcDataStride) * y);
+		uint32 *dstRow = to<uint32*>(lookup.dstData + uintptr(lookup.dstDataStride) * y);
+		if (lookup.useAVX2)
+			LookupRow_AVX2(lookup.table, srcRow, dstRow, lookup.width);
+		else
+			LookupRow_Scalar(lookup.table, srcRow, dstRow, 0, lookup.width);
+	}
+}
+
+// ColorLookup ==============================================================================//
+
+void ColorLookup::BuildBrightnessContrastGamma(ColorLookupTable& table,
+	float32 brightness, float32 contrast, float32 gamma)
+{
+	for (uint32 i = 0; i < 256; i++)
+	{
+		float32 value = float32(i) / 255.0f;
+		value = (value - 0.5f) * contrast + 0.5f + brightness;
+		// Negative base results in NaN on GPU, which is written to UNORM target as zero.
+		value = value > 0.0f ? powf(value, gamma) : 0.0f;
+		table.values[i] = uint8(clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+void ColorLookup::Apply(const ColorLookupTable& table, const void* srcData, uint32 srcDataStride,
+	uint32x2 size, void* dstData, uint32 dstDataStride)
+{
+	if (!size.x || !size.y)
+		return;
+	if (!srcDataStride)
+		srcDataStride = size.x * 4;
+	if (!dstDataStride)
+		dstDataStride = size.x * 4;
+
+	LookupContext context;
+	for (uint32 i = 0; i < 256; i++)
+		context.table[i] = table.values[i];
+	context.srcData = to<const byte*>(srcData);
+	context.dstData = to<byte*>(dstData);
+	context.srcDataStride = srcDataStride;
+	context.dstDataStride = dstDataStride;
+	context.width = size.x;
+	context.useAVX2 = CPU::SupportsAVX2();
+
+	uint32 bandHeight = max(minBandHeight, intdivceil(minBandPixelCount, size.x));
+	WorkerPool::Global.parallelFor(size.y, bandHeight, LookupRows, &context);
+}
+
+// Benchmark ================================================================================//
+
+void ColorLookup::RunBenchmark()
+{
+	static constexpr uint32 iterationCount = 8;
+
+	HeapPtr<uint32> srcData(Benchmark::MaxImagePixelCount);
+	HeapPtr<uint32> dstData(Benchmark::MaxImagePixelCount);
+	Benchmark::FillRandom(srcData, Benchmark::MaxImagePixelCount);
+
+	ColorLookupTable table;
+	BuildBrightnessContrastGamma(table, 0.1f, 1.2f, 0.8f);
+
+	Benchmark::LogHeader("Color lookup", CPU::SupportsAVX2() ? "AVX2 kernel" : "scalar kernel");
+
+	for (const BenchmarkImageSize &imageSize : Benchmark::ImageSizes)
+	{
+		auto kernel = [&]() { Apply(table, srcData, 0, imageSize.size, dstData); };
+		float32 time = Benchmark::MeasureTime(iterationCount, kernel);
+
+		// Every pixel is read once and written once.
+		float64 pixelCount = float64(imageSize.size.x) * float64(imageSize.size.y);
+		Benchmark::LogResult(time, pixelCount, pixelCount * 8.0, "%s", imageSize.name);
+	}
+}
\ No newline at end of file
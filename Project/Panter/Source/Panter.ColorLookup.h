@@ -0,0 +1,33 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.Vectors.h>
+
+namespace Panter
+{
+	// Per channel table mapping of straight alpha RGBA8 images. Table is applied to color
+	// channels only, alpha is kept and fully transparent pixels stay transparent, so
+	// result is the same as if filter was applied to unpremultiplied color.
+
+	struct ColorLookupTable
+	{
+		uint8 values[256];
+	};
+
+	struct ColorLookup abstract final
+	{
+		// Same transform as former brightness contrast gamma shader:
+		// pow((value - 0.5) * contrast + 0.5 + brightness, gamma), saturated.
+		static void BuildBrightnessContrastGamma(ColorLookupTable& table,
+			float32 brightness, float32 contrast, float32 gamma);
+
+		// Rows are split into bands that are processed by worker pool threads.
+		// Uses AVX2 gather kernel if it is supported and scalar kernel otherwise.
+		// Source and destination may be the same memory.
+		static void Apply(const ColorLookupTable& table, const void* srcData, uint32 srcDataStride,
+			uint32x2 size, void* dstData, uint32 dstDataStride = 0);
+
+		// Logs lookup throughput at 4k and 8k.
+		static void RunBenchmark();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include <immintrin.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Memory.h>
+#include <XLib.Debug.h>
+#include <XLib.Random.h>
+#include <XLib.Benchmark.h>
+#include <XLib.System.CPU.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "Panter.Compositor.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr uint32 minBandHeight = 16;
+static constexpr uint32 minBandPixelCount = 128 * 128;
+
+struct CompositionContext
+{
+	const CompositorLayer *layers;
+	uint32 layerCount;
+	uint32 width;
+	byte *dstData;
+	uint32 dstDataStride;
+	bool useAVX2;
+};
+
+// SSE2 kernel ==============================================================================//
+
+static inline __m128i Div255U16(__m128i value)
+{
+	value = _mm_add_epi16(value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+// acc = src * src.a + acc * (1 - src.a) with src alpha channel replaced by one, that is
+// premultiplied source-over for straight alpha source. Accumulator holds 16 bit channels.
+static inline void BlendOver(__m128i& accLo, __m128i& accHi, __m128i src)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(255);
+	const __m128i alphaMask = _mm_set1_epi32(sint32(0xFF000000));
+
+	__m128i srcAlpha = _mm_and_si128(src, alphaMask);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, zero)) == 0xFFFF)
+		return;
+
+	__m128i opaqueSrc = _mm_or_si128(src, alphaMask);
+	__m128i srcLo = _mm_unpacklo_epi8(opaqueSrc, zero);
+	__m128i srcHi = _mm_unpackhi_epi8(opaqueSrc, zero);
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xFFFF)
+	{
+		accLo = srcLo;
+		accHi = srcHi;
+		return;
+	}
+
+	__m128i alpha = _mm_srli_epi32(src, 24);
+	alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+	__m128i alphaLo = _mm_unpacklo_epi32(alpha, alpha);
+	__m128i alphaHi = _mm_unpackhi_epi32(alpha, alpha);
+
+	accLo = Div255U16(_mm_add_epi16(_mm_mullo_epi16(srcLo, alphaLo),
+		_mm_mullo_epi16(accLo, _mm_sub_epi16(one, alphaLo))));
+	accHi = Div255U16(_mm_add_epi16(_mm_mullo_epi16(srcHi, alphaHi),
+		_mm_mullo_epi16(accHi, _mm_sub_epi16(one, alphaHi))));
+}
+
+static inline __m128i Unpremultiply(__m128i accLo, __m128i accHi)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(sint32(0xFF000000));
+
+	__m128i premultiplied = _mm_packus_epi16(accLo, accHi);
+	__m128i alpha = _mm_and_si128(premultiplied, alphaMask);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF)
+		return premultiplied;
+
+	__m128 alphaF = _mm_cvtepi32_ps(_mm_srli_epi32(premultiplied, 24));
+	__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(255.0f), alphaF),
+		_mm_cmpneq_ps(alphaF, _mm_setzero_ps()));
+
+	__m128i p0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(accLo, zero)),
+		_mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0))));
+	__m128i p1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(accLo, zero)),
+		_mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1, 1, 1, 1))));
+	__m128i p2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(accHi, zero)),
+		_mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2, 2, 2, 2))));
+	__m128i p3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(accHi, zero)),
+		_mm_shuffle_ps(scale, scale, _MM_SHUFFLE(3, 3, 3, 3))));
+
+	__m128i color = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+	return _mm_or_si128(_mm_andnot_si128(alphaMask, color), alpha);
+}
+
+static inline __m128i CompositePixels(const uint32* const* srcRows, uint32 layerCount, uint32 x)
+{
+	__m128i accLo = _mm_setzero_si128();
+	__m128i accHi = _mm_setzero_si128();
+	for (uint32 i = 0; i < layerCount; i++)
+		BlendOver(accLo, accHi, _mm_loadu_si128(to<const __m128i*>(srcRows[i] + x)));
+	return Unpremultiply(accLo, accHi);
+}
+
+static void CompositeRow_SSE2(const uint32* const* srcRows, uint32 layerCount,
+	uint32* dstRow, uint32 begin, uint32 end)
+{
+	uint32 x = begin;
+	for (; x + 4 <= end; x += 4)
+		_mm_storeu_si128(to<__m128i*>(dstRow + x), CompositePixels(srcRows, layerCount, x));
+
+	if (x == end)
+		return;
+
+	// Tail pixels are copied to temporary rows.
+	uint32 tailSize = end - x;
+	uint32 tailPixels[Compositor::MaxLayerCount][4] = {};
+	const uint32 *tailRows[Compositor::MaxLayerCount];
+	for (uint32 i = 0; i < layerCount; i++)
+	{
+		Memory::Copy(tailPixels[i], srcRows[i] + x, tailSize * 4);
+		tailRows[i] = tailPixels[i];
+	}
+
+	uint32 result[4];
+	_mm_storeu_si128(to<__m128i*>(result), CompositePixels(tailRows, layerCount, 0));
+	Memory::Copy(dstRow + x, result, tailSize * 4);
+}
+
+// AVX2 kernel ==============================================================================//
+
+// Same as SSE2 kernel, but for 8 pixels. Unpacks operate on 128 bit lanes, so accumulator
+// low half holds pixels 0, 1, 4, 5 and high half holds pixels 2, 3, 6, 7.
+
+static inline __m256i Div255U16(__m256i value)
+{
+	value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+static inline void BlendOver(__m256i& accLo, __m256i& accHi, __m256i src)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi16(255);
+	const __m256i alphaMask = _mm256_set1_epi32(sint32(0xFF000000));
+
+	__m256i srcAlpha = _mm256_and_si256(src, alphaMask);
+	if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, zero)) == -1)
+		return;
+
+	__m256i opaqueSrc = _mm256_or_si256(src, alphaMask);
+	__m256i srcLo = _mm256_unpacklo_epi8(opaqueSrc, zero);
+	__m256i srcHi = _mm256_unpackhi_epi8(opaqueSrc, zero);
+
+	if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(srcAlpha, alphaMask)) == -1)
+	{
+		accLo = srcLo;
+		accHi = srcHi;
+		return;
+	}
+
+	__m256i alpha = _mm256_srli_epi32(src, 24);
+	alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+	__m256i alphaLo = _mm256_unpacklo_epi32(alpha, alpha);
+	__m256i alphaHi = _mm256_unpackhi_epi32(alpha, alpha);
+
+	accLo = Div255U16(_mm256_add_epi16(_mm256_mullo_epi16(srcLo, alphaLo),
+		_mm256_mullo_epi16(accLo, _mm256_sub_epi16(one, alphaLo))));
+	accHi = Div255U16(_mm256_add_epi16(_mm256_mullo_epi16(srcHi, alphaHi),
+		_mm256_mullo_epi16(accHi, _mm256_sub_epi16(one, alphaHi))));
+}
+
+static inline __m256i UnpremultiplyChannels(__m256i channels, __m256 scale, __m256i scaleIndices)
+{
+	__m256 values = _mm256_cvtepi32_ps(channels);
+	return _mm256_cvtps_epi32(_mm256_mul_ps(values, _mm256_permutevar8x32_ps(scale, scaleIndices)));
+}
+
+static inline __m256i Unpremultiply(__m256i accLo, __m256i accHi)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alphaMask = _mm256_set1_epi32(sint32(0xFF000000));
+
+	__m256i premultiplied = _mm256_packus_epi16(accLo, accHi);
+	__m256i alpha = _mm256_and_si256(premultiplied, alphaMask);
+	if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaMask)) == -1)
+		return premultiplied;
+
+	__m256 alphaF = _mm256_cvtepi32_ps(_mm256_srli_epi32(premultiplied, 24));
+	__m256 scale = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(255.0f), alphaF),
+		_mm256_cmp_ps(alphaF, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+
+	__m256i p0 = UnpremultiplyChannels(_mm256_unpacklo_epi16(accLo, zero), scale, _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4));
+	__m256i p1 = UnpremultiplyChannels(_mm256_unpackhi_epi16(accLo, zero), scale, _mm256_setr_epi32(1, 1, 1, 1, 5, 5, 5, 5));
+	__m256i p2 = UnpremultiplyChannels(_mm256_unpacklo_epi16(accHi, zero), scale, _mm256_setr_epi32(2, 2, 2, 2, 6, 6, 6, 6));
+	__m256i p3 = UnpremultiplyChannels(_mm256_unpackhi_epi16(accHi, zero), scale, _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7));
+
+	__m256i color = _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+	return _mm256_or_si256(_mm256_andnot_si256(alphaMask, color), alpha);
+}
+
+static void CompositeRow_AVX2(const uint32* const* srcRows, uint32 layerCount,
+	uint32* dstRow, uint32 begin, uint32 end)
+{
+	uint32 x = begin;
+	for (; x + 8 <= end; x += 8)
+	{
+		__m256i accLo = _mm256_setzero_si256();
+		__m256i accHi = _mm256_setzero_si256();
+		for (uint32 i = 0; i < layerCount; i++)
+			BlendOver(accLo, accHi, _mm256_loadu_si256(to<const __m256i*>(srcRows[i] + x)));
+		_mm256_storeu_si256(to<__m256i*>(dstRow + x), Unpremultiply(accLo, accHi));
+	}
+	_mm256_zeroupper();
+
+	if (x < end)
+		CompositeRow_SSE2(srcRows, layerCount, dstRow, x, end);
+}
+
+// Compositor ===============================================================================//
+
+static void CompositeRows(void* context, uint32 begin, uint32 end)
+{
+	const CompositionContext &composition = *to<CompositionContext*>(context);
+
+	const uint32 *srcRows[Compositor::MaxLayerCount];
+	for (uint32 y = begin; y < end; y++)
+	{
+		for (uint32 i = 0; i < composition.layerCount; i++)
+		{
+			const CompositorLayer &layer = composition.layers[i];
+			srcRows[i] = to<const uint32*>(to<const byte*>(layer.data) + uintptr(layer.dataStride) * y);
+		}
+
+		uint32 *dstRow = to<uint32*>(composition.dstData + uintptr(composition.dstDataStride) * y);
+		if (composition.useAVX2)
+			CompositeRow_AVX2(srcRows, composition.layerCount, dstRow, 0, composition.width);
+		else
+			CompositeRow_SSE2(srcRows, composition.layerCount, dstRow, 0, composition.width);
+	}
+}
+
+void Compositor::Composite(const CompositorLayer* layers, uint32 layerCount,
+	uint32x2 size, void* dstData, uint32 dstDataStride)
+{
+	Debug::CrashCondition(layerCount > MaxLayerCount, DbgMsgFmt("too many layers"));
+
+	if (!size.x || !size.y)
+		return;
+	if (!dstDataStride)
+		dstDataStride = size.x * 4;
+
+	if (!layerCount)
+	{
+		for (uint32 y = 0; y < size.y; y++)
+			Memory::Set(to<byte*>(dstData) + uintptr(dstDataStride) * y, 0, size.x * 4);
+		return;
+	}
+
+	CompositionContext context;
+	context.layers = layers;
+	context.layerCount = layerCount;
+	context.width = size.x;
+	context.dstData = to<byte*>(dstData);
+	context.dstDataStride = dstDataStride;
+	context.useAVX2 = CPU::SupportsAVX2();
+
+	uint32 bandHeight = max(minBandHeight, intdivceil(minBandPixelCount, size.x));
+	WorkerPool::Global.parallelFor(size.y, bandHeight, CompositeRows, &context);
+}
+
+// Benchmark ================================================================================//
+
+void Compositor::RunBenchmark()
+{
+	static constexpr uint32 layerCounts[] = { 2, 8, 16 };
+	static constexpr uint32 iterationCount = 4;
+	static constexpr uint32 runLength = 64;
+
+	uintptr layerPixelCount = Benchmark::MaxImagePixelCount;
+
+	HeapPtr<uint32> layerData(layerPixelCount * MaxLayerCount);
+	HeapPtr<uint32> dstData(layerPixelCount);
+
+	// Runs of transparent, opaque and translucent pixels, so every kernel path is taken.
+	Random random(1);
+	for (uintptr i = 0; i < layerPixelCount * MaxLayerCount; i += runLength)
+	{
+		uint32 runType = random.getU16() % 4;
+		for (uintptr j = i; j < i + runLength; j++)
+		{
+			uint32 color = random.getU32() & 0x00FFFFFF;
+			uint32 alpha = runType == 0 ? 0 : (runType == 1 ? 255 : random.getU16() & 0xFF);
+			layerData[j] = color | (alpha << 24);
+		}
+	}
+
+	Benchmark::LogHeader("Compositor", CPU::SupportsAVX2() ? "AVX2 kernel" : "SSE2 kernel");
+
+	CompositorLayer layers[MaxLayerCount];
+	for (uint32 i = 0; i < MaxLayerCount; i++)
+	{
+		layers[i].data = layerData + layerPixelCount * i;
+		layers[i].dataStride = Benchmark::MaxImageWidth * 4;
+	}
+
+	for (const BenchmarkImageSize &imageSize : Benchmark::ImageSizes)
+	{
+		for (uint32 layerCount : layerCounts)
+		{
+			auto kernel = [&]() { Composite(layers, layerCount, imageSize.size, dstData); };
+			float32 time = Benchmark::MeasureTime(iterationCount, kernel);
+
+			// Every layer is read once and destination is written once.
+			float64 pixelCount = float64(imageSize.size.x) * float64(imageSize.size.y);
+			Benchmark::LogResult(time, 0.0, pixelCount * 4.0 * float64(layerCount + 1),
+				"%s, %2u layers", imageSize.name, layerCount);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.Vectors.h>
+
+namespace Panter
+{
+	struct CompositorLayer
+	{
+		const void *data;
+		uint32 dataStride;	// Zero means that every row is the same.
+	};
+
+	// CPU compositing of straight alpha RGBA8 layers. Layers are premultiplied on the fly,
+	// blended bottom to top with source-over and result is converted back to straight alpha.
+
+	struct Compositor abstract final
+	{
+		static constexpr uint32 MaxLayerCount = 16;
+
+		// Rows are split into bands that are processed by worker pool threads.
+		// Uses AVX2 kernel if it is supported and SSE2 kernel otherwise.
+		static void Composite(const CompositorLayer* layers, uint32 layerCount,
+			uint32x2 size, void* dstData, uint32 dstDataStride = 0);
+
+		// Logs compositing throughput for 2, 8 and 16 layers at 4k and 8k.
+		static void RunBenchmark();
+	};
+}
\ No newline at end of file
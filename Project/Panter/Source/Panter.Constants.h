@@ -9,5 +9,25 @@ namespace Panter
 		SelectionShadowColor = 0x006AC480_rgba;
 
 	static constexpr float32
-		ViewSpaceAnchorGrabDistance = 8.0f;
+		ViewSpaceAnchorGrabDistance = 8.0f,
+		AutosaveInterval = 30.0f; // Seconds between autosave journal appends.
+
+	static constexpr uint32
+		MergeScratchTileLimit = 64, // Max layer tiles read back at once by merged layers download.
+		ProjectLoadBatchTileCount = 64; // Project tiles decoded in parallel before upload.
+
+	static constexpr uint64
+		DefaultHistoryMemoryBudget = 256 * 1024 * 1024;
+
+	static constexpr const char*
+		HistoryJournalFileName = "Panter.history.tmp";
+
+	static constexpr const wchar*
+		AutosaveJournalFileName = L"Panter.autosave.tmp";
+
+	static constexpr const wchar*
+		InputTraceFileName = L"Panter.inputtrace";
+
+	static constexpr const wchar*
+		ProfilerCaptureFileName = L"Panter.profile.json";	// Chrome trace event format.
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <XLib.Program.h>
 #include <XLib.Graphics.h>
+#include <XLib.System.Profiler.h>
 
 using namespace XLib;
 using namespace XLib::Graphics;
@@ -13,12 +14,18 @@ void Program::Run()
 	if (!device.initialize())
 		return;
 
+	ProfileThreadName("Main");
+
 	MainWindow window(device);
 	window.create(1280, 720, L"Panter - Untitled", true);
 
 	while (window.isOpened())
 	{
-		WindowBase::DispatchPending();
+		ProfileNextFrame();
+		{
+			ProfileScope("DispatchPending");
+			WindowBase::DispatchPending();
+		}
 		window.updateAndRedraw();
 	}
 }
@@ -0,0 +1,515 @@
+#include <immintrin.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Memory.h>
+#include <XLib.Debug.h>
+#include <XLib.Random.h>
+#include <XLib.Benchmark.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "Panter.GaussianBlur.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr uint32 passCount = 3;
+static constexpr uint32 lineGroupSize = 64; // Lines transposed together, so stores are not scattered over memory.
+static constexpr uint32 minChunkPixelCount = 128 * 128;
+
+// Box approximation is too coarse for narrow kernels, which are cheap to convolve directly.
+static constexpr float32 maxDirectKernelSigma = 3.0f;
+static constexpr uint32 maxDirectKernelRadius = 9;
+
+struct BlurContext
+{
+	const byte *srcData;
+	byte *dstData;
+	uint64 *transposedData; // Column major premultiplied 16 bit channels.
+	uint32 srcDataStride;
+	uint32 dstDataStride;
+	uint32x2 size;
+	uint32 radii[passCount];
+	float32 kernel[maxDirectKernelRadius * 2 + 1];
+	uint32 kernelRadius; // Zero means that box passes are used.
+	uint32 padding;
+};
+
+static void ComputeKernel(float32 sigma, float32* kernel, uint32 radius)
+{
+	float32 sum = 0.0f;
+	for (uint32 i = 0; i <= radius * 2; i++)
+	{
+		float32 offset = float32(sint32(i) - sint32(radius));
+		kernel[i] = expf(-offset * offset / (2.0f * sigma * sigma));
+		sum += kernel[i];
+	}
+
+	for (uint32 i = 0; i <= radius * 2; i++)
+		kernel[i] /= sum;
+}
+
+// Box widths approximating Gaussian, as in "Fast Almost-Gaussian Filtering" by P. Kovesi.
+static void ComputeBoxRadii(float32 sigma, uint32 (&radii)[passCount])
+{
+	sigma = clamp(sigma, 0.0f, GaussianBlur::MaxSigma);
+
+	float32 n = float32(passCount);
+	float32 idealWidth = sqrtf(12.0f * sigma * sigma / n + 1.0f);
+	sint32 lowerWidth = sint32(idealWidth);
+	if (lowerWidth % 2 == 0)
+		lowerWidth--;
+	sint32 upperWidth = lowerWidth + 2;
+
+	float32 wl = float32(lowerWidth);
+	float32 idealLowerCount = (12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f);
+	sint32 lowerCount = clamp<sint32>(sint32(floorf(idealLowerCount + 0.5f)), 0, passCount);
+
+	for (uint32 i = 0; i < passCount; i++)
+		radii[i] = uint32(((sint32(i) < lowerCount ? lowerWidth : upperWidth) - 1) / 2);
+}
+
+// Line kernels ============================================================================//
+
+// Channels are kept premultiplied and scaled by 255, so alpha is in the same range as color.
+static void LoadPremultipliedLine(const uint32* src, __m128i* dst, uint32 length)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaLanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m128i alphaScale = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+	uint32 x = 0;
+	for (; x + 2 <= length; x += 2)
+	{
+		__m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(to<const __m128i*>(src + x)), zero);
+		__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		alpha = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaScale);
+		pixels = _mm_mullo_epi16(pixels, alpha);
+		_mm_storeu_si128(dst + x, _mm_unpacklo_epi16(pixels, zero));
+		_mm_storeu_si128(dst + x + 1, _mm_unpackhi_epi16(pixels, zero));
+	}
+
+	if (x < length)
+	{
+		__m128i pixel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(sint32(src[x])), zero);
+		__m128i alpha = _mm_shufflelo_epi16(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+		alpha = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaScale);
+		pixel = _mm_mullo_epi16(pixel, alpha);
+		_mm_storeu_si128(dst + x, _mm_unpacklo_epi16(pixel, zero));
+	}
+}
+
+static void LoadU16Line(const uint64* src, __m128i* dst, uint32 length)
+{
+	const __m128i zero = _mm_setzero_si128();
+	for (uint32 x = 0; x < length; x++)
+		_mm_storeu_si128(dst + x, _mm_unpacklo_epi16(_mm_loadl_epi64(to<const __m128i*>(src + x)), zero));
+}
+
+static void StoreU16Line(const __m128i* src, uint64* dst, uint32 length)
+{
+	// SSE2 has only signed saturating pack, so values are biased to signed range and back.
+	const __m128i bias32 = _mm_set1_epi32(32768);
+	const __m128i bias16 = _mm_set1_epi16(-32768);
+
+	for (uint32 x = 0; x < length; x++)
+	{
+		__m128i value = _mm_sub_epi32(_mm_loadu_si128(src + x), bias32);
+		value = _mm_xor_si128(_mm_packs_epi32(value, value), bias16);
+		_mm_storel_epi64(to<__m128i*>(dst + x), value);
+	}
+}
+
+static void StoreUnpremultipliedLine(const __m128i* src, uint32* dst, uint32 length)
+{
+	const __m128 colorLanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	const __m128 numerator = _mm_setr_ps(255.0f, 255.0f, 255.0f, 1.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 maxValue = _mm_set1_ps(255.0f);
+
+	for (uint32 x = 0; x < length; x++)
+	{
+		// Color is divided by alpha and alpha is divided by its 255 scale.
+		__m128 channels = _mm_cvtepi32_ps(_mm_loadu_si128(src + x));
+		__m128 alpha = _mm_shuffle_ps(channels, channels, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 denominator = _mm_or_ps(_mm_and_ps(colorLanes, alpha), _mm_andnot_ps(colorLanes, maxValue));
+		denominator = _mm_max_ps(denominator, one);
+
+		channels = _mm_min_ps(_mm_div_ps(_mm_mul_ps(channels, numerator), denominator), maxValue);
+
+		__m128i pixel = _mm_cvtps_epi32(channels);
+		pixel = _mm_packs_epi32(pixel, pixel);
+		dst[x] = uint32(_mm_cvtsi128_si32(_mm_packus_epi16(pixel, pixel)));
+	}
+}
+
+// dst[x] = (src[x - r] + ... + src[x + r]) / (2r + 1) for x in [begin, end).
+static void BoxLine(const __m128i* src, __m128i* dst, sint32 begin, sint32 end, uint32 radius)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / float32(radius * 2 + 1));
+	const __m128i *head = src + radius;
+	const __m128i *tail = src - radius;
+
+	__m128i sum = _mm_setzero_si128();
+	for (sint32 x = begin - sint32(radius); x < begin + sint32(radius); x++)
+		sum = _mm_add_epi32(sum, _mm_loadu_si128(src + x));
+
+	for (sint32 x = begin; x < end; x++)
+	{
+		sum = _mm_add_epi32(sum, _mm_loadu_si128(head + x));
+		_mm_storeu_si128(dst + x, _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale)));
+		sum = _mm_sub_epi32(sum, _mm_loadu_si128(tail + x));
+	}
+}
+
+// Kernel is symmetric, so pixels at the same distance are summed before weighting.
+static void KernelLine(const __m128i* src, __m128i* dst, uint32 length, const float32* kernel, uint32 radius)
+{
+	const float32 *halfKernel = kernel + radius;
+
+	for (uint32 x = 0; x < length; x++)
+	{
+		__m128 sum = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(src + x)), _mm_set1_ps(halfKernel[0]));
+		for (uint32 i = 1; i <= radius; i++)
+		{
+			__m128i pair = _mm_add_epi32(_mm_loadu_si128(src + x - i), _mm_loadu_si128(src + x + i));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(pair), _mm_set1_ps(halfKernel[i])));
+		}
+		_mm_storeu_si128(dst + x, _mm_cvtps_epi32(sum));
+	}
+}
+
+// Line in first buffer is blurred, result ends up in second buffer. Buffers are padded
+// by support radius and padding of first buffer must be zero. Intermediate box passes
+// are evaluated beyond line ends too, otherwise energy spread outside of line by one pass
+// would be lost for the next ones.
+static inline void BlurLine(const BlurContext& blur, __m128i* lineA, __m128i* lineB, uint32 length)
+{
+	if (blur.kernelRadius)
+	{
+		KernelLine(lineA, lineB, length, blur.kernel, blur.kernelRadius);
+		return;
+	}
+
+	sint32 tailRadius = sint32(blur.radii[1] + blur.radii[2]);
+	sint32 lastRadius = sint32(blur.radii[2]);
+
+	BoxLine(lineA, lineB, -tailRadius, sint32(length) + tailRadius, blur.radii[0]);
+	BoxLine(lineB, lineA, -lastRadius, sint32(length) + lastRadius, blur.radii[1]);
+	BoxLine(lineA, lineB, 0, sint32(length), blur.radii[2]);
+
+	Memory::Set(lineA - lastRadius, 0, lastRadius * sizeof(__m128i));
+	Memory::Set(lineA + length, 0, lastRadius * sizeof(__m128i));
+}
+
+// Passes ==================================================================================//
+
+static void BlurRowGroups(void* context, uint32 begin, uint32 end)
+{
+	const BlurContext &blur = *to<const BlurContext*>(context);
+	uint32 width = blur.size.x;
+	uint32 height = blur.size.y;
+	uint32 lineSize = width + blur.padding * 2;
+
+	HeapPtr<__m128i> lineBuffers(uintptr(lineSize) * 2);
+	HeapPtr<uint64> groupData(uintptr(width) * lineGroupSize);
+	Memory::Set(lineBuffers, 0, uintptr(lineSize) * 2 * sizeof(__m128i));
+
+	__m128i *lineA = lineBuffers + blur.padding;
+	__m128i *lineB = lineBuffers + lineSize + blur.padding;
+
+	for (uint32 group = begin; group < end; group++)
+	{
+		uint32 firstRow = group * lineGroupSize;
+		uint32 rowCount = min(lineGroupSize, height - firstRow);
+
+		for (uint32 i = 0; i < rowCount; i++)
+		{
+			const uint32 *srcRow = to<const uint32*>(blur.srcData + uintptr(blur.srcDataStride) * (firstRow + i));
+			LoadPremultipliedLine(srcRow, lineA, width);
+			BlurLine(blur, lineA, lineB, width);
+			StoreU16Line(lineB, groupData + uintptr(width) * i, width);
+		}
+
+		// Rows are stored as columns, so column passes read contiguous memory too.
+		for (uint32 x = 0; x < width; x++)
+		{
+			uint64 *column = blur.transposedData + uintptr(height) * x + firstRow;
+			for (uint32 i = 0; i < rowCount; i++)
+				column[i] = groupData[uintptr(width) * i + x];
+		}
+	}
+}
+
+static void BlurColumnGroups(void* context, uint32 begin, uint32 end)
+{
+	const BlurContext &blur = *to<const BlurContext*>(context);
+	uint32 width = blur.size.x;
+	uint32 height = blur.size.y;
+	uint32 lineSize = height + blur.padding * 2;
+
+	HeapPtr<__m128i> lineBuffers(uintptr(lineSize) * 2);
+	HeapPtr<uint32> groupData(uintptr(height) * lineGroupSize);
+	Memory::Set(lineBuffers, 0, uintptr(lineSize) * 2 * sizeof(__m128i));
+
+	__m128i *lineA = lineBuffers + blur.padding;
+	__m128i *lineB = lineBuffers + lineSize + blur.padding;
+
+	for (uint32 group = begin; group < end; group++)
+	{
+		uint32 firstColumn = group * lineGroupSize;
+		uint32 columnCount = min(lineGroupSize, width - firstColumn);
+
+		for (uint32 i = 0; i < columnCount; i++)
+		{
+			LoadU16Line(blur.transposedData + uintptr(height) * (firstColumn + i), lineA, height);
+			BlurLine(blur, lineA, lineB, height);
+			StoreUnpremultipliedLine(lineB, groupData + uintptr(height) * i, height);
+		}
+
+		for (uint32 y = 0; y < height; y++)
+		{
+			uint32 *dstRow = to<uint32*>(blur.dstData + uintptr(blur.dstDataStride) * y) + firstColumn;
+			for (uint32 i = 0; i < columnCount; i++)
+				dstRow[i] = groupData[uintptr(height) * i + y];
+		}
+	}
+}
+
+// GaussianBlur ============================================================================//
+
+void GaussianBlur::Apply(const void* srcData, uint32 srcDataStride, uint32x2 size,
+	void* dstData, uint32 dstDataStride, float32 sigma)
+{
+	if (!size.x || !size.y)
+		return;
+	if (!srcDataStride)
+		srcDataStride = size.x * 4;
+	if (!dstDataStride)
+		dstDataStride = size.x * 4;
+
+	// Kernel degenerates to single tap, so image is copied as is.
+	if (sigma <= MinSigma)
+	{
+		if (srcData == dstData && srcDataStride == dstDataStride)
+			return;
+
+		for (uint32 y = 0; y < size.y; y++)
+		{
+			Memory::Move(to<byte*>(dstData) + uintptr(y) * dstDataStride,
+				to<const byte*>(srcData) + uintptr(y) * srcDataStride, size.x * 4);
+		}
+		return;
+	}
+
+	BlurContext context;
+	context.srcData = to<const byte*>(srcData);
+	context.dstData = to<byte*>(dstData);
+	context.srcDataStride = srcDataStride;
+	context.dstDataStride = dstDataStride;
+	context.size = size;
+	ComputeBoxRadii(sigma, context.radii);
+	context.kernelRadius = 0;
+	context.padding = context.radii[0] + context.radii[1] + context.radii[2];
+
+	if (sigma < maxDirectKernelSigma)
+	{
+		context.kernelRadius = clamp<uint32>(uint32(ceilf(sigma * 3.0f)), 1, maxDirectKernelRadius);
+		context.padding = context.kernelRadius;
+		ComputeKernel(sigma, context.kernel, context.kernelRadius);
+	}
+
+	// Whole source is consumed by row passes before column passes write destination,
+	// so blurring in place is fine.
+	HeapPtr<uint64> transposedData(uintptr(size.x) * size.y);
+	context.transposedData = transposedData;
+
+	uint32 chunkCount = WorkerPool::Global.getConcurrency() * 4;
+
+	uint32 rowGroupCount = intdivceil(size.y, lineGroupSize);
+	uint32 rowGroupGrain = max(intdivceil(rowGroupCount, chunkCount),
+		intdivceil(minChunkPixelCount, size.x * lineGroupSize));
+	WorkerPool::Global.parallelFor(rowGroupCount, rowGroupGrain, BlurRowGroups, &context);
+
+	uint32 columnGroupCount = intdivceil(size.x, lineGroupSize);
+	uint32 columnGroupGrain = max(intdivceil(columnGroupCount, chunkCount),
+		intdivceil(minChunkPixelCount, size.y * lineGroupSize));
+	WorkerPool::Global.parallelFor(columnGroupCount, columnGroupGrain, BlurColumnGroups, &context);
+}
+
+uint32 GaussianBlur::GetSupportRadius(float32 sigma)
+{
+	if (sigma <= MinSigma)
+		return 0;
+	if (sigma < maxDirectKernelSigma)
+		return clamp<uint32>(uint32(ceilf(sigma * 3.0f)), 1, maxDirectKernelRadius);
+
+	uint32 radii[passCount];
+	ComputeBoxRadii(sigma, radii);
+	return radii[0] + radii[1] + radii[2];
+}
+
+// Self test ===============================================================================//
+
+// Exact separable Gaussian convolution of premultiplied float channels.
+static void ComputeReferenceBlur(const float32* src, float32* dst, uint32x2 size, float32 sigma)
+{
+	if (sigma <= GaussianBlur::MinSigma)
+	{
+		Memory::Copy(dst, src, uintptr(size.x) * size.y * 4 * sizeof(float32));
+		return;
+	}
+
+	sint32 kernelRadius = sint32(ceilf(sigma * 4.0f));
+	HeapPtr<float32> kernel(kernelRadius * 2 + 1);
+	float32 kernelSum = 0.0f;
+	for (sint32 i = -kernelRadius; i <= kernelRadius; i++)
+	{
+		kernel[i + kernelRadius] = expf(-float32(i * i) / (2.0f * sigma * sigma));
+		kernelSum += kernel[i + kernelRadius];
+	}
+	for (sint32 i = 0; i <= kernelRadius * 2; i++)
+		kernel[i] /= kernelSum;
+
+	HeapPtr<float32> rowsBlurred(uintptr(size.x) * size.y * 4);
+
+	for (sint32 y = 0; y < sint32(size.y); y++)
+	{
+		for (sint32 x = 0; x < sint32(size.x); x++)
+		{
+			float32 sum[4] = {};
+			for (sint32 i = max(-kernelRadius, -x); i <= min(kernelRadius, sint32(size.x) - 1 - x); i++)
+			{
+				const float32 *pixel = src + (uintptr(y) * size.x + x + i) * 4;
+				for (uint32 c = 0; c < 4; c++)
+					sum[c] += pixel[c] * kernel[i + kernelRadius];
+			}
+			Memory::Copy(rowsBlurred + (uintptr(y) * size.x + x) * 4, sum, sizeof(sum));
+		}
+	}
+
+	for (sint32 y = 0; y < sint32(size.y); y++)
+	{
+		for (sint32 x = 0; x < sint32(size.x); x++)
+		{
+			float32 sum[4] = {};
+			for (sint32 i = max(-kernelRadius, -y); i <= min(kernelRadius, sint32(size.y) - 1 - y); i++)
+			{
+				const float32 *pixel = rowsBlurred + (uintptr(y + i) * size.x + x) * 4;
+				for (uint32 c = 0; c < 4; c++)
+					sum[c] += pixel[c] * kernel[i + kernelRadius];
+			}
+			Memory::Copy(dst + (uintptr(y) * size.x + x) * 4, sum, sizeof(sum));
+		}
+	}
+}
+
+bool GaussianBlur::RunSelfTest()
+{
+	static constexpr uint32 width = 197;
+	static constexpr uint32 height = 163;
+	static constexpr float32 sigmas[] = { 0.0f, 0.7f, 2.0f, 5.0f, 12.0f, 30.0f };
+	static constexpr float32 maxErrorLimit = 6.0f;
+	static constexpr float32 meanErrorLimit = 0.75f;
+
+	uint32x2 size(width, height);
+	uintptr pixelCount = uintptr(width) * height;
+
+	// Translucent and opaque rectangles over transparent background, so both hard edges
+	// and alpha handling are covered.
+	HeapPtr<uint32> srcData(pixelCount);
+	Memory::Set(srcData, 0, pixelCount * 4);
+
+	Random random(7);
+	for (uint32 i = 0; i < 24; i++)
+	{
+		uint32 left = random.getU32() % width;
+		uint32 top = random.getU32() % height;
+		uint32 right = min(left + 8 + random.getU32() % 64, width);
+		uint32 bottom = min(top + 8 + random.getU32() % 64, height);
+		uint32 color = (random.getU32() & 0x00FFFFFF) | ((i % 3 ? 0xFFu : 64 + random.getU32() % 128) << 24);
+
+		for (uint32 y = top; y < bottom; y++)
+		{
+			for (uint32 x = left; x < right; x++)
+				srcData[uintptr(y) * width + x] = color;
+		}
+	}
+
+	HeapPtr<float32> srcPremultiplied(pixelCount * 4);
+	HeapPtr<float32> reference(pixelCount * 4);
+	HeapPtr<uint32> result(pixelCount);
+
+	for (uintptr i = 0; i < pixelCount; i++)
+	{
+		float32 alpha = float32(srcData[i] >> 24);
+		for (uint32 c = 0; c < 3; c++)
+			srcPremultiplied[i * 4 + c] = float32((srcData[i] >> (c * 8)) & 0xFF) * alpha / 255.0f;
+		srcPremultiplied[i * 4 + 3] = alpha;
+	}
+
+	bool passed = true;
+	char message[256];
+	Debug::Log("Gaussian blur self test:");
+
+	for (float32 sigma : sigmas)
+	{
+		ComputeReferenceBlur(srcPremultiplied, reference, size, sigma);
+		Apply(srcData, 0, size, result, 0, sigma);
+
+		// Premultiplied channels are compared, so error of nearly transparent pixels is not amplified.
+		float32 maxError = 0.0f;
+		float64 errorSum = 0.0;
+		for (uintptr i = 0; i < pixelCount; i++)
+		{
+			float32 alpha = float32(result[i] >> 24);
+			for (uint32 c = 0; c < 4; c++)
+			{
+				float32 value = float32((result[i] >> (c * 8)) & 0xFF);
+				if (c < 3)
+					value = value * alpha / 255.0f;
+
+				float32 error = fabsf(value - reference[i * 4 + c]);
+				maxError = max(maxError, error);
+				errorSum += error;
+			}
+		}
+
+		float32 meanError = float32(errorSum / float64(pixelCount * 4));
+		bool sigmaPassed = maxError <= maxErrorLimit && meanError <= meanErrorLimit;
+		passed &= sigmaPassed;
+
+		sprintf_s(message, "  sigma %5.1f: max error %5.2f, mean error %5.3f %s",
+			sigma, maxError, meanError, sigmaPassed ? "" : "FAILED");
+		Debug::Log(message);
+	}
+
+	return passed;
+}
+
+// Benchmark ===============================================================================//
+
+void GaussianBlur::RunBenchmark()
+{
+	static constexpr float32 sigmas[] = { 2.0f, 20.0f, 200.0f };
+	static constexpr uint32 iterationCount = 2;
+
+	HeapPtr<uint32> data(Benchmark::MaxImagePixelCount);
+	Benchmark::FillRandom(data, Benchmark::MaxImagePixelCount);
+
+	Benchmark::LogHeader("Gaussian blur");
+
+	for (const BenchmarkImageSize &imageSize : Benchmark::ImageSizes)
+	{
+		for (float32 sigma : sigmas)
+		{
+			auto kernel = [&]() { Apply(data, 0, imageSize.size, data, 0, sigma); };
+			float32 time = Benchmark::MeasureTime(iterationCount, kernel);
+
+			float64 pixelCount = float64(imageSize.size.x) * float64(imageSize.size.y);
+			Benchmark::LogResult(time, pixelCount, 0.0, "%s, sigma %5.1f", imageSize.name, sigma);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.Vectors.h>
+
+namespace Panter
+{
+	// CPU Gaussian blur of straight alpha RGBA8 images. Gaussian is approximated with three
+	// successive sliding window box passes along rows and then along columns, so cost per pixel
+	// does not depend on sigma. Blur is done in premultiplied space and pixels outside of image
+	// are treated as transparent.
+
+	struct GaussianBlur abstract final
+	{
+		static constexpr float32 MaxSigma = 1024.0f;
+		static constexpr float32 MinSigma = 1.0e-3f; // Smaller sigmas leave image unchanged.
+
+		// Rows and columns are split into groups that are processed by worker pool threads.
+		// Source and destination may be the same memory.
+		static void Apply(const void* srcData, uint32 srcDataStride, uint32x2 size,
+			void* dstData, uint32 dstDataStride, float32 sigma);
+
+		// Distance in pixels at which source pixels stop affecting result.
+		static uint32 GetSupportRadius(float32 sigma);
+
+		// Compares result with exact Gaussian convolution and logs deviation.
+		// Returns false if deviation exceeds expected approximation error.
+		static bool RunSelfTest();
+		// Logs blur throughput for several sigmas at 4k and 8k.
+		static void RunBenchmark();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,484 @@
+#include <XLib.Debug.h>
+#include <XLib.Memory.h>
+
+#include "Panter.History.h"
+#include "Panter.TileCodec.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+static TiledLayer* AllocateLayer(TiledLayer&& layer)
+{
+	TiledLayer *result = Heap::Allocate<TiledLayer>();
+	construct(*result);
+	*result = move(layer);
+	return result;
+}
+
+static void ReleaseLayer(TiledLayer* layer)
+{
+	layer->~TiledLayer();
+	Heap::Release(layer);
+}
+
+// Memory that is held only by history. Tiles shared with canvas are not counted.
+static uint64 ComputeLayerMemoryUsage(TiledLayer& layer, uint32 tileByteSize)
+{
+	uint64 result = 0;
+	uint32x2 gridSize = layer.getGridSize();
+	for (uint32 y = 0; y < gridSize.y; y++)
+	{
+		for (uint32 x = 0; x < gridSize.x; x++)
+		{
+			LayerTile *tile = layer.getTile(uint32x2(x, y));
+			if (tile && tile->referenceCount == 1 && !tile->isUniform)
+				result += tileByteSize;
+		}
+	}
+	return result;
+}
+
+// Internal =====================================================================================//
+
+void History::releaseRecord(HistoryRecord& record)
+{
+	switch (record.type)
+	{
+		case HistoryRecordType::Tile:
+			if (record.tileLocation == HistoryTileLocation::Resident)
+			{
+				pool->release(record.tile);
+			}
+			else if (record.tileLocation == HistoryTileLocation::Compressed)
+			{
+				Heap::Release(record.compressedTile);
+			}
+			else if (record.tileLocation == HistoryTileLocation::Journal)
+			{
+				journaledTileCount--;
+				if (!journaledTileCount)
+					journalSize = 0;
+			}
+			break;
+
+		case HistoryRecordType::LayerPresence:
+		case HistoryRecordType::LayerReplace:
+			ReleaseLayer(record.layer);
+			break;
+	}
+
+	record.type = HistoryRecordType::None;
+}
+
+void History::releaseEntry(HistoryEntry& entry)
+{
+	for (uint32 i = 0; i < entry.recordCount; i++)
+		releaseRecord(entry.records[i]);
+	entry.records.release();
+	entry.recordCount = 0;
+
+	memoryUsage -= entry.memoryUsage;
+	entry.memoryUsage = 0;
+}
+
+void History::dropOldestEntry()
+{
+	releaseEntry(entries[0]);
+
+	// Entries are moved with swap, so released entry ends up at the back.
+	uint32 entryCount = entries.getSize();
+	for (uint32 i = 1; i < entryCount; i++)
+		entries[i - 1] = move(entries[i]);
+	entries.dropBack();
+
+	if (currentEntryIndex)
+		currentEntryIndex--;
+}
+
+void History::dropRedoEntries()
+{
+	while (entries.getSize() > currentEntryIndex)
+	{
+		releaseEntry(entries.back());
+		entries.dropBack();
+	}
+}
+
+uint64 History::computeRecordMemoryUsage(HistoryRecord& record)
+{
+	switch (record.type)
+	{
+		case HistoryRecordType::Tile:
+			if (record.tileLocation == HistoryTileLocation::Resident)
+			{
+				LayerTile *tile = record.tile;
+				return tile && tile->referenceCount == 1 && !tile->isUniform ? tileByteSize : 0;
+			}
+			if (record.tileLocation == HistoryTileLocation::Compressed)
+				return record.compressedTileSize;
+			return 0;
+
+		case HistoryRecordType::LayerPresence:
+		case HistoryRecordType::LayerReplace:
+			return ComputeLayerMemoryUsage(*record.layer, tileByteSize);
+	}
+
+	return 0;
+}
+
+void History::updateEntryMemoryUsage(HistoryEntry& entry)
+{
+	memoryUsage -= entry.memoryUsage;
+	entry.memoryUsage = 0;
+
+	for (uint32 i = 0; i < entry.recordCount; i++)
+	{
+		HistoryRecord &record = entry.records[i];
+		record.memoryUsage = computeRecordMemoryUsage(record);
+		entry.memoryUsage += record.memoryUsage;
+	}
+
+	memoryUsage += entry.memoryUsage;
+	entry.memoryUsageOutOfDate = false;
+}
+
+bool History::compressTile(HistoryRecord& record)
+{
+	pool->getDevice().downloadTexture(record.tile->texture,
+		rectu32(0, 0, LayerTileSize, LayerTileSize), tilePixels);
+
+	uint32 compressedSize = TileCodec::Compress(tilePixels, compressionBuffer);
+	byte *compressedTile = Heap::Allocate<byte>(compressedSize);
+	if (!compressedTile)
+		return false;
+
+	Memory::Copy(compressedTile, compressionBuffer, compressedSize);
+
+	pool->release(record.tile);
+	record.compressedTile = compressedTile;
+	record.compressedTileSize = compressedSize;
+	record.tileLocation = HistoryTileLocation::Compressed;
+
+	return true;
+}
+
+bool History::spillTileToJournal(HistoryRecord& record)
+{
+	if (!journalFile.isInitialized())
+	{
+		if (!journalFileName)
+			return false;
+
+		if (!journalFile.open(journalFileName, FileAccessMode::ReadWrite, FileOpenMode::Override))
+		{
+			Debug::Warning(DbgMsgFmt("can't open history journal file"));
+			journalFile.close();
+			journalFileName = nullptr;
+			return false;
+		}
+
+		journalSize = 0;
+	}
+
+	if (journalFile.setPosition(journalSize) != journalSize ||
+		!journalFile.write(record.compressedTile, record.compressedTileSize))
+	{
+		return false;
+	}
+
+	Heap::Release(record.compressedTile);
+	record.journalOffset = journalSize;
+	record.tileLocation = HistoryTileLocation::Journal;
+
+	journalSize += record.compressedTileSize;
+	journaledTileCount++;
+
+	return true;
+}
+
+void History::enforceMemoryBudget()
+{
+	// Usage is counted when entry is committed and kept up to date as records are compressed,
+	// spilled and dropped. Only entries that were undone or redone since are counted again.
+
+	for (HistoryEntry &entry : entries)
+	{
+		if (entry.memoryUsageOutOfDate)
+			updateEntryMemoryUsage(entry);
+	}
+
+	// Oldest tiles are compressed first. If it is not enough, they are spilled to journal and
+	// finally oldest entries are dropped. Most recent entry is always kept.
+
+	for (uint32 i = 0; i < entries.getSize() && memoryUsage > memoryBudget; i++)
+	{
+		HistoryEntry &entry = entries[i];
+		for (uint32 j = 0; j < entry.recordCount && memoryUsage > memoryBudget; j++)
+		{
+			HistoryRecord &record = entry.records[j];
+			if (record.type != HistoryRecordType::Tile ||
+				record.tileLocation != HistoryTileLocation::Resident ||
+				!record.memoryUsage || record.tile->referenceCount != 1)
+			{
+				continue;
+			}
+
+			if (!compressTile(record))
+				continue;
+
+			memoryUsage = memoryUsage + record.compressedTileSize - record.memoryUsage;
+			entry.memoryUsage = entry.memoryUsage + record.compressedTileSize - record.memoryUsage;
+			record.memoryUsage = record.compressedTileSize;
+		}
+	}
+
+	for (uint32 i = 0; i < entries.getSize() && memoryUsage > memoryBudget; i++)
+	{
+		HistoryEntry &entry = entries[i];
+		for (uint32 j = 0; j < entry.recordCount && memoryUsage > memoryBudget; j++)
+		{
+			HistoryRecord &record = entry.records[j];
+			if (record.type != HistoryRecordType::Tile ||
+				record.tileLocation != HistoryTileLocation::Compressed)
+			{
+				continue;
+			}
+
+			if (!spillTileToJournal(record))
+				continue;
+
+			memoryUsage -= record.memoryUsage;
+			entry.memoryUsage -= record.memoryUsage;
+			record.memoryUsage = 0;
+		}
+	}
+
+	// Only undoable entries may be dropped, otherwise redo order would be broken.
+	while (memoryUsage > memoryBudget && currentEntryIndex > 1)
+		dropOldestEntry();
+}
+
+// Public interface =============================================================================//
+
+void History::initialize(LayerTilePool& pool, uint64 memoryBudget, const char* journalFileName)
+{
+	this->pool = &pool;
+	this->memoryBudget = memoryBudget;
+	this->journalFileName = journalFileName;
+
+	tilePixels = HeapPtr<uint32>(TileCodec::TilePixelCount);
+	compressionBuffer = HeapPtr<byte>(TileCodec::MaxCompressedSize);
+}
+
+void History::destroy()
+{
+	if (!pool)
+		return;
+
+	clear();
+	journalFile.close();
+
+	pendingTileFlags.release();
+	tilePixels.release();
+	compressionBuffer.release();
+	layerTileCount = 0;
+
+	pool = nullptr;
+}
+
+void History::clear()
+{
+	for (HistoryRecord &record : pendingRecords)
+		releaseRecord(record);
+	pendingRecords.clear();
+
+	for (HistoryEntry &entry : entries)
+		releaseEntry(entry);
+	entries.clear();
+
+	if (layerTileCount)
+		Memory::Set(pendingTileFlags, 0, maxLayerCount * layerTileCount * sizeof(bool));
+
+	currentEntryIndex = 0;
+	memoryUsage = 0;
+	journalSize = 0;
+	journaledTileCount = 0;
+}
+
+void History::setLayerTileCount(uint32 tileCount)
+{
+	// Dropping flags is safe: tile recorded twice is restored correctly, as records of entry
+	// are applied in reverse order.
+
+	layerTileCount = tileCount;
+	pendingTileFlags = HeapPtr<bool>(maxLayerCount * tileCount);
+	Memory::Set(pendingTileFlags, 0, maxLayerCount * tileCount * sizeof(bool));
+}
+
+void History::recordTile(uint16 layerIndex, TiledLayer& layer, uint32x2 tileCoords)
+{
+	uint32 tileIndex = tileCoords.y * layer.getGridSize().x + tileCoords.x;
+
+	bool &tileFlag = pendingTileFlags[layerIndex * layerTileCount + tileIndex];
+	if (tileFlag)
+		return;
+	tileFlag = true;
+
+	LayerTile *tile = layer.getTile(tileCoords);
+	if (tile)
+		pool->addReference(tile);
+
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::Tile;
+	record.tileLocation = HistoryTileLocation::Resident;
+	record.tile = tile;
+	record.layerIndex = layerIndex;
+	record.tileIndex = tileIndex;
+}
+
+void History::recordLayerInsert(uint16 layerIndex)
+{
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::LayerPresence;
+	record.layer = AllocateLayer(TiledLayer());
+	record.layerIndex = layerIndex;
+}
+
+void History::recordLayerRemove(uint16 layerIndex, TiledLayer&& layer, bool renderingFlag)
+{
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::LayerPresence;
+	record.layer = AllocateLayer(move(layer));
+	record.layerIndex = layerIndex;
+	record.layerRenderingFlag = renderingFlag;
+}
+
+void History::recordLayerSwap(uint16 layerIndex, uint16 otherLayerIndex)
+{
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::LayerSwap;
+	record.layerIndex = layerIndex;
+	record.otherLayerIndex = otherLayerIndex;
+}
+
+void History::recordLayerReplace(uint16 layerIndex, TiledLayer&& layer)
+{
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::LayerReplace;
+	record.layer = AllocateLayer(move(layer));
+	record.layerIndex = layerIndex;
+}
+
+void History::recordCanvasSize(uint32x2 canvasSize)
+{
+	HistoryRecord &record = pendingRecords.allocateBack();
+	record.type = HistoryRecordType::CanvasSize;
+	record.canvasSize = canvasSize;
+}
+
+void History::commit()
+{
+	if (pendingRecords.isEmpty())
+		return;
+
+	for (HistoryRecord &record : pendingRecords)
+	{
+		if (record.type == HistoryRecordType::Tile)
+			pendingTileFlags[record.layerIndex * layerTileCount + record.tileIndex] = false;
+	}
+
+	dropRedoEntries();
+	if (entries.getSize() >= maxEntryCount)
+		dropOldestEntry();
+
+	HistoryEntry &entry = entries.allocateBack();
+	entry.recordCount = pendingRecords.getSize();
+	entry.records = pendingRecords.takeBuffer();
+	entry.memoryUsage = 0;
+	currentEntryIndex = entries.getSize();
+
+	updateEntryMemoryUsage(entry);
+	enforceMemoryBudget();
+}
+
+HistoryEntry* History::stepBack()
+{
+	if (!canUndo())
+		return nullptr;
+
+	currentEntryIndex--;
+	entries[currentEntryIndex].memoryUsageOutOfDate = true;
+	return &entries[currentEntryIndex];
+}
+
+HistoryEntry* History::stepForward()
+{
+	if (!canRedo())
+		return nullptr;
+
+	currentEntryIndex++;
+	entries[currentEntryIndex - 1].memoryUsageOutOfDate = true;
+	return &entries[currentEntryIndex - 1];
+}
+
+LayerTile* History::takeTile(HistoryRecord& record)
+{
+	if (record.tileLocation == HistoryTileLocation::Resident)
+	{
+		LayerTile *tile = record.tile;
+		record.tile = nullptr;
+		return tile;
+	}
+
+	const byte *compressedTile = record.compressedTile;
+	bool restored = true;
+
+	if (record.tileLocation == HistoryTileLocation::Journal)
+	{
+		restored = journalFile.setPosition(record.journalOffset) == record.journalOffset &&
+			journalFile.read(compressionBuffer, record.compressedTileSize);
+		compressedTile = compressionBuffer;
+	}
+
+	restored = restored &&
+		TileCodec::Decompress(compressedTile, record.compressedTileSize, tilePixels);
+
+	if (record.tileLocation == HistoryTileLocation::Compressed)
+	{
+		Heap::Release(record.compressedTile);
+	}
+	else
+	{
+		journaledTileCount--;
+		if (!journaledTileCount)
+			journalSize = 0;
+	}
+
+	record.tile = nullptr;
+	record.tileLocation = HistoryTileLocation::Resident;
+
+	if (!restored)
+	{
+		Debug::Warning(DbgMsgFmt("history tile is corrupted"));
+		return nullptr;
+	}
+
+	LayerTile *tile = pool->allocate();
+	pool->getDevice().uploadTexture(tile->texture,
+		rectu32(0, 0, LayerTileSize, LayerTileSize), tilePixels);
+
+	return tile;
+}
+
+void History::putTile(HistoryRecord& record, LayerTile* tile)
+{
+	record.tile = tile;
+	record.tileLocation = HistoryTileLocation::Resident;
+}
+
+void History::setMemoryBudget(uint64 memoryBudget)
+{
+	this->memoryBudget = memoryBudget;
+	enforceMemoryBudget();
+}
\ No newline at end of file
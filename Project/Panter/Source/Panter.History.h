@@ -0,0 +1,140 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Heap.h>
+#include <XLib.Containers.Vector.h>
+#include <XLib.System.File.h>
+
+#include "Panter.TiledLayer.h"
+
+namespace Panter
+{
+	enum class HistoryRecordType : uint8
+	{
+		None = 0,
+
+		Tile,			// Single layer tile.
+		LayerPresence,	// Layer inserted to or removed from canvas.
+		LayerSwap,		// Two layers swapped.
+		LayerReplace,	// Whole layer replaced.
+		CanvasSize,
+	};
+
+	enum class HistoryTileLocation : uint8
+	{
+		Resident = 0,	// Tile is referenced directly.
+		Compressed,		// Tile pixels are compressed in memory.
+		Journal,		// Compressed tile pixels are spilled to journal file.
+	};
+
+	// Every record stores state that is swapped with canvas state when record is applied,
+	// so applying record second time reverts it. Undo applies records of entry in reverse
+	// order and redo applies them in forward order.
+
+	struct HistoryRecord
+	{
+		LayerTile *tile;
+		byte *compressedTile;
+		TiledLayer *layer;		// Empty while layer is in canvas.
+		uint64 journalOffset;
+		uint64 memoryUsage;		// Counted when entry was committed or last applied.
+		uint32x2 canvasSize;
+		uint32 tileIndex;
+		uint32 compressedTileSize;
+		uint16 layerIndex;
+		uint16 otherLayerIndex;
+		HistoryRecordType type;
+		HistoryTileLocation tileLocation;
+		bool layerRenderingFlag;
+	};
+
+	struct HistoryEntry
+	{
+		XLib::HeapPtr<HistoryRecord> records;
+		uint64 memoryUsage;			// Sum of record usages.
+		uint32 recordCount;
+		bool memoryUsageOutOfDate;	// Records were applied, so they hold other tiles and layers now.
+	};
+
+	class History : public XLib::NonCopyable
+	{
+	private:
+		static constexpr uint32 maxLayerCount = 16;
+		static constexpr uint32 maxEntryCount = 1024;
+		static constexpr uint32 tileByteSize = LayerTileSize * LayerTileSize * 4;
+
+		LayerTilePool *pool = nullptr;
+
+		XLib::Vector<HistoryEntry> entries;
+		uint32 currentEntryIndex = 0; // entries before this index can be undone
+		XLib::Vector<HistoryRecord> pendingRecords;
+		XLib::HeapPtr<bool> pendingTileFlags;
+		uint32 layerTileCount = 0;
+
+		uint64 memoryBudget = 0;
+		uint64 memoryUsage = 0;
+
+		const char *journalFileName = nullptr;
+		XLib::File journalFile;
+		uint64 journalSize = 0;
+		uint32 journaledTileCount = 0;
+
+		XLib::HeapPtr<uint32> tilePixels;
+		XLib::HeapPtr<byte> compressionBuffer;
+
+		void releaseRecord(HistoryRecord& record);
+		void releaseEntry(HistoryEntry& entry);
+		void dropOldestEntry();
+		void dropRedoEntries();
+
+		uint64 computeRecordMemoryUsage(HistoryRecord& record);
+		void updateEntryMemoryUsage(HistoryEntry& entry);
+		bool compressTile(HistoryRecord& record);
+		bool spillTileToJournal(HistoryRecord& record);
+		void enforceMemoryBudget();
+
+	public:
+		History() = default;
+		~History() = default;
+
+		void initialize(LayerTilePool& pool, uint64 memoryBudget, const char* journalFileName);
+		void destroy();
+		void clear();
+
+		// Must be called whenever canvas tile grid changes.
+		void setLayerTileCount(uint32 tileCount);
+
+		// Record functions must be called before canvas state is modified.
+		// Tile is recorded only once per entry, so it is fine to record it repeatedly.
+		void recordTile(uint16 layerIndex, TiledLayer& layer, uint32x2 tileCoords);
+		void recordLayerInsert(uint16 layerIndex);
+		// Takes ownership of removed layer.
+		void recordLayerRemove(uint16 layerIndex, TiledLayer&& layer, bool renderingFlag);
+		void recordLayerSwap(uint16 layerIndex, uint16 otherLayerIndex);
+		// Takes ownership of replaced layer.
+		void recordLayerReplace(uint16 layerIndex, TiledLayer&& layer);
+		void recordCanvasSize(uint32x2 canvasSize);
+
+		// Finishes entry from pending records. Does nothing if nothing was recorded.
+		void commit();
+
+		// Return entry that should be applied, or nullptr.
+		HistoryEntry* stepBack();
+		HistoryEntry* stepForward();
+
+		// Restores tile stored in tile record and passes its ownership to caller.
+		// Record must be refilled with putTile right after that.
+		LayerTile* takeTile(HistoryRecord& record);
+		void putTile(HistoryRecord& record, LayerTile* tile);
+
+		void setMemoryBudget(uint64 memoryBudget);
+
+		inline bool canUndo() const { return currentEntryIndex > 0; }
+		inline bool canRedo() const { return currentEntryIndex < entries.getSize(); }
+		inline bool hasPendingRecords() const { return !pendingRecords.isEmpty(); }
+		inline uint32 getEntryCount() const { return entries.getSize(); }
+		inline uint64 getMemoryUsage() const { return memoryUsage; }
+		inline uint64 getJournalSize() const { return journalSize; }
+	};
+}
\ No newline at end of file
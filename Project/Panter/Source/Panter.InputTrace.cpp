@@ -0,0 +1,657 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <XLib.Debug.h>
+#include <XLib.Heap.h>
+#include <XLib.Util.h>
+#include <XLib.Math.h>
+#include <XLib.System.File.h>
+
+#include "Panter.InputTrace.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+static constexpr uint32 InputTraceMagic = 0x4352'5449;	// "ITRC"
+static constexpr uint32 InputTraceVersion = 2;	// Version 1 has no pointer pressure.
+
+// InputTrace ===================================================================================//
+
+void InputTrace::begin(uint32x2 canvasSize, uint16 layerCount, uint16 currentLayer, uint16 visibleLayerFlags)
+{
+	events.clear();
+
+	header = {};
+	header.magic = InputTraceMagic;
+	header.version = InputTraceVersion;
+	header.canvasSize = canvasSize;
+	header.layerCount = layerCount;
+	header.currentLayer = currentLayer;
+	header.visibleLayerFlags = visibleLayerFlags;
+
+	startTime = Timer::GetRecord();
+}
+
+InputTraceEvent& InputTrace::addEvent(InputTraceEventType type)
+{
+	InputTraceEvent &event = events.allocateBack();
+	event.time = Timer::GetTimeDelta(startTime);
+	event.type = type;
+	return event;
+}
+
+bool InputTrace::load(const wchar* filename)
+{
+	File file;
+	if (!file.open(filename, FileAccessMode::Read, FileOpenMode::OpenExisting, FileAccessHint::Sequential))
+		return false;
+
+	InputTraceHeader loadedHeader = {};
+	if (!file.read(loadedHeader) || loadedHeader.magic != InputTraceMagic ||
+		loadedHeader.version < 1 || loadedHeader.version > InputTraceVersion || !loadedHeader.layerCount ||
+		loadedHeader.layerCount > 16 || loadedHeader.currentLayer >= loadedHeader.layerCount)
+	{
+		Debug::Warning(DbgMsgFmt("invalid input trace file"));
+		return false;
+	}
+
+	events.resize(loadedHeader.eventCount);
+	if (!file.read(events, sizeof(InputTraceEvent) * loadedHeader.eventCount))
+	{
+		Debug::Warning(DbgMsgFmt("input trace file is truncated"));
+		events.clear();
+		return false;
+	}
+
+	if (loadedHeader.version == 1)
+	{
+		for (InputTraceEvent &event : events)
+		{
+			if (event.type == InputTraceEventType::PointerState)
+				event.pointer.pressure = 1.0f;
+		}
+	}
+
+	header = loadedHeader;
+	header.version = InputTraceVersion;
+	return true;
+}
+
+bool InputTrace::save(const wchar* filename)
+{
+	File file;
+	if (!file.open(filename, FileAccessMode::Write, FileOpenMode::Override, FileAccessHint::Sequential))
+		return false;
+
+	header.eventCount = events.getSize();
+	return file.write(&header, sizeof(InputTraceHeader)) &&
+		file.write(events, sizeof(InputTraceEvent) * events.getSize());
+}
+
+// Replay =======================================================================================//
+
+static void ReplayEvent(CanvasManager& canvasManager, const InputTraceEvent& event)
+{
+	switch (event.type)
+	{
+		case InputTraceEventType::PointerState:
+			canvasManager.setPointerState(event.pointer.position, event.pointer.isActive, event.pointer.pressure);
+			break;
+
+		case InputTraceEventType::PointerPanViewMode:
+			canvasManager.enablePointerPanViewMode(event.enabled);
+			break;
+
+		case InputTraceEventType::SetInstrument:
+		{
+			const InstrumentSettings &settings = event.instrumentSettings;
+			switch (event.instrument)
+			{
+				case Instrument::None:
+					canvasManager.resetInstrument();
+					break;
+				case Instrument::Selection:
+					canvasManager.setInstrument_selection();
+					break;
+				case Instrument::Pencil:
+					canvasManager.setInstrument_pencil(settings.pencil.color);
+					break;
+				case Instrument::Brush:
+					canvasManager.setInstrument_brush(settings.brush.color, settings.brush.width, settings.brush.blendEnabled);
+					break;
+				case Instrument::Line:
+					canvasManager.setInstrument_line(settings.line.color, settings.line.width,
+						settings.line.roundedStart, settings.line.roundedEnd);
+					break;
+				case Instrument::Shape:
+					canvasManager.setInstrument_shape(settings.shape.fillColor, settings.shape.borderColor,
+						settings.shape.borderWidth, settings.shape.shape);
+					break;
+				case Instrument::BrightnessContrastGammaFilter:
+					canvasManager.setInstrument_brightnessContrastGammaFilter(settings.brightnessContrastGamma.brightness,
+						settings.brightnessContrastGamma.contrast, settings.brightnessContrastGamma.gamma);
+					break;
+				case Instrument::GaussianBlurFilter:
+					canvasManager.setInstrument_gaussianBlurFilter(settings.gaussianBlur.radius);
+					break;
+				case Instrument::SharpenFilter:
+					canvasManager.setInstrument_sharpenFilter(settings.sharpen.intensity);
+					break;
+			}
+			break;
+		}
+
+		case InputTraceEventType::InstrumentSettings:
+		{
+			// Event is recorded only for settings of current instrument.
+			const InstrumentSettings &settings = event.instrumentSettings;
+			switch (canvasManager.getCanvasInstrument())
+			{
+				case Instrument::Pencil:
+					canvasManager.getInstrumentSettings_pencil() = settings.pencil;
+					break;
+				case Instrument::Brush:
+					canvasManager.getInstrumentSettings_brush() = settings.brush;
+					break;
+				case Instrument::Line:
+					canvasManager.getInstrumentSettings_line() = settings.line;
+					break;
+				case Instrument::Shape:
+					canvasManager.getInstrumentSettings_shape() = settings.shape;
+					break;
+				case Instrument::BrightnessContrastGammaFilter:
+					canvasManager.getInstrumentSettings_brightnessContrastGammaFilter() = settings.brightnessContrastGamma;
+					break;
+				case Instrument::GaussianBlurFilter:
+					canvasManager.getInstrumentSettings_gaussianBlurFilter() = settings.gaussianBlur;
+					break;
+				case Instrument::SharpenFilter:
+					canvasManager.getInstrumentSettings_sharpenFilter() = settings.sharpen;
+					break;
+			}
+			canvasManager.updateInstrumentSettings();
+			break;
+		}
+
+		case InputTraceEventType::ResetInstrument:
+			canvasManager.resetInstrument();
+			break;
+
+		case InputTraceEventType::ApplyInstrument:
+			canvasManager.applyInstrument();
+			break;
+
+		case InputTraceEventType::ResetSelection:
+			canvasManager.resetSelection();
+			break;
+
+		case InputTraceEventType::CreateLayer:
+			canvasManager.createLayer();
+			break;
+
+		case InputTraceEventType::RemoveLayer:
+			canvasManager.removeLayer(event.layerIndex);
+			break;
+
+		case InputTraceEventType::MoveLayer:
+			canvasManager.moveLayer(event.layerIndex, event.otherLayerIndex);
+			break;
+
+		case InputTraceEventType::EnableLayer:
+			canvasManager.enableLayer(event.layerIndex, event.enabled);
+			break;
+
+		case InputTraceEventType::SetCurrentLayer:
+			canvasManager.setCurrentLayer(event.layerIndex);
+			break;
+
+		case InputTraceEventType::ClearLayer:
+			canvasManager.clearLayer(event.layerIndex, event.color);
+			break;
+
+		case InputTraceEventType::Undo:
+			canvasManager.undo();
+			break;
+
+		case InputTraceEventType::Redo:
+			canvasManager.redo();
+			break;
+
+		case InputTraceEventType::ClearHistory:
+			canvasManager.clearHistory();
+			break;
+
+		case InputTraceEventType::CenterView:
+			canvasManager.centerView();
+			break;
+
+		case InputTraceEventType::ScaleView:
+			canvasManager.scaleView(event.scale);
+			break;
+
+		case InputTraceEventType::SetCanvasScale:
+			canvasManager.setAbsoluteCanvasScale(event.scale);
+			break;
+
+		case InputTraceEventType::ResizeDiscardingContents:
+			canvasManager.resizeDiscardingContents(event.size);
+			break;
+
+		case InputTraceEventType::ResizeSavingContents:
+			canvasManager.resizeSavingContents(rects32(event.canvasRect.left, event.canvasRect.top,
+				event.canvasRect.right, event.canvasRect.bottom), event.canvasRect.fillColor);
+			break;
+
+		default:
+			Debug::Crash("invalid input trace event");
+	}
+}
+
+static int CompareFrameTimes(const void* a, const void* b)
+{
+	float32 timeA = *(const float32*)a, timeB = *(const float32*)b;
+	return timeA < timeB ? -1 : (timeA > timeB ? 1 : 0);
+}
+
+void InputTraceReplay::Run(InputTrace& trace, Device& device, InputTraceReplayStats& stats)
+{
+	const InputTraceHeader &header = trace.getHeader();
+	const InputTraceEvent *events = trace.getEvents();
+	uint32 eventCount = trace.getEventCount();
+
+	stats = {};
+
+	// Target covers largest viewport of trace.
+	uint32x2 targetSize(1, 1);
+	uint32 frameCount = 0;
+	for (uint32 i = 0; i < eventCount; i++)
+	{
+		if (events[i].type != InputTraceEventType::Frame)
+			continue;
+
+		targetSize.x = max(targetSize.x, events[i].size.x);
+		targetSize.y = max(targetSize.y, events[i].size.y);
+		frameCount++;
+	}
+
+	if (!frameCount)
+		return;
+
+	HeapPtr<float32> frameTimes(frameCount);
+
+	TextureRenderTarget target;
+	device.createTextureRenderTarget(target, targetSize.x, targetSize.y);
+
+	CanvasManager *canvasManager = Heap::Allocate<CanvasManager>();
+	construct(*canvasManager);
+
+	// Starting state of trace. Layer contents are not part of trace, so first layer is white
+	// as in new document and other layers are empty.
+	canvasManager->initialize(device, header.canvasSize, nullptr);
+	for (uint16 i = 0; i < header.layerCount; i++)
+	{
+		canvasManager->createLayer();
+		canvasManager->enableLayer(i, (header.visibleLayerFlags >> i) & 1 ? true : false);
+	}
+	canvasManager->clearLayer(0, 0xFFFFFFFF_rgba);
+	canvasManager->setCurrentLayer(header.currentLayer);
+	canvasManager->clearHistory();
+
+	// Frame starts with first event after previous frame, so it includes input handling, and
+	// ends when drawing is done on device.
+	TimerRecord replayStartTime = Timer::GetRecord();
+	TimerRecord frameStartTime = replayStartTime;
+	uint64 frameStartAllocationCount = Heap::GetAllocationCount();
+	bool frameStarted = false;
+	uint32 frameIndex = 0;
+
+	for (uint32 i = 0; i < eventCount; i++)
+	{
+		const InputTraceEvent &event = events[i];
+
+		if (!frameStarted)
+		{
+			frameStartTime = Timer::GetRecord();
+			frameStartAllocationCount = Heap::GetAllocationCount();
+			frameStarted = true;
+		}
+
+		if (event.type != InputTraceEventType::Frame)
+		{
+			ReplayEvent(*canvasManager, event);
+			continue;
+		}
+
+		canvasManager->updateAndDraw(target, rectu32(0, 0, event.size));
+
+		uint32 pixel = 0;
+		device.downloadTexture(target, rectu32(0, 0, 1, 1), &pixel);
+
+		frameTimes[frameIndex] = Timer::GetTimeDelta(frameStartTime);
+
+		const CanvasFrameStats &frameStats = canvasManager->getLastFrameStats();
+		uint64 touchedPixelCount = uint64(frameStats.layerDirtyPixelCount) +
+			uint64(frameStats.tempLayerDirtyPixelCount) + uint64(frameStats.recompositedPixelCount);
+		stats.touchedPixelCount += touchedPixelCount;
+		stats.maxFrameTouchedPixelCount = max(stats.maxFrameTouchedPixelCount, touchedPixelCount);
+		stats.geometryVertexCount += frameStats.geometryVertexCount;
+		stats.geometryIndexCount += frameStats.geometryIndexCount;
+		stats.geometryFlushCount += frameStats.geometryFlushCount;
+		stats.geometryDrawCount += frameStats.geometryDrawCount;
+
+		uint64 allocationCount = Heap::GetAllocationCount() - frameStartAllocationCount;
+		stats.allocationCount += allocationCount;
+		stats.maxFrameAllocationCount = max(stats.maxFrameAllocationCount, uint32(allocationCount));
+
+		frameIndex++;
+		frameStarted = false;
+	}
+
+	stats.totalTime = Timer::GetTimeDelta(replayStartTime);
+
+	canvasManager->destroy();
+	canvasManager->~CanvasManager();
+	Heap::Release(canvasManager);
+	target.destroy();
+
+	qsort(frameTimes, frameCount, sizeof(float32), CompareFrameTimes);
+	stats.frameCount = frameCount;
+	stats.medianFrameTime = frameTimes[frameCount / 2];
+	stats.p99FrameTime = frameTimes[min(frameCount - 1, frameCount * 99 / 100)];
+	stats.maxFrameTime = frameTimes[frameCount - 1];
+}
+
+// Standard traces ==============================================================================//
+
+namespace
+{
+	// Events are spaced as if editor was running at steady 120 frames per second.
+	struct TraceBuilder
+	{
+		static constexpr float32 FrameTime = 1.0f / 120.0f;
+		static constexpr uint32x2 ViewportSize = { 1280, 720 };
+
+		InputTrace &trace;
+		float32 time = 0.0f;
+
+		inline TraceBuilder(InputTrace& trace) : trace(trace) {}
+
+		inline InputTraceEvent& add(InputTraceEventType type)
+		{
+			InputTraceEvent &event = trace.addEvent(type);
+			event.time = time;
+			return event;
+		}
+
+		void frame()
+		{
+			add(InputTraceEventType::Frame).size = ViewportSize;
+			time += FrameTime;
+		}
+
+		void pointer(sint16x2 position, bool isActive)
+		{
+			add(InputTraceEventType::PointerState).pointer = { position, isActive, 1.0f };
+			frame();
+		}
+
+		InstrumentSettings& setInstrument(Instrument instrument)
+		{
+			InputTraceEvent &event = add(InputTraceEventType::SetInstrument);
+			event.instrument = instrument;
+			return event.instrumentSettings;
+		}
+
+		InstrumentSettings& updateSettings(Instrument instrument)
+		{
+			InputTraceEvent &event = add(InputTraceEventType::InstrumentSettings);
+			event.instrument = instrument;
+			return event.instrumentSettings;
+		}
+
+		void layerEvent(InputTraceEventType type, uint16 layerIndex)
+		{
+			add(type).layerIndex = layerIndex;
+		}
+
+		void enableLayer(uint16 layerIndex, bool enabled)
+		{
+			InputTraceEvent &event = add(InputTraceEventType::EnableLayer);
+			event.layerIndex = layerIndex;
+			event.enabled = enabled;
+			frame();
+		}
+
+		// Lissajous curve around viewport center, pointer moves every frame.
+		void stroke(uint32 frameCount, float32x2 radius, float32 frequencyX, float32 frequencyY, float32 phase)
+		{
+			for (uint32 i = 0; i <= frameCount; i++)
+			{
+				float32 t = float32(i) / float32(frameCount) * 2.0f * Math::PiF32;
+				sint16x2 position(
+					sint16(float32(ViewportSize.x / 2) + radius.x * Math::Sin(t * frequencyX + phase)),
+					sint16(float32(ViewportSize.y / 2) + radius.y * Math::Sin(t * frequencyY)));
+				pointer(position, i < frameCount);
+			}
+		}
+
+		// Pressed, dragged and released, then applied.
+		void drag(sint16x2 from, sint16x2 to, uint32 frameCount)
+		{
+			pointer(from, false);
+			for (uint32 i = 0; i <= frameCount; i++)
+			{
+				sint16x2 position(
+					sint16(from.x + sint32(to.x - from.x) * sint32(i) / sint32(frameCount)),
+					sint16(from.y + sint32(to.y - from.y) * sint32(i) / sint32(frameCount)));
+				pointer(position, true);
+			}
+			pointer(to, false);
+			add(InputTraceEventType::ApplyInstrument);
+			frame();
+			frame();
+		}
+	};
+
+	void BuildBrushStrokesTrace(InputTrace& trace)
+	{
+		trace.begin(uint32x2(4096, 4096), 1, 0, 1);
+		TraceBuilder builder(trace);
+
+		for (uint32 i = 0; i < 6; i++)
+		{
+			BrushSettings &brush = builder.setInstrument(Instrument::Brush).brush;
+			brush.color = Color(uint8(40 * i), uint8(80 + 20 * i), uint8(200 - 30 * i), 160);
+			brush.width = 4.0f + float32(i) * 12.0f;
+			brush.blendEnabled = (i & 1) == 0;
+			builder.stroke(360, float32x2(560.0f, 320.0f), float32(i % 3 + 1), float32(i % 2 + 2), float32(i) * 0.7f);
+		}
+
+		for (uint32 i = 0; i < 2; i++)
+		{
+			builder.setInstrument(Instrument::Pencil).pencil.color = Color(uint8(200 * i), 40, 60, 255);
+			builder.stroke(480, float32x2(600.0f, 340.0f), float32(i + 3), float32(i + 4), 0.3f);
+		}
+	}
+
+	void BuildManyLayersTrace(InputTrace& trace)
+	{
+		static constexpr uint16 LayerCount = 14;
+
+		trace.begin(uint32x2(2048, 1536), 1, 0, 1);
+		TraceBuilder builder(trace);
+
+		for (uint16 i = 1; i < LayerCount; i++)
+		{
+			builder.add(InputTraceEventType::CreateLayer);
+			if (i % 3 == 0)
+			{
+				InputTraceEvent &clear = builder.add(InputTraceEventType::ClearLayer);
+				clear.layerIndex = i;
+				clear.color = Color(uint8(16 * i), 64, uint8(255 - 16 * i), 32);
+			}
+			builder.frame();
+		}
+
+		// Strokes spread over layers, so caches below and above current layer are rebuilt.
+		for (uint16 i = 0; i < LayerCount; i++)
+		{
+			uint16 layerIndex = uint16(i * 5 % LayerCount);
+			builder.layerEvent(InputTraceEventType::SetCurrentLayer, layerIndex);
+
+			BrushSettings &brush = builder.setInstrument(Instrument::Brush).brush;
+			brush.color = Color(uint8(255 - 18 * i), uint8(18 * i), 96, 192);
+			brush.width = 8.0f + float32(i % 4) * 8.0f;
+			brush.blendEnabled = true;
+			builder.stroke(90, float32x2(420.0f + float32(i) * 10.0f, 240.0f), 1.0f, 2.0f, float32(i));
+		}
+
+		// Lines and shapes on other layers, applied from temp layer.
+		for (uint16 i = 0; i < 4; i++)
+		{
+			builder.layerEvent(InputTraceEventType::SetCurrentLayer, uint16(LayerCount - 1 - i));
+
+			LineSettings &line = builder.setInstrument(Instrument::Line).line;
+			line = { 0xFF204080_rgba, 6.0f + float32(i) * 4.0f, (i & 1) != 0, (i & 2) != 0 };
+			builder.drag(sint16x2(200 + i * 40, 150), sint16x2(1000 - i * 60, 560), 40);
+
+			ShapeSettings &shape = builder.setInstrument(Instrument::Shape).shape;
+			shape = { 0x8040A020_rgba, 0xFF000000_rgba, 5.0f, (i & 1) ? Shape::Circle : Shape::Rectangle };
+			builder.drag(sint16x2(300 + i * 30, 200 + i * 20), sint16x2(800 - i * 20, 500), 40);
+		}
+
+		// Visibility toggles and reordering recomposite whole canvas.
+		for (uint16 i = 0; i < LayerCount; i++)
+		{
+			builder.enableLayer(i, false);
+			builder.enableLayer(i, true);
+		}
+		for (uint16 i = 0; i + 1 < LayerCount; i++)
+		{
+			InputTraceEvent &move = builder.add(InputTraceEventType::MoveLayer);
+			move.layerIndex = i;
+			move.otherLayerIndex = uint16(LayerCount - 1 - i);
+			builder.frame();
+		}
+
+		for (uint32 i = 0; i < 12; i++)
+		{
+			builder.add(InputTraceEventType::Undo);
+			builder.frame();
+		}
+		for (uint32 i = 0; i < 12; i++)
+		{
+			builder.add(InputTraceEventType::Redo);
+			builder.frame();
+		}
+	}
+
+	void BuildFilterScrubbingTrace(InputTrace& trace)
+	{
+		trace.begin(uint32x2(2048, 2048), 1, 0, 1);
+		TraceBuilder builder(trace);
+
+		for (uint32 i = 0; i < 4; i++)
+		{
+			BrushSettings &brush = builder.setInstrument(Instrument::Brush).brush;
+			brush = { Color(uint8(60 * i), 160, uint8(240 - 60 * i), 255), 24.0f + float32(i) * 16.0f, false };
+			builder.stroke(60, float32x2(480.0f, 280.0f), float32(i + 1), 2.0f, 0.0f);
+		}
+
+		// Slider is dragged back and forth, every frame filter preview is rebuilt.
+		builder.setInstrument(Instrument::GaussianBlurFilter).gaussianBlur.radius = 1;
+		builder.frame();
+		for (uint32 i = 0; i < 120; i++)
+		{
+			uint32 radius = i < 60 ? 1 + i : 120 - i;
+			builder.updateSettings(Instrument::GaussianBlurFilter).gaussianBlur.radius = radius;
+			builder.frame();
+		}
+		builder.add(InputTraceEventType::ApplyInstrument);
+		builder.frame();
+
+		builder.setInstrument(Instrument::BrightnessContrastGammaFilter).brightnessContrastGamma = { 0.0f, 1.0f, 1.0f };
+		builder.frame();
+		for (uint32 i = 0; i < 120; i++)
+		{
+			float32 t = float32(i) / 120.0f;
+			builder.updateSettings(Instrument::BrightnessContrastGammaFilter).brightnessContrastGamma =
+				{ t * 0.5f, 1.0f + t * 2.0f, 1.0f + Math::Sin(t * Math::PiF32) };
+			builder.frame();
+		}
+		builder.add(InputTraceEventType::ApplyInstrument);
+		builder.frame();
+
+		builder.setInstrument(Instrument::SharpenFilter).sharpen.intensity = 0.0f;
+		builder.frame();
+		for (uint32 i = 0; i < 60; i++)
+		{
+			builder.updateSettings(Instrument::SharpenFilter).sharpen.intensity = float32(i) / 60.0f;
+			builder.frame();
+		}
+		builder.add(InputTraceEventType::ApplyInstrument);
+		builder.frame();
+	}
+}
+
+void InputTraceReplay::BuildStandardTrace(uint32 index, InputTrace& trace, const char*& name)
+{
+	switch (index)
+	{
+		case 0:
+			name = "brush strokes";
+			BuildBrushStrokesTrace(trace);
+			break;
+
+		case 1:
+			name = "many layers";
+			BuildManyLayersTrace(trace);
+			break;
+
+		case 2:
+			name = "filter scrubbing";
+			BuildFilterScrubbingTrace(trace);
+			break;
+
+		default:
+			Debug::Crash("invalid standard input trace index");
+	}
+}
+
+void InputTraceReplay::LogStats(const char* name, const InputTraceReplayStats& stats)
+{
+	char message[256];
+	sprintf_s(message, "%-16s %5u frames, %7.2f s, frame p50 %6.2f ms, p99 %6.2f ms, max %6.2f ms",
+		name, stats.frameCount, stats.totalTime, stats.medianFrameTime * 1000.0f,
+		stats.p99FrameTime * 1000.0f, stats.maxFrameTime * 1000.0f);
+	Debug::Log(message);
+
+	uint32 frameCount = max<uint32>(stats.frameCount, 1);
+	sprintf_s(message, "%-16s %9.2f Mpixels/frame avg, %7.2f max, %7.1f allocs/frame avg, %u max", "",
+		float32(stats.touchedPixelCount) / float32(frameCount) * 1.0e-6f,
+		float32(stats.maxFrameTouchedPixelCount) * 1.0e-6f,
+		float32(stats.allocationCount) / float32(frameCount), stats.maxFrameAllocationCount);
+	Debug::Log(message);
+
+	sprintf_s(message, "%-16s %9.1f geometry vertices/frame avg, %9.1f indices, %5.2f flushes, %5.2f draws", "",
+		float32(stats.geometryVertexCount) / float32(frameCount),
+		float32(stats.geometryIndexCount) / float32(frameCount),
+		float32(stats.geometryFlushCount) / float32(frameCount),
+		float32(stats.geometryDrawCount) / float32(frameCount));
+	Debug::Log(message);
+}
+
+void InputTraceReplay::RunBenchmark(Device& device)
+{
+	for (uint32 i = 0; i < StandardTraceCount; i++)
+	{
+		InputTrace trace;
+		const char *name = nullptr;
+		BuildStandardTrace(i, trace, name);
+
+		InputTraceReplayStats stats;
+		Run(trace, device, stats);
+		LogStats(name, stats);
+	}
+}
\ No newline at end of file
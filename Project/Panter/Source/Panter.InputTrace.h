@@ -0,0 +1,145 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Containers.Vector.h>
+#include <XLib.System.Timer.h>
+#include <XLib.Graphics.h>
+
+#include "Panter.CanvasManager.h"
+
+namespace Panter
+{
+	// Trace of canvas input: pointer, instrument, layer and view calls made on canvas between
+	// frames. Replaying trace on new canvas repeats the same work deterministically, so frame
+	// latency can be compared across builds. Layer pixels uploaded from outside (loaded
+	// images) are not recorded, replay starts with white first layer and empty other layers.
+	// Trace file is header followed by events.
+
+	enum class InputTraceEventType : uint8
+	{
+		None = 0,
+
+		Frame,					// updateAndDraw, argument is viewport size.
+		PointerState,
+		PointerPanViewMode,
+		SetInstrument,			// Settings are taken when next event is recorded, so they
+		InstrumentSettings,		// include changes made through returned reference.
+		ResetInstrument,
+		ApplyInstrument,
+		ResetSelection,
+		CreateLayer,
+		RemoveLayer,
+		MoveLayer,
+		EnableLayer,
+		SetCurrentLayer,
+		ClearLayer,
+		Undo,
+		Redo,
+		ClearHistory,
+		CenterView,
+		ScaleView,
+		SetCanvasScale,
+		ResizeDiscardingContents,
+		ResizeSavingContents,
+	};
+
+	struct InputTraceEvent
+	{
+		float32 time;				// Seconds since recording started.
+		InputTraceEventType type;
+		Instrument instrument;
+		uint16 layerIndex;
+
+		union
+		{
+			InstrumentSettings instrumentSettings;
+			struct
+			{
+				sint16x2 position;
+				bool isActive;
+				float32 pressure;
+			} pointer;
+			struct
+			{
+				sint32 left, top, right, bottom;
+				XLib::Color fillColor;
+			} canvasRect;
+			uint32x2 size;			// Viewport or canvas size.
+			XLib::Color color;
+			float32 scale;
+			uint16 otherLayerIndex;
+			bool enabled;
+		};
+	};
+
+	struct InputTraceHeader
+	{
+		uint32 magic;
+		uint32 version;
+		uint32x2 canvasSize;
+		uint32 eventCount;
+		uint16 layerCount;
+		uint16 currentLayer;
+		uint16 visibleLayerFlags;	// Bit per layer.
+		uint16 reserved;
+	};
+
+	class InputTrace : public XLib::NonCopyable
+	{
+	private:
+		XLib::Vector<InputTraceEvent> events;
+		InputTraceHeader header = {};
+		XLib::TimerRecord startTime = 0;
+
+	public:
+		InputTrace() = default;
+		~InputTrace() = default;
+
+		// Drops previous events. Canvas state is what replay starts from.
+		void begin(uint32x2 canvasSize, uint16 layerCount, uint16 currentLayer, uint16 visibleLayerFlags);
+		// Event is stamped with time since begin.
+		InputTraceEvent& addEvent(InputTraceEventType type);
+
+		bool load(const wchar* filename);
+		bool save(const wchar* filename);
+
+		inline const InputTraceHeader& getHeader() const { return header; }
+		inline const InputTraceEvent* getEvents() { return events; }
+		inline uint32 getEventCount() const { return events.getSize(); }
+	};
+
+	struct InputTraceReplayStats
+	{
+		uint32 frameCount;
+		float32 totalTime;
+		float32 medianFrameTime;		// Frame time covers events since previous frame and drawing.
+		float32 p99FrameTime;
+		float32 maxFrameTime;
+		uint64 touchedPixelCount;		// Layer, preview and recomposited pixels.
+		uint64 maxFrameTouchedPixelCount;
+		uint64 allocationCount;
+		uint32 maxFrameAllocationCount;
+		uint64 geometryVertexCount;
+		uint64 geometryIndexCount;
+		uint64 geometryFlushCount;
+		uint64 geometryDrawCount;
+	};
+
+	struct InputTraceReplay abstract final
+	{
+		static constexpr uint32 StandardTraceCount = 3;
+
+		// Replays on new canvas of given device. Drawing is waited for every frame, so frame
+		// time includes GPU work.
+		static void Run(InputTrace& trace, XLib::Graphics::Device& device, InputTraceReplayStats& stats);
+
+		// Standard suite: long brush strokes, many layers scene and filter scrubbing. Traces are
+		// generated, so they are identical for every run.
+		static void BuildStandardTrace(uint32 index, InputTrace& trace, const char*& name);
+		static void LogStats(const char* name, const InputTraceReplayStats& stats);
+		static void RunBenchmark(XLib::Graphics::Device& device);
+	};
+}
\ No newline at end of file
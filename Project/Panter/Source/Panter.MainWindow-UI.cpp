@@ -1,6 +1,17 @@
 #include <map>
 
+#include <XLib.Debug.h>
+#include <XLib.Crypto.CRC.h>
+#include <XLib.System.Profiler.h>
+#include <XLib.System.Threading.WorkerPool.h>
+#include <XLib.Graphics.PathRasterizer.h>
+
 #include "Panter.MainWindow.h"
+#include "Panter.Compositor.h"
+#include "Panter.GaussianBlur.h"
+#include "Panter.ColorLookup.h"
+#include "Panter.PngCodec.h"
+#include "Panter.Constants.h"
 
 #include "imgui\imgui_impl_dx11.h"
 
@@ -57,6 +68,8 @@ void Panter::MainWindow::InitGui() {
 }
 
 void Panter::MainWindow::ProcessGui() {
+	ProfileFunction();
+
 	float buttonSize = min(0.07f * (float)width, 0.07f * (float)height);
 	Instrument currentInstrument = canvasManager.getCanvasInstrument();
 
@@ -72,6 +85,7 @@ void Panter::MainWindow::ProcessGui() {
 	static bool showInstrumentProperties = true;
 	static bool showLayers = true;
 	static bool showNewCanvasProperties = true;
+	static bool showProfiler = false;
 
 	const uint16 widgetsXOffset = 5;
 	const uint16 widgetsYOffset = 25;
@@ -87,7 +101,8 @@ void Panter::MainWindow::ProcessGui() {
 				if (ImGui::MenuItem("Open")) {
 					openFile();
 				}
-				if (ImGui::MenuItem("Save")) {
+				// Image save runs in background, next one can start only after it is finished.
+				if (ImGui::MenuItem("Save", nullptr, false, !backgroundSave.isActive())) {
 					if (currentFileName.empty()) {
 						saveFileWithDialog();
 					}
@@ -95,7 +110,7 @@ void Panter::MainWindow::ProcessGui() {
 						saveCurrentFile();
 					}
 				}
-				if (ImGui::MenuItem("Save As...")) {
+				if (ImGui::MenuItem("Save As...", nullptr, false, !backgroundSave.isActive())) {
 					saveFileWithDialog();
 				}
 
@@ -107,6 +122,16 @@ void Panter::MainWindow::ProcessGui() {
 				ImGui::EndMenu();
 			}
 
+			if (ImGui::BeginMenu("Edit")) {
+				if (ImGui::MenuItem("Undo", "Z", false, canvasManager.canUndo())) {
+					canvasManager.undo();
+				}
+				if (ImGui::MenuItem("Redo", "Y", false, canvasManager.canRedo())) {
+					canvasManager.redo();
+				}
+				ImGui::EndMenu();
+			}
+
 			if (ImGui::BeginMenu("Tools")) {
 				if (ImGui::MenuItem("Center view")) {
 					canvasManager.centerView();
@@ -121,6 +146,49 @@ void Panter::MainWindow::ProcessGui() {
 					resizeXOffset = 0;
 					resizeYOffset = 0;
 				}
+				if (ImGui::MenuItem("Compositor benchmark")) {
+					Compositor::RunBenchmark();
+				}
+				if (ImGui::MenuItem("Worker pool self test")) {
+					WorkerPool::RunSelfTest();
+				}
+				if (ImGui::MenuItem("Gaussian blur self test")) {
+					GaussianBlur::RunSelfTest();
+				}
+				if (ImGui::MenuItem("Gaussian blur benchmark")) {
+					GaussianBlur::RunBenchmark();
+				}
+				if (ImGui::MenuItem("Color lookup benchmark")) {
+					ColorLookup::RunBenchmark();
+				}
+				if (ImGui::MenuItem("PNG codec benchmark")) {
+					PngCodec::RunBenchmark();
+				}
+				if (ImGui::MenuItem("CRC benchmark")) {
+					CRC32::RunBenchmark();
+				}
+				if (ImGui::MenuItem("Path rasterizer benchmark")) {
+					PathRasterizer::RunBenchmark();
+				}
+				ImGui::Separator();
+				ImGui::MenuItem("Profiler", nullptr, &showProfiler);
+				if (ImGui::MenuItem("Record input trace", nullptr, canvasManager.isRecordingInputTrace())) {
+					if (!canvasManager.isRecordingInputTrace()) {
+						canvasManager.startInputTraceRecording(inputTrace);
+					} else {
+						canvasManager.stopInputTraceRecording();
+						Debug::WarningCondition(!inputTrace.save(InputTraceFileName), "can't save input trace");
+					}
+				}
+				if (ImGui::MenuItem("Replay input trace", nullptr, false, !canvasManager.isRecordingInputTrace()) &&
+					inputTrace.load(InputTraceFileName)) {
+					InputTraceReplayStats stats;
+					InputTraceReplay::Run(inputTrace, device, stats);
+					InputTraceReplay::LogStats("input trace", stats);
+				}
+				if (ImGui::MenuItem("Input trace benchmark")) {
+					InputTraceReplay::RunBenchmark(device);
+				}
 				ImGui::EndMenu();
 			}
 
@@ -365,7 +433,7 @@ void Panter::MainWindow::ProcessGui() {
 				auto& settings = canvasManager.getInstrumentSettings_gaussianBlurFilter();
 				bool updateSettings = false;
 
-				updateSettings |= ImGui::SliderInt("Radius", (int*)&settings.radius, 1, 16);
+				updateSettings |= ImGui::SliderInt("Radius", (int*)&settings.radius, 1, 500);
 
 				if (updateSettings) canvasManager.updateInstrumentSettings();
 
@@ -565,6 +633,106 @@ void Panter::MainWindow::ProcessGui() {
 		ImGui::End();
 	}
 
+	if (openRecoveryWindow) {
+		ImGui::SetNextWindowPos(ImVec2(width * 0.4f, height * 0.4f), ImGuiCond_Always);
+		ImGui::SetNextWindowSize(ImVec2(width * 0.2f, -1), ImGuiCond_Always);
+		ImGui::Begin("Recovery", nullptr, windowFlags & ~ImGuiWindowFlags_NoTitleBar);
+
+		ImGui::TextWrapped("Previous session was not closed properly. Recover unsaved work?");
+		if (ImGui::Button("Recover", ImVec2(buttonSize, buttonSize * 0.5f))) {
+			recoverAutosave();
+			openRecoveryWindow = false;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Discard", ImVec2(buttonSize, buttonSize * 0.5f))) {
+			discardAutosave();
+			openRecoveryWindow = false;
+		}
+
+		ImGui::End();
+	}
+
+	// Placed above loading window, so both are visible when image is saved during loading.
+	if (backgroundSave.isActive()) {
+		ImGui::SetNextWindowPos(ImVec2(width * 0.4f, height - 120.0f), ImGuiCond_Always);
+		ImGui::SetNextWindowSize(ImVec2(width * 0.2f, -1), ImGuiCond_Always);
+		ImGui::Begin("Saving", nullptr, windowFlags);
+
+		ImGui::Text(backgroundSave.getState() == BackgroundSaveState::ReadingCanvas ? "Reading canvas" : "Saving");
+		ImGui::ProgressBar(backgroundSave.getProgress(), ImVec2(-1, 0));
+		if (ImGui::Button("Cancel", ImVec2(buttonSize, buttonSize * 0.5f))) {
+			backgroundSave.cancel();
+		}
+
+		ImGui::End();
+	}
+
+	if (imageLoader.isOpen()) {
+		ImGui::SetNextWindowPos(ImVec2(width * 0.4f, height - 60.0f), ImGuiCond_Always);
+		ImGui::SetNextWindowSize(ImVec2(width * 0.2f, -1), ImGuiCond_Always);
+		ImGui::Begin("Loading", nullptr, windowFlags);
+
+		ImGui::Text("Reading image");
+		ImGui::ProgressBar(float32(imageLoader.getReadRowCount()) / float32(imageLoader.getHeight()), ImVec2(-1, 0));
+		if (ImGui::Button("Cancel", ImVec2(buttonSize, buttonSize * 0.5f))) {
+			imageLoader.close();
+			canvasManager.clearHistory();
+		}
+
+		ImGui::End();
+	}
+
+	// Rolling breakdown of last frames, scopes of every thread summed per frame.
+	if (showProfiler) {
+		ImGui::SetNextWindowSize(ImVec2(560.0f, 400.0f), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Profiler", &showProfiler);
+
+		ImGui::Text("Frame %.2f ms avg, %.2f ms max, %llu events dropped", Profiler::GetAverageFrameTime() * 1000.0f,
+			Profiler::GetMaxFrameTime() * 1000.0f, (unsigned long long)Profiler::GetDroppedEventCount());
+		if (!Profiler::IsCapturing()) {
+			if (ImGui::Button("Start capture")) {
+				Profiler::StartCapture();
+			}
+		}
+		else if (ImGui::Button("Save capture")) {
+			Profiler::StopCapture(ProfilerCaptureFileName);
+		}
+		ImGui::Separator();
+
+		ProfilerScopeStats scopes[Profiler::MaxScopeCount];
+		uint32 scopeCount = Profiler::GetFrameBreakdown(scopes, Profiler::MaxScopeCount);
+
+		ImGui::Columns(4, "ProfilerScopes");
+		ImGui::SetColumnWidth(0, 280.0f);
+		ImGui::Text("Scope"); ImGui::NextColumn();
+		ImGui::Text("Avg ms"); ImGui::NextColumn();
+		ImGui::Text("Max ms"); ImGui::NextColumn();
+		ImGui::Text("Calls"); ImGui::NextColumn();
+		ImGui::Separator();
+		for (uint32 i = 0; i < scopeCount; i++) {
+			const ProfilerScopeStats &scope = scopes[i];
+			if (i == 0 || scope.threadIndex != scopes[i - 1].threadIndex) {
+				const char *threadName = Profiler::GetThreadName(scope.threadIndex);
+				ImGui::TextDisabled("%s", threadName ? threadName : "Thread");
+				ImGui::NextColumn(); ImGui::NextColumn(); ImGui::NextColumn(); ImGui::NextColumn();
+			}
+			ImGui::Text("%*s%s", int(scope.depth) * 2 + 2, "", scope.name); ImGui::NextColumn();
+			ImGui::Text("%.3f", scope.averageTime * 1000.0f); ImGui::NextColumn();
+			ImGui::Text("%.3f", scope.maxTime * 1000.0f); ImGui::NextColumn();
+			ImGui::Text("%.1f", scope.averageCallCount); ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+		ImGui::Separator();
+
+		ProfilerCounterStats counters[Profiler::MaxCounterCount];
+		uint32 counterCount = Profiler::GetCounters(counters, Profiler::MaxCounterCount);
+		for (uint32 i = 0; i < counterCount; i++) {
+			ImGui::Text("%s: %llu", counters[i].name, (unsigned long long)counters[i].value);
+		}
+
+		ImGui::End();
+	}
+
 	ImGui::Render();
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "FileUtil.h"
 
+#include <XLib.System.Profiler.h>
+
 using namespace XLib;
 using namespace XLib::Graphics;
 using namespace Panter;
@@ -15,6 +17,14 @@ void MainWindow::onCreate(CreationArgs& args)
 	canvasManager.initialize(device, { 720, 1280 });
 	canvasManager.createLayer();
 	canvasManager.clearLayer(0, 0xFFFFFF_rgb);
+	canvasManager.clearHistory();
+
+	// Journal left by crashed session is offered for recovery.
+	AutosaveJournalReader journal;
+	openRecoveryWindow = journal.open(AutosaveJournalFileName);
+	journal.close();
+	if (!openRecoveryWindow)
+		autosave.initialize(canvasManager, AutosaveJournalFileName, AutosaveInterval);
 
 	width = args.width;
 	height = args.height;
@@ -112,6 +122,14 @@ void MainWindow::onKeyboard(VirtualKey key, bool state)
 			break;
 		}*/
 
+		case VirtualKey('Z'):
+			canvasManager.undo();
+			break;
+
+		case VirtualKey('Y'):
+			canvasManager.redo();
+			break;
+
 		case VirtualKey('Q'):
 			canvasManager.resetSelection();
 			break;
@@ -204,11 +222,24 @@ void Panter::MainWindow::openFile()
     if (!OpenImageFileDialog(getHandle(), filename, countof(filename)))
 		return;
 
-    HeapPtr<byte> imageData;
-    uint32 width = 0, height = 0;
-	ImageFormat format = ImageFormat::None;
+	// Image that is still being loaded is abandoned.
+	imageLoader.close();
+
+	ProjectFileReader projectFile;
+	if (projectFile.open(filename))
+	{
+		openProject(projectFile);
+		autosave.restart(canvasManager);
+
+		currentFileName.assign(filename);
+		currentFileImageFormat = ImageFormat::Panter;
 
-    if (!LoadImageFromFile(filename, imageData, width, height, format))
+		std::wstring title = L"Panter - " + currentFileName;
+		setTitle(title.c_str());
+		return;
+	}
+
+	if (!imageLoader.open(filename))
 		return;
 
 	canvasManager.resetInstrument();
@@ -220,17 +251,126 @@ void Panter::MainWindow::openFile()
     layerNames[0] = "Layer 0";
     lastLayerNumber = 0;
 
-    canvasManager.resizeDiscardingContents({ width, height });
-    canvasManager.uploadLayerRegion(canvasManager.getCurrentLayerId(),
-		{ 0, 0, width, height }, imageData, width * 4);
+	// Pixels are uploaded by continueImageLoading() band by band, so image appears
+	// progressively and only one band is held in memory.
+    canvasManager.resizeDiscardingContents({ imageLoader.getWidth(), imageLoader.getHeight() });
+	loadingLayerId = canvasManager.getCurrentLayerId();
+	autosave.restart(canvasManager);
 
     currentFileName.assign(filename);
-	currentFileImageFormat = format;
+	currentFileImageFormat = imageLoader.getFormat();
 
     std::wstring title = L"Panter - " + currentFileName;
     setTitle(title.c_str());
 }
 
+void Panter::MainWindow::UploadImageBand(void* context, uint32 firstRow, uint32 rowCount, const uint32* pixels)
+{
+	MainWindow &window = *(MainWindow*)context;
+	uint32 width = window.imageLoader.getWidth();
+	window.canvasManager.uploadLayerRegion(window.loadingLayerId,
+		{ 0, firstRow, width, firstRow + rowCount }, pixels, width * 4);
+}
+
+void Panter::MainWindow::continueImageLoading()
+{
+	// Loading stops if loaded layer was removed or canvas resized meanwhile.
+	if (loadingLayerId >= canvasManager.getLayerCount() ||
+		canvasManager.getCanvasSize() != uint32x2(imageLoader.getWidth(), imageLoader.getHeight()))
+	{
+		imageLoader.close();
+		return;
+	}
+
+	// Partially loaded image is kept on read error.
+	if (!imageLoader.readBand(UploadImageBand, this) || imageLoader.isFinished())
+	{
+		imageLoader.close();
+		canvasManager.clearHistory();
+	}
+}
+
+// Recovered canvas is untitled, as it is newer than any saved file. Journal is continued
+// after replayed records, so recovered work stays recoverable while new journal is written.
+void Panter::MainWindow::recoverAutosave()
+{
+	AutosaveJournalReader journal;
+	if (!journal.open(AutosaveJournalFileName))
+	{
+		discardAutosave();
+		return;
+	}
+
+	canvasManager.readAutosaveJournal(journal);
+	uint64 journalValidSize = journal.getValidSize();
+	uint32 journalSession = journal.getSession();
+	journal.close();
+
+	uint16 layerCount = canvasManager.getLayerCount();
+	for (uint16 i = 0; i < countof(layerNames); i++)
+	{
+		layerNames[i] = i < layerCount ? "Layer " + std::to_string(i) : "";
+		enableLayer[i] = i < layerCount ? canvasManager.isLayerEnabled(i) : true;
+	}
+	lastLayerNumber = layerCount ? layerCount - 1 : 0;
+
+	currentFileName.clear();
+	currentFileImageFormat = ImageFormat::None;
+	setTitle(L"Panter - Untitled");
+
+	autosave.initialize(canvasManager, AutosaveJournalFileName, AutosaveInterval,
+		journalValidSize, journalSession);
+}
+
+void Panter::MainWindow::discardAutosave()
+{
+	autosave.initialize(canvasManager, AutosaveJournalFileName, AutosaveInterval);
+}
+
+void Panter::MainWindow::openProject(ProjectFileReader& projectFile)
+{
+	canvasManager.readProject(projectFile);
+
+	uint16 layerCount = canvasManager.getLayerCount();
+	for (uint16 i = 0; i < countof(layerNames); i++)
+	{
+		if (i < layerCount)
+		{
+			ProjectFileLayerInfo info = projectFile.getLayerInfo(i);
+			layerNames[i] = info.name;
+			enableLayer[i] = info.visible;
+		}
+		else
+		{
+			layerNames[i] = "";
+			enableLayer[i] = true;
+		}
+	}
+	lastLayerNumber = layerCount - 1;
+}
+
+bool Panter::MainWindow::saveProject(const wchar* filename)
+{
+	ProjectFileWriter projectFile;
+	if (!projectFile.open(filename, canvasManager.getCanvasSize(),
+		canvasManager.getLayerCount(), canvasManager.getCurrentLayerId()))
+	{
+		return false;
+	}
+
+	for (uint16 i = 0; i < canvasManager.getLayerCount(); i++)
+		projectFile.writeLayerInfo(i, { layerNames[i].c_str(), enableLayer[i] });
+
+	canvasManager.writeProject(projectFile);
+
+	// Saved project makes journal of previous changes unnecessary.
+	if (!projectFile.finish())
+		return false;
+
+	autosave.restart(canvasManager);
+	return true;
+}
+
 void Panter::MainWindow::saveFileWithDialog()
 {
 	wchar filename[260] = {};
@@ -238,9 +378,12 @@ void Panter::MainWindow::saveFileWithDialog()
 	if (!SaveImageFileDialog(getHandle(), filename, countof(filename), &format))
 		return;
 
+	// File name is kept only if save has started, so title does not point to unwritten file.
+	if (!saveFile(filename, format))
+		return;
+
 	currentFileName.assign(filename);
 	currentFileImageFormat = format;
-	saveCurrentFile();
 
 	std::wstring title = L"Panter - " + currentFileName;
 	setTitle(title.c_str());
@@ -248,17 +391,29 @@ void Panter::MainWindow::saveFileWithDialog()
 
 void Panter::MainWindow::saveCurrentFile()
 {
-	uint32x2 size = canvasManager.getCanvasSize();
-	HeapPtr<byte> buffer(size.x * size.y * 4);
+	saveFile(currentFileName.c_str(), currentFileImageFormat);
+}
 
-	canvasManager.downloadMergedLayers(buffer);
+bool Panter::MainWindow::saveFile(const wchar* filename, ImageFormat format)
+{
+	if (format == ImageFormat::Panter)
+		return saveProject(filename);
 
-	SaveImageToFile(currentFileName.c_str(), currentFileImageFormat, buffer, size.x, size.y);
+	// Fails while previous image save is still running.
+	return backgroundSave.start(canvasManager, filename, format);
 }
 
 void MainWindow::updateAndRedraw()
 {
+	ProfileFunction();
+
+	backgroundSave.update(canvasManager);
+	autosave.update(canvasManager);
+	if (imageLoader.isOpen())
+		continueImageLoading();
 	canvasManager.updateAndDraw(windowRenderTarget, { 0, 0, width, height });
     ProcessGui();
+
+	ProfileScope("Present");
 	windowRenderTarget.present();
 }
@@ -9,6 +9,9 @@
 #include <XLib.Graphics.h>
 
 #include "Panter.CanvasManager.h"
+#include "Panter.BackgroundSave.h"
+#include "Panter.AutosaveJournal.h"
+#include "Panter.InputTrace.h"
 
 #include "FileUtil.h"
 
@@ -26,6 +29,11 @@ namespace Panter
 		float32 *someParameterChangeTarget = nullptr;
 
 		CanvasManager canvasManager;
+		BackgroundImageSave backgroundSave;	// Holds canvas tiles, so destroyed before canvas.
+		AutosaveJournal autosave;			// Same.
+		ImageBandReader imageLoader;		// Opened image is uploaded band per frame.
+		uint16 loadingLayerId = 0;
+		InputTrace inputTrace;				// Recorded and replayed from tools menu.
         
 		std::wstring currentFileName = L"";
 		ImageFormat currentFileImageFormat = ImageFormat::None;
@@ -48,6 +56,8 @@ namespace Panter
 		int resizeYOffset = 0;
 
 		bool openCreateWindow = false;
+
+		bool openRecoveryWindow = false;	// Autosave starts after user decides.
 		int createWidth = 0;
 		int createHeight = 0;
 
@@ -61,8 +71,16 @@ namespace Panter
         virtual void onCharacter(wchar character) override;
 
         void openFile();
+		void openProject(ProjectFileReader& projectFile);
 		void saveFileWithDialog();
 		void saveCurrentFile();
+		bool saveFile(const wchar* filename, ImageFormat format);
+		bool saveProject(const wchar* filename);
+		void continueImageLoading();
+		void recoverAutosave();
+		void discardAutosave();
+
+		static void UploadImageBand(void* context, uint32 firstRow, uint32 rowCount, const uint32* pixels);
 
         void InitGui();
         void ProcessGui();
@@ -0,0 +1,1330 @@
+#include <immintrin.h>
+#include <string.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Memory.h>
+#include <XLib.Debug.h>
+#include <XLib.Random.h>
+#include <XLib.Crypto.CRC.h>
+#include <XLib.Compression.Deflate.h>
+#include <XLib.Benchmark.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "Panter.PngCodec.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr byte PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static constexpr uint32 MaxImageDimension = 1 << 16;
+static constexpr uint32 EncodeBandSize = 1 << 20;	// Filtered bytes per band.
+static constexpr uint32 EncodeWaveBandsPerThread = 2;
+
+static constexpr uint32 ChunkType(const char (&name)[5])
+{
+	return (uint32(byte(name[0])) << 24) | (uint32(byte(name[1])) << 16) |
+		(uint32(byte(name[2])) << 8) | uint32(byte(name[3]));
+}
+
+static constexpr uint32 ChunkIHDR = ChunkType("IHDR");
+static constexpr uint32 ChunkPLTE = ChunkType("PLTE");
+static constexpr uint32 ChunktRNS = ChunkType("tRNS");
+static constexpr uint32 ChunkIDAT = ChunkType("IDAT");
+static constexpr uint32 ChunkIEND = ChunkType("IEND");
+static constexpr uint32 ChunkpnSG = ChunkType("pnSG");	// Private: band row count and offsets.
+
+enum ColorType : uint32
+{
+	ColorTypeGray = 0,
+	ColorTypeRGB = 2,
+	ColorTypePalette = 3,
+	ColorTypeGrayAlpha = 4,
+	ColorTypeRGBA = 6,
+};
+
+enum Filter : uint32
+{
+	FilterNone = 0,
+	FilterSub = 1,
+	FilterUp = 2,
+	FilterAverage = 3,
+	FilterPaeth = 4,
+	FilterCount = 5,
+};
+
+static inline uint32 LoadBE32(const byte* data)
+{
+	return (uint32(data[0]) << 24) | (uint32(data[1]) << 16) | (uint32(data[2]) << 8) | uint32(data[3]);
+}
+static inline uint32 LoadBE16(const byte* data) { return (uint32(data[0]) << 8) | uint32(data[1]); }
+static inline void StoreBE32(byte* data, uint32 value)
+{
+	data[0] = byte(value >> 24);
+	data[1] = byte(value >> 16);
+	data[2] = byte(value >> 8);
+	data[3] = byte(value);
+}
+
+// Filters ==================================================================================//
+
+static inline __m128i Select(__m128i mask, __m128i ifSet, __m128i ifClear)
+{
+	return _mm_or_si128(_mm_and_si128(mask, ifSet), _mm_andnot_si128(mask, ifClear));
+}
+
+static inline __m128i Abs16(__m128i value)
+{
+	return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+// Paeth predictor of 16 bit lanes: a is left, b is up and c is up left.
+static inline __m128i PaethPredict16(__m128i a, __m128i b, __m128i c)
+{
+	__m128i pa = Abs16(_mm_sub_epi16(b, c));
+	__m128i pb = Abs16(_mm_sub_epi16(a, c));
+	__m128i pc = Abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+
+	__m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i notB = _mm_cmpgt_epi16(pb, pc);
+	return Select(notA, Select(notB, c, b), a);
+}
+
+static inline __m128i PaethPredict8(__m128i a, __m128i b, __m128i c)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = PaethPredict16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+	__m128i hi = PaethPredict16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+	return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i AveragePredict8(__m128i a, __m128i b)
+{
+	// _mm_avg_epu8 rounds up, filter rounds down.
+	__m128i roundingBits = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+	return _mm_sub_epi8(_mm_avg_epu8(a, b), roundingBits);
+}
+
+static inline uint32 PaethPredict(uint32 a, uint32 b, uint32 c)
+{
+	sint32 pa = abs(sint32(b) - sint32(c));
+	sint32 pb = abs(sint32(a) - sint32(c));
+	sint32 pc = abs(sint32(a) + sint32(b) - 2 * sint32(c));
+	return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+static inline uint32 Predict(uint32 filter, uint32 a, uint32 b, uint32 c)
+{
+	switch (filter)
+	{
+		case FilterSub:		return a;
+		case FilterUp:		return b;
+		case FilterAverage:	return (a + b) >> 1;
+		case FilterPaeth:	return PaethPredict(a, b, c);
+	}
+	return 0;
+}
+
+// Sum of absolute values of filtered bytes taken as signed, the usual filter heuristic.
+static inline __m128i FilterCost(__m128i filtered)
+{
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_sad_epu8(_mm_min_epu8(filtered, _mm_sub_epi8(zero, filtered)), zero);
+}
+
+// Filters RGBA8 row with filter giving the smallest cost. Independent row uses only filters
+// that do not depend on previous row.
+static void FilterRow(const byte* row, const byte* previousRow, uint32 size, bool independent, byte* output)
+{
+	constexpr uint32 stride = 4;
+
+	__m128i costs[FilterCount];
+	for (__m128i& cost : costs)
+		cost = _mm_setzero_si128();
+
+	uint32 i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(previousRow + i));
+		__m128i a = i ? _mm_loadu_si128((const __m128i*)(row + i - stride)) : _mm_slli_si128(x, stride);
+		__m128i c = i ? _mm_loadu_si128((const __m128i*)(previousRow + i - stride)) : _mm_slli_si128(b, stride);
+
+		costs[FilterNone] = _mm_add_epi64(costs[FilterNone], FilterCost(x));
+		costs[FilterSub] = _mm_add_epi64(costs[FilterSub], FilterCost(_mm_sub_epi8(x, a)));
+		costs[FilterUp] = _mm_add_epi64(costs[FilterUp], FilterCost(_mm_sub_epi8(x, b)));
+		costs[FilterAverage] = _mm_add_epi64(costs[FilterAverage], FilterCost(_mm_sub_epi8(x, AveragePredict8(a, b))));
+		costs[FilterPaeth] = _mm_add_epi64(costs[FilterPaeth], FilterCost(_mm_sub_epi8(x, PaethPredict8(a, b, c))));
+	}
+
+	uint64 scalarCosts[FilterCount] = {};
+	for (; i < size; i++)
+	{
+		uint32 a = i >= stride ? row[i - stride] : 0;
+		uint32 c = i >= stride ? previousRow[i - stride] : 0;
+		for (uint32 filter = FilterNone; filter < FilterCount; filter++)
+		{
+			sint8 filtered = sint8(row[i] - Predict(filter, a, previousRow[i], c));
+			scalarCosts[filter] += abs(sint32(filtered));
+		}
+	}
+
+	uint32 bestFilter = FilterNone;
+	uint64 bestCost = uint64(-1);
+	for (uint32 filter = FilterNone; filter < (independent ? FilterUp : FilterCount); filter++)
+	{
+		uint64 vectorCosts[2];
+		_mm_storeu_si128((__m128i*)vectorCosts, costs[filter]);
+		uint64 cost = scalarCosts[filter] + vectorCosts[0] + vectorCosts[1];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestFilter = filter;
+		}
+	}
+
+	output[0] = byte(bestFilter);
+	output++;
+
+	if (bestFilter == FilterNone)
+	{
+		Memory::Copy(output, row, size);
+		return;
+	}
+
+	for (i = 0; i + 16 <= size; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(previousRow + i));
+		__m128i a = i ? _mm_loadu_si128((const __m128i*)(row + i - stride)) : _mm_slli_si128(x, stride);
+		__m128i c = i ? _mm_loadu_si128((const __m128i*)(previousRow + i - stride)) : _mm_slli_si128(b, stride);
+
+		__m128i prediction;
+		switch (bestFilter)
+		{
+			case FilterSub:		prediction = a;							break;
+			case FilterUp:		prediction = b;							break;
+			case FilterAverage:	prediction = AveragePredict8(a, b);		break;
+			default:			prediction = PaethPredict8(a, b, c);	break;
+		}
+		_mm_storeu_si128((__m128i*)(output + i), _mm_sub_epi8(x, prediction));
+	}
+	for (; i < size; i++)
+	{
+		uint32 a = i >= stride ? row[i - stride] : 0;
+		uint32 c = i >= stride ? previousRow[i - stride] : 0;
+		output[i] = byte(row[i] - Predict(bestFilter, a, previousRow[i], c));
+	}
+}
+
+// Pixels of up to 8 bytes are loaded to low half of register.
+template <uint32 stride>
+static inline __m128i LoadPixel(const byte* data)
+{
+	uint64 value = 0;
+	memcpy(&value, data, stride);
+	return _mm_loadl_epi64((const __m128i*)&value);
+}
+
+template <uint32 stride>
+static inline void StorePixel(byte* data, __m128i pixel)
+{
+	uint64 value;
+	_mm_storel_epi64((__m128i*)&value, pixel);
+	memcpy(data, &value, stride);
+}
+
+// Sub, Average and Paeth filters depend on previous pixel, so they are undone pixel by pixel
+// with all channels at once.
+template <uint32 stride>
+static void UnfilterRowSIMD(byte* row, const byte* previousRow, uint32 size, uint32 filter)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = zero, c = zero;
+
+	switch (filter)
+	{
+		case FilterSub:
+			for (uint32 i = 0; i < size; i += stride)
+			{
+				a = _mm_add_epi8(LoadPixel<stride>(row + i), a);
+				StorePixel<stride>(row + i, a);
+			}
+			break;
+
+		case FilterAverage:
+			for (uint32 i = 0; i < size; i += stride)
+			{
+				__m128i b = LoadPixel<stride>(previousRow + i);
+				a = _mm_add_epi8(LoadPixel<stride>(row + i), AveragePredict8(a, b));
+				StorePixel<stride>(row + i, a);
+			}
+			break;
+
+		case FilterPaeth:
+			for (uint32 i = 0; i < size; i += stride)
+			{
+				__m128i b = _mm_unpacklo_epi8(LoadPixel<stride>(previousRow + i), zero);
+				__m128i x = _mm_unpacklo_epi8(LoadPixel<stride>(row + i), zero);
+				a = _mm_and_si128(_mm_add_epi16(x, PaethPredict16(a, b, c)), _mm_set1_epi16(0xFF));
+				StorePixel<stride>(row + i, _mm_packus_epi16(a, a));
+				c = b;
+			}
+			break;
+	}
+}
+
+// RGBA8 Sub filter is undone four pixels at once with prefix sum.
+static void UnfilterRowSub4(byte* row, uint32 size)
+{
+	__m128i last = _mm_setzero_si128();
+	uint32 i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi8(x, last);
+		_mm_storeu_si128((__m128i*)(row + i), x);
+		last = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	for (; i < size; i++)
+		row[i] += i >= 4 ? row[i - 4] : 0;
+}
+
+static bool UnfilterRow(byte* row, const byte* previousRow, uint32 size, uint32 filter, uint32 stride)
+{
+	switch (filter)
+	{
+		case FilterNone:
+			return true;
+
+		case FilterUp:
+		{
+			uint32 i = 0;
+			for (; i + 16 <= size; i += 16)
+			{
+				__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+				__m128i b = _mm_loadu_si128((const __m128i*)(previousRow + i));
+				_mm_storeu_si128((__m128i*)(row + i), _mm_add_epi8(x, b));
+			}
+			for (; i < size; i++)
+				row[i] += previousRow[i];
+			return true;
+		}
+
+		case FilterSub:
+		case FilterAverage:
+		case FilterPaeth:
+			if (filter == FilterSub && stride == 4)
+			{
+				UnfilterRowSub4(row, size);
+				return true;
+			}
+
+			switch (stride)
+			{
+				case 1: UnfilterRowSIMD<1>(row, previousRow, size, filter); break;
+				case 2: UnfilterRowSIMD<2>(row, previousRow, size, filter); break;
+				case 3: UnfilterRowSIMD<3>(row, previousRow, size, filter); break;
+				case 4: UnfilterRowSIMD<4>(row, previousRow, size, filter); break;
+				case 6: UnfilterRowSIMD<6>(row, previousRow, size, filter); break;
+				case 8: UnfilterRowSIMD<8>(row, previousRow, size, filter); break;
+				default: return false;
+			}
+			return true;
+	}
+	return false;
+}
+
+// Encoder ==================================================================================//
+
+struct EncodeContext
+{
+	const byte *pixels;
+	uint32 pixelsStride;
+	uint32 height;
+	uint32 rowSize;
+	uint32 bandRowCount;
+	uint32 bandCount;
+	uint32 firstBand;		// Of current wave.
+	const byte *zeroRow;
+
+	byte *filteredData;		// Slot per band of wave.
+	byte *chunkData;
+	uintptr filteredSlotSize;
+	uintptr chunkSlotSize;
+	uint32 *filteredSizes;
+	uint32 *chunkSizes;
+	uint32 *adlers;
+};
+
+// Every band is filtered, deflated and framed as complete IDAT chunk.
+static void EncodeBands(void* _context, uint32 begin, uint32 end)
+{
+	EncodeContext &context = *(EncodeContext*)_context;
+
+	for (uint32 slot = begin; slot < end; slot++)
+	{
+		uint32 band = context.firstBand + slot;
+		uint32 rowBegin = band * context.bandRowCount;
+		uint32 rowEnd = min(rowBegin + context.bandRowCount, context.height);
+
+		byte *filtered = context.filteredData + context.filteredSlotSize * slot;
+		for (uint32 y = rowBegin; y < rowEnd; y++)
+		{
+			const byte *row = context.pixels + uintptr(context.pixelsStride) * y;
+			const byte *previousRow = y == rowBegin ? context.zeroRow : row - context.pixelsStride;
+			FilterRow(row, previousRow, context.rowSize, y == rowBegin,
+				filtered + uintptr(context.rowSize + 1) * (y - rowBegin));
+		}
+
+		uint32 filteredSize = (context.rowSize + 1) * (rowEnd - rowBegin);
+		context.filteredSizes[slot] = filteredSize;
+		context.adlers[slot] = Adler32::Compute(filtered, filteredSize);
+
+		byte *chunk = context.chunkData + context.chunkSlotSize * slot;
+		uint32 compressedSize = uint32(Deflate::Compress(filtered, filteredSize, chunk + 8,
+			band == context.bandCount - 1));
+
+		StoreBE32(chunk, compressedSize);
+		StoreBE32(chunk + 4, ChunkIDAT);
+		StoreBE32(chunk + 8 + compressedSize, CRC32IEEE::Compute(chunk + 4, compressedSize + 4));
+		context.chunkSizes[slot] = compressedSize + 12;
+	}
+}
+
+struct PngWriter
+{
+	HeapPtr<byte> &data;
+	uintptr size;
+	uintptr capacity;
+
+	void append(const void* source, uintptr sourceSize)
+	{
+		if (size + sourceSize > capacity)
+		{
+			capacity = max(capacity * 2, size + sourceSize);
+			data.resize(capacity);
+		}
+		Memory::Copy(data + size, source, sourceSize);
+		size += sourceSize;
+	}
+
+	void appendChunk(uint32 type, const void* chunkData, uint32 chunkSize)
+	{
+		byte header[8];
+		StoreBE32(header, chunkSize);
+		StoreBE32(header + 4, type);
+
+		byte footer[4];
+		StoreBE32(footer, CRC32IEEE::Compute(chunkData, chunkSize, CRC32IEEE::Compute(header + 4, 4)));
+
+		append(header, 8);
+		append(chunkData, chunkSize);
+		append(footer, 4);
+	}
+};
+
+bool PngCodec::Encode(const void* pixels, uint32 pixelsStride, uint32 width, uint32 height,
+	HeapPtr<byte>& data, uintptr& dataSize, bool parallel, PngEncodeProgress* progress)
+{
+	if (!width || !height || width > MaxImageDimension || height > MaxImageDimension)
+		return false;
+
+	uint32 rowSize = width * 4;
+	uint32 bandRowCount = clamp<uint32>(EncodeBandSize / (rowSize + 1), 1, height);
+	uint32 bandCount = intdivceil(height, bandRowCount);
+	uint32 waveBandCount = parallel ?
+		min(bandCount, WorkerPool::Global.getConcurrency() * EncodeWaveBandsPerThread) : 1;
+
+	uintptr filteredSlotSize = uintptr(bandRowCount) * (rowSize + 1);
+	uintptr chunkSlotSize = Deflate::GetMaxCompressedSize(filteredSlotSize) + 12;
+
+	HeapPtr<byte> zeroRow(rowSize);
+	HeapPtr<byte> filteredData(filteredSlotSize * waveBandCount);
+	HeapPtr<byte> chunkData(chunkSlotSize * waveBandCount);
+	HeapPtr<uint32> filteredSizes(waveBandCount);
+	HeapPtr<uint32> chunkSizes(waveBandCount);
+	HeapPtr<uint32> adlers(waveBandCount);
+	HeapPtr<byte> segmentTable(4 + uintptr(bandCount) * 4);
+	Memory::Set(zeroRow, 0, rowSize);
+
+	EncodeContext context = {};
+	context.pixels = (const byte*)pixels;
+	context.pixelsStride = pixelsStride;
+	context.height = height;
+	context.rowSize = rowSize;
+	context.bandRowCount = bandRowCount;
+	context.bandCount = bandCount;
+	context.zeroRow = zeroRow;
+	context.filteredData = filteredData;
+	context.chunkData = chunkData;
+	context.filteredSlotSize = filteredSlotSize;
+	context.chunkSlotSize = chunkSlotSize;
+	context.filteredSizes = filteredSizes;
+	context.chunkSizes = chunkSizes;
+	context.adlers = adlers;
+
+	PngWriter writer = { data, 0, 0 };
+	writer.append(PngSignature, sizeof(PngSignature));
+
+	byte header[13];
+	StoreBE32(header, width);
+	StoreBE32(header + 4, height);
+	header[8] = 8;					// Bit depth.
+	header[9] = ColorTypeRGBA;
+	header[10] = 0;					// Compression.
+	header[11] = 0;					// Filter method.
+	header[12] = 0;					// No interlacing.
+	writer.appendChunk(ChunkIHDR, header, sizeof(header));
+
+	// zlib header, 32 KB window, fastest compression level.
+	static constexpr byte zlibHeader[2] = { 0x78, 0x01 };
+	writer.appendChunk(ChunkIDAT, zlibHeader, sizeof(zlibHeader));
+
+	// Bands are encoded in waves, so only few of them are kept in memory.
+	uint32 adler = 1;
+	uint64 zlibOffset = sizeof(zlibHeader);
+	StoreBE32(segmentTable, bandRowCount);
+
+	for (uint32 firstBand = 0; firstBand < bandCount; firstBand += waveBandCount)
+	{
+		if (progress && progress->cancelled)
+			return false;
+
+		uint32 waveSize = min(waveBandCount, bandCount - firstBand);
+		context.firstBand = firstBand;
+
+		if (parallel)
+			WorkerPool::Global.parallelFor(waveSize, 1, EncodeBands, &context);
+		else
+			EncodeBands(&context, 0, waveSize);
+
+		for (uint32 slot = 0; slot < waveSize; slot++)
+		{
+			StoreBE32(segmentTable + 4 + uintptr(firstBand + slot) * 4, uint32(zlibOffset));
+			zlibOffset += chunkSizes[slot] - 12;
+			adler = Adler32::Combine(adler, adlers[slot], filteredSizes[slot]);
+			writer.append(chunkData + chunkSlotSize * slot, chunkSizes[slot]);
+		}
+
+		if (progress)
+			progress->encodedRowCount = min((firstBand + waveSize) * bandRowCount, height);
+	}
+
+	byte zlibFooter[4];
+	StoreBE32(zlibFooter, adler);
+	writer.appendChunk(ChunkIDAT, zlibFooter, sizeof(zlibFooter));
+
+	if (zlibOffset <= uint32(-1))
+		writer.appendChunk(ChunkpnSG, segmentTable, 4 + bandCount * 4);
+	writer.appendChunk(ChunkIEND, nullptr, 0);
+
+	dataSize = writer.size;
+	return true;
+}
+
+// Decoder ==================================================================================//
+
+namespace
+{
+	struct PngInfo
+	{
+		uint32 width, height;
+		uint32 bitDepth;
+		uint32 colorType;
+		bool interlaced;
+		uint32 bitsPerPixel;
+		uint32 filterStride;	// Bytes per pixel rounded up.
+
+		uint32 palette[256];	// RGBA with transparency applied.
+		bool hasPalette;
+		bool hasColorKey;
+		uint32 colorKey[3];		// Transparent gray or RGB value at image bit depth.
+	};
+
+	struct PngPass
+	{
+		uint32 width, height;
+		uint32 rowSize;
+		uintptr offset;			// Of filtered data.
+		uint32 xStart, yStart;
+		uint32 xStep, yStep;
+	};
+
+	struct PngFile
+	{
+		PngInfo info;
+		const byte *zlibData;
+		uintptr zlibSize;
+		HeapPtr<byte> zlibBuffer;	// Concatenated data of multiple IDAT chunks.
+		const byte *segmentTable;
+		uint32 segmentTableSize;
+	};
+}
+
+static bool ParseHeader(const byte* data, uint32 size, PngInfo& info)
+{
+	if (size != 13)
+		return false;
+
+	info.width = LoadBE32(data);
+	info.height = LoadBE32(data + 4);
+	info.bitDepth = data[8];
+	info.colorType = data[9];
+	info.interlaced = data[12] == 1;
+
+	if (!info.width || !info.height || info.width > MaxImageDimension || info.height > MaxImageDimension ||
+		data[10] != 0 || data[11] != 0 || data[12] > 1)
+	{
+		return false;
+	}
+
+	uint32 channelCount = 0;
+	bool validDepth = false;
+	switch (info.colorType)
+	{
+		case ColorTypeGray:
+			channelCount = 1;
+			validDepth = info.bitDepth == 1 || info.bitDepth == 2 || info.bitDepth == 4 || info.bitDepth == 8 || info.bitDepth == 16;
+			break;
+		case ColorTypePalette:
+			channelCount = 1;
+			validDepth = info.bitDepth == 1 || info.bitDepth == 2 || info.bitDepth == 4 || info.bitDepth == 8;
+			break;
+		case ColorTypeRGB:		channelCount = 3; validDepth = info.bitDepth == 8 || info.bitDepth == 16; break;
+		case ColorTypeGrayAlpha:	channelCount = 2; validDepth = info.bitDepth == 8 || info.bitDepth == 16; break;
+		case ColorTypeRGBA:		channelCount = 4; validDepth = info.bitDepth == 8 || info.bitDepth == 16; break;
+	}
+	if (!validDepth)
+		return false;
+
+	info.bitsPerPixel = channelCount * info.bitDepth;
+	info.filterStride = max<uint32>(info.bitsPerPixel / 8, 1);
+	return true;
+}
+
+static bool ParseFile(const byte* data, uintptr dataSize, PngFile& file)
+{
+	PngInfo &info = file.info;
+	info.hasPalette = false;
+	info.hasColorKey = false;
+	for (uint32& color : info.palette)
+		color = 0xFF000000;
+
+	file.segmentTable = nullptr;
+	file.segmentTableSize = 0;
+
+	if (!PngCodec::IsPng(data, dataSize))
+		return false;
+
+	const byte *firstIDAT = nullptr;
+	uintptr idatSize = 0;
+	uint32 idatCount = 0;
+	bool headerFound = false, endFound = false;
+
+	uintptr offset = sizeof(PngSignature);
+	while (!endFound && dataSize - offset >= 12)
+	{
+		uint32 chunkSize = LoadBE32(data + offset);
+		uint32 chunkType = LoadBE32(data + offset + 4);
+		const byte *chunkData = data + offset + 8;
+		if (chunkSize > dataSize - offset - 12)
+			return false;
+		offset += uintptr(chunkSize) + 12;
+
+		if (!headerFound)
+		{
+			if (chunkType != ChunkIHDR || !ParseHeader(chunkData, chunkSize, info))
+				return false;
+			headerFound = true;
+			continue;
+		}
+
+		switch (chunkType)
+		{
+			case ChunkPLTE:
+			{
+				if (chunkSize % 3 || chunkSize > 256 * 3)
+					return false;
+				for (uint32 i = 0; i < chunkSize / 3; i++)
+				{
+					const byte *color = chunkData + i * 3;
+					info.palette[i] = uint32(color[0]) | (uint32(color[1]) << 8) |
+						(uint32(color[2]) << 16) | (info.palette[i] & 0xFF000000);
+				}
+				info.hasPalette = true;
+				break;
+			}
+
+			case ChunktRNS:
+				if (info.colorType == ColorTypePalette)
+				{
+					if (chunkSize > 256)
+						return false;
+					for (uint32 i = 0; i < chunkSize; i++)
+						info.palette[i] = (info.palette[i] & 0x00FFFFFF) | (uint32(chunkData[i]) << 24);
+				}
+				else if (info.colorType == ColorTypeGray && chunkSize == 2)
+				{
+					info.colorKey[0] = LoadBE16(chunkData);
+					info.hasColorKey = true;
+				}
+				else if (info.colorType == ColorTypeRGB && chunkSize == 6)
+				{
+					for (uint32 i = 0; i < 3; i++)
+						info.colorKey[i] = LoadBE16(chunkData + i * 2);
+					info.hasColorKey = true;
+				}
+				break;
+
+			case ChunkIDAT:
+				if (!firstIDAT)
+					firstIDAT = chunkData;
+				idatSize += chunkSize;
+				idatCount++;
+				break;
+
+			case ChunkpnSG:
+				file.segmentTable = chunkData;
+				file.segmentTableSize = chunkSize;
+				break;
+
+			case ChunkIEND:
+				endFound = true;
+				break;
+
+			default:
+				// Unknown critical chunk.
+				if (!(chunkType & 0x20000000))
+					return false;
+				break;
+		}
+	}
+
+	if (!headerFound || !idatSize || (info.colorType == ColorTypePalette && !info.hasPalette))
+		return false;
+
+	if (idatCount == 1)
+	{
+		file.zlibData = firstIDAT;
+		file.zlibSize = idatSize;
+		return true;
+	}
+
+	// Second pass gathers data of all IDAT chunks.
+	file.zlibBuffer = HeapPtr<byte>(idatSize);
+	file.zlibData = file.zlibBuffer;
+	file.zlibSize = idatSize;
+
+	uintptr zlibOffset = 0;
+	for (offset = sizeof(PngSignature); zlibOffset < idatSize;)
+	{
+		uint32 chunkSize = LoadBE32(data + offset);
+		if (LoadBE32(data + offset + 4) == ChunkIDAT)
+		{
+			Memory::Copy(file.zlibBuffer + zlibOffset, data + offset + 8, chunkSize);
+			zlibOffset += chunkSize;
+		}
+		offset += uintptr(chunkSize) + 12;
+	}
+
+	return true;
+}
+
+static uint32 ComputePasses(const PngInfo& info, PngPass* passes)
+{
+	static constexpr uint32 adam7XStarts[7] = { 0, 4, 0, 2, 0, 1, 0 };
+	static constexpr uint32 adam7YStarts[7] = { 0, 0, 4, 0, 2, 0, 1 };
+	static constexpr uint32 adam7XSteps[7] = { 8, 8, 4, 4, 2, 2, 1 };
+	static constexpr uint32 adam7YSteps[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+	uint32 passCount = info.interlaced ? 7 : 1;
+	uintptr offset = 0;
+
+	for (uint32 i = 0; i < passCount; i++)
+	{
+		PngPass &pass = passes[i];
+		pass.xStart = info.interlaced ? adam7XStarts[i] : 0;
+		pass.yStart = info.interlaced ? adam7YStarts[i] : 0;
+		pass.xStep = info.interlaced ? adam7XSteps[i] : 1;
+		pass.yStep = info.interlaced ? adam7YSteps[i] : 1;
+		pass.width = info.width > pass.xStart ? (info.width - pass.xStart + pass.xStep - 1) / pass.xStep : 0;
+		pass.height = info.height > pass.yStart ? (info.height - pass.yStart + pass.yStep - 1) / pass.yStep : 0;
+		pass.rowSize = (pass.width * info.bitsPerPixel + 7) / 8;
+		pass.offset = offset;
+
+		// Empty passes have no filter bytes.
+		if (pass.width && pass.height)
+			offset += uintptr(pass.rowSize + 1) * pass.height;
+	}
+
+	return passCount;
+}
+
+static inline uint32 ReadSample(const byte* row, uint32 x, uint32 bitDepth)
+{
+	if (bitDepth == 8)
+		return row[x];
+	uint32 bitOffset = x * bitDepth;
+	return (row[bitOffset >> 3] >> (8 - bitDepth - (bitOffset & 7))) & ((1 << bitDepth) - 1);
+}
+
+static inline uint32 Gray(uint32 value) { return value | (value << 8) | (value << 16); }
+
+static void ConvertRow(const PngInfo& info, const byte* row, uint32 width, uint32* output)
+{
+	bool wide = info.bitDepth == 16;
+
+	switch (info.colorType)
+	{
+		case ColorTypeGray:
+		{
+			static constexpr uint32 scales[9] = { 0, 255, 85, 0, 17, 0, 0, 0, 1 };
+			for (uint32 x = 0; x < width; x++)
+			{
+				uint32 value = wide ? LoadBE16(row + x * 2) : ReadSample(row, x, info.bitDepth);
+				uint32 gray = wide ? row[x * 2] : value * scales[info.bitDepth];
+				bool transparent = info.hasColorKey && value == info.colorKey[0];
+				output[x] = Gray(gray) | (transparent ? 0 : 0xFF000000);
+			}
+			break;
+		}
+
+		case ColorTypeRGB:
+			for (uint32 x = 0; x < width; x++)
+			{
+				const byte *pixel = row + x * (wide ? 6 : 3);
+				uint32 r = wide ? LoadBE16(pixel) : pixel[0];
+				uint32 g = wide ? LoadBE16(pixel + 2) : pixel[1];
+				uint32 b = wide ? LoadBE16(pixel + 4) : pixel[2];
+				bool transparent = info.hasColorKey &&
+					r == info.colorKey[0] && g == info.colorKey[1] && b == info.colorKey[2];
+				if (wide)
+				{
+					r >>= 8;
+					g >>= 8;
+					b >>= 8;
+				}
+				output[x] = r | (g << 8) | (b << 16) | (transparent ? 0 : 0xFF000000);
+			}
+			break;
+
+		case ColorTypePalette:
+			for (uint32 x = 0; x < width; x++)
+				output[x] = info.palette[ReadSample(row, x, info.bitDepth)];
+			break;
+
+		case ColorTypeGrayAlpha:
+			for (uint32 x = 0; x < width; x++)
+			{
+				const byte *pixel = row + x * (wide ? 4 : 2);
+				output[x] = Gray(pixel[0]) | (uint32(pixel[wide ? 2 : 1]) << 24);
+			}
+			break;
+
+		case ColorTypeRGBA:
+			if (!wide)
+			{
+				Memory::Copy(output, row, width * 4);
+				break;
+			}
+			for (uint32 x = 0; x < width; x++)
+			{
+				const byte *pixel = row + x * 8;
+				output[x] = uint32(pixel[0]) | (uint32(pixel[2]) << 8) |
+					(uint32(pixel[4]) << 16) | (uint32(pixel[6]) << 24);
+			}
+			break;
+	}
+}
+
+struct SegmentDecodeContext
+{
+	const PngInfo *info;
+	const byte *deflateData;
+	uintptr deflateSize;
+	const uint32 *segmentOffsets;	// Of deflate data.
+	uint32 segmentCount;
+	uint32 segmentRowCount;
+	uint32 firstSegment;			// Buffers start at first row of this segment.
+	uint32 rowSize;
+	byte *filteredData;
+	const byte *zeroRow;
+	uint32 *pixels;
+	volatile bool failed;
+};
+
+// Segments written by encoder start with independent row, so they are inflated, unfiltered
+// and converted in parallel.
+static void DecodeSegments(void* _context, uint32 begin, uint32 end)
+{
+	SegmentDecodeContext &context = *(SegmentDecodeContext*)_context;
+	const PngInfo &info = *context.info;
+	uint32 filteredRowSize = context.rowSize + 1;
+	uint32 firstRow = context.firstSegment * context.segmentRowCount;
+
+	for (uint32 segment = context.firstSegment + begin; segment < context.firstSegment + end && !context.failed; segment++)
+	{
+		uint32 rowBegin = segment * context.segmentRowCount;
+		uint32 rowEnd = min(rowBegin + context.segmentRowCount, info.height);
+		uintptr dataBegin = context.segmentOffsets[segment];
+		uintptr dataEnd = segment + 1 < context.segmentCount ?
+			context.segmentOffsets[segment + 1] : context.deflateSize;
+
+		byte *filtered = context.filteredData + uintptr(filteredRowSize) * (rowBegin - firstRow);
+		uintptr filteredSize = uintptr(filteredRowSize) * (rowEnd - rowBegin);
+		uintptr decompressedSize = 0;
+		if (!Inflate::Decompress(context.deflateData + dataBegin, dataEnd - dataBegin,
+			filtered, filteredSize, decompressedSize) || decompressedSize != filteredSize)
+		{
+			context.failed = true;
+			return;
+		}
+
+		for (uint32 y = rowBegin; y < rowEnd; y++)
+		{
+			byte *row = filtered + uintptr(filteredRowSize) * (y - rowBegin);
+			uint32 filter = row[0];
+			if (y == rowBegin && segment > 0 && filter != FilterNone && filter != FilterSub)
+			{
+				context.failed = true;
+				return;
+			}
+
+			const byte *previousRow = y == rowBegin ? context.zeroRow : row - context.rowSize;
+			if (!UnfilterRow(row + 1, previousRow, context.rowSize, filter, info.filterStride))
+			{
+				context.failed = true;
+				return;
+			}
+			ConvertRow(info, row + 1, info.width, context.pixels + uintptr(info.width) * (y - firstRow));
+		}
+	}
+}
+
+static bool ReadSegmentTable(const PngFile& file, HeapPtr<uint32>& offsets, uint32& segmentCount, uint32& segmentRowCount)
+{
+	if (!file.segmentTable || file.info.interlaced || file.segmentTableSize < 8 || file.segmentTableSize % 4)
+		return false;
+
+	segmentRowCount = LoadBE32(file.segmentTable);
+	segmentCount = file.segmentTableSize / 4 - 1;
+	if (!segmentRowCount || segmentCount != intdivceil(file.info.height, segmentRowCount))
+		return false;
+
+	// Offsets are stored relative to zlib stream and converted to deflate data offsets.
+	offsets = HeapPtr<uint32>(segmentCount);
+	for (uint32 i = 0; i < segmentCount; i++)
+	{
+		uint32 offset = LoadBE32(file.segmentTable + 4 + i * 4);
+		if (offset < 2 || offset - 2 >= file.zlibSize - 2 || (i == 0 && offset != 2) ||
+			(i > 0 && offset - 2 <= offsets[i - 1]))
+		{
+			return false;
+		}
+		offsets[i] = offset - 2;
+	}
+	return true;
+}
+
+// zlib header: deflate with at most 32 KB window, no preset dictionary.
+static bool GetDeflateData(const PngFile& file, const byte*& deflateData, uintptr& deflateSize)
+{
+	const byte *zlibData = file.zlibData;
+	if (file.zlibSize < 2 || (zlibData[0] & 0x0F) != 8 || (zlibData[0] >> 4) > 7 ||
+		((uint32(zlibData[0]) << 8) | zlibData[1]) % 31 || (zlibData[1] & 0x20))
+	{
+		return false;
+	}
+
+	deflateData = zlibData + 2;
+	deflateSize = file.zlibSize - 2;
+	return true;
+}
+
+struct ConvertContext
+{
+	const PngInfo *info;
+	const byte *filteredData;
+	uint32 rowSize;
+	uint32 *pixels;
+};
+
+static void ConvertRows(void* _context, uint32 begin, uint32 end)
+{
+	ConvertContext &context = *(ConvertContext*)_context;
+	uint32 width = context.info->width;
+
+	for (uint32 y = begin; y < end; y++)
+	{
+		const byte *row = context.filteredData + uintptr(context.rowSize + 1) * y + 1;
+		ConvertRow(*context.info, row, width, context.pixels + uintptr(width) * y);
+	}
+}
+
+bool PngCodec::IsPng(const void* data, uintptr dataSize)
+{
+	return dataSize >= sizeof(PngSignature) && memcmp(data, PngSignature, sizeof(PngSignature)) == 0;
+}
+
+bool PngCodec::Decode(const void* data, uintptr dataSize,
+	HeapPtr<byte>& pixels, uint32& width, uint32& height)
+{
+	PngFile file;
+	const byte *deflateData = nullptr;
+	uintptr deflateSize = 0;
+	if (!ParseFile((const byte*)data, dataSize, file) || !GetDeflateData(file, deflateData, deflateSize))
+		return false;
+
+	const PngInfo &info = file.info;
+
+	PngPass passes[7];
+	uint32 passCount = ComputePasses(info, passes);
+	uintptr filteredSize = passes[passCount - 1].offset;
+	if (passes[passCount - 1].width && passes[passCount - 1].height)
+		filteredSize += uintptr(passes[passCount - 1].rowSize + 1) * passes[passCount - 1].height;
+
+	uint32 rowSize = passes[0].rowSize;
+	if (info.interlaced)
+		rowSize = (info.width * info.bitsPerPixel + 7) / 8;
+
+	HeapPtr<byte> filteredData(filteredSize);
+	HeapPtr<byte> zeroRow(rowSize);
+	Memory::Set(zeroRow, 0, rowSize);
+	pixels.resize(uintptr(info.width) * info.height * 4);
+	uint32 *outputPixels = to<uint32*>(pixels);
+
+	HeapPtr<uint32> segmentOffsets;
+	uint32 segmentCount = 0, segmentRowCount = 0;
+	if (ReadSegmentTable(file, segmentOffsets, segmentCount, segmentRowCount))
+	{
+		SegmentDecodeContext context = {};
+		context.info = &info;
+		context.deflateData = deflateData;
+		context.deflateSize = deflateSize;
+		context.segmentOffsets = segmentOffsets;
+		context.segmentCount = segmentCount;
+		context.segmentRowCount = segmentRowCount;
+		context.firstSegment = 0;
+		context.rowSize = rowSize;
+		context.filteredData = filteredData;
+		context.zeroRow = zeroRow;
+		context.pixels = outputPixels;
+		context.failed = false;
+
+		WorkerPool::Global.parallelFor(segmentCount, 1, DecodeSegments, &context);
+		if (!context.failed)
+		{
+			width = info.width;
+			height = info.height;
+			return true;
+		}
+	}
+
+	uintptr decompressedSize = 0;
+	if (!Inflate::Decompress(deflateData, deflateSize, filteredData, filteredSize, decompressedSize) ||
+		decompressedSize != filteredSize)
+	{
+		return false;
+	}
+
+	for (uint32 i = 0; i < passCount; i++)
+	{
+		const PngPass &pass = passes[i];
+		if (!pass.width || !pass.height)
+			continue;
+
+		const byte *previousRow = zeroRow;
+		for (uint32 y = 0; y < pass.height; y++)
+		{
+			byte *row = filteredData + pass.offset + uintptr(pass.rowSize + 1) * y;
+			if (!UnfilterRow(row + 1, previousRow, pass.rowSize, row[0], info.filterStride))
+				return false;
+			previousRow = row + 1;
+		}
+	}
+
+	if (!info.interlaced)
+	{
+		ConvertContext context = { &info, filteredData, rowSize, outputPixels };
+		WorkerPool::Global.parallelFor(info.height, 16, ConvertRows, &context);
+	}
+	else
+	{
+		HeapPtr<uint32> passRow(info.width);
+		for (uint32 i = 0; i < passCount; i++)
+		{
+			const PngPass &pass = passes[i];
+			if (!pass.width || !pass.height)
+				continue;
+
+			for (uint32 y = 0; y < pass.height; y++)
+			{
+				const byte *row = filteredData + pass.offset + uintptr(pass.rowSize + 1) * y + 1;
+				ConvertRow(info, row, pass.width, passRow);
+
+				uint32 *outputRow = outputPixels + uintptr(info.width) * (pass.yStart + y * pass.yStep);
+				for (uint32 x = 0; x < pass.width; x++)
+					outputRow[pass.xStart + x * pass.xStep] = passRow[x];
+			}
+		}
+	}
+
+	width = info.width;
+	height = info.height;
+	return true;
+}
+
+// PngStreamDecoder =========================================================================//
+
+static constexpr uint32 DecodeBandSize = 1 << 22;	// Pixel bytes per band of stream decode.
+
+struct PngStreamDecoder::State
+{
+	PngFile file;
+	const byte *deflateData;
+	uintptr deflateSize;
+	InflateStream stream;
+
+	HeapPtr<uint32> segmentOffsets;
+	uint32 segmentCount;
+	uint32 segmentRowCount;
+	uint32 decodedSegmentCount;
+
+	HeapPtr<byte> filteredData;
+	HeapPtr<byte> previousRow;		// Unfiltered last row of previous band.
+	HeapPtr<uint32> pixels;			// Band or whole interlaced image.
+	uint32 rowSize;
+	uint32 bandRowCount;
+	uint32 decodedRowCount;
+	bool segmented;
+	bool interlaced;
+};
+
+bool PngStreamDecoder::open(const void* data, uintptr dataSize)
+{
+	destroy();
+
+	state = Heap::Allocate<State>();
+	construct(*state);
+
+	PngFile &file = state->file;
+	if (!ParseFile((const byte*)data, dataSize, file) ||
+		!GetDeflateData(file, state->deflateData, state->deflateSize))
+	{
+		destroy();
+		return false;
+	}
+
+	const PngInfo &info = file.info;
+	state->rowSize = (info.width * info.bitsPerPixel + 7) / 8;
+	state->decodedRowCount = 0;
+	state->decodedSegmentCount = 0;
+	state->interlaced = info.interlaced;
+	state->segmented = !info.interlaced &&
+		ReadSegmentTable(file, state->segmentOffsets, state->segmentCount, state->segmentRowCount);
+
+	// Passes of interlaced image are spread over whole image, so it is decoded at once and
+	// then passed in bands.
+	if (state->interlaced)
+	{
+		HeapPtr<byte> imagePixels;
+		uint32 width = 0, height = 0;
+		if (!PngCodec::Decode(data, dataSize, imagePixels, width, height))
+		{
+			destroy();
+			return false;
+		}
+
+		state->pixels = HeapPtr<uint32>(uintptr(width) * height);
+		Memory::Copy(state->pixels, imagePixels, uintptr(width) * height * 4);
+		state->bandRowCount = clamp<uint32>(DecodeBandSize / (info.width * 4), 1, info.height);
+		return true;
+	}
+
+	if (state->segmented)
+	{
+		uint32 waveSegmentCount = min(WorkerPool::Global.getConcurrency(), state->segmentCount);
+		state->bandRowCount = min(state->segmentRowCount * waveSegmentCount, info.height);
+	}
+	else
+	{
+		state->bandRowCount = clamp<uint32>(DecodeBandSize / (info.width * 4), 1, info.height);
+		state->stream.initialize(state->deflateData, state->deflateSize);
+	}
+
+	state->filteredData = HeapPtr<byte>(uintptr(state->rowSize + 1) * state->bandRowCount);
+	state->previousRow = HeapPtr<byte>(state->rowSize);
+	state->pixels = HeapPtr<uint32>(uintptr(info.width) * state->bandRowCount);
+	Memory::Set(state->previousRow, 0, state->rowSize);
+
+	return true;
+}
+
+void PngStreamDecoder::destroy()
+{
+	if (state)
+	{
+		state->~State();
+		Heap::Release(state);
+		state = nullptr;
+	}
+}
+
+bool PngStreamDecoder::decodeBand(BandSink sink, void* sinkContext)
+{
+	const PngInfo &info = state->file.info;
+	uint32 firstRow = state->decodedRowCount;
+	uint32 rowCount = min(state->bandRowCount, info.height - firstRow);
+	if (!rowCount)
+		return true;
+
+	if (state->interlaced)
+	{
+		sink(sinkContext, firstRow, rowCount, state->pixels + uintptr(info.width) * firstRow);
+		state->decodedRowCount += rowCount;
+		return true;
+	}
+
+	if (state->segmented)
+	{
+		SegmentDecodeContext context = {};
+		context.info = &info;
+		context.deflateData = state->deflateData;
+		context.deflateSize = state->deflateSize;
+		context.segmentOffsets = state->segmentOffsets;
+		context.segmentCount = state->segmentCount;
+		context.segmentRowCount = state->segmentRowCount;
+		context.firstSegment = state->decodedSegmentCount;
+		context.rowSize = state->rowSize;
+		context.filteredData = state->filteredData;
+		context.zeroRow = state->previousRow;
+		context.pixels = state->pixels;
+		context.failed = false;
+
+		uint32 waveSegmentCount = intdivceil(rowCount, state->segmentRowCount);
+		WorkerPool::Global.parallelFor(waveSegmentCount, 1, DecodeSegments, &context);
+		if (!context.failed)
+		{
+			state->decodedSegmentCount += waveSegmentCount;
+			sink(sinkContext, firstRow, rowCount, state->pixels);
+			state->decodedRowCount += rowCount;
+			return true;
+		}
+
+		// Segment table does not match data. Same as in PngCodec::Decode whole stream is
+		// inflated sequentially, rows that were already passed to sink are skipped.
+		state->segmented = false;
+		state->stream.initialize(state->deflateData, state->deflateSize);
+		for (uint32 skippedRowCount = 0; skippedRowCount < firstRow;)
+		{
+			uint32 skipCount = min(state->bandRowCount, firstRow - skippedRowCount);
+			if (!readStreamRows(skipCount))
+				return false;
+			skippedRowCount += skipCount;
+		}
+	}
+
+	if (!readStreamRows(rowCount))
+		return false;
+
+	ConvertContext context = { &info, state->filteredData, state->rowSize, state->pixels };
+	WorkerPool::Global.parallelFor(rowCount, 16, ConvertRows, &context);
+
+	sink(sinkContext, firstRow, rowCount, state->pixels);
+	state->decodedRowCount += rowCount;
+	return true;
+}
+
+// Inflates and unfilters next rows of sequential stream. Last row is kept for next call.
+bool PngStreamDecoder::readStreamRows(uint32 rowCount)
+{
+	uint32 filteredRowSize = state->rowSize + 1;
+	uintptr filteredSize = uintptr(filteredRowSize) * rowCount;
+	uintptr readSize = 0;
+	if (!state->stream.read(state->filteredData, filteredSize, readSize) || readSize != filteredSize)
+		return false;
+
+	const byte *previousRow = state->previousRow;
+	for (uint32 y = 0; y < rowCount; y++)
+	{
+		byte *row = state->filteredData + uintptr(filteredRowSize) * y;
+		if (!UnfilterRow(row + 1, previousRow, state->rowSize, row[0], state->file.info.filterStride))
+			return false;
+		previousRow = row + 1;
+	}
+	Memory::Copy(state->previousRow, previousRow, state->rowSize);
+	return true;
+}
+
+uint32 PngStreamDecoder::getWidth() const { return state->file.info.width; }
+uint32 PngStreamDecoder::getHeight() const { return state->file.info.height; }
+uint32 PngStreamDecoder::getDecodedRowCount() const { return state->decodedRowCount; }
+
+// Benchmark ================================================================================//
+
+void PngCodec::RunBenchmark()
+{
+	static constexpr uint32 iterationCount = 2;
+
+	uint32 maxWidth = Benchmark::MaxImageWidth;
+	uint32 maxHeight = Benchmark::MaxImageHeight;
+	HeapPtr<uint32> image(Benchmark::MaxImagePixelCount);
+
+	// Painting like content: gradients with noise, flat strokes and transparent areas.
+	Random random(1);
+	for (uint32 y = 0; y < maxHeight; y++)
+	{
+		for (uint32 x = 0; x < maxWidth; x++)
+		{
+			uint32 region = ((x >> 9) + (y >> 8)) % 4;
+			uint32 noise = random.getU16() & 0x7;
+			uint32 color = 0;
+			if (region == 1)
+				color = 0xFF000000 | (((x >> 4) + noise) & 0xFF) | ((((y >> 4) + noise) & 0xFF) << 8) | 0x400000;
+			else if (region == 2)
+				color = 0xFF3080C0;
+			else if (region == 3)
+				color = (((x + y) & 0xFF) << 24) | 0x2020F0;
+			image[uintptr(maxWidth) * y + x] = color;
+		}
+	}
+
+	Benchmark::LogHeader("PNG codec");
+
+	for (const BenchmarkImageSize &imageSize : Benchmark::ImageSizes)
+	{
+		uint32 width = imageSize.size.x;
+		uint32 height = imageSize.size.y;
+		float64 byteCount = float64(width) * float64(height) * 4.0;
+
+		HeapPtr<byte> data;
+		uintptr dataSize = 0;
+		for (uint32 parallel = 0; parallel < 2; parallel++)
+		{
+			auto kernel = [&]() { Encode(image, maxWidth * 4, width, height, data, dataSize, parallel != 0); };
+			float32 time = Benchmark::MeasureTime(iterationCount, kernel);
+			Benchmark::LogResult(time, 0.0, byteCount, "%s, encode %s", imageSize.name,
+				parallel ? "parallel" : "sequential");
+		}
+
+		HeapPtr<byte> decodedPixels;
+		uint32 decodedWidth = 0, decodedHeight = 0;
+		bool decoded = false;
+		auto kernel = [&]() { decoded = Decode(data, dataSize, decodedPixels, decodedWidth, decodedHeight); };
+		float32 decodeTime = Benchmark::MeasureTime(1, kernel);
+		Benchmark::LogResult(decodeTime, 0.0, byteCount, "%s, decode", imageSize.name);
+
+		bool valid = decoded && decodedWidth == width && decodedHeight == height;
+		for (uint32 y = 0; valid && y < height; y++)
+		{
+			valid = memcmp(to<uint32*>(decodedPixels) + uintptr(width) * y,
+				image + uintptr(maxWidth) * y, width * 4) == 0;
+		}
+
+		Benchmark::Log("  %s, ratio %.3f, %s", imageSize.name,
+			float64(dataSize) / byteCount, valid ? "roundtrip ok" : "ROUNDTRIP FAILED");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Heap.h>
+
+namespace Panter
+{
+	// PNG codec for straight alpha RGBA8 images. Encoder splits image into row bands that are
+	// filtered and deflated independently on worker pool and stored as separate IDAT chunks.
+	// First row of every band uses filter that does not depend on previous row and band
+	// offsets are stored in private 'pnSG' chunk, so such images are decoded in parallel too.
+	// Other images are inflated sequentially.
+
+	// Shared with thread running encoder.
+
+	struct PngEncodeProgress
+	{
+		volatile uint32 encodedRowCount;
+		volatile bool cancelled;	// Set by other thread to stop encoding.
+	};
+
+	struct PngCodec abstract final
+	{
+		static bool IsPng(const void* data, uintptr dataSize);
+
+		// Returns whole file in data buffer. Returns false if encoding was cancelled.
+		static bool Encode(const void* pixels, uint32 pixelsStride, uint32 width, uint32 height,
+			XLib::HeapPtr<byte>& data, uintptr& dataSize, bool parallel = true,
+			PngEncodeProgress* progress = nullptr);
+
+		// Any valid PNG: all color types, bit depths and interlacing. 16 bit channels are
+		// truncated, transparency chunk is applied.
+		static bool Decode(const void* data, uintptr dataSize,
+			XLib::HeapPtr<byte>& pixels, uint32& width, uint32& height);
+
+		// Logs encode and decode throughput at 4k and 8k, sequential and on worker pool.
+		static void RunBenchmark();
+	};
+
+	// Decodes image in bands of rows, so only one band of pixels is held in memory. Images
+	// written by encoder are decoded few segments at once in parallel, others are inflated
+	// as stream. Interlaced images can't be split into bands and are decoded whole on open.
+
+	class PngStreamDecoder : public XLib::NonCopyable
+	{
+	public:
+		// Pixels are straight alpha RGBA8, rows are passed in top to bottom order.
+		using BandSink = void(*)(void* context, uint32 firstRow, uint32 rowCount, const uint32* pixels);
+
+	private:
+		struct State;
+
+		State *state = nullptr;
+
+		bool readStreamRows(uint32 rowCount);
+
+	public:
+		PngStreamDecoder() = default;
+		inline ~PngStreamDecoder() { destroy(); }
+
+		// Data is referenced until decoder is destroyed.
+		bool open(const void* data, uintptr dataSize);
+		void destroy();
+
+		// Returns false on corrupt data.
+		bool decodeBand(BandSink sink, void* sinkContext);
+
+		uint32 getWidth() const;
+		uint32 getHeight() const;
+		uint32 getDecodedRowCount() const;
+		inline bool isFinished() const { return getDecodedRowCount() == getHeight(); }
+		inline bool isOpen() const { return state != nullptr; }
+	};
+}
\ No newline at end of file
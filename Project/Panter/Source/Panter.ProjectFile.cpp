@@ -0,0 +1,335 @@
+#include <XLib.Memory.h>
+#include <XLib.Util.h>
+#include <XLib.Crypto.CRC.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "Panter.ProjectFile.h"
+
+#include "Panter.TileCodec.h"
+#include "Panter.Compositor.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr uint64 ProjectFileMagic = 0x0000'5245'544E'4150;	// "PANTER"
+static constexpr uint32 ProjectFileVersion = 1;
+
+static uint32 ComputeHeaderCRC(ProjectFileHeader header)
+{
+	header.headerCRC = 0;
+	return CRC32::Compute(header);
+}
+
+static uint32 ComputeTileCount(uint32x2 canvasSize)
+{
+	return ((canvasSize.x + LayerTileSize - 1) >> LayerTileSizeLog2) *
+		((canvasSize.y + LayerTileSize - 1) >> LayerTileSizeLog2);
+}
+
+// ProjectFileWriter ========================================================================//
+
+struct CompressBatchContext
+{
+	const uint32 *pixels;
+	byte *compressedData;
+	uint32 *compressedSizes;
+};
+
+static void CompressBatchTiles(void* _context, uint32 begin, uint32 end)
+{
+	CompressBatchContext &context = *(CompressBatchContext*)_context;
+
+	for (uint32 i = begin; i < end; i++)
+	{
+		context.compressedSizes[i] = TileCodec::Compress(
+			context.pixels + uintptr(i) * TileCodec::TilePixelCount,
+			context.compressedData + uintptr(i) * TileCodec::MaxCompressedSize);
+	}
+}
+
+void ProjectFileWriter::waitForBatchWrite(uint32 bufferIndex)
+{
+	while (batchWritePending[bufferIndex])
+	{
+		FileIOCompletion completion;
+		if (!ioQueue.takeCompletion(completion))
+			break;
+
+		batchWritePending[completion.userData] = false;
+		if (!completion.succeeded)
+			failed = true;
+	}
+}
+
+// Tiles are compressed to fixed size slots and then packed, so whole batch goes to file with
+// single write.
+void ProjectFileWriter::flushBatch()
+{
+	if (!batchTileCount)
+		return;
+
+	byte *compressedData = batchCompressedData[batchBufferIndex];
+	waitForBatchWrite(batchBufferIndex);
+
+	CompressBatchContext context = { batchPixels, compressedData, batchCompressedSizes };
+	WorkerPool::Global.parallelFor(batchTileCount, 1, CompressBatchTiles, &context);
+
+	uintptr packedSize = 0;
+	for (uint32 i = 0; i < batchTileCount; i++)
+	{
+		const byte *compressedTile = compressedData + uintptr(i) * TileCodec::MaxCompressedSize;
+		uint32 compressedSize = batchCompressedSizes[i];
+
+		ProjectFileTileRecord &record = tileRecords[batchRecordIndices[i]];
+		record.offset = dataSize + packedSize;
+		record.size = compressedSize;
+		record.crc = CRC32::Compute(compressedTile, compressedSize);
+
+		Memory::Move(compressedData + packedSize, compressedTile, compressedSize);
+		packedSize += compressedSize;
+	}
+
+	if (!failed)
+	{
+		ioQueue.submitWrite(file, dataSize, compressedData, packedSize, batchBufferIndex);
+		batchWritePending[batchBufferIndex] = true;
+	}
+	dataSize += packedSize;
+
+	batchTileCount = 0;
+	batchBufferIndex ^= 1;
+}
+
+bool ProjectFileWriter::open(const wchar* filename, uint32x2 canvasSize,
+	uint16 layerCount, uint16 currentLayer)
+{
+	if (!file.open(filename, FileAccessMode::Write, FileOpenMode::Override))
+		return false;
+
+	indexHeader.canvasSize = canvasSize;
+	indexHeader.tileSizeLog2 = LayerTileSizeLog2;
+	indexHeader.layerCount = layerCount;
+	indexHeader.currentLayer = currentLayer;
+
+	tileCount = ComputeTileCount(canvasSize);
+	tileRecords = HeapPtr<ProjectFileTileRecord>(uintptr(tileCount) * layerCount);
+	layerRecords = HeapPtr<ProjectFileLayerRecord>(layerCount);
+	Memory::Set(tileRecords, 0, uintptr(tileCount) * layerCount * sizeof(ProjectFileTileRecord));
+	Memory::Set(layerRecords, 0, layerCount * sizeof(ProjectFileLayerRecord));
+
+	batchPixels = HeapPtr<uint32>(batchTileLimit * TileCodec::TilePixelCount);
+	batchCompressedData[0] = HeapPtr<byte>(batchTileLimit * TileCodec::MaxCompressedSize);
+	batchCompressedData[1] = HeapPtr<byte>(batchTileLimit * TileCodec::MaxCompressedSize);
+	batchCompressedSizes = HeapPtr<uint32>(batchTileLimit);
+	batchRecordIndices = HeapPtr<uint32>(batchTileLimit);
+	batchTileCount = 0;
+	batchBufferIndex = 0;
+	batchWritePending[0] = false;
+	batchWritePending[1] = false;
+	ioQueue.initialize(2);
+
+	// Header is rewritten by finish().
+	ProjectFileHeader header = {};
+	dataSize = sizeof(header);
+	failed = !file.write(header);
+
+	return !failed;
+}
+
+void ProjectFileWriter::writeLayerInfo(uint16 layerIndex, const ProjectFileLayerInfo& info)
+{
+	ProjectFileLayerRecord &record = layerRecords[layerIndex];
+
+	uint32 nameLength = 0;
+	while (info.name && info.name[nameLength] && nameLength < ProjectFileLayerRecord::NameLength - 1)
+		nameLength++;
+	Memory::Set(record.name, 0, sizeof(record.name));
+	Memory::Copy(record.name, info.name, nameLength);
+
+	record.flags = info.visible ? ProjectFileLayerRecord::VisibleFlag : 0;
+}
+
+uint32* ProjectFileWriter::allocateTile(uint16 layerIndex, uint32 tileIndex)
+{
+	if (batchTileCount == batchTileLimit)
+		flushBatch();
+
+	batchRecordIndices[batchTileCount] = uint32(layerIndex) * tileCount + tileIndex;
+	return batchPixels + uintptr(batchTileCount++) * TileCodec::TilePixelCount;
+}
+
+void ProjectFileWriter::writeUniformTile(uint16 layerIndex, uint32 tileIndex, Color color)
+{
+	ProjectFileTileRecord &record = tileRecords[uint32(layerIndex) * tileCount + tileIndex];
+	record.offset = 0;
+	record.size = 0;
+	record.crc = color.rgba;
+}
+
+bool ProjectFileWriter::finish()
+{
+	flushBatch();
+	waitForBatchWrite(0);
+	waitForBatchWrite(1);
+	ioQueue.destroy();
+
+	uint32 layerCount = indexHeader.layerCount;
+	uint32 layerRecordsSize = layerCount * sizeof(ProjectFileLayerRecord);
+	uint32 tileRecordsSize = layerCount * tileCount * sizeof(ProjectFileTileRecord);
+
+	CRC32 indexCRC;
+	indexCRC.process(indexHeader);
+	indexCRC.process(layerRecords, layerRecordsSize);
+	indexCRC.process(tileRecords, tileRecordsSize);
+
+	// Index is aligned, so its records can be accessed directly in mapped file.
+	uint64 zero = 0;
+	uint32 paddingSize = uint32(-sint64(dataSize) & 7);
+	if (!failed)
+		failed = file.setPosition(dataSize) != dataSize;
+	if (!failed && paddingSize)
+		failed = !file.write(&zero, paddingSize);
+	dataSize += paddingSize;
+
+	if (!failed)
+	{
+		failed = !file.write(indexHeader) ||
+			!file.write(layerRecords, layerRecordsSize) ||
+			!file.write(tileRecords, tileRecordsSize);
+	}
+
+	ProjectFileHeader header = {};
+	header.magic = ProjectFileMagic;
+	header.version = ProjectFileVersion;
+	header.indexOffset = dataSize;
+	header.indexSize = sizeof(indexHeader) + layerRecordsSize + tileRecordsSize;
+	header.indexCRC = indexCRC.getValue();
+	header.headerCRC = ComputeHeaderCRC(header);
+
+	// Header is written only after everything else reached the file.
+	if (!failed)
+	{
+		file.flush();
+		failed = file.setPosition(0) != 0 || !file.write(header);
+	}
+
+	file.close();
+	tileRecords.release();
+	layerRecords.release();
+	batchPixels.release();
+	batchCompressedData[0].release();
+	batchCompressedData[1].release();
+	batchCompressedSizes.release();
+	batchRecordIndices.release();
+
+	return !failed;
+}
+
+// ProjectFileReader ========================================================================//
+
+bool ProjectFileReader::open(const wchar* filename)
+{
+	close();
+
+	if (!mapping.open(filename))
+		return false;
+
+	const byte *data = to<const byte*>(mapping.getData());
+	uint64 size = mapping.getSize();
+
+	if (size < sizeof(ProjectFileHeader))
+	{
+		close();
+		return false;
+	}
+
+	ProjectFileHeader header;
+	Memory::Copy(&header, data, sizeof(header));
+	if (header.magic != ProjectFileMagic || header.version != ProjectFileVersion ||
+		header.headerCRC != ComputeHeaderCRC(header) ||
+		header.indexOffset < sizeof(header) || header.indexSize < sizeof(ProjectFileIndexHeader) ||
+		header.indexOffset + header.indexSize > size)
+	{
+		close();
+		return false;
+	}
+
+	const byte *index = data + header.indexOffset;
+	if (CRC32::Compute(index, header.indexSize) != header.indexCRC)
+	{
+		close();
+		return false;
+	}
+
+	const ProjectFileIndexHeader *_indexHeader = to<const ProjectFileIndexHeader*>(index);
+	uint32 _tileCount = ComputeTileCount(_indexHeader->canvasSize);
+	uint64 expectedIndexSize = sizeof(ProjectFileIndexHeader) +
+		uint64(_indexHeader->layerCount) * sizeof(ProjectFileLayerRecord) +
+		uint64(_indexHeader->layerCount) * _tileCount * sizeof(ProjectFileTileRecord);
+
+	if (_indexHeader->tileSizeLog2 != LayerTileSizeLog2 ||
+		_indexHeader->canvasSize.x == 0 || _indexHeader->canvasSize.y == 0 ||
+		_indexHeader->layerCount == 0 || _indexHeader->layerCount > Compositor::MaxLayerCount ||
+		_indexHeader->currentLayer >= _indexHeader->layerCount ||
+		header.indexSize != expectedIndexSize)
+	{
+		close();
+		return false;
+	}
+
+	indexHeader = _indexHeader;
+	layerRecords = to<const ProjectFileLayerRecord*>(indexHeader + 1);
+	tileRecords = to<const ProjectFileTileRecord*>(layerRecords + indexHeader->layerCount);
+	tileCount = _tileCount;
+
+	// Tiles are read soon after open, so system can start loading them in background.
+	mapping.prefetch(sizeof(ProjectFileHeader), header.indexOffset - sizeof(ProjectFileHeader));
+
+	return true;
+}
+
+void ProjectFileReader::close()
+{
+	mapping.close();
+	indexHeader = nullptr;
+	layerRecords = nullptr;
+	tileRecords = nullptr;
+	tileCount = 0;
+}
+
+ProjectFileLayerInfo ProjectFileReader::getLayerInfo(uint16 layerIndex)
+{
+	const ProjectFileLayerRecord &record = layerRecords[layerIndex];
+
+	ProjectFileLayerInfo info;
+	info.name = record.name;
+	info.visible = (record.flags & ProjectFileLayerRecord::VisibleFlag) != 0;
+	return info;
+}
+
+bool ProjectFileReader::isTileUniform(uint16 layerIndex, uint32 tileIndex, Color& color)
+{
+	const ProjectFileTileRecord &record = tileRecords[uint32(layerIndex) * tileCount + tileIndex];
+	if (record.offset)
+		return false;
+
+	color.rgba = record.crc;
+	return true;
+}
+
+bool ProjectFileReader::readTile(uint16 layerIndex, uint32 tileIndex, uint32* pixels)
+{
+	const ProjectFileTileRecord &record = tileRecords[uint32(layerIndex) * tileCount + tileIndex];
+
+	if (record.offset < sizeof(ProjectFileHeader) || record.size > TileCodec::MaxCompressedSize ||
+		record.offset + record.size > mapping.getSize())
+	{
+		return false;
+	}
+
+	const byte *compressedTile = to<const byte*>(mapping.getData()) + record.offset;
+	if (CRC32::Compute(compressedTile, record.size) != record.crc)
+		return false;
+
+	return TileCodec::Decompress(compressedTile, record.size, pixels);
+}
\ No newline at end of file
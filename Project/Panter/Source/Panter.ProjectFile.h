@@ -0,0 +1,138 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Heap.h>
+#include <XLib.System.File.h>
+#include <XLib.System.FileIOQueue.h>
+
+#include "Panter.TiledLayer.h"
+
+namespace Panter
+{
+	// Native layered project container (.panter). Layout:
+	//   header | compressed tiles ... | index
+	// Index holds canvas info, layer records and offset table of every layer tile. Uniform
+	// tiles are stored in offset table only. Header, index and every tile are protected by
+	// their own CRC32. Header is written last, so interrupted save leaves invalid file.
+	// File is read through memory mapping, so tiles that are never read are never touched.
+
+	struct ProjectFileHeader
+	{
+		uint64 magic;
+		uint32 version;
+		uint32 headerCRC;	// Of header with this field zeroed.
+		uint64 indexOffset;
+		uint32 indexSize;
+		uint32 indexCRC;
+	};
+
+	struct ProjectFileIndexHeader
+	{
+		uint32x2 canvasSize;
+		uint32 tileSizeLog2;
+		uint16 layerCount;
+		uint16 currentLayer;
+	};
+
+	struct ProjectFileLayerRecord
+	{
+		static constexpr uint32 NameLength = 64;
+		static constexpr uint32 VisibleFlag = 0x1;
+
+		char name[NameLength];	// Zero terminated.
+		uint32 flags;
+		uint32 reserved;
+	};
+
+	// offset == 0 means uniform tile with color stored in crc field.
+	struct ProjectFileTileRecord
+	{
+		uint64 offset;
+		uint32 size;
+		uint32 crc;
+	};
+
+	struct ProjectFileLayerInfo
+	{
+		const char *name;
+		bool visible;
+	};
+
+	// Compressed batch is written asynchronously while next batch is filled and compressed,
+	// so there are two compressed data buffers.
+
+	class ProjectFileWriter : public XLib::NonCopyable
+	{
+	private:
+		static constexpr uint32 batchTileLimit = 64;
+
+		XLib::File file;
+		XLib::FileIOQueue ioQueue;
+		XLib::HeapPtr<ProjectFileTileRecord> tileRecords;
+		XLib::HeapPtr<ProjectFileLayerRecord> layerRecords;
+		ProjectFileIndexHeader indexHeader = {};
+		uint32 tileCount = 0;
+		uint64 dataSize = 0;
+		bool failed = false;
+
+		XLib::HeapPtr<uint32> batchPixels;
+		XLib::HeapPtr<byte> batchCompressedData[2];
+		XLib::HeapPtr<uint32> batchCompressedSizes;
+		XLib::HeapPtr<uint32> batchRecordIndices;
+		uint32 batchTileCount = 0;
+		uint32 batchBufferIndex = 0;
+		bool batchWritePending[2] = {};
+
+		void flushBatch();
+		void waitForBatchWrite(uint32 bufferIndex);
+
+	public:
+		ProjectFileWriter() = default;
+		~ProjectFileWriter() = default;
+
+		bool open(const wchar* filename, uint32x2 canvasSize, uint16 layerCount, uint16 currentLayer);
+		void writeLayerInfo(uint16 layerIndex, const ProjectFileLayerInfo& info);
+
+		// Non uniform tiles are compressed in batches on worker pool. Returned buffer must be
+		// filled with tile pixels (LayerTileSize stride) before next call.
+		uint32* allocateTile(uint16 layerIndex, uint32 tileIndex);
+		void writeUniformTile(uint16 layerIndex, uint32 tileIndex, XLib::Color color);
+
+		// Writes index and header. Returns false if anything failed.
+		bool finish();
+	};
+
+	class ProjectFileReader : public XLib::NonCopyable
+	{
+	private:
+		XLib::FileMapping mapping;
+		const ProjectFileIndexHeader *indexHeader = nullptr;
+		const ProjectFileLayerRecord *layerRecords = nullptr;
+		const ProjectFileTileRecord *tileRecords = nullptr;
+		uint32 tileCount = 0;
+
+	public:
+		ProjectFileReader() = default;
+		~ProjectFileReader() = default;
+
+		// Validates header and index. Tiles are validated when they are read.
+		bool open(const wchar* filename);
+		void close();
+
+		ProjectFileLayerInfo getLayerInfo(uint16 layerIndex);
+
+		// Returns true if tile is uniform. Transparent uniform tile means missing tile.
+		bool isTileUniform(uint16 layerIndex, uint32 tileIndex, XLib::Color& color);
+		// Checks CRC and decompresses tile. Safe to call from multiple threads.
+		bool readTile(uint16 layerIndex, uint32 tileIndex, uint32* pixels);
+
+		inline uint32x2 getCanvasSize() const { return indexHeader->canvasSize; }
+		inline uint16 getLayerCount() const { return indexHeader->layerCount; }
+		inline uint16 getCurrentLayer() const { return indexHeader->currentLayer; }
+		inline uint32 getTileCount() const { return tileCount; }
+		inline bool isOpen() const { return indexHeader != nullptr; }
+	};
+}
\ No newline at end of file
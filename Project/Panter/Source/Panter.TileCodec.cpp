@@ -0,0 +1,126 @@
+#include <XLib.Memory.h>
+#include <XLib.Util.h>
+
+#include "Panter.TileCodec.h"
+
+using namespace XLib;
+using namespace Panter;
+
+static constexpr byte OpLiteral = 0x00;
+static constexpr byte OpRepeat = 0x40;
+static constexpr byte OpCopyAbove = 0x80;
+static constexpr byte OpMask = 0xC0;
+static constexpr uint32 MaxTokenLength = 64;
+
+uint32 TileCodec::Compress(const uint32* pixels, byte* buffer)
+{
+	byte *output = buffer;
+	uint32 literalStart = 0, literalLength = 0;
+
+	auto flushLiterals = [&]()
+	{
+		while (literalLength)
+		{
+			uint32 length = min(literalLength, MaxTokenLength);
+			*output++ = byte(OpLiteral | (length - 1));
+			Memory::Copy(output, pixels + literalStart, length * 4);
+			output += length * 4;
+			literalStart += length;
+			literalLength -= length;
+		}
+	};
+
+	uint32 i = 0;
+	while (i < TilePixelCount)
+	{
+		uint32 lengthLimit = min(TilePixelCount - i, MaxTokenLength);
+
+		uint32 repeatLength = 0;
+		if (i > 0)
+		{
+			uint32 previousPixel = pixels[i - 1];
+			while (repeatLength < lengthLimit && pixels[i + repeatLength] == previousPixel)
+				repeatLength++;
+		}
+
+		uint32 copyAboveLength = 0;
+		if (i >= LayerTileSize)
+		{
+			const uint32 *above = pixels + i - LayerTileSize;
+			while (copyAboveLength < lengthLimit && pixels[i + copyAboveLength] == above[copyAboveLength])
+				copyAboveLength++;
+		}
+
+		if (!repeatLength && !copyAboveLength)
+		{
+			if (!literalLength)
+				literalStart = i;
+			literalLength++;
+			i++;
+			continue;
+		}
+
+		flushLiterals();
+
+		if (repeatLength >= copyAboveLength)
+		{
+			*output++ = byte(OpRepeat | (repeatLength - 1));
+			i += repeatLength;
+		}
+		else
+		{
+			*output++ = byte(OpCopyAbove | (copyAboveLength - 1));
+			i += copyAboveLength;
+		}
+	}
+
+	flushLiterals();
+
+	return uint32(output - buffer);
+}
+
+bool TileCodec::Decompress(const byte* data, uint32 dataSize, uint32* pixels)
+{
+	const byte *input = data;
+	const byte *inputEnd = data + dataSize;
+	uint32 i = 0;
+
+	while (input < inputEnd)
+	{
+		byte token = *input++;
+		uint32 length = (token & ~OpMask) + 1;
+		if (i + length > TilePixelCount)
+			return false;
+
+		switch (token & OpMask)
+		{
+			case OpLiteral:
+				if (uintptr(inputEnd - input) < length * 4)
+					return false;
+				Memory::Copy(pixels + i, input, length * 4);
+				input += length * 4;
+				break;
+
+			case OpRepeat:
+				if (!i)
+					return false;
+				for (uint32 j = 0; j < length; j++)
+					pixels[i + j] = pixels[i - 1];
+				break;
+
+			case OpCopyAbove:
+				if (i < LayerTileSize)
+					return false;
+				for (uint32 j = 0; j < length; j++)
+					pixels[i + j] = pixels[i + j - LayerTileSize];
+				break;
+
+			default:
+				return false;
+		}
+
+		i += length;
+	}
+
+	return i == TilePixelCount;
+}
\ No newline at end of file
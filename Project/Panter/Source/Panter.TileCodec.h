@@ -0,0 +1,21 @@
+#pragma once
+
+#include <XLib.Types.h>
+
+#include "Panter.TiledLayer.h"
+
+namespace Panter
+{
+	// Lossless codec for layer tile pixels. Stream consists of tokens with 2 bit opcode
+	// and 6 bit length: literal pixels, repeat of previous pixel or copy from row above.
+
+	struct TileCodec abstract final
+	{
+		static constexpr uint32 TilePixelCount = LayerTileSize * LayerTileSize;
+		static constexpr uint32 MaxCompressedSize = TilePixelCount * 4 + TilePixelCount / 64;
+
+		// Returns size of compressed data. Buffer must be at least MaxCompressedSize bytes.
+		static uint32 Compress(const uint32* pixels, byte* buffer);
+		static bool Decompress(const byte* data, uint32 dataSize, uint32* pixels);
+	};
+}
\ No newline at end of file
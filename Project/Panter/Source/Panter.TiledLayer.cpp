@@ -0,0 +1,596 @@
+#include <XLib.Debug.h>
+#include <XLib.Memory.h>
+
+#include "Panter.TiledLayer.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+// Returns true when all pixels of region are equal. Fully transparent pixels are all
+// treated as zero, so region of transparent pixels with garbage color results in zero.
+static bool CheckIfRegionIsUniform(const byte* data, uint32 stride, uint32x2 size, uint32& color)
+{
+	const uint32 firstPixel = *to<const uint32*>(data);
+	bool uniform = true;
+	bool transparent = true;
+
+	for (uint32 y = 0; y < size.y; y++)
+	{
+		const uint32 *row = to<const uint32*>(data + uintptr(stride) * y);
+		for (uint32 x = 0; x < size.x; x++)
+		{
+			uniform &= row[x] == firstPixel;
+			transparent &= (row[x] >> 24) == 0;
+		}
+
+		if (!uniform && !transparent)
+			return false;
+	}
+
+	color = transparent ? 0 : firstPixel;
+	return true;
+}
+
+// LayerTilePool ================================================================================//
+
+void LayerTilePool::unregisterUniform(LayerTile* tile)
+{
+	uint32 count = uniformTiles.getSize();
+	for (uint32 i = 0; i < count; i++)
+	{
+		if (uniformTiles[i] == tile)
+		{
+			uniformTiles[i] = uniformTiles[count - 1];
+			uniformTiles.dropBack();
+			break;
+		}
+	}
+
+	tile->isUniform = false;
+}
+
+void LayerTilePool::initialize(Device& device)
+{
+	this->device = &device;
+
+	device.createTextureRenderTarget(transparentTexture, LayerTileSize, LayerTileSize);
+	device.clear(transparentTexture, 0);
+}
+
+void LayerTilePool::destroy()
+{
+	for (LayerTile *tile : freeTiles)
+	{
+		tile->texture.destroy();
+		allocator.release(tile);
+		allocatedTileCount--;
+	}
+	freeTiles.clear();
+
+	transparentTexture.destroy();
+}
+
+LayerTile* LayerTilePool::allocate()
+{
+	LayerTile *tile = nullptr;
+
+	if (!freeTiles.isEmpty())
+	{
+		tile = freeTiles.popBack();
+	}
+	else
+	{
+		tile = allocator.allocate();
+		Debug::CrashCondition(!tile, DbgMsgFmt("layer tile pool exhausted"));
+
+		device->createTextureRenderTarget(tile->texture, LayerTileSize, LayerTileSize);
+		allocatedTileCount++;
+	}
+
+	tile->referenceCount = 1;
+	tile->uniformColor = 0;
+	tile->isUniform = false;
+
+	return tile;
+}
+
+LayerTile* LayerTilePool::getUniform(Color color)
+{
+	if (color.a == 0)
+		return nullptr;
+
+	for (LayerTile *tile : uniformTiles)
+	{
+		if (tile->uniformColor == color)
+		{
+			tile->referenceCount++;
+			return tile;
+		}
+	}
+
+	LayerTile *tile = allocate();
+	device->clear(tile->texture, color);
+	tile->uniformColor = color;
+	tile->isUniform = true;
+	uniformTiles.pushBack(tile);
+
+	return tile;
+}
+
+LayerTile* LayerTilePool::makeWritable(LayerTile* tile)
+{
+	if (!tile)
+	{
+		LayerTile *newTile = allocate();
+		device->clear(newTile->texture, 0);
+		return newTile;
+	}
+
+	if (tile->referenceCount == 1)
+	{
+		if (tile->isUniform)
+			unregisterUniform(tile);
+		return tile;
+	}
+
+	LayerTile *newTile = allocate();
+	if (tile->isUniform)
+	{
+		device->clear(newTile->texture, tile->uniformColor);
+	}
+	else
+	{
+		device->copyTexture(newTile->texture, tile->texture,
+			{ 0, 0 }, { 0, 0, LayerTileSize, LayerTileSize });
+	}
+
+	release(tile);
+	return newTile;
+}
+
+void LayerTilePool::release(LayerTile* tile)
+{
+	if (!tile)
+		return;
+
+	Debug::CrashCondition(!tile->referenceCount, DbgMsgFmt("layer tile is already released"));
+
+	tile->referenceCount--;
+	if (tile->referenceCount)
+		return;
+
+	if (tile->isUniform)
+		unregisterUniform(tile);
+
+	if (freeTiles.getSize() < freeTileCountLimit)
+	{
+		freeTiles.pushBack(tile);
+	}
+	else
+	{
+		tile->texture.destroy();
+		allocator.release(tile);
+		allocatedTileCount--;
+	}
+}
+
+// TiledLayer ===================================================================================//
+
+TiledLayer::TiledLayer(TiledLayer&& that) : pool(that.pool), tiles(move(that.tiles)),
+	size(that.size), gridSize(that.gridSize)
+{
+	that.pool = nullptr;
+	that.size = { 0, 0 };
+	that.gridSize = { 0, 0 };
+}
+
+TiledLayer& TiledLayer::operator = (TiledLayer&& that)
+{
+	swap(pool, that.pool);
+	swap(tiles, that.tiles);
+	swap(size, that.size);
+	swap(gridSize, that.gridSize);
+	return *this;
+}
+
+void TiledLayer::initialize(LayerTilePool& pool, uint32x2 size)
+{
+	destroy();
+
+	this->pool = &pool;
+	this->size = size;
+	this->gridSize =
+	{
+		(size.x + LayerTileSize - 1) >> LayerTileSizeLog2,
+		(size.y + LayerTileSize - 1) >> LayerTileSizeLog2,
+	};
+
+	tiles = HeapPtr<LayerTile*>(getTileCount());
+	Memory::Set(tiles, 0, getTileCount() * sizeof(LayerTile*));
+}
+
+void TiledLayer::initializeShared(TiledLayer& source)
+{
+	initialize(*source.pool, source.size);
+
+	uint32 tileCount = getTileCount();
+	for (uint32 i = 0; i < tileCount; i++)
+	{
+		tiles[i] = source.tiles[i];
+		if (tiles[i])
+			pool->addReference(tiles[i]);
+	}
+}
+
+void TiledLayer::destroy()
+{
+	if (!pool)
+		return;
+
+	uint32 tileCount = getTileCount();
+	for (uint32 i = 0; i < tileCount; i++)
+		pool->release(tiles[i]);
+	tiles.release();
+
+	pool = nullptr;
+	size = { 0, 0 };
+	gridSize = { 0, 0 };
+}
+
+void TiledLayer::resize(const rects32& newRect, Color fillColor)
+{
+	Device &device = pool->getDevice();
+
+	TiledLayer newLayer;
+	newLayer.initialize(*pool, uint32x2(newRect.getSize()));
+
+	// Region of new layer that receives old contents.
+	rectu32 contentsRegion(
+		uint32(clamp<sint32>(-newRect.left, 0, newRect.getWidth())),
+		uint32(clamp<sint32>(-newRect.top, 0, newRect.getHeight())),
+		uint32(clamp<sint32>(sint32(size.x) - newRect.left, 0, newRect.getWidth())),
+		uint32(clamp<sint32>(sint32(size.y) - newRect.top, 0, newRect.getHeight())));
+
+	bool tileAligned =
+		(newRect.left & (LayerTileSize - 1)) == 0 &&
+		(newRect.top & (LayerTileSize - 1)) == 0;
+
+	for (uint32 y = 0; y < newLayer.gridSize.y; y++)
+	{
+		for (uint32 x = 0; x < newLayer.gridSize.x; x++)
+		{
+			uint32x2 tileCoords(x, y);
+			rectu32 tileRect = newLayer.getTileRect(tileCoords);
+			rectu32 tileContentsRegion = IntersectRects(tileRect, contentsRegion);
+			bool coveredWithContents = tileContentsRegion.leftTop == tileRect.leftTop &&
+				tileContentsRegion.rightBottom == tileRect.rightBottom;
+
+			if (IsEmptyRect(tileContentsRegion))
+			{
+				newLayer.setTile(tileCoords, pool->getUniform(fillColor));
+				continue;
+			}
+
+			// Old layer region that maps to the new tile contents.
+			rectu32 srcRegion(
+				uint32(sint32(tileContentsRegion.left) + newRect.left),
+				uint32(sint32(tileContentsRegion.top) + newRect.top),
+				uint32(sint32(tileContentsRegion.right) + newRect.left),
+				uint32(sint32(tileContentsRegion.bottom) + newRect.top));
+			rectu32 srcTileRange = getTileRange(srcRegion);
+
+			if (coveredWithContents && tileAligned)
+			{
+				// Tile grids match, so tile can be shared.
+				LayerTile *srcTile = getTile(srcTileRange.leftTop);
+				if (srcTile)
+					pool->addReference(srcTile);
+				newLayer.setTile(tileCoords, srcTile);
+				continue;
+			}
+
+			bool srcTilesEmpty = true;
+			for (uint32 srcY = srcTileRange.top; srcY < srcTileRange.bottom; srcY++)
+			{
+				for (uint32 srcX = srcTileRange.left; srcX < srcTileRange.right; srcX++)
+				{
+					if (getTile(uint32x2(srcX, srcY)))
+						srcTilesEmpty = false;
+				}
+			}
+
+			if (srcTilesEmpty && (coveredWithContents || fillColor.a == 0))
+			{
+				if (!coveredWithContents)
+					newLayer.setTile(tileCoords, pool->getUniform(fillColor));
+				continue;
+			}
+
+			LayerTile *dstTile = pool->allocate();
+			device.clear(dstTile->texture, coveredWithContents ? Color(0) : fillColor);
+
+			for (uint32 srcY = srcTileRange.top; srcY < srcTileRange.bottom; srcY++)
+			{
+				for (uint32 srcX = srcTileRange.left; srcX < srcTileRange.right; srcX++)
+				{
+					uint32x2 srcTileCoords(srcX, srcY);
+					rectu32 srcTileRect = getTileRect(srcTileCoords);
+					rectu32 copiedRegion = IntersectRects(srcTileRect, srcRegion);
+					if (IsEmptyRect(copiedRegion))
+						continue;
+
+					LayerTile *srcTile = getTile(srcTileCoords);
+					if (!srcTile && coveredWithContents)
+						continue;
+
+					uint32x2 dstLocation(
+						uint32(sint32(copiedRegion.left) - newRect.left) - tileRect.left,
+						uint32(sint32(copiedRegion.top) - newRect.top) - tileRect.top);
+
+					device.copyTexture(dstTile->texture,
+						srcTile ? srcTile->texture : pool->getTransparentTexture(),
+						dstLocation, MakeRectRelative(copiedRegion, srcTileRect.leftTop));
+				}
+			}
+
+			newLayer.setTile(tileCoords, dstTile);
+		}
+	}
+
+	*this = move(newLayer);
+}
+
+void TiledLayer::clear(Color color)
+{
+	uint32 tileCount = getTileCount();
+	for (uint32 i = 0; i < tileCount; i++)
+	{
+		pool->release(tiles[i]);
+		tiles[i] = nullptr;
+	}
+
+	LayerTile *uniformTile = pool->getUniform(color);
+	if (!uniformTile)
+		return;
+
+	for (uint32 i = 0; i < tileCount; i++)
+	{
+		pool->addReference(uniformTile);
+		tiles[i] = uniformTile;
+	}
+
+	pool->release(uniformTile);
+}
+
+void TiledLayer::upload(const rectu32& region, const void* srcData, uint32 srcDataStride)
+{
+	Device &device = pool->getDevice();
+
+	if (!srcDataStride)
+		srcDataStride = region.getWidth() * 4;
+
+	rectu32 tileRange = getTileRange(region);
+	for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+	{
+		for (uint32 x = tileRange.left; x < tileRange.right; x++)
+		{
+			uint32x2 tileCoords(x, y);
+			rectu32 tileRect = getTileRect(tileCoords);
+			rectu32 subregion = IntersectRects(tileRect, region);
+			if (IsEmptyRect(subregion))
+				continue;
+
+			const byte *subregionData = to<const byte*>(srcData) +
+				uintptr(subregion.top - region.top) * srcDataStride +
+				uintptr(subregion.left - region.left) * 4;
+
+			LayerTile *tile = getTile(tileCoords);
+
+			uint32 uniformColor = 0;
+			if (CheckIfRegionIsUniform(subregionData, srcDataStride, subregion.getSize(), uniformColor))
+			{
+				bool coversTile = subregion.leftTop == tileRect.leftTop &&
+					subregion.rightBottom == tileRect.rightBottom;
+
+				if (coversTile)
+				{
+					setTile(tileCoords, pool->getUniform(uniformColor));
+					continue;
+				}
+
+				if (!tile && uniformColor == 0)
+					continue;
+				if (tile && tile->isUniform && tile->uniformColor == uniformColor)
+					continue;
+			}
+
+			tile = getWritableTile(tileCoords);
+			device.uploadTexture(tile->texture, MakeRectRelative(subregion, tileRect.leftTop),
+				subregionData, srcDataStride);
+		}
+	}
+}
+
+void TiledLayer::download(const rectu32& region, void* dstData, uint32 dstDataStride)
+{
+	Device &device = pool->getDevice();
+
+	if (!dstDataStride)
+		dstDataStride = region.getWidth() * 4;
+
+	rectu32 tileRange = getTileRange(region);
+	for (uint32 y = tileRange.top; y < tileRange.bottom; y++)
+	{
+		for (uint32 x = tileRange.left; x < tileRange.right; x++)
+		{
+			uint32x2 tileCoords(x, y);
+			rectu32 tileRect = getTileRect(tileCoords);
+			rectu32 subregion = IntersectRects(tileRect, region);
+			if (IsEmptyRect(subregion))
+				continue;
+
+			byte *subregionData = to<byte*>(dstData) +
+				uintptr(subregion.top - region.top) * dstDataStride +
+				uintptr(subregion.left - region.left) * 4;
+
+			LayerTile *tile = getTile(tileCoords);
+			if (tile && !tile->isUniform)
+			{
+				device.downloadTexture(tile->texture, MakeRectRelative(subregion, tileRect.leftTop),
+					subregionData, dstDataStride);
+				continue;
+			}
+
+			uint32 color = tile ? tile->uniformColor.rgba : 0;
+			uint32x2 subregionSize = subregion.getSize();
+			for (uint32 row = 0; row < subregionSize.y; row++)
+			{
+				uint32 *rowData = to<uint32*>(subregionData + uintptr(dstDataStride) * row);
+				if (!color)
+				{
+					Memory::Set(rowData, 0, subregionSize.x * 4);
+					continue;
+				}
+				for (uint32 i = 0; i < subregionSize.x; i++)
+					rowData[i] = color;
+			}
+		}
+	}
+}
+
+LayerTile* TiledLayer::getWritableTile(uint32x2 tileCoords)
+{
+	LayerTile *&tile = tiles[tileCoords.y * gridSize.x + tileCoords.x];
+	tile = pool->makeWritable(tile);
+	return tile;
+}
+
+void TiledLayer::setTile(uint32x2 tileCoords, LayerTile* tile)
+{
+	LayerTile *&dstTile = tiles[tileCoords.y * gridSize.x + tileCoords.x];
+	pool->release(dstTile);
+	dstTile = tile;
+}
+
+LayerTile* TiledLayer::exchangeTile(uint32x2 tileCoords, LayerTile* tile)
+{
+	LayerTile *&dstTile = tiles[tileCoords.y * gridSize.x + tileCoords.x];
+	LayerTile *previousTile = dstTile;
+	dstTile = tile;
+	return previousTile;
+}
+
+uint32 TiledLayer::getAllocatedTileCount()
+{
+	uint32 result = 0;
+	uint32 tileCount = getTileCount();
+	for (uint32 i = 0; i < tileCount; i++)
+	{
+		if (tiles[i])
+			result++;
+	}
+	return result;
+}
+
+// DirtyRegion ==================================================================================//
+
+void DirtyRegion::addToTile(uint32 tileIndex, const rectu32& rect)
+{
+	rectu32 &tileRect = tileRects[tileIndex];
+
+	if (IsEmptyRect(tileRect))
+	{
+		tileRect = rect;
+		dirtyTiles.pushBack(tileIndex);
+		pixelCount += uint64(rect.getWidth()) * rect.getHeight();
+		return;
+	}
+
+	pixelCount -= uint64(tileRect.getWidth()) * tileRect.getHeight();
+	tileRect = rectu32(min(tileRect.left, rect.left), min(tileRect.top, rect.top),
+		max(tileRect.right, rect.right), max(tileRect.bottom, rect.bottom));
+	pixelCount += uint64(tileRect.getWidth()) * tileRect.getHeight();
+}
+
+void DirtyRegion::initialize(uint32x2 size)
+{
+	this->size = size;
+	this->gridSize =
+	{
+		(size.x + LayerTileSize - 1) >> LayerTileSizeLog2,
+		(size.y + LayerTileSize - 1) >> LayerTileSizeLog2,
+	};
+
+	uint32 tileCount = gridSize.x * gridSize.y;
+	tileRects = HeapPtr<rectu32>(tileCount);
+	for (uint32 i = 0; i < tileCount; i++)
+		tileRects[i] = rectu32(0, 0, 0, 0);
+
+	dirtyTiles.clear();
+	pixelCount = 0;
+}
+
+void DirtyRegion::add(const rectu32& rect)
+{
+	rectu32 clippedRect = IntersectRects(rect, rectu32(0, 0, size));
+	if (IsEmptyRect(clippedRect))
+		return;
+
+	uint32 tileLeft = clippedRect.left >> LayerTileSizeLog2;
+	uint32 tileTop = clippedRect.top >> LayerTileSizeLog2;
+	uint32 tileRight = (clippedRect.right + LayerTileSize - 1) >> LayerTileSizeLog2;
+	uint32 tileBottom = (clippedRect.bottom + LayerTileSize - 1) >> LayerTileSizeLog2;
+
+	for (uint32 y = tileTop; y < tileBottom; y++)
+	{
+		for (uint32 x = tileLeft; x < tileRight; x++)
+		{
+			uint32x2 tileLeftTop = uint32x2(x, y) << LayerTileSizeLog2;
+			rectu32 tileRect(tileLeftTop,
+				min(tileLeftTop.x + LayerTileSize, size.x),
+				min(tileLeftTop.y + LayerTileSize, size.y));
+
+			addToTile(y * gridSize.x + x, IntersectRects(tileRect, clippedRect));
+		}
+	}
+}
+
+void DirtyRegion::add(DirtyRegion& region)
+{
+	Debug::CrashCondition(region.gridSize != gridSize, DbgMsgFmt("dirty regions size mismatch"));
+
+	for (uint32 tileIndex : region.dirtyTiles)
+		addToTile(tileIndex, region.tileRects[tileIndex]);
+}
+
+void DirtyRegion::addAll()
+{
+	add(rectu32(0, 0, size));
+}
+
+void DirtyRegion::clear()
+{
+	for (uint32 tileIndex : dirtyTiles)
+		tileRects[tileIndex] = rectu32(0, 0, 0, 0);
+
+	dirtyTiles.clear();
+	pixelCount = 0;
+}
+
+rectu32 DirtyRegion::getBounds()
+{
+	if (dirtyTiles.isEmpty())
+		return rectu32(0, 0, 0, 0);
+
+	rectu32 bounds(uint32(-1), uint32(-1), 0, 0);
+	for (uint32 tileIndex : dirtyTiles)
+	{
+		const rectu32 &rect = tileRects[tileIndex];
+		bounds.left = min(bounds.left, rect.left);
+		bounds.top = min(bounds.top, rect.top);
+		bounds.right = max(bounds.right, rect.right);
+		bounds.bottom = max(bounds.bottom, rect.bottom);
+	}
+	return bounds;
+}
\ No newline at end of file
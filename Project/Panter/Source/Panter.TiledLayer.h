@@ -0,0 +1,195 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Vectors.Arithmetics.h>
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.PoolAllocator.h>
+#include <XLib.Containers.Vector.h>
+#include <XLib.Graphics.h>
+
+namespace Panter
+{
+	static constexpr uint32 LayerTileSizeLog2 = 8;
+	static constexpr uint32 LayerTileSize = 1 << LayerTileSizeLog2;
+
+	inline bool IsEmptyRect(const rectu32& rect)
+	{
+		return rect.left >= rect.right || rect.top >= rect.bottom;
+	}
+
+	inline rectu32 IntersectRects(const rectu32& a, const rectu32& b)
+	{
+		rectu32 result(max(a.left, b.left), max(a.top, b.top),
+			min(a.right, b.right), min(a.bottom, b.bottom));
+		return IsEmptyRect(result) ? rectu32(0, 0, 0, 0) : result;
+	}
+
+	// Left and top sides saturate at zero.
+	inline rectu32 InflateRect(const rectu32& rect, uint32 amount)
+	{
+		return rectu32(rect.left - min(rect.left, amount), rect.top - min(rect.top, amount),
+			rect.right + amount, rect.bottom + amount);
+	}
+
+	inline rectu32 MakeRectRelative(const rectu32& rect, uint32x2 origin)
+	{
+		return rectu32(rect.leftTop - origin, rect.rightBottom - origin);
+	}
+
+	// Square piece of layer contents. Tiles are reference counted and may be shared
+	// between layers and history, so contents of a tile with more than one reference
+	// or of a uniform tile must never be modified in place.
+
+	struct LayerTile
+	{
+		XLib::Graphics::TextureRenderTarget texture;
+		uint32 referenceCount;
+		XLib::Color uniformColor;
+		bool isUniform;
+	};
+
+	class LayerTilePool : public XLib::NonCopyable
+	{
+	private:
+		static constexpr uint32 freeTileCountLimit = 64;
+
+		using TileAllocator = XLib::PoolAllocator<LayerTile,
+			XLib::PoolAllocatorHeapUsagePolicy::MultipleStaticChunks<6, 16>>;
+
+		XLib::Graphics::Device *device = nullptr;
+		TileAllocator allocator;
+		XLib::Vector<LayerTile*> freeTiles;
+		XLib::Vector<LayerTile*> uniformTiles;
+		XLib::Graphics::TextureRenderTarget transparentTexture;
+		uint32 allocatedTileCount = 0;
+
+		void unregisterUniform(LayerTile* tile);
+
+	public:
+		LayerTilePool() = default;
+		~LayerTilePool() = default;
+
+		void initialize(XLib::Graphics::Device& device);
+		void destroy();
+
+		// Returns tile with single reference and undefined contents.
+		LayerTile* allocate();
+		// Returns shared tile filled with color. Transparent color results in nullptr.
+		LayerTile* getUniform(XLib::Color color);
+		// Consumes reference to tile (may be nullptr) and returns tile that can be modified.
+		LayerTile* makeWritable(LayerTile* tile);
+		void release(LayerTile* tile);
+
+		inline void addReference(LayerTile* tile) { tile->referenceCount++; }
+
+		inline XLib::Graphics::Device& getDevice() { return *device; }
+		inline XLib::Graphics::TextureRenderTarget& getTransparentTexture() { return transparentTexture; }
+		inline uint32 getAllocatedTileCount() const { return allocatedTileCount; }
+	};
+
+	// Sparse grid of tiles. Missing tile means fully transparent contents.
+
+	class TiledLayer : public XLib::NonCopyable
+	{
+	private:
+		LayerTilePool *pool = nullptr;
+		XLib::HeapPtr<LayerTile*> tiles;
+		uint32x2 size = { 0, 0 };
+		uint32x2 gridSize = { 0, 0 };
+
+	public:
+		TiledLayer() = default;
+		inline ~TiledLayer() { destroy(); }
+
+		TiledLayer(TiledLayer&& that);
+		TiledLayer& operator = (TiledLayer&& that);
+
+		void initialize(LayerTilePool& pool, uint32x2 size);
+		// Initializes layer with all tiles shared with source layer.
+		void initializeShared(TiledLayer& source);
+		void destroy();
+
+		void resize(const rects32& newRect, XLib::Color fillColor);
+		void clear(XLib::Color color);
+		void upload(const rectu32& region, const void* srcData, uint32 srcDataStride = 0);
+		void download(const rectu32& region, void* dstData, uint32 dstDataStride = 0);
+
+		// Returns tile that can be modified, allocating or unsharing it if needed.
+		LayerTile* getWritableTile(uint32x2 tileCoords);
+		// Takes ownership of one reference to tile.
+		void setTile(uint32x2 tileCoords, LayerTile* tile);
+		// Takes ownership of one reference to tile and passes ownership of previous one to caller.
+		LayerTile* exchangeTile(uint32x2 tileCoords, LayerTile* tile);
+		uint32 getAllocatedTileCount();
+
+		inline LayerTile* getTile(uint32x2 tileCoords) { return tiles[tileCoords.y * gridSize.x + tileCoords.x]; }
+
+		inline rectu32 getTileRect(uint32x2 tileCoords) const
+		{
+			uint32x2 leftTop = tileCoords << LayerTileSizeLog2;
+			return rectu32(leftTop,
+				min(leftTop.x + LayerTileSize, size.x),
+				min(leftTop.y + LayerTileSize, size.y));
+		}
+
+		// Range of tile coords (right and bottom exclusive) intersecting region.
+		inline rectu32 getTileRange(const rectu32& region) const
+		{
+			if (region.left >= region.right || region.top >= region.bottom)
+				return rectu32(0, 0, 0, 0);
+			return rectu32(
+				region.left >> LayerTileSizeLog2,
+				region.top >> LayerTileSizeLog2,
+				min((region.right + LayerTileSize - 1) >> LayerTileSizeLog2, gridSize.x),
+				min((region.bottom + LayerTileSize - 1) >> LayerTileSizeLog2, gridSize.y));
+		}
+
+		inline uint32x2 getSize() const { return size; }
+		inline uint32x2 getGridSize() const { return gridSize; }
+		inline uint32 getTileCount() const { return gridSize.x * gridSize.y; }
+		inline bool isInitialized() const { return pool != nullptr; }
+	};
+
+	// Modified pixels of layer on tile grid. Every dirty tile keeps bounding rect
+	// of pixels modified inside it, so consumers can process just that part of tile.
+
+	class DirtyRegion : public XLib::NonCopyable
+	{
+	private:
+		XLib::HeapPtr<rectu32> tileRects;	// Canvas space. Empty rect means clean tile.
+		XLib::Vector<uint32> dirtyTiles;
+		uint32x2 size = { 0, 0 };
+		uint32x2 gridSize = { 0, 0 };
+		uint64 pixelCount = 0;
+
+		void addToTile(uint32 tileIndex, const rectu32& rect);
+
+	public:
+		DirtyRegion() = default;
+		~DirtyRegion() = default;
+
+		// Region is initialized clean.
+		void initialize(uint32x2 size);
+
+		void add(const rectu32& rect);
+		void add(DirtyRegion& region);
+		void addAll();
+		void clear();
+
+		// Bounding rect of all dirty pixels.
+		rectu32 getBounds();
+
+		inline XLib::Vector<uint32>& getDirtyTiles() { return dirtyTiles; }
+		inline const rectu32& getTileDirtyRect(uint32 tileIndex) { return tileRects[tileIndex]; }
+		inline bool isTileDirty(uint32 tileIndex) { return !IsEmptyRect(tileRects[tileIndex]); }
+
+		// Sum of dirty rect areas of all tiles.
+		inline uint64 getPixelCount() const { return pixelCount; }
+		inline uint32x2 getGridSize() const { return gridSize; }
+		inline bool isEmpty() const { return dirtyTiles.isEmpty(); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <Windows.h>
+#include <shellapi.h>
+#include <stdio.h>
+#include <wchar.h>
+
+#include <XLib.Program.h>
+#include <XLib.Util.h>
+#include <XLib.Debug.h>
+#include <XLib.Graphics.h>
+
+#include "PanterBatch.Job.h"
+#include "PanterBatch.Pipeline.h"
+#include "Panter.InputTrace.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+// Usage: PanterBatch <job file> [-threads <decode> <process> <encode>] [-software]
+//        PanterBatch -replay <input trace file>
+//        PanterBatch -trace-benchmark
+// Zero thread count leaves default for that stage. With -software images are processed on
+// software device, so hosts without GPU can run batches. Input traces are replayed on hardware
+// device without window, so their frame times can be compared between builds.
+
+static bool ParseArguments(int argumentCount, wchar** arguments,
+	const wchar*& jobFilename, uint32 (&threadCounts)[uint32(BatchStage::Count)], DeviceType& deviceType)
+{
+	if (argumentCount < 2)
+		return false;
+
+	jobFilename = arguments[1];
+	for (int i = 2; i < argumentCount; i++)
+	{
+		if (wcscmp(arguments[i], L"-software") == 0)
+		{
+			deviceType = DeviceType::Software;
+			continue;
+		}
+
+		if (wcscmp(arguments[i], L"-threads") != 0 || i + int(countof(threadCounts)) >= argumentCount)
+			return false;
+
+		for (uint32 &threadCount : threadCounts)
+			threadCount = uint32(wcstoul(arguments[++i], nullptr, 10));
+	}
+	return true;
+}
+
+static void ReportStats(const BatchStats& stats)
+{
+	static const char *stageNames[uint32(BatchStage::Count)] = { "decode", "process", "encode" };
+
+	char message[256];
+	sprintf_s(message, "%u images, %u failed, %.2f s, %.2f images/s, %.1f Mpixels/s",
+		stats.imageCount, stats.failedImageCount, stats.totalTime,
+		stats.totalTime > 0.0f ? float32(stats.imageCount) / stats.totalTime : 0.0f,
+		stats.totalTime > 0.0f ? float32(stats.pixelCount) / stats.totalTime * 1.0e-6f : 0.0f);
+	Debug::Log(message);
+
+	// Utilization close to 100% marks stage that limits throughput.
+	uint32 handledImageCount = max<uint32>(stats.imageCount + stats.failedImageCount, 1);
+	for (uint32 i = 0; i < countof(stageNames); i++)
+	{
+		const BatchStageStats &stage = stats.stages[i];
+		float32 utilization = stats.totalTime > 0.0f ?
+			stage.busyTime / (stats.totalTime * float32(stage.threadCount)) * 100.0f : 0.0f;
+
+		sprintf_s(message, "  %-8s %u threads, %7.2f s busy, %7.2f ms/image, %5.1f%% utilization",
+			stageNames[i], stage.threadCount, stage.busyTime,
+			stage.busyTime / float32(handledImageCount) * 1000.0f, utilization);
+		Debug::Log(message);
+	}
+}
+
+static void RunInputTraces(const wchar* traceFilename)
+{
+	Device device;
+	if (!device.initialize(DeviceType::Hardware))
+	{
+		Debug::Log("can't initialize graphics device");
+		return;
+	}
+
+	if (!traceFilename)
+	{
+		InputTraceReplay::RunBenchmark(device);
+		return;
+	}
+
+	InputTrace trace;
+	if (!trace.load(traceFilename))
+	{
+		Debug::Log("can't load input trace");
+		return;
+	}
+
+	InputTraceReplayStats stats;
+	InputTraceReplay::Run(trace, device, stats);
+	InputTraceReplay::LogStats("input trace", stats);
+}
+
+void Program::Run()
+{
+	int argumentCount = 0;
+	wchar **arguments = CommandLineToArgvW(GetCommandLineW(), &argumentCount);
+
+	if (arguments && argumentCount == 3 && wcscmp(arguments[1], L"-replay") == 0)
+	{
+		RunInputTraces(arguments[2]);
+		LocalFree(arguments);
+		return;
+	}
+	if (arguments && argumentCount == 2 && wcscmp(arguments[1], L"-trace-benchmark") == 0)
+	{
+		RunInputTraces(nullptr);
+		LocalFree(arguments);
+		return;
+	}
+
+	const wchar *jobFilename = nullptr;
+	uint32 threadCounts[uint32(BatchStage::Count)] = {};
+	DeviceType deviceType = DeviceType::Hardware;
+	if (!arguments || !ParseArguments(argumentCount, arguments, jobFilename, threadCounts, deviceType))
+	{
+		Debug::Log("usage: PanterBatch <job file> [-threads <decode> <process> <encode>] [-software]");
+		Debug::Log("       PanterBatch -replay <input trace file>");
+		Debug::Log("       PanterBatch -trace-benchmark");
+		LocalFree(arguments);
+		return;
+	}
+
+	BatchJob job;
+	BatchStats stats = {};
+	if (job.load(jobFilename) && BatchPipeline::Run(job, threadCounts, deviceType, stats))
+		ReportStats(stats);
+
+	LocalFree(arguments);
+}
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+#include <XLib.Util.h>
+#include <XLib.Debug.h>
+#include <XLib.System.File.h>
+
+#include "PanterBatch.Job.h"
+
+using namespace XLib;
+using namespace Panter;
+
+// Parsing ==================================================================================//
+
+// Invalid sequences are replaced with '?'. Buffer has to fit size characters. Characters
+// out of basic plane become surrogate pairs where wchar is 16-bit.
+static uint32 ConvertUTF8(const byte* data, uintptr size, wchar* buffer)
+{
+	uintptr i = 0;
+	if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+		i = 3;
+
+	uint32 length = 0;
+	while (i < size)
+	{
+		uint32 c = data[i++];
+		uint32 continuationCount = 0;
+		if (c >= 0xF0)
+		{
+			c &= 0x07;
+			continuationCount = 3;
+		}
+		else if (c >= 0xE0)
+		{
+			c &= 0x0F;
+			continuationCount = 2;
+		}
+		else if (c >= 0xC0)
+		{
+			c &= 0x1F;
+			continuationCount = 1;
+		}
+		else if (c >= 0x80)
+			c = '?';
+
+		for (; continuationCount && i < size && (data[i] & 0xC0) == 0x80; continuationCount--)
+			c = (c << 6) | (data[i++] & 0x3F);
+		if (continuationCount || c > 0x10FFFF)
+			c = '?';
+
+		if (sizeof(wchar) == 2 && c >= 0x10000)
+		{
+			c -= 0x10000;
+			buffer[length++] = wchar(0xD800 | (c >> 10));
+			c = 0xDC00 | (c & 0x3FF);
+		}
+		buffer[length++] = wchar(c);
+	}
+	return length;
+}
+
+static inline bool IsSpace(wchar c) { return c == ' ' || c == '\t'; }
+
+// Token is terminated in place, current is moved past it.
+static wchar* ReadToken(wchar*& current)
+{
+	while (IsSpace(*current))
+		current++;
+
+	wchar *token = current;
+	while (*current && !IsSpace(*current))
+		current++;
+	if (*current)
+		*current++ = 0;
+
+	return token;
+}
+
+// Rest of line with surrounding spaces trimmed, so file names may contain spaces.
+static wchar* ReadRest(wchar*& current)
+{
+	while (IsSpace(*current))
+		current++;
+
+	wchar *rest = current;
+	wchar *end = rest + wcslen(rest);
+	while (end > rest && IsSpace(end[-1]))
+		end--;
+	*end = 0;
+
+	current = end;
+	return rest;
+}
+
+static bool ParseFloat(const wchar* token, float32& value)
+{
+	wchar *end = nullptr;
+	value = wcstof(token, &end);
+	return *token && !*end;
+}
+
+static bool ParseInt(const wchar* token, sint32& value)
+{
+	wchar *end = nullptr;
+	value = sint32(wcstol(token, &end, 10));
+	return *token && !*end;
+}
+
+static bool ParseColor(const wchar* token, Color& color)
+{
+	wchar *end = nullptr;
+	uint32 value = uint32(wcstoul(token, &end, 16));
+	color = Color(uint8(value >> 24), uint8(value >> 16), uint8(value >> 8), uint8(value));
+	return end - token == 8 && !*end;
+}
+
+// BatchJob =================================================================================//
+
+bool BatchJob::parseLine(wchar* line)
+{
+	wchar *current = line;
+	const wchar *directive = ReadToken(current);
+	if (!*directive || *directive == '#')
+		return true;
+
+	if (wcscmp(directive, L"output") == 0 || wcscmp(directive, L"input") == 0)
+	{
+		const wchar *name = ReadRest(current);
+		if (!*name)
+			return false;
+
+		if (directive[0] == 'o')
+			outputDirectory = name;
+		else
+			inputs.pushBack(name);
+		return true;
+	}
+
+	if (wcscmp(directive, L"format") == 0)
+	{
+		const wchar *format = ReadToken(current);
+		if (wcscmp(format, L"png") == 0)
+			outputFormat = ImageFormat::Png;
+		else if (wcscmp(format, L"jpeg") == 0)
+			outputFormat = ImageFormat::Jpeg;
+		else if (wcscmp(format, L"bmp") == 0)
+			outputFormat = ImageFormat::Bmp;
+		else
+			return false;
+		return !*ReadToken(current);
+	}
+
+	BatchOperation operation = {};
+	bool valid = false;
+
+	if (wcscmp(directive, L"brightness-contrast-gamma") == 0)
+	{
+		operation.type = BatchOperationType::BrightnessContrastGamma;
+		valid = ParseFloat(ReadToken(current), operation.values[0]) &&
+			ParseFloat(ReadToken(current), operation.values[1]) &&
+			ParseFloat(ReadToken(current), operation.values[2]);
+	}
+	else if (wcscmp(directive, L"gaussian-blur") == 0)
+	{
+		sint32 radius = 0;
+		operation.type = BatchOperationType::GaussianBlur;
+		valid = ParseInt(ReadToken(current), radius) && radius >= 1;
+		operation.radius = uint32(radius);
+	}
+	else if (wcscmp(directive, L"sharpen") == 0)
+	{
+		operation.type = BatchOperationType::Sharpen;
+		valid = ParseFloat(ReadToken(current), operation.values[0]);
+	}
+	else if (wcscmp(directive, L"resize-canvas") == 0)
+	{
+		operation.type = BatchOperationType::ResizeCanvas;
+		operation.fillColor = Color(0);
+		valid = true;
+		for (sint32 &margin : operation.margins)
+			valid = valid && ParseInt(ReadToken(current), margin);
+
+		const wchar *fillColor = ReadToken(current);
+		if (valid && *fillColor)
+			valid = ParseColor(fillColor, operation.fillColor);
+	}
+
+	if (!valid || *ReadToken(current))
+		return false;
+
+	operations.pushBack(operation);
+	return true;
+}
+
+bool BatchJob::load(const wchar* filename)
+{
+	operations.clear();
+	inputs.clear();
+	outputDirectory = nullptr;
+	outputFormat = ImageFormat::Png;
+
+	File file;
+	if (!file.open(filename, FileAccessMode::Read))
+	{
+		Debug::Warning("can't open job file");
+		return false;
+	}
+
+	uint64 fileSize = file.getSize();
+	if (fileSize >= uintptr(-1) / sizeof(wchar))
+		return false;
+
+	uintptr dataSize = uintptr(fileSize);
+	HeapPtr<byte> data(dataSize);
+	if (!file.read(data, dataSize))
+	{
+		Debug::Warning("can't read job file");
+		return false;
+	}
+	file.close();
+
+	text = HeapPtr<wchar>(dataSize + 1);
+	uint32 textLength = ConvertUTF8(data, dataSize, text);
+	text[textLength] = 0;
+
+	wchar *line = text;
+	for (uint32 lineNumber = 1;; lineNumber++)
+	{
+		wchar *lineEnd = line;
+		while (*lineEnd && *lineEnd != '\n')
+			lineEnd++;
+
+		bool lastLine = !*lineEnd;
+		*lineEnd = 0;
+		if (lineEnd > line && lineEnd[-1] == '\r')
+			lineEnd[-1] = 0;
+
+		if (!parseLine(line))
+		{
+			char message[64];
+			sprintf_s(message, "job line %u is invalid", lineNumber);
+			Debug::Warning(message);
+			return false;
+		}
+
+		if (lastLine)
+			break;
+		line = lineEnd + 1;
+	}
+
+	if (!outputDirectory || inputs.isEmpty())
+	{
+		Debug::Warning("job has no output directory or no inputs");
+		return false;
+	}
+	return true;
+}
+
+bool BatchJob::getOutputFilename(uint32 inputIndex, wchar* buffer, uint32 bufferLength)
+{
+	const wchar *name = inputs[inputIndex];
+	for (const wchar *current = name; *current; current++)
+	{
+		if (*current == '/' || *current == '\\')
+			name = current + 1;
+	}
+
+	const wchar *extension = wcsrchr(name, '.');
+	int nameLength = int(extension ? extension - name : wcslen(name));
+
+	const wchar *outputExtension = L".png";
+	if (outputFormat == ImageFormat::Jpeg)
+		outputExtension = L".jpg";
+	else if (outputFormat == ImageFormat::Bmp)
+		outputExtension = L".bmp";
+
+	return swprintf(buffer, bufferLength, L"%ls/%.*ls%ls", outputDirectory, nameLength, name, outputExtension) > 0;
+}
\ No newline at end of file
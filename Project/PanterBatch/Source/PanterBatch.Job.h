@@ -0,0 +1,74 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Heap.h>
+#include <XLib.Containers.Vector.h>
+
+#include "FileUtil.h"
+
+namespace Panter
+{
+	enum class BatchOperationType : uint8
+	{
+		None = 0,
+
+		BrightnessContrastGamma,
+		GaussianBlur,
+		Sharpen,
+		ResizeCanvas,
+	};
+
+	struct BatchOperation
+	{
+		BatchOperationType type;
+		XLib::Color fillColor;		// Of area added by canvas resize.
+
+		union
+		{
+			float32 values[3];		// Brightness, contrast and gamma or sharpen intensity.
+			uint32 radius;
+			sint32 margins[4];		// Left, top, right, bottom. Negative margin crops.
+		};
+	};
+
+	// Job description is UTF-8 text with one directive per line:
+	//   output <directory>
+	//   format png | jpeg | bmp
+	//   brightness-contrast-gamma <brightness> <contrast> <gamma>
+	//   gaussian-blur <radius>
+	//   sharpen <intensity>
+	//   resize-canvas <left> <top> <right> <bottom> [<fill color RRGGBBAA>]
+	//   input <file>
+	// Operations are applied to every input in the order they are listed. Output keeps input
+	// file name with extension of output format. Blur radius starts from 1, as in editor.
+	// Lines starting with '#' are comments.
+
+	class BatchJob : public XLib::NonCopyable
+	{
+	private:
+		XLib::HeapPtr<wchar> text;		// Converted job file, all strings of job point into it.
+		XLib::Vector<BatchOperation> operations;
+		XLib::Vector<const wchar*> inputs;
+		const wchar *outputDirectory = nullptr;
+		ImageFormat outputFormat = ImageFormat::Png;
+
+		bool parseLine(wchar* line);
+
+	public:
+		BatchJob() = default;
+		~BatchJob() = default;
+
+		// Reports first invalid line and returns false.
+		bool load(const wchar* filename);
+		// Returns false if name does not fit buffer.
+		bool getOutputFilename(uint32 inputIndex, wchar* buffer, uint32 bufferLength);
+
+		inline const BatchOperation* getOperations() { return operations; }
+		inline uint32 getOperationCount() const { return operations.getSize(); }
+		inline const wchar* getInput(uint32 index) { return inputs[index]; }
+		inline uint32 getInputCount() const { return inputs.getSize(); }
+		inline ImageFormat getOutputFormat() const { return outputFormat; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,411 @@
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <stdio.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Debug.h>
+#include <XLib.Vectors.h>
+#include <XLib.System.Timer.h>
+#include <XLib.System.Threading.h>
+#include <XLib.System.Threading.Atomics.h>
+#include <XLib.System.Threading.CyclicQueue.h>
+#include <XLib.Graphics.h>
+
+#include "PanterBatch.Pipeline.h"
+
+#include "Panter.CanvasManager.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+using namespace Panter;
+
+namespace
+{
+	struct Image
+	{
+		HeapPtr<byte> pixels;
+		uint32x2 size;
+		uint32 inputIndex;
+	};
+
+	static constexpr uint32 ImageQueueSizeLog2 = 6;
+	static_assert(BatchPipeline::MaxImagesInFlight + BatchPipeline::MaxStageThreadCount <= 1 << ImageQueueSizeLog2,
+		"queues must fit all images in flight and stop markers");
+
+	using ImageQueue = ThreadSafeCyclicQueue<Image*, ImageQueueSizeLog2, ThreadSafeQueueType::MultipleProducersMultipleConsumers>;
+
+	struct Pipeline;
+
+	struct StageThread
+	{
+		Pipeline *pipeline;
+		Thread thread;
+		float32 busyTime;
+		uint64 pixelCount;
+		uint32 imageCount;
+		uint32 failedImageCount;
+	};
+
+	struct ProcessThread : StageThread
+	{
+		Device device;
+		CanvasManager canvasManager;
+	};
+
+	struct Pipeline
+	{
+		BatchJob *job;
+		Image images[BatchPipeline::MaxImagesInFlight];
+		ImageQueue freeImages;
+		ImageQueue decodedImages;		// nullptr stops process thread.
+		ImageQueue processedImages;		// nullptr stops encode thread.
+		Atomic<uint32> nextInputIndex;
+		Atomic<uint32> runningDecodeThreadCount;
+		Atomic<uint32> runningProcessThreadCount;
+
+		StageThread decodeThreads[BatchPipeline::MaxStageThreadCount];
+		ProcessThread processThreads[BatchPipeline::MaxStageThreadCount];
+		StageThread encodeThreads[BatchPipeline::MaxStageThreadCount];
+		uint32 threadCounts[uint32(BatchStage::Count)];
+		DeviceType deviceType;
+	};
+}
+
+static void ReportFailure(BatchJob& job, uint32 inputIndex, const char* reason)
+{
+	char message[512];
+	sprintf_s(message, "%s \"%.400ls\"", reason, job.getInput(inputIndex));
+	Debug::Warning(message);
+}
+
+// Decode and encode threads use WIC on Windows, so they join multithreaded apartment.
+static inline void InitializeStageThreadCOM()
+{
+#ifdef _WIN32
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+}
+
+static inline void UninitializeStageThreadCOM()
+{
+#ifdef _WIN32
+	CoUninitialize();
+#endif
+}
+
+// Stages ===================================================================================//
+
+static uint32 __stdcall DecodeThreadMain(StageThread* self)
+{
+	Pipeline &pipeline = *self->pipeline;
+	BatchJob &job = *pipeline.job;
+
+	InitializeStageThreadCOM();
+
+	for (;;)
+	{
+		uint32 inputIndex = pipeline.nextInputIndex.increment() - 1;
+		if (inputIndex >= job.getInputCount())
+			break;
+
+		Image *image = pipeline.freeImages.dequeue();
+		image->inputIndex = inputIndex;
+
+		TimerRecord startTime = Timer::GetRecord();
+		ImageFormat format = ImageFormat::None;
+		bool loaded = LoadImageFromFile(job.getInput(inputIndex), image->pixels, image->size.x, image->size.y, format);
+		self->busyTime += Timer::GetTimeDelta(startTime);
+
+		if (!loaded)
+		{
+			ReportFailure(job, inputIndex, "can't load");
+			self->failedImageCount++;
+			pipeline.freeImages.enqueue(image);
+			continue;
+		}
+
+		self->pixelCount += uint64(image->size.x) * image->size.y;
+		self->imageCount++;
+		pipeline.decodedImages.enqueue(image);
+	}
+
+	UninitializeStageThreadCOM();
+
+	// Every decode thread has queued its images before, so stop markers come after all of them.
+	if (pipeline.runningDecodeThreadCount.decrement() == 0)
+	{
+		for (uint32 i = 0; i < pipeline.threadCounts[uint32(BatchStage::Process)]; i++)
+			pipeline.decodedImages.enqueue(nullptr);
+	}
+	return 0;
+}
+
+// Image is placed to single layer of canvas and operations are run as if filters were applied
+// in editor, just without drawing. History is not needed, so it is dropped after every step.
+static bool ProcessImage(ProcessThread& self, BatchJob& job, Image& image)
+{
+	CanvasManager &canvasManager = self.canvasManager;
+
+	canvasManager.resizeDiscardingContents(image.size);
+	canvasManager.uploadLayerRegion(0, rectu32(0, 0, image.size), image.pixels);
+	canvasManager.clearHistory();
+
+	const BatchOperation *operations = job.getOperations();
+	for (uint32 i = 0; i < job.getOperationCount(); i++)
+	{
+		const BatchOperation &operation = operations[i];
+
+		switch (operation.type)
+		{
+			case BatchOperationType::BrightnessContrastGamma:
+				canvasManager.setInstrument_brightnessContrastGammaFilter(
+					operation.values[0], operation.values[1], operation.values[2]);
+				break;
+
+			case BatchOperationType::GaussianBlur:
+				canvasManager.setInstrument_gaussianBlurFilter(operation.radius);
+				break;
+
+			case BatchOperationType::Sharpen:
+				// Sharpen is pixel shader effect, software device can't run it.
+				if (self.device.isSoftware())
+					return false;
+				canvasManager.setInstrument_sharpenFilter(operation.values[0]);
+				break;
+
+			case BatchOperationType::ResizeCanvas:
+			{
+				uint32x2 canvasSize = canvasManager.getCanvasSize();
+				rects32 canvasRect(-operation.margins[0], -operation.margins[1],
+					sint32(canvasSize.x) + operation.margins[2], sint32(canvasSize.y) + operation.margins[3]);
+				if (canvasRect.right <= canvasRect.left || canvasRect.bottom <= canvasRect.top)
+					return false;
+
+				canvasManager.resizeSavingContents(canvasRect, operation.fillColor);
+				canvasManager.clearHistory();
+				continue;
+			}
+
+			default:
+				Debug::Crash("invalid operation");
+		}
+
+		canvasManager.applyInstrument();
+		canvasManager.updateInstrument();
+		canvasManager.clearHistory();
+	}
+
+	image.size = canvasManager.getCanvasSize();
+	image.pixels.resize(uintptr(image.size.x) * image.size.y * 4);
+	canvasManager.downloadLayerRegion(0, rectu32(0, 0, image.size), image.pixels);
+	return true;
+}
+
+static uint32 __stdcall ProcessThreadMain(ProcessThread* self)
+{
+	Pipeline &pipeline = *self->pipeline;
+
+	// Devices are not shared, so every thread drives its own device context.
+	bool deviceInitialized = self->device.initialize(pipeline.deviceType);
+	Debug::CrashCondition(!deviceInitialized, DbgMsgFmt("can't initialize graphics device"));
+
+	self->canvasManager.initialize(self->device, uint32x2(LayerTileSize, LayerTileSize), nullptr);
+	self->canvasManager.createLayer();
+
+	for (;;)
+	{
+		Image *image = pipeline.decodedImages.dequeue();
+		if (!image)
+			break;
+
+		TimerRecord startTime = Timer::GetRecord();
+		bool processed = ProcessImage(*self, *pipeline.job, *image);
+		self->busyTime += Timer::GetTimeDelta(startTime);
+
+		if (!processed)
+		{
+			ReportFailure(*pipeline.job, image->inputIndex, "can't process");
+			self->failedImageCount++;
+			pipeline.freeImages.enqueue(image);
+			continue;
+		}
+
+		self->imageCount++;
+		pipeline.processedImages.enqueue(image);
+	}
+
+	self->canvasManager.destroy();
+
+	if (pipeline.runningProcessThreadCount.decrement() == 0)
+	{
+		for (uint32 i = 0; i < pipeline.threadCounts[uint32(BatchStage::Encode)]; i++)
+			pipeline.processedImages.enqueue(nullptr);
+	}
+	return 0;
+}
+
+static uint32 __stdcall EncodeThreadMain(StageThread* self)
+{
+	Pipeline &pipeline = *self->pipeline;
+	BatchJob &job = *pipeline.job;
+
+	InitializeStageThreadCOM();
+
+	for (;;)
+	{
+		Image *image = pipeline.processedImages.dequeue();
+		if (!image)
+			break;
+
+		TimerRecord startTime = Timer::GetRecord();
+		wchar filename[1024];
+		bool saved = job.getOutputFilename(image->inputIndex, filename, countof(filename)) &&
+			SaveImageToFile(filename, job.getOutputFormat(), image->pixels, image->size.x, image->size.y);
+		self->busyTime += Timer::GetTimeDelta(startTime);
+
+		if (saved)
+		{
+			self->pixelCount += uint64(image->size.x) * image->size.y;
+			self->imageCount++;
+		}
+		else
+		{
+			ReportFailure(job, image->inputIndex, "can't save");
+			self->failedImageCount++;
+		}
+
+		pipeline.freeImages.enqueue(image);
+	}
+
+	UninitializeStageThreadCOM();
+	return 0;
+}
+
+// BatchPipeline ============================================================================//
+
+static void ResetStageThread(StageThread& thread, Pipeline* pipeline)
+{
+	thread.pipeline = pipeline;
+	thread.busyTime = 0.0f;
+	thread.pixelCount = 0;
+	thread.imageCount = 0;
+	thread.failedImageCount = 0;
+}
+
+template <typename ThreadType>
+static void CollectStageStats(ThreadType* threads, uint32 threadCount, BatchStageStats& stageStats, uint32& failedImageCount)
+{
+	stageStats.busyTime = 0.0f;
+	stageStats.threadCount = threadCount;
+	for (uint32 i = 0; i < threadCount; i++)
+	{
+		stageStats.busyTime += threads[i].busyTime;
+		failedImageCount += threads[i].failedImageCount;
+	}
+}
+
+bool BatchPipeline::Run(BatchJob& job, const uint32 (&threadCounts)[uint32(BatchStage::Count)],
+	DeviceType deviceType, BatchStats& stats)
+{
+	// Decoding and encoding of compressed images take about as long as filters, so by default
+	// process stage gets half of threads and other stages quarter each.
+	uint32 hardwareThreadCount = Thread::GetHardwareThreadCount();
+	uint32 defaultThreadCounts[uint32(BatchStage::Count)] =
+	{
+		clamp<uint32>(hardwareThreadCount / 4, 1, MaxStageThreadCount),
+		clamp<uint32>(hardwareThreadCount / 2, 1, MaxStageThreadCount),
+		clamp<uint32>(hardwareThreadCount / 4, 1, MaxStageThreadCount),
+	};
+
+	for (uint32 i = 0; i < countof(defaultThreadCounts); i++)
+	{
+		if (threadCounts[i] > MaxStageThreadCount)
+		{
+			Debug::Warning("too many pipeline stage threads");
+			return false;
+		}
+		if (threadCounts[i])
+			defaultThreadCounts[i] = threadCounts[i];
+	}
+
+	InitializeImageFileIO();
+
+	Pipeline *pipeline = Heap::Allocate<Pipeline>();
+	construct(*pipeline);
+	pipeline->job = &job;
+	pipeline->deviceType = deviceType;
+	for (uint32 i = 0; i < countof(defaultThreadCounts); i++)
+		pipeline->threadCounts[i] = defaultThreadCounts[i];
+
+	const uint32 decodeThreadCount = pipeline->threadCounts[uint32(BatchStage::Decode)];
+	const uint32 processThreadCount = pipeline->threadCounts[uint32(BatchStage::Process)];
+	const uint32 encodeThreadCount = pipeline->threadCounts[uint32(BatchStage::Encode)];
+
+	pipeline->freeImages.initialize();
+	pipeline->decodedImages.initialize();
+	pipeline->processedImages.initialize();
+	for (Image &image : pipeline->images)
+		pipeline->freeImages.enqueue(&image);
+
+	pipeline->nextInputIndex.store(0);
+	pipeline->runningDecodeThreadCount.store(decodeThreadCount);
+	pipeline->runningProcessThreadCount.store(processThreadCount);
+
+	TimerRecord startTime = Timer::GetRecord();
+
+	for (uint32 i = 0; i < encodeThreadCount; i++)
+	{
+		ResetStageThread(pipeline->encodeThreads[i], pipeline);
+		pipeline->encodeThreads[i].thread.create(EncodeThreadMain, &pipeline->encodeThreads[i]);
+	}
+	for (uint32 i = 0; i < processThreadCount; i++)
+	{
+		ResetStageThread(pipeline->processThreads[i], pipeline);
+		pipeline->processThreads[i].thread.create(ProcessThreadMain, &pipeline->processThreads[i]);
+	}
+	for (uint32 i = 0; i < decodeThreadCount; i++)
+	{
+		ResetStageThread(pipeline->decodeThreads[i], pipeline);
+		pipeline->decodeThreads[i].thread.create(DecodeThreadMain, &pipeline->decodeThreads[i]);
+	}
+
+	// Encode threads are the last to finish.
+	for (uint32 i = 0; i < encodeThreadCount; i++)
+		pipeline->encodeThreads[i].thread.wait();
+
+	stats.totalTime = Timer::GetTimeDelta(startTime);
+
+	for (uint32 i = 0; i < decodeThreadCount; i++)
+	{
+		pipeline->decodeThreads[i].thread.wait();
+		pipeline->decodeThreads[i].thread.destroy();
+	}
+	for (uint32 i = 0; i < processThreadCount; i++)
+	{
+		pipeline->processThreads[i].thread.wait();
+		pipeline->processThreads[i].thread.destroy();
+	}
+	for (uint32 i = 0; i < encodeThreadCount; i++)
+		pipeline->encodeThreads[i].thread.destroy();
+
+	stats.pixelCount = 0;
+	stats.imageCount = 0;
+	stats.failedImageCount = 0;
+	for (uint32 i = 0; i < decodeThreadCount; i++)
+		stats.pixelCount += pipeline->decodeThreads[i].pixelCount;
+	for (uint32 i = 0; i < encodeThreadCount; i++)
+		stats.imageCount += pipeline->encodeThreads[i].imageCount;
+
+	CollectStageStats(pipeline->decodeThreads, decodeThreadCount,
+		stats.stages[uint32(BatchStage::Decode)], stats.failedImageCount);
+	CollectStageStats(pipeline->processThreads, processThreadCount,
+		stats.stages[uint32(BatchStage::Process)], stats.failedImageCount);
+	CollectStageStats(pipeline->encodeThreads, encodeThreadCount,
+		stats.stages[uint32(BatchStage::Encode)], stats.failedImageCount);
+
+	pipeline->~Pipeline();
+	Heap::Release(pipeline);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.Graphics.h>
+
+#include "PanterBatch.Job.h"
+
+namespace Panter
+{
+	enum class BatchStage : uint8
+	{
+		Decode = 0,
+		Process,
+		Encode,
+
+		Count,
+	};
+
+	struct BatchStageStats
+	{
+		float32 busyTime;		// Summed over stage threads, time spent waiting on queues excluded.
+		uint32 threadCount;
+	};
+
+	struct BatchStats
+	{
+		BatchStageStats stages[uint32(BatchStage::Count)];
+		float32 totalTime;
+		uint64 pixelCount;		// Of decoded images.
+		uint32 imageCount;		// Written successfully.
+		uint32 failedImageCount;
+	};
+
+	// Images go through three stages: decode, process and encode. Every stage runs on its own
+	// threads and stages are connected with queues, so decoding of next images, processing and
+	// encoding of previous ones overlap. Number of images in flight is limited, so memory does
+	// not grow when one stage is slower than others. Every process thread owns graphics device
+	// and canvas, operations inside it are spread over worker pool as in editor.
+
+	struct BatchPipeline abstract final
+	{
+		static constexpr uint32 MaxStageThreadCount = 16;
+		static constexpr uint32 MaxImagesInFlight = 32;
+
+		// Zero thread count means default for number of hardware threads. Software device lets
+		// batches run on hosts without GPU, images with sharpen fail on it. Returns false if
+		// pipeline could not be started, failed images are only counted.
+		static bool Run(BatchJob& job, const uint32 (&threadCounts)[uint32(BatchStage::Count)],
+			XLib::Graphics::DeviceType deviceType, BatchStats& stats);
+	};
+}
\ No newline at end of file
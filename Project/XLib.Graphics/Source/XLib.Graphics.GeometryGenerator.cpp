@@ -1,17 +1,128 @@
+#include <immintrin.h>
+
+#include <XLib.Math.h>
 #include <XLib.Vectors.Math.h>
+#include <XLib.System.Profiler.h>
 
 #include "XLib.Graphics.GeometryGenerator.h"
 
 using namespace XLib;
 using namespace XLib::Graphics;
 
-void GeometryGenerator::initialize(Device& device, uint32 vertexBufferSize)
+// Points center + axisX * cos + axisY * sin for count table angles, count is multiple of four.
+static void GenerateEllipsePoints(const float32* cosTable, const float32* sinTable, uint32 count,
+	float32x2 center, float32x2 axisX, float32x2 axisY, float32x2* points)
+{
+	const __m128 centerX = _mm_set1_ps(center.x);
+	const __m128 centerY = _mm_set1_ps(center.y);
+	const __m128 axisXX = _mm_set1_ps(axisX.x);
+	const __m128 axisXY = _mm_set1_ps(axisX.y);
+	const __m128 axisYX = _mm_set1_ps(axisY.x);
+	const __m128 axisYY = _mm_set1_ps(axisY.y);
+
+	for (uint32 i = 0; i < count; i += 4)
+	{
+		__m128 cos = _mm_loadu_ps(cosTable + i);
+		__m128 sin = _mm_loadu_ps(sinTable + i);
+		__m128 x = _mm_add_ps(centerX, _mm_add_ps(_mm_mul_ps(cos, axisXX), _mm_mul_ps(sin, axisYX)));
+		__m128 y = _mm_add_ps(centerY, _mm_add_ps(_mm_mul_ps(cos, axisXY), _mm_mul_ps(sin, axisYY)));
+
+		_mm_storeu_ps((float32*)(points + i), _mm_unpacklo_ps(x, y));
+		_mm_storeu_ps((float32*)(points + i + 2), _mm_unpackhi_ps(x, y));
+	}
+}
+
+// Ellipse points moved by offset along ellipse normal to both sides.
+static void GenerateEllipseBorderPoints(const float32* cosTable, const float32* sinTable, uint32 count,
+	float32x2 center, float32x2 radius, float32 offset, float32x2* innerPoints, float32x2* outerPoints)
+{
+	const __m128 centerX = _mm_set1_ps(center.x);
+	const __m128 centerY = _mm_set1_ps(center.y);
+	const __m128 radiusX = _mm_set1_ps(radius.x);
+	const __m128 radiusY = _mm_set1_ps(radius.y);
+	const __m128 offsetValue = _mm_set1_ps(offset);
+	const __m128 minLengthSquared = _mm_set1_ps(1.0e-20f);
+
+	for (uint32 i = 0; i < count; i += 4)
+	{
+		__m128 cos = _mm_loadu_ps(cosTable + i);
+		__m128 sin = _mm_loadu_ps(sinTable + i);
+		__m128 x = _mm_add_ps(centerX, _mm_mul_ps(cos, radiusX));
+		__m128 y = _mm_add_ps(centerY, _mm_mul_ps(sin, radiusY));
+
+		// Normal of (rx * cos, ry * sin) is along (ry * cos, rx * sin).
+		__m128 normalX = _mm_mul_ps(cos, radiusY);
+		__m128 normalY = _mm_mul_ps(sin, radiusX);
+		__m128 lengthSquared = _mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY));
+		__m128 scale = _mm_div_ps(offsetValue, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLengthSquared)));
+		__m128 offsetX = _mm_mul_ps(normalX, scale);
+		__m128 offsetY = _mm_mul_ps(normalY, scale);
+
+		__m128 innerX = _mm_sub_ps(x, offsetX), innerY = _mm_sub_ps(y, offsetY);
+		__m128 outerX = _mm_add_ps(x, offsetX), outerY = _mm_add_ps(y, offsetY);
+
+		_mm_storeu_ps((float32*)(innerPoints + i), _mm_unpacklo_ps(innerX, innerY));
+		_mm_storeu_ps((float32*)(innerPoints + i + 2), _mm_unpackhi_ps(innerX, innerY));
+		_mm_storeu_ps((float32*)(outerPoints + i), _mm_unpacklo_ps(outerX, outerY));
+		_mm_storeu_ps((float32*)(outerPoints + i + 2), _mm_unpackhi_ps(outerX, outerY));
+	}
+}
+
+uint32 GeometryGenerator::getCircleSegmentCount(float32 radius, uint32 segmentCount) const
+{
+	if (!segmentCount)
+	{
+		// Chord of angle step deviates from circle of radius r by r * (1 - cos(step / 2)).
+		if (radius <= tolerance)
+			return MinCircleSegmentCount;
+
+		float32 step = 2.0f * Math::Acos(1.0f - tolerance / radius);
+		segmentCount = uint32(min(Math::PiF32 * 2.0f / step, float32(MaxCircleSegmentCount))) + 1;
+	}
+
+	uint32 result = MinCircleSegmentCount;
+	while (result < segmentCount && result < MaxCircleSegmentCount)
+		result *= 2;
+	return result;
+}
+
+const float32* GeometryGenerator::getCircleTable(uint32 segmentCount)
+{
+	// Tables of growing segment counts follow each other, each takes two counts of values.
+	return circleTables + (segmentCount - MinCircleSegmentCount) * 2;
+}
+
+void GeometryGenerator::initialize(Device& device, uint32 ringVertexCount)
 {
 	this->device = &device;
-	this->vertexBufferSize = vertexBufferSize;
 
-	device.createBuffer(gpuVertexBuffer, vertexBufferSize);
-	cpuVertexBuffer.resize(vertexBufferSize);
+	ringVertexCount = max(ringVertexCount, MaxBatchVertexCount);
+	vertexRingSize = ringVertexCount * sizeof(VertexColor2D);
+	indexRingSize = ringVertexCount * 3 * sizeof(uint16);
+	device.createDynamicBuffer(vertexRingBuffer, vertexRingSize);
+	device.createDynamicBuffer(indexRingBuffer, indexRingSize);
+	vertexRingOffset = 0;
+	indexRingOffset = 0;
+
+	vertexCapacity = initialBatchVertexCount;
+	indexCapacity = initialBatchVertexCount * 3;
+	vertices.resize(vertexCapacity);
+	indices.resize(indexCapacity);
+	vertexCount = 0;
+	indexCount = 0;
+	batchUploaded = false;
+
+	circleTables.resize((MaxCircleSegmentCount * 2 - MinCircleSegmentCount) * 2);
+	for (uint32 segmentCount = MinCircleSegmentCount; segmentCount <= MaxCircleSegmentCount; segmentCount *= 2)
+	{
+		float32 *table = circleTables + (segmentCount - MinCircleSegmentCount) * 2;
+		for (uint32 i = 0; i < segmentCount; i++)
+		{
+			float32 angle = Math::PiF32 * 2.0f * float32(i) / float32(segmentCount);
+			table[i] = Math::Cos(angle);
+			table[segmentCount + i] = Math::Sin(angle);
+		}
+	}
 }
 
 void GeometryGenerator::destroy()
@@ -21,33 +132,76 @@ void GeometryGenerator::destroy()
 
 void GeometryGenerator::discard()
 {
-	vertexBufferBytesUsed = 0;
+	vertexCount = 0;
+	indexCount = 0;
+	batchUploaded = false;
 }
 
 void GeometryGenerator::flush()
 {
-	if (!vertexBufferBytesUsed)
+	if (!indexCount)
+		return;
+
+	ProfileFunction();
+
+	stats.vertexCount += vertexCount;
+	stats.indexCount += indexCount;
+	stats.flushCount++;
+
+	if (flushHandler)
+		flushHandler(flushHandlerContext);
+	else
+		draw();
+
+	discard();
+}
+
+void GeometryGenerator::draw()
+{
+	if (!indexCount)
 		return;
 
-	device->uploadBuffer(gpuVertexBuffer, cpuVertexBuffer, 0, vertexBufferBytesUsed);
-	device->draw2D(PrimitiveType::TriangleList, Effect::PerVertexColor, gpuVertexBuffer,
-		0, sizeof(VertexColor2D), vertexBufferBytesUsed / sizeof(VertexColor2D));
+	if (!batchUploaded)
+	{
+		// Batch that does not fit to the rest of ring is written to its beginning, which
+		// discards ring contents.
+		uint32 vertexDataSize = vertexCount * sizeof(VertexColor2D);
+		uint32 indexDataSize = ((indexCount + 1) & ~1u) * sizeof(uint16);	// Keeps offsets 4 byte aligned, capacity is even.
+
+		if (vertexRingOffset + vertexDataSize > vertexRingSize)
+			vertexRingOffset = 0;
+		if (indexRingOffset + indexDataSize > indexRingSize)
+			indexRingOffset = 0;
+
+		device->appendBuffer(vertexRingBuffer, vertices, vertexRingOffset, vertexDataSize);
+		device->appendBuffer(indexRingBuffer, indices, indexRingOffset, indexDataSize);
+
+		batchVertexOffset = vertexRingOffset;
+		batchIndexOffset = indexRingOffset;
+		vertexRingOffset += vertexDataSize;
+		indexRingOffset += indexDataSize;
+		batchUploaded = true;
+	}
 
-	vertexBufferBytesUsed = 0;
+	device->drawIndexed2D(PrimitiveType::TriangleList, Effect::PerVertexColor,
+		vertexRingBuffer, batchVertexOffset, sizeof(VertexColor2D),
+		indexRingBuffer, batchIndexOffset, indexCount);
+	stats.drawCount++;
 }
 
 void GeometryGenerator::drawLine(float32x2 start, float32x2 end, float32 width,
 	Color color, bool roundedStart, bool roundedEnd)
 {
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(6);
+	VertexColor2D *quadVertices = nullptr;
+	uint16 *quadIndices = nullptr;
+	uint16 base = allocate(4, 6, quadVertices, quadIndices);
 
 	float32x2 w = VectorMath::NormalLeft(VectorMath::Normalize(end - start)) * (width / 2.0f);
-	vertices[0] = { end + w, color };
-	vertices[1] = { start + w, color };
-	vertices[2] = { start - w, color };
-	vertices[3] = vertices[0];
-	vertices[4] = vertices[2];
-	vertices[5] = { end - w, color };
+	quadVertices[0] = { end + w, color };
+	quadVertices[1] = { start + w, color };
+	quadVertices[2] = { start - w, color };
+	quadVertices[3] = { end - w, color };
+	WriteQuadIndices(quadIndices, base, base + 1, base + 2, base + 3);
 
 	if (roundedStart)
 		drawLeftHalfEllipseOnDiameter(start - w, start + w, color);
@@ -58,14 +212,15 @@ void GeometryGenerator::drawLine(float32x2 start, float32x2 end, float32 width,
 
 void GeometryGenerator::drawFilledRect(const rectf32& rect, Color color)
 {
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(6);
-
-	vertices[0] = { { rect.left,   rect.top    }, color };
-	vertices[1] = { { rect.right,  rect.top    }, color };
-	vertices[2] = { { rect.right,  rect.bottom }, color };
-	vertices[3] = { { rect.left,   rect.top    }, color };
-	vertices[4] = { { rect.right,  rect.bottom }, color };
-	vertices[5] = { { rect.left,   rect.bottom }, color };
+	VertexColor2D *quadVertices = nullptr;
+	uint16 *quadIndices = nullptr;
+	uint16 base = allocate(4, 6, quadVertices, quadIndices);
+
+	quadVertices[0] = { { rect.left,   rect.top    }, color };
+	quadVertices[1] = { { rect.right,  rect.top    }, color };
+	quadVertices[2] = { { rect.right,  rect.bottom }, color };
+	quadVertices[3] = { { rect.left,   rect.bottom }, color };
+	WriteQuadIndices(quadIndices, base, base + 1, base + 2, base + 3);
 }
 
 void GeometryGenerator::drawFilledRectWithBorder(const rectf32& rect,
@@ -88,226 +243,450 @@ void GeometryGenerator::drawFilledRectWithBorder(const rectf32& rect,
 		inner.right -= w;
 		inner.bottom -= w;
 
-		VertexColor2D *vertices = allocateVertices<VertexColor2D>(30);
+		VertexColor2D *rectVertices = nullptr;
+		uint16 *rectIndices = nullptr;
+		uint16 base = allocate(12, 30, rectVertices, rectIndices);
 
 		// fill
-		vertices[ 0] = { { inner.left,   inner.top    }, fillColor };
-		vertices[ 1] = { { inner.right,  inner.top    }, fillColor };
-		vertices[ 2] = { { inner.right,  inner.bottom }, fillColor };
-		vertices[ 3] = { { inner.left,   inner.top    }, fillColor };
-		vertices[ 4] = { { inner.right,  inner.bottom }, fillColor };
-		vertices[ 5] = { { inner.left,   inner.bottom }, fillColor };
-
-		// border left
-		vertices[ 6] = { { outer.left,   outer.top    }, borderColor };
-		vertices[ 7] = { { inner.left,   inner.top    }, borderColor };
-		vertices[ 8] = { { inner.left,   inner.bottom }, borderColor };
-		vertices[ 9] = { { outer.left,   outer.top    }, borderColor };
-		vertices[10] = { { inner.left,   inner.bottom }, borderColor };
-		vertices[11] = { { outer.left,   outer.bottom }, borderColor };
-
-		// border top
-		vertices[12] = { { outer.left,   outer.top    }, borderColor };
-		vertices[13] = { { outer.right,  outer.top    }, borderColor };
-		vertices[14] = { { inner.right,  inner.top    }, borderColor };
-		vertices[15] = { { outer.left,   outer.top    }, borderColor };
-		vertices[16] = { { inner.right,  inner.top    }, borderColor };
-		vertices[17] = { { inner.left,   inner.top    }, borderColor };
-
-		// border right
-		vertices[18] = { { inner.right,  inner.top    }, borderColor };
-		vertices[19] = { { outer.right,  outer.top    }, borderColor };
-		vertices[20] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[21] = { { inner.right,  inner.top    }, borderColor };
-		vertices[22] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[23] = { { inner.right,  inner.bottom }, borderColor };
-
-		// border bottom
-		vertices[24] = { { inner.left,   inner.bottom }, borderColor };
-		vertices[25] = { { inner.right,  inner.bottom }, borderColor };
-		vertices[26] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[27] = { { inner.left,   inner.bottom }, borderColor };
-		vertices[28] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[29] = { { outer.left,   outer.bottom }, borderColor };
+		rectVertices[ 0] = { { inner.left,   inner.top    }, fillColor };
+		rectVertices[ 1] = { { inner.right,  inner.top    }, fillColor };
+		rectVertices[ 2] = { { inner.right,  inner.bottom }, fillColor };
+		rectVertices[ 3] = { { inner.left,   inner.bottom }, fillColor };
+
+		// border inner corners
+		rectVertices[ 4] = { { inner.left,   inner.top    }, borderColor };
+		rectVertices[ 5] = { { inner.right,  inner.top    }, borderColor };
+		rectVertices[ 6] = { { inner.right,  inner.bottom }, borderColor };
+		rectVertices[ 7] = { { inner.left,   inner.bottom }, borderColor };
+
+		// border outer corners
+		rectVertices[ 8] = { { outer.left,   outer.top    }, borderColor };
+		rectVertices[ 9] = { { outer.right,  outer.top    }, borderColor };
+		rectVertices[10] = { { outer.right,  outer.bottom }, borderColor };
+		rectVertices[11] = { { outer.left,   outer.bottom }, borderColor };
+
+		WriteQuadIndices(rectIndices +  0, base + 0, base +  1, base +  2, base + 3);	// fill
+		WriteQuadIndices(rectIndices +  6, base + 8, base +  4, base +  7, base + 11);	// border left
+		WriteQuadIndices(rectIndices + 12, base + 8, base +  9, base +  5, base + 4);	// border top
+		WriteQuadIndices(rectIndices + 18, base + 5, base +  9, base + 10, base + 6);	// border right
+		WriteQuadIndices(rectIndices + 24, base + 7, base +  6, base + 10, base + 11);	// border bottom
 	}
 	else
 	{
-		VertexColor2D *vertices = allocateVertices<VertexColor2D>(6);
-
 		// fill with borders
-		vertices[0] = { { outer.left,   outer.top    }, borderColor };
-		vertices[1] = { { outer.right,  outer.top    }, borderColor };
-		vertices[2] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[3] = { { outer.left,   outer.top    }, borderColor };
-		vertices[4] = { { outer.right,  outer.bottom }, borderColor };
-		vertices[5] = { { outer.left,   outer.bottom }, borderColor };
+		drawFilledRect(outer, borderColor);
 	}
 }
 
 void GeometryGenerator::drawRectShadow(const rectf32& rect, float32 width, Color color)
 {
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(36);
+	VertexColor2D *shadowVertices = nullptr;
+	uint16 *shadowIndices = nullptr;
+	uint16 base = allocate(12, 36, shadowVertices, shadowIndices);
 
 	const uint32 innerColor = color;
 	const uint32 outerColor = 0x00000000_rgba; // TODO: rgb from inner color.
 
-	vertices[0] = { { rect.left - width, rect.top    }, outerColor };
-	vertices[1] = { { rect.left,         rect.top    }, innerColor };
-	vertices[2] = { { rect.left - width, rect.bottom }, outerColor };
-	vertices[3] = { { rect.left,         rect.top    }, innerColor };
-	vertices[4] = { { rect.left,         rect.bottom }, innerColor };
-	vertices[5] = { { rect.left - width, rect.bottom }, outerColor };
-
-	vertices[6] = { { rect.right,         rect.top    }, innerColor };
-	vertices[7] = { { rect.right + width, rect.top    }, outerColor };
-	vertices[8] = { { rect.right,         rect.bottom }, innerColor };
-	vertices[9] = { { rect.right + width, rect.top    }, outerColor };
-	vertices[10] = { { rect.right + width, rect.bottom }, outerColor };
-	vertices[11] = { { rect.right,         rect.bottom }, innerColor };
-
-	vertices[12] = { { rect.left,  rect.top },         innerColor };
-	vertices[13] = { { rect.left,  rect.top - width }, outerColor };
-	vertices[14] = { { rect.right, rect.top },         innerColor };
-	vertices[15] = { { rect.left,  rect.top - width }, outerColor };
-	vertices[16] = { { rect.right, rect.top - width }, outerColor };
-	vertices[17] = { { rect.right, rect.top },         innerColor };
-
-	vertices[18] = { { rect.left,  rect.bottom + width }, outerColor };
-	vertices[19] = { { rect.left,  rect.bottom },         innerColor };
-	vertices[20] = { { rect.right, rect.bottom + width }, outerColor };
-	vertices[21] = { { rect.left,  rect.bottom },         innerColor };
-	vertices[22] = { { rect.right, rect.bottom },         innerColor };
-	vertices[23] = { { rect.right, rect.bottom + width }, outerColor };
-
-	vertices[24] = { { rect.left,         rect.top         }, innerColor };
-	vertices[25] = { { rect.left - width, rect.top         }, outerColor };
-	vertices[26] = { { rect.left,         rect.top - width }, outerColor };
-
-	vertices[27] = { { rect.left,         rect.bottom         }, innerColor };
-	vertices[28] = { { rect.left,         rect.bottom + width }, outerColor };
-	vertices[29] = { { rect.left - width, rect.bottom         }, outerColor };
-
-	vertices[30] = { { rect.right,         rect.top         }, innerColor };
-	vertices[31] = { { rect.right,         rect.top - width }, outerColor };
-	vertices[32] = { { rect.right + width, rect.top         }, outerColor };
-
-	vertices[33] = { { rect.right,         rect.bottom         }, innerColor };
-	vertices[34] = { { rect.right + width, rect.bottom         }, outerColor };
-	vertices[35] = { { rect.right,         rect.bottom + width }, outerColor };
+	// rect corners
+	shadowVertices[ 0] = { { rect.left,  rect.top    }, innerColor };
+	shadowVertices[ 1] = { { rect.right, rect.top    }, innerColor };
+	shadowVertices[ 2] = { { rect.right, rect.bottom }, innerColor };
+	shadowVertices[ 3] = { { rect.left,  rect.bottom }, innerColor };
+
+	// left and right sides
+	shadowVertices[ 4] = { { rect.left - width,  rect.top    }, outerColor };
+	shadowVertices[ 5] = { { rect.left - width,  rect.bottom }, outerColor };
+	shadowVertices[ 6] = { { rect.right + width, rect.top    }, outerColor };
+	shadowVertices[ 7] = { { rect.right + width, rect.bottom }, outerColor };
+
+	// top and bottom sides
+	shadowVertices[ 8] = { { rect.left,  rect.top - width    }, outerColor };
+	shadowVertices[ 9] = { { rect.right, rect.top - width    }, outerColor };
+	shadowVertices[10] = { { rect.left,  rect.bottom + width }, outerColor };
+	shadowVertices[11] = { { rect.right, rect.bottom + width }, outerColor };
+
+	WriteQuadIndices(shadowIndices +  0, base + 4, base + 0, base +  3, base +  5);	// left
+	WriteQuadIndices(shadowIndices +  6, base + 1, base + 6, base +  7, base +  2);	// right
+	WriteQuadIndices(shadowIndices + 12, base + 8, base + 9, base +  1, base +  0);	// top
+	WriteQuadIndices(shadowIndices + 18, base + 3, base + 2, base + 11, base + 10);	// bottom
+
+	// corners
+	const uint16 cornerIndices[12] =
+	{
+		0, 4,  8,
+		3, 10, 5,
+		1, 9,  6,
+		2, 7,  11,
+	};
+	for (uint32 i = 0; i < 12; i++)
+		shadowIndices[24 + i] = base + cornerIndices[i];
 }
 
 void GeometryGenerator::drawVerticalGradientRect(const rectf32& rect, Color topColor, Color bottomColor)
 {
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(6);
-
-	vertices[0] = { { rect.left,   rect.top    }, topColor };
-	vertices[1] = { { rect.right,  rect.top    }, topColor };
-	vertices[2] = { { rect.right,  rect.bottom }, bottomColor };
-	vertices[3] = { { rect.left,   rect.top    }, topColor };
-	vertices[4] = { { rect.right,  rect.bottom }, bottomColor };
-	vertices[5] = { { rect.left,   rect.bottom }, bottomColor };
+	VertexColor2D *quadVertices = nullptr;
+	uint16 *quadIndices = nullptr;
+	uint16 base = allocate(4, 6, quadVertices, quadIndices);
+
+	quadVertices[0] = { { rect.left,   rect.top    }, topColor };
+	quadVertices[1] = { { rect.right,  rect.top    }, topColor };
+	quadVertices[2] = { { rect.right,  rect.bottom }, bottomColor };
+	quadVertices[3] = { { rect.left,   rect.bottom }, bottomColor };
+	WriteQuadIndices(quadIndices, base, base + 1, base + 2, base + 3);
 }
 
 void GeometryGenerator::drawLeftHalfEllipseOnDiameter(float32x2 diameterStart, float32x2 diameterEnd,
 	Color color, uint32 segmentCount)
 {
-	float32 angleStep = Math::PiF32 / float32(segmentCount);
-	float32 angle = angleStep;
-	float32x2 prevVertex = diameterEnd;
-
 	float32x2 diameter = (diameterEnd - diameterStart) / 2.0f;
 	float32x2 side = VectorMath::NormalLeft(diameter);
 
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(segmentCount * 3);
+	// First half of full circle goes from diameter end to start, last point is diameter start.
+	uint32 circleSegmentCount = getCircleSegmentCount(VectorMath::Length(diameter), segmentCount * 2);
+	const float32 *cosTable = getCircleTable(circleSegmentCount);
+	uint32 pointCount = circleSegmentCount / 2;
 
-	for (uint32 i = 0; i < segmentCount; i++)
-	{
-		float32 sin = Math::Sin(angle);
-		float32 cos = Math::Cos(angle);
+	float32x2 points[MaxCircleSegmentCount / 2];
+	GenerateEllipsePoints(cosTable, cosTable + circleSegmentCount, pointCount,
+		diameterStart + diameter, diameter, side, points);
 
-		float32x2 newVertex = diameterStart + diameter * (1.0f + cos) + side * sin;
+	// Fan around diameter start.
+	uint32 triangleCount = pointCount - 1;
+	VertexColor2D *fanVertices = nullptr;
+	uint16 *fanIndices = nullptr;
+	uint16 base = allocate(pointCount + 1, triangleCount * 3, fanVertices, fanIndices);
 
-		vertices[i * 3 + 0] = { diameterStart, color };
-		vertices[i * 3 + 1] = { prevVertex, color };
-		vertices[i * 3 + 2] = { newVertex, color };
+	fanVertices[0] = { diameterStart, color };
+	for (uint32 i = 0; i < pointCount; i++)
+		fanVertices[i + 1] = { points[i], color };
 
-		prevVertex = newVertex;
-		angle += angleStep;
+	for (uint32 i = 0; i < triangleCount; i++)
+	{
+		fanIndices[i * 3 + 0] = base;
+		fanIndices[i * 3 + 1] = uint16(base + i + 1);
+		fanIndices[i * 3 + 2] = uint16(base + i + 2);
 	}
 }
 
 void GeometryGenerator::drawEllipseBorder(float32x2 center, float32x2 radius,
 	Color color, float32 width, uint32 segmentCount)
 {
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(segmentCount * 6);
+	float32 w = width * 0.5f;
+	segmentCount = getCircleSegmentCount(max(radius.x, radius.y) + w, segmentCount);
+	const float32 *cosTable = getCircleTable(segmentCount);
 
-	float32 aspect = radius.y / radius.x;
+	float32x2 innerPoints[MaxCircleSegmentCount];
+	float32x2 outerPoints[MaxCircleSegmentCount];
+	GenerateEllipseBorderPoints(cosTable, cosTable + segmentCount, segmentCount,
+		center, radius, w, innerPoints, outerPoints);
 
-	float32 w = width * 0.5f;
-	float32 angleStep = Math::PiF32 * 2.0f / float32(segmentCount);
-	float32x2 prevInner = float32x2(center.x + radius.x, center.y);
-	float32x2 prevOuter = prevInner;
-	prevInner.x -= w;
-	prevOuter.x += w;
+	// Inner and outer points alternate.
+	VertexColor2D *ringVertices = nullptr;
+	uint16 *ringIndices = nullptr;
+	uint16 base = allocate(segmentCount * 2, segmentCount * 6, ringVertices, ringIndices);
 
-	float32x2 prevVertex = center + float32x2(Math::Cos(angleStep), Math::Sin(angleStep)) * radius;
+	for (uint32 i = 0; i < segmentCount; i++)
+	{
+		ringVertices[i * 2 + 0] = { innerPoints[i], color };
+		ringVertices[i * 2 + 1] = { outerPoints[i], color };
+	}
 
 	for (uint32 i = 0; i < segmentCount; i++)
 	{
-		float32 angle = float32(i + 1) * angleStep;
-		float32x2 cosSin(Math::Cos(angle), Math::Sin(angle));
+		uint16 inner = uint16(base + i * 2);
+		uint16 nextInner = uint16(base + ((i + 1) & (segmentCount - 1)) * 2);
+		WriteQuadIndices(ringIndices + i * 6, inner, inner + 1, nextInner + 1, nextInner);
+	}
+}
+
+void GeometryGenerator::drawFilledEllipse(float32x2 center, float32x2 radius,
+	Color color, uint32 segmentCount)
+{
+	segmentCount = getCircleSegmentCount(max(radius.x, radius.y), segmentCount);
+	const float32 *cosTable = getCircleTable(segmentCount);
 
-		float32x2 base = center + cosSin * radius;
-		float32x2 normal = VectorMath::Normalize({ cosSin.x * aspect, cosSin.y });
-		float32x2 normalOffset = normal * w;
+	float32x2 points[MaxCircleSegmentCount];
+	GenerateEllipsePoints(cosTable, cosTable + segmentCount, segmentCount,
+		center, float32x2(radius.x, 0.0f), float32x2(0.0f, radius.y), points);
 
-		float32x2 newInner = base - normalOffset;
-		float32x2 newOuter = base + normalOffset;
+	// Fan around first point.
+	uint32 fillTriangleCount = segmentCount - 2;
+	VertexColor2D *fanVertices = nullptr;
+	uint16 *fanIndices = nullptr;
+	uint16 base = allocate(segmentCount, fillTriangleCount * 3, fanVertices, fanIndices);
 
-		vertices[i * 6 + 0] = { prevInner, color };
-		vertices[i * 6 + 1] = { prevOuter, color };
-		vertices[i * 6 + 2] = { newOuter,  color };
-		vertices[i * 6 + 3] = { prevInner, color };
-		vertices[i * 6 + 4] = { newOuter,  color };
-		vertices[i * 6 + 5] = { newInner,  color };
+	for (uint32 i = 0; i < segmentCount; i++)
+		fanVertices[i] = { points[i], color };
 
-		prevInner = newInner;
-		prevOuter = newOuter;
+	for (uint32 i = 0; i < fillTriangleCount; i++)
+	{
+		fanIndices[i * 3 + 0] = base;
+		fanIndices[i * 3 + 1] = uint16(base + i + 1);
+		fanIndices[i * 3 + 2] = uint16(base + i + 2);
 	}
 }
 
-void GeometryGenerator::drawFilledEllipse(float32x2 center, float32x2 radius,
-	Color color, uint32 segmentCount)
+void GeometryGenerator::drawPolyline(const float32x2* points, uint32 pointCount, float32 width,
+	Color color, LineJoin join, LineCap startCap, LineCap endCap)
 {
-	uint32 fillTriangleCount = segmentCount - 2;
-	VertexColor2D *vertices = allocateVertices<VertexColor2D>(fillTriangleCount * 3);
+	if (!pointCount)
+		return;
+
+	float32 w = width * 0.5f;
+
+	auto findNextPoint = [&](uint32 index, float32x2 point) -> uint32
+	{
+		while (index < pointCount && VectorMath::Length(points[index] - point) < minSegmentLength)
+			index++;
+		return index;
+	};
+
+	float32x2 start = points[0];
+	uint32 pointIndex = findNextPoint(1, start);
+	if (pointIndex == pointCount)
+	{
+		// Single point is covered by its caps only.
+		if (startCap == LineCap::Round)
+			drawFilledEllipse(start, float32x2(w, w), color);
+		else if (startCap == LineCap::Square)
+			drawFilledRect(rectf32(start.x - w, start.y - w, start.x + w, start.y + w), color);
+		return;
+	}
 
-	float32x2 startVertex = center;
-	startVertex.x += radius.x;
+	uint32 capSegmentCount = getCircleSegmentCount(w, 0) / 4;
+	const float32 *capCosTable = getCircleTable(capSegmentCount * 4);
+	const float32 *capSinTable = capCosTable + capSegmentCount * 4;
 
-	float32 angleStep = Math::PiF32 * 2.0f / float32(segmentCount);
-	float32x2 prevVertex = center + float32x2(Math::Cos(angleStep), Math::Sin(angleStep)) * radius;
+	float32x2 segmentEnd = points[pointIndex];
+	float32 length = VectorMath::Length(segmentEnd - start);
+	float32x2 direction = (segmentEnd - start) / length;
+	float32x2 normal = VectorMath::NormalLeft(direction) * w;
 
-	for (uint32 i = 0; i < fillTriangleCount; i++)
+	beginStrip(color);
+
+	// Round cap is strip of chords perpendicular to direction, starting from its tip.
+	if (startCap == LineCap::Round)
+	{
+		addStripPoint(start - direction * w);
+		for (uint32 i = 1; i < capSegmentCount; i++)
+		{
+			float32x2 chordCenter = start - direction * (w * capCosTable[i]);
+			float32x2 chordHalf = normal * capSinTable[i];
+			addStripPair(chordCenter + chordHalf, chordCenter - chordHalf);
+		}
+	}
+
+	float32x2 startOffset = startCap == LineCap::Square ? direction * w : float32x2(0.0f, 0.0f);
+	addStripPair(start - startOffset + normal, start - startOffset - normal);
+
+	for (pointIndex = findNextPoint(pointIndex + 1, segmentEnd); pointIndex < pointCount;
+		pointIndex = findNextPoint(pointIndex + 1, segmentEnd))
 	{
-		float32 angle = float32(i + 2) * angleStep;
-		float32x2 newVertex = center + float32x2(Math::Cos(angle), Math::Sin(angle)) * radius;
+		float32x2 nextSegmentEnd = points[pointIndex];
+		float32 nextLength = VectorMath::Length(nextSegmentEnd - segmentEnd);
+		float32x2 nextDirection = (nextSegmentEnd - segmentEnd) / nextLength;
+
+		addStripJoin(segmentEnd, direction, length, nextDirection, nextLength, w, join);
+
+		segmentEnd = nextSegmentEnd;
+		length = nextLength;
+		direction = nextDirection;
+	}
 
-		vertices[i * 3 + 0] = { startVertex, color };
-		vertices[i * 3 + 1] = { prevVertex,  color };
-		vertices[i * 3 + 2] = { newVertex,   color };
+	normal = VectorMath::NormalLeft(direction) * w;
+	float32x2 endOffset = endCap == LineCap::Square ? direction * w : float32x2(0.0f, 0.0f);
+	addStripPair(segmentEnd + endOffset + normal, segmentEnd + endOffset - normal);
 
-		prevVertex = newVertex;
+	if (endCap == LineCap::Round)
+	{
+		for (uint32 i = capSegmentCount - 1; i > 0; i--)
+		{
+			float32x2 chordCenter = segmentEnd + direction * (w * capCosTable[i]);
+			float32x2 chordHalf = normal * capSinTable[i];
+			addStripPair(chordCenter + chordHalf, chordCenter - chordHalf);
+		}
+		addStripPoint(segmentEnd + direction * w);
 	}
+
+	stripStarted = false;
+}
+
+void GeometryGenerator::beginStrip(Color color)
+{
+	stripColor = color;
+	stripStarted = false;
 }
 
-inline void* GeometryGenerator::allocateVertices(uint32 size)
+void GeometryGenerator::addStripPair(float32x2 left, float32x2 right, bool keepLeft, bool keepRight)
 {
-	if (vertexBufferBytesUsed + size > vertexBufferSize)
+	uint32 pairVertexCount = (keepLeft ? 0 : 1) + (keepRight ? 0 : 1);
+
+	if (stripStarted && (vertexCount + pairVertexCount + 2 > MaxBatchVertexCount ||
+		indexCount + 6 > MaxBatchIndexCount))
+	{
 		flush();
 
-	void *result = cpuVertexBuffer + vertexBufferBytesUsed;
-	vertexBufferBytesUsed += size;
+		VertexColor2D *lastVertices = nullptr;
+		uint16 *lastIndices = nullptr;
+		uint16 base = allocate(2, 0, lastVertices, lastIndices);
+		lastVertices[0] = { stripLeft, stripColor };
+		lastVertices[1] = { stripRight, stripColor };
+		stripLeftIndex = base;
+		stripRightIndex = base + 1;
+	}
 
-	return result;
+	VertexColor2D *pairVertices = nullptr;
+	uint16 *pairIndices = nullptr;
+	uint16 base = allocate(pairVertexCount, stripStarted ? 6 : 0, pairVertices, pairIndices);
+
+	uint16 leftIndex = stripLeftIndex;
+	uint16 rightIndex = stripRightIndex;
+	if (!keepLeft)
+	{
+		*pairVertices++ = { left, stripColor };
+		leftIndex = base++;
+		stripLeft = left;
+	}
+	if (!keepRight)
+	{
+		*pairVertices++ = { right, stripColor };
+		rightIndex = base++;
+		stripRight = right;
+	}
+
+	if (stripStarted)
+	{
+		// Same orientation as quads of drawLine. Triangles that would repeat vertex are skipped.
+		uint32 pairIndexCount = 0;
+		if (leftIndex != stripLeftIndex && stripLeftIndex != stripRightIndex)
+		{
+			pairIndices[pairIndexCount++] = stripLeftIndex;
+			pairIndices[pairIndexCount++] = stripRightIndex;
+			pairIndices[pairIndexCount++] = leftIndex;
+		}
+		if (rightIndex != stripRightIndex && leftIndex != rightIndex)
+		{
+			pairIndices[pairIndexCount++] = stripRightIndex;
+			pairIndices[pairIndexCount++] = rightIndex;
+			pairIndices[pairIndexCount++] = leftIndex;
+		}
+		indexCount -= 6 - pairIndexCount;
+	}
+
+	stripLeftIndex = leftIndex;
+	stripRightIndex = rightIndex;
+	stripStarted = true;
+}
+
+void GeometryGenerator::addStripPoint(float32x2 point)
+{
+	// Single vertex is both sides of pair.
+	addStripPair(point, point, false, true);
+	stripRightIndex = stripLeftIndex;
+	stripRight = point;
+}
+
+void GeometryGenerator::addStripJoin(float32x2 point, float32x2 prevDirection, float32 prevLength,
+	float32x2 nextDirection, float32 nextLength, float32 halfWidth, LineJoin join)
+{
+	// Inner side of join is at intersection of segment sides, outer side is miter point, arc or
+	// bevel between segment normals. Intersection of short segments at sharp angle lies beyond
+	// their ends, so join point itself is used instead.
+
+	float32x2 prevNormal = VectorMath::NormalLeft(prevDirection) * halfWidth;
+	float32x2 nextNormal = VectorMath::NormalLeft(nextDirection) * halfWidth;
+	float32 cosine = VectorMath::Dot(prevDirection, nextDirection);
+	float32 sine = VectorMath::Cross(prevDirection, nextDirection);
+
+	bool leftInner = sine > 0.0f;
+	bool innerBeyondEnds = halfWidth * abs(sine) > min(prevLength, nextLength) * (1.0f + cosine);
+	bool miterFits = 1.0f + cosine >= 2.0f / (MiterLimit * MiterLimit);
+
+	// Miter offset points to left side, its projection on both normals is half width.
+	float32x2 miter = miterFits ? (prevNormal + nextNormal) / (1.0f + cosine) : float32x2(0.0f, 0.0f);
+	float32x2 inner = innerBeyondEnds ? point : point + (leftInner ? miter : -miter);
+
+	// Round join within single circle segment is closer to miter than to bevel.
+	float32 angle = Math::Acos(max(min(cosine, 1.0f), -1.0f));
+	float32 stepAngle = Math::PiF32 * 2.0f / float32(getCircleSegmentCount(halfWidth, 0));
+	if (join == LineJoin::Round && angle < stepAngle)
+		join = LineJoin::Miter;
+
+	if (join == LineJoin::Miter && miterFits)
+	{
+		float32x2 outer = point + (leftInner ? -miter : miter);
+		addStripPair(leftInner ? inner : outer, leftInner ? outer : inner);
+		return;
+	}
+
+	float32x2 outerOffset = leftInner ? -prevNormal : prevNormal;
+	float32x2 lastOuterOffset = leftInner ? -nextNormal : nextNormal;
+
+	if (leftInner)
+		addStripPair(inner, point + outerOffset);
+	else
+		addStripPair(point + outerOffset, inner);
+
+	if (join == LineJoin::Round)
+	{
+		// Outer offset is rotated in same direction as segment.
+		uint32 stepCount = uint32(angle / stepAngle) + 1;
+		float32 stepCos = Math::Cos(angle / float32(stepCount));
+		float32 stepSin = Math::Sin(angle / float32(stepCount)) * (leftInner ? 1.0f : -1.0f);
+
+		for (uint32 i = 1; i < stepCount; i++)
+		{
+			outerOffset = float32x2(
+				outerOffset.x * stepCos - outerOffset.y * stepSin,
+				outerOffset.x * stepSin + outerOffset.y * stepCos);
+			addStripPair(point + outerOffset, point + outerOffset, leftInner, !leftInner);
+		}
+	}
+
+	addStripPair(point + lastOuterOffset, point + lastOuterOffset, leftInner, !leftInner);
+}
+
+inline uint16 GeometryGenerator::allocate(uint32 allocationVertexCount, uint32 allocationIndexCount,
+	VertexColor2D*& allocatedVertices, uint16*& allocatedIndices)
+{
+	if (vertexCount + allocationVertexCount > MaxBatchVertexCount ||
+		indexCount + allocationIndexCount > MaxBatchIndexCount)
+	{
+		flush();
+	}
+
+	// Batch storage grows instead of flushing, so batch is split only by explicit flush or
+	// when indices run out.
+	if (vertexCount + allocationVertexCount > vertexCapacity)
+	{
+		while (vertexCount + allocationVertexCount > vertexCapacity)
+			vertexCapacity *= 2;
+		vertices.resize(vertexCapacity);
+	}
+	if (indexCount + allocationIndexCount > indexCapacity)
+	{
+		while (indexCount + allocationIndexCount > indexCapacity)
+			indexCapacity *= 2;
+		indices.resize(indexCapacity);
+	}
+
+	allocatedVertices = vertices + vertexCount;
+	allocatedIndices = indices + indexCount;
+	uint16 base = uint16(vertexCount);
+
+	vertexCount += allocationVertexCount;
+	indexCount += allocationIndexCount;
+	batchUploaded = false;
+
+	return base;
+}
+
+inline void GeometryGenerator::WriteQuadIndices(uint16* indices, uint16 a, uint16 b, uint16 c, uint16 d)
+{
+	indices[0] = a;
+	indices[1] = b;
+	indices[2] = c;
+	indices[3] = a;
+	indices[4] = c;
+	indices[5] = d;
 }
\ No newline at end of file
@@ -10,30 +10,126 @@
 
 namespace XLib::Graphics
 {
+	enum class LineJoin : uint8
+	{
+		Miter = 0,		// Beveled when miter is longer than limit.
+		Round,
+		Bevel,
+	};
+
+	enum class LineCap : uint8
+	{
+		Butt = 0,
+		Round,
+		Square,
+	};
+
+	struct GeometryGeneratorStats
+	{
+		uint32 vertexCount;		// Vertices flushed since stats reset.
+		uint32 indexCount;
+		uint32 flushCount;
+		uint32 drawCount;		// Draw calls, flush handler can draw batch several times.
+	};
+
+	// Primitives are indexed triangle lists, so quads take four vertices and fans and rings
+	// share their points. Batch grows until 16 bit indices run out, and is written once to
+	// dynamic vertex and index ring buffers on first draw, every other draw of the same batch
+	// reuses it. Writes go past the data of previous batches, which GPU may still read, and
+	// ring is discarded only when it wraps.
+	//
+	// Curved primitives are tessellated with power of two segment count that keeps vertices
+	// within tolerance of exact curve, so count follows radius in vertex space. Unit circle
+	// cos and sin are precomputed for every such count, and ellipse points are generated from
+	// them four at a time.
+
 	class GeometryGenerator : public XLib::NonCopyable
 	{
+	public:
+		// Called instead of drawing on flush, including implicit flush on buffer overflow.
+		// Handler can draw batch any number of times with draw(). Batch is discarded after.
+		using FlushHandler = void(*)(void* context);
+
+		static constexpr float32 DefaultTolerance = 0.25f;		// Max distance of tessellated curve from exact one.
+		static constexpr uint32 MinCircleSegmentCount = 8;
+		static constexpr uint32 MaxCircleSegmentCount = 256;
+
+		static constexpr float32 MiterLimit = 4.0f;		// Max ratio of miter length to half width.
+
+		static constexpr uint32 MaxBatchVertexCount = 0x10000;
+		static constexpr uint32 MaxBatchIndexCount = MaxBatchVertexCount * 3;
+
 	private:
+		static constexpr uint32 initialBatchVertexCount = 4096;
+		static constexpr float32 minSegmentLength = 1.0e-3f;		// Shorter polyline segments are skipped.
+
 		Device *device = nullptr;
-		Buffer gpuVertexBuffer;
-		HeapPtr<byte> cpuVertexBuffer;
-		uint32 vertexBufferSize = 0;
-		uint32 vertexBufferBytesUsed = 0;
+		Buffer vertexRingBuffer;
+		Buffer indexRingBuffer;
+		uint32 vertexRingSize = 0;
+		uint32 indexRingSize = 0;
+		uint32 vertexRingOffset = 0;		// Where next batch is written.
+		uint32 indexRingOffset = 0;
+
+		HeapPtr<VertexColor2D> vertices;
+		HeapPtr<uint16> indices;
+		uint32 vertexCapacity = 0;
+		uint32 indexCapacity = 0;
+		uint32 vertexCount = 0;
+		uint32 indexCount = 0;
+		uint32 batchVertexOffset = 0;		// In ring buffers, valid when batch is uploaded.
+		uint32 batchIndexOffset = 0;
+		bool batchUploaded = false;
+
+		FlushHandler flushHandler = nullptr;
+		void *flushHandlerContext = nullptr;
 
-		inline void* allocateVertices(uint32 size);
+		HeapPtr<float32> circleTables;		// Cos values followed by sin values, per segment count.
+		float32 tolerance = DefaultTolerance;
+		GeometryGeneratorStats stats = {};
 
-		template <typename VertexType>
-		inline VertexType* allocateVertices(uint32 count)
-			{ return (VertexType*)allocateVertices(count * sizeof(VertexType)); }
+		// Strip in progress. Last pair is written again when batch is flushed in the middle of strip.
+		float32x2 stripLeft = { 0.0f, 0.0f };
+		float32x2 stripRight = { 0.0f, 0.0f };
+		uint16 stripLeftIndex = 0;
+		uint16 stripRightIndex = 0;
+		Color stripColor = {};
+		bool stripStarted = false;
+
+		// Returns index of first allocated vertex in batch. Batch is flushed first if it is full.
+		inline uint16 allocate(uint32 vertexCount, uint32 indexCount,
+			VertexColor2D*& allocatedVertices, uint16*& allocatedIndices);
+		// Quad of four allocated vertices in clockwise order.
+		static inline void WriteQuadIndices(uint16* indices, uint16 a, uint16 b, uint16 c, uint16 d);
+
+		// Strip of left and right side point pairs, emitted as triangle list. Kept side reuses
+		// vertex of previous pair, so joins and caps fan around it without degenerate triangles.
+		void beginStrip(Color color);
+		void addStripPair(float32x2 left, float32x2 right, bool keepLeft = false, bool keepRight = false);
+		void addStripPoint(float32x2 point);
+		void addStripJoin(float32x2 point, float32x2 prevDirection, float32 prevLength,
+			float32x2 nextDirection, float32 nextLength, float32 halfWidth, LineJoin join);
+
+		// Zero segment count is derived from radius, other counts are rounded up to power of two.
+		uint32 getCircleSegmentCount(float32 radius, uint32 segmentCount) const;
+		const float32* getCircleTable(uint32 segmentCount);
 
 	public:
 		GeometryGenerator() = default;
 		~GeometryGenerator() = default;
 
-		void initialize(Device& device, uint32 vertexBufferSize = 65536);
+		// Ring buffers hold at least one full batch.
+		void initialize(Device& device, uint32 ringVertexCount = MaxBatchVertexCount * 2);
 		void destroy();
 
 		void discard();
 		void flush();
+		void draw();
+
+		inline void setFlushHandler(FlushHandler handler, void* context)
+			{ flushHandler = handler; flushHandlerContext = context; }
+		// In vertex space units. Geometry drawn scaled up needs proportionally lower tolerance.
+		inline void setTolerance(float32 tolerance) { this->tolerance = tolerance; }
 
 		void drawLine(float32x2 start, float32x2 end, float32 width, Color color,
 			bool roundedStart = false, bool roundedEnd = false);
@@ -41,8 +137,21 @@ namespace XLib::Graphics
 		void drawFilledRectWithBorder(const rectf32& rect, Color fillColor, Color borderColor, float32 borderWidth);
 		void drawRectShadow(const rectf32& rect, float32 width, Color color);
 		void drawVerticalGradientRect(const rectf32& rect, Color topColor, Color bottomColor);
-		void drawLeftHalfEllipseOnDiameter(float32x2 diameterStart, float32x2 diameterEnd, Color color, uint32 segmentCount = 16);
-		void drawEllipseBorder(float32x2 center, float32x2 radius, Color color, float32 width, uint32 segmentCount = 64);
-		void drawFilledEllipse(float32x2 center, float32x2 radius, Color color, uint32 segmentCount = 64);
+		// Segment count is of half ellipse.
+		void drawLeftHalfEllipseOnDiameter(float32x2 diameterStart, float32x2 diameterEnd, Color color, uint32 segmentCount = 0);
+		void drawEllipseBorder(float32x2 center, float32x2 radius, Color color, float32 width, uint32 segmentCount = 0);
+		void drawFilledEllipse(float32x2 center, float32x2 radius, Color color, uint32 segmentCount = 0);
+		// Whole polyline is single strip, so joins do not overlap segments and translucent
+		// strokes are blended once. Coincident points are skipped.
+		void drawPolyline(const float32x2* points, uint32 pointCount, float32 width, Color color,
+			LineJoin join = LineJoin::Miter, LineCap startCap = LineCap::Butt, LineCap endCap = LineCap::Butt);
+
+		inline const VertexColor2D* getVertices() { return vertices; }
+		inline const uint16* getIndices() { return indices; }
+		inline uint32 getVertexCount() const { return vertexCount; }
+		inline uint32 getIndexCount() const { return indexCount; }
+
+		inline const GeometryGeneratorStats& getStats() const { return stats; }
+		inline void resetStats() { stats = {}; }
 	};
 }
\ No newline at end of file
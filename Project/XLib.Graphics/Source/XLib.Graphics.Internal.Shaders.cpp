@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include <Windows.h>
 
 #include "XLib.Graphics.Internal.Shaders.h"
@@ -13,4 +15,6 @@ ShaderData Shaders::Color2DVS = { Color2DVSData, sizeof(Color2DVSData) };
 ShaderData Shaders::ColorPS = { ColorPSData, sizeof(ColorPSData) };
 
 ShaderData Shaders::Textured2DVS = { Textured2DVSData, sizeof(Textured2DVSData) };
-ShaderData Shaders::TexturedPS = { TexturedPSData, sizeof(TexturedPSData) };
\ No newline at end of file
+ShaderData Shaders::TexturedPS = { TexturedPSData, sizeof(TexturedPSData) };
+
+#endif
\ No newline at end of file
@@ -10,7 +10,7 @@ namespace XLib::Graphics::Internal
 		uint32 size;
 	};
 
-	class Shaders abstract final
+	class Shaders XLIB_ABSTRACT final
 	{
 	public:
 		static ShaderData Color2DVS;
@@ -0,0 +1,621 @@
+#include <emmintrin.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Memory.h>
+#include <XLib.System.Threading.WorkerPool.h>
+
+#include "XLib.Graphics.Internal.Software.h"
+
+using namespace XLib;
+using namespace XLib::Graphics::Internal;
+
+static constexpr uint32 cacheLineSize = 64;
+static constexpr sint64 subpixelScale = 256;
+static constexpr float32 coordinateLimit = float32(1 << 20);
+static constexpr uint64 parallelPixelCountThreshold = 128 * 128;
+static constexpr sint32 minBandHeight = 16;
+
+struct SoftwareRasterizer::DrawCall
+{
+	SoftwareShading shading;
+	SoftwareBlending blending;
+	SoftwareSurface *target;
+	SoftwareSurface *texture;
+	const Triangle *triangles;
+	uint32 triangleCount;
+};
+
+// Utils ====================================================================================//
+
+static inline sint64 FloorToSInt64(float64 value)
+{
+	sint64 result = sint64(value);
+	return float64(result) > value ? result - 1 : result;
+}
+
+static inline sint64 ToFixed(float32 value)
+{
+	return FloorToSInt64(float64(clamp(value, -coordinateLimit, coordinateLimit)) * subpixelScale + 0.5);
+}
+
+static inline sint64 FloorDiv(sint64 a, sint64 b) { return a >= 0 ? a / b : -((b - a - 1) / b); }
+static inline sint64 CeilDiv(sint64 a, sint64 b) { return a >= 0 ? (a + b - 1) / b : -(-a / b); }
+
+static inline bool IsNearlyEqual(float64 a, float64 b, float64 epsilon) { return abs(a - b) < epsilon; }
+
+static inline __m128i Div255U16(__m128i value)
+{
+	value = _mm_add_epi16(value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+// Four pixels at once.
+// Default:					rgb = src.rgb * src.a + dst.rgb * (1 - src.a), a = saturate(src.a + dst.a).
+// StraightToPremultiplied:	rgb = src.rgb * src.a + dst.rgb * (1 - src.a), a = src.a + dst.a * (1 - src.a).
+// Premultiplied:			rgba = src.rgba + dst.rgba * (1 - src.a).
+static inline __m128i BlendPixels(__m128i dst, __m128i src, SoftwareBlending blending)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(255);
+	const __m128i alphaMask = _mm_set1_epi32(sint32(0xFF000000));
+
+	__m128i srcLo = _mm_unpacklo_epi8(src, zero);
+	__m128i srcHi = _mm_unpackhi_epi8(src, zero);
+	__m128i dstLo = _mm_unpacklo_epi8(dst, zero);
+	__m128i dstHi = _mm_unpackhi_epi8(dst, zero);
+
+	__m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+	if (blending == SoftwareBlending::Premultiplied)
+	{
+		__m128i resultLo = _mm_add_epi16(srcLo, Div255U16(_mm_mullo_epi16(dstLo, _mm_sub_epi16(one, alphaLo))));
+		__m128i resultHi = _mm_add_epi16(srcHi, Div255U16(_mm_mullo_epi16(dstHi, _mm_sub_epi16(one, alphaHi))));
+		return _mm_packus_epi16(resultLo, resultHi);
+	}
+
+	// Source alpha channel multiplied by one gives src.a + dst.a * (1 - src.a).
+	if (blending == SoftwareBlending::StraightToPremultiplied)
+	{
+		srcLo = _mm_or_si128(srcLo, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+		srcHi = _mm_or_si128(srcHi, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+	}
+
+	__m128i resultLo = Div255U16(_mm_add_epi16(_mm_mullo_epi16(srcLo, alphaLo),
+		_mm_mullo_epi16(dstLo, _mm_sub_epi16(one, alphaLo))));
+	__m128i resultHi = Div255U16(_mm_add_epi16(_mm_mullo_epi16(srcHi, alphaHi),
+		_mm_mullo_epi16(dstHi, _mm_sub_epi16(one, alphaHi))));
+
+	__m128i color = _mm_packus_epi16(resultLo, resultHi);
+	if (blending == SoftwareBlending::StraightToPremultiplied)
+		return color;
+
+	__m128i alpha = _mm_adds_epu8(src, dst);
+	return _mm_or_si128(_mm_andnot_si128(alphaMask, color), _mm_and_si128(alphaMask, alpha));
+}
+
+static inline void BlendPixelsTo(uint32* dst, __m128i src, SoftwareBlending blending)
+{
+	const __m128i alphaMask = _mm_set1_epi32(sint32(0xFF000000));
+
+	__m128i srcAlpha = _mm_and_si128(src, alphaMask);
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, _mm_setzero_si128())) == 0xFFFF)
+		return;
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xFFFF)
+	{
+		_mm_storeu_si128((__m128i*)dst, src);
+		return;
+	}
+
+	_mm_storeu_si128((__m128i*)dst, BlendPixels(_mm_loadu_si128((__m128i*)dst), src, blending));
+}
+
+static inline void BlendPixelsTo(uint32* dst, __m128i src, uint32 count, SoftwareBlending blending)
+{
+	alignas(16) uint32 buffer[4] = {};
+	for (uint32 i = 0; i < count; i++)
+		buffer[i] = dst[i];
+	_mm_store_si128((__m128i*)buffer, BlendPixels(_mm_load_si128((__m128i*)buffer), src, blending));
+	for (uint32 i = 0; i < count; i++)
+		dst[i] = buffer[i];
+}
+
+static inline __m128i PackColors(__m128 c0, __m128 c1, __m128 c2, __m128 c3)
+{
+	__m128i c01 = _mm_packs_epi32(_mm_cvtps_epi32(c0), _mm_cvtps_epi32(c1));
+	__m128i c23 = _mm_packs_epi32(_mm_cvtps_epi32(c2), _mm_cvtps_epi32(c3));
+	return _mm_packus_epi16(c01, c23);
+}
+
+// Bilinear sample with clamp addressing. u, v are texel space coordinates (texel centers at integers).
+static inline uint32 SampleBilinear(SoftwareSurface& texture, float32 u, float32 v)
+{
+	u = clamp(u, 0.0f, float32(texture.width - 1));
+	v = clamp(v, 0.0f, float32(texture.height - 1));
+
+	uint32 x0 = uint32(u), y0 = uint32(v);
+	uint32 x1 = min(x0 + 1, texture.width - 1);
+	uint32 y1 = min(y0 + 1, texture.height - 1);
+	sint16 fx = sint16((u - float32(x0)) * 128.0f);
+	sint16 fy = sint16((v - float32(y0)) * 128.0f);
+
+	const uint32 *row0 = texture.getRow(y0);
+	const uint32 *row1 = texture.getRow(y1);
+
+	const __m128i zero = _mm_setzero_si128();
+	__m128i top = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, row0[x1], row0[x0]), zero);
+	__m128i bottom = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, row1[x1], row1[x0]), zero);
+
+	__m128i vertical = _mm_add_epi16(top,
+		_mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, top), _mm_set1_epi16(fy)), 7));
+	__m128i right = _mm_srli_si128(vertical, 8);
+	__m128i result = _mm_add_epi16(vertical,
+		_mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(right, vertical), _mm_set1_epi16(fx)), 7));
+
+	return uint32(_mm_cvtsi128_si32(_mm_packus_epi16(result, result)));
+}
+
+// Span shaders =============================================================================//
+
+static void FillSpanFlat(uint32* row, sint32 left, sint32 right, uint32 color, SoftwareBlending blending)
+{
+	uint32 alpha = color >> 24;
+	if (!alpha)
+		return;
+
+	uint32 *pixels = row + left;
+	uint32 count = uint32(right - left);
+	__m128i src = _mm_set1_epi32(sint32(color));
+
+	uint32 i = 0;
+	if (alpha == 0xFF)
+	{
+		for (; i < count && (uintptr(pixels + i) & 15); i++)
+			pixels[i] = color;
+		for (; i + 4 <= count; i += 4)
+			_mm_store_si128((__m128i*)(pixels + i), src);
+		for (; i < count; i++)
+			pixels[i] = color;
+		return;
+	}
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i*)(pixels + i), BlendPixels(_mm_loadu_si128((__m128i*)(pixels + i)), src, blending));
+	if (i < count)
+		BlendPixelsTo(pixels + i, src, count - i, blending);
+}
+
+static void FillSpanGradient(uint32* row, sint32 left, sint32 right,
+	const float32* start, const float32* step, SoftwareBlending blending)
+{
+	uint32 *pixels = row + left;
+	uint32 count = uint32(right - left);
+
+	__m128 color = _mm_loadu_ps(start);
+	__m128 step1 = _mm_loadu_ps(step);
+	__m128 step2 = _mm_add_ps(step1, step1);
+	__m128 step3 = _mm_add_ps(step2, step1);
+	__m128 step4 = _mm_add_ps(step2, step2);
+
+	for (uint32 i = 0; i < count; i += 4)
+	{
+		__m128i src = PackColors(color,
+			_mm_add_ps(color, step1), _mm_add_ps(color, step2), _mm_add_ps(color, step3));
+		if (i + 4 <= count)
+			BlendPixelsTo(pixels + i, src, blending);
+		else
+			BlendPixelsTo(pixels + i, src, count - i, blending);
+		color = _mm_add_ps(color, step4);
+	}
+}
+
+static void CopySpanBlend(uint32* row, sint32 left, sint32 right, const uint32* srcRow, SoftwareBlending blending)
+{
+	uint32 *pixels = row + left;
+	const uint32 *srcPixels = srcRow + left;
+	uint32 count = uint32(right - left);
+
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+		BlendPixelsTo(pixels + i, _mm_loadu_si128((const __m128i*)(srcPixels + i)), blending);
+	if (i < count)
+	{
+		alignas(16) uint32 buffer[4] = {};
+		for (uint32 j = 0; i + j < count; j++)
+			buffer[j] = srcPixels[i + j];
+		BlendPixelsTo(pixels + i, _mm_load_si128((__m128i*)buffer), count - i, blending);
+	}
+}
+
+static void SampleSpan(uint32* row, sint32 left, sint32 right,
+	SoftwareSurface& texture, float32 u, float32 v, float32 du, float32 dv, SoftwareBlending blending)
+{
+	uint32 *pixels = row + left;
+	uint32 count = uint32(right - left);
+
+	for (uint32 i = 0; i < count; i += 4)
+	{
+		alignas(16) uint32 buffer[4] = {};
+		uint32 blockSize = min<uint32>(count - i, 4);
+		for (uint32 j = 0; j < blockSize; j++)
+		{
+			buffer[j] = SampleBilinear(texture, u, v);
+			u += du;
+			v += dv;
+		}
+
+		__m128i src = _mm_load_si128((__m128i*)buffer);
+		if (blockSize == 4)
+			BlendPixelsTo(pixels + i, src, blending);
+		else
+			BlendPixelsTo(pixels + i, src, blockSize, blending);
+	}
+}
+
+// SoftwareSurfacePtr =======================================================================//
+
+bool SoftwareSurfacePtr::create(uint32 width, uint32 height)
+{
+	destroy();
+
+	if (!width || !height)
+		return false;
+
+	uint32 rowPitch = alignup(width * 4, cacheLineSize);
+	uintptr pixelsSize = uintptr(rowPitch) * height;
+
+	byte *block = (byte*)Heap::Allocate(alignup(sizeof(SoftwareSurface), cacheLineSize) + cacheLineSize + pixelsSize);
+	if (!block)
+		return false;
+
+	surface = (SoftwareSurface*)block;
+	surface->pixels = (byte*)alignup(uintptr(block) + sizeof(SoftwareSurface), uintptr(cacheLineSize));
+	surface->width = width;
+	surface->height = height;
+	surface->rowPitch = rowPitch;
+	Memory::Set(surface->pixels, 0, pixelsSize);
+
+	return true;
+}
+
+void SoftwareSurfacePtr::destroy()
+{
+	if (surface)
+	{
+		Heap::Release(surface);
+		surface = nullptr;
+	}
+}
+
+// SoftwareRasterizer =======================================================================//
+
+void SoftwareRasterizer::initialize()
+{
+	renderTarget = nullptr;
+	texture = nullptr;
+	viewport = {};
+	scissorRect = { 0, 0, uint32(-1), uint32(-1) };
+	transform = Matrix2x3::Identity();
+	triangles.clear();
+
+	WorkerPool::Global.initialize();
+}
+
+void SoftwareRasterizer::clear(SoftwareSurface* surface, Color color)
+{
+	if (!surface)
+		return;
+
+	for (uint32 y = 0; y < surface->height; y++)
+	{
+		uint32 *row = surface->getRow(y);
+		__m128i value = _mm_set1_epi32(sint32(color.rgba));
+
+		uint32 x = 0;
+		for (; x + 4 <= surface->width; x += 4)
+			_mm_store_si128((__m128i*)(row + x), value);
+		for (; x < surface->width; x++)
+			row[x] = color.rgba;
+	}
+}
+
+void SoftwareRasterizer::upload(SoftwareSurface* surface, const rectu32& region,
+	const void* srcData, uint32 srcDataStride)
+{
+	uint32 rowLength = region.getWidth() * 4;
+	for (uint32 i = 0; i < region.getHeight(); i++)
+	{
+		Memory::Copy(surface->getRow(region.top + i) + region.left,
+			to<const byte*>(srcData) + uintptr(srcDataStride) * i, rowLength);
+	}
+}
+
+void SoftwareRasterizer::download(SoftwareSurface* surface, const rectu32& region,
+	void* dstData, uint32 dstDataStride)
+{
+	uint32 rowLength = region.getWidth() * 4;
+	for (uint32 i = 0; i < region.getHeight(); i++)
+	{
+		Memory::Copy(to<byte*>(dstData) + uintptr(dstDataStride) * i,
+			surface->getRow(region.top + i) + region.left, rowLength);
+	}
+}
+
+void SoftwareRasterizer::copy(SoftwareSurface* dstSurface, SoftwareSurface* srcSurface,
+	uint32x2 dstLocation, const rectu32& srcRegion)
+{
+	uint32 rowLength = srcRegion.getWidth() * 4;
+	for (uint32 i = 0; i < srcRegion.getHeight(); i++)
+	{
+		Memory::Move(dstSurface->getRow(dstLocation.y + i) + dstLocation.x,
+			srcSurface->getRow(srcRegion.top + i) + srcRegion.left, rowLength);
+	}
+}
+
+void SoftwareRasterizer::drawTriangles(SoftwareShading shading, bool strip,
+	const void* vertices, uint32 vertexStride, uint32 count, const uint16* indices)
+{
+	if (!renderTarget || count < 3)
+		return;
+	if (shading == SoftwareShading::TexturedUnorm && !texture)
+		return;
+
+	sint32 clipLeft = sint32(min(max(viewport.left, scissorRect.left), renderTarget->width));
+	sint32 clipTop = sint32(min(max(viewport.top, scissorRect.top), renderTarget->height));
+	sint32 clipRight = sint32(min(min(viewport.right, scissorRect.right), renderTarget->width));
+	sint32 clipBottom = sint32(min(min(viewport.bottom, scissorRect.bottom), renderTarget->height));
+	if (clipLeft >= clipRight || clipTop >= clipBottom)
+		return;
+
+	Matrix2x3 screenTransform = Matrix2x3::Translation(float32(viewport.left), float32(viewport.top)) * transform;
+	uint32 triangleCount = strip ? count - 2 : count / 3;
+
+	triangles.clear();
+	sint32 drawTop = clipBottom, drawBottom = clipTop;
+	uint64 pixelCount = 0;
+
+	for (uint32 triangleIndex = 0; triangleIndex < triangleCount; triangleIndex++)
+	{
+		uint32 triangleIndices[3];
+		if (!strip)
+		{
+			triangleIndices[0] = triangleIndex * 3;
+			triangleIndices[1] = triangleIndex * 3 + 1;
+			triangleIndices[2] = triangleIndex * 3 + 2;
+		}
+		else
+		{
+			// Odd strip triangles are flipped to keep winding consistent.
+			bool odd = (triangleIndex & 1) != 0;
+			triangleIndices[0] = triangleIndex + (odd ? 1 : 0);
+			triangleIndices[1] = triangleIndex + (odd ? 0 : 1);
+			triangleIndices[2] = triangleIndex + 2;
+		}
+
+		if (indices)
+		{
+			for (uint32 i = 0; i < 3; i++)
+				triangleIndices[i] = indices[triangleIndices[i]];
+		}
+
+		const byte *vertexData[3];
+		float32x2 positions[3];
+		sint64 x[3], y[3];
+		for (uint32 i = 0; i < 3; i++)
+		{
+			vertexData[i] = to<const byte*>(vertices) + uintptr(vertexStride) * triangleIndices[i];
+			positions[i] = *to<const float32x2*>(vertexData[i]) * screenTransform;
+			x[i] = ToFixed(positions[i].x);
+			y[i] = ToFixed(positions[i].y);
+		}
+
+		// Back faces (counter clockwise in y-down space) and degenerate triangles are culled.
+		sint64 doubleArea = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		if (doubleArea <= 0)
+			continue;
+
+		sint64 minX = min(x[0], min(x[1], x[2])), maxX = max(x[0], max(x[1], x[2]));
+		sint64 minY = min(y[0], min(y[1], y[2])), maxY = max(y[0], max(y[1], y[2]));
+
+		sint32 left = sint32(max<sint64>(FloorDiv(minX, subpixelScale), clipLeft));
+		sint32 top = sint32(max<sint64>(FloorDiv(minY, subpixelScale), clipTop));
+		sint32 right = sint32(min<sint64>(FloorDiv(maxX, subpixelScale) + 1, clipRight));
+		sint32 bottom = sint32(min<sint64>(FloorDiv(maxY, subpixelScale) + 1, clipBottom));
+		if (left >= right || top >= bottom)
+			continue;
+
+		Triangle &triangle = triangles.allocateBack();
+		triangle.left = left;
+		triangle.top = top;
+		triangle.right = right;
+		triangle.bottom = bottom;
+
+		for (uint32 i = 0; i < 3; i++)
+		{
+			uint32 j = (i + 1) % 3;
+			sint64 a = y[i] - y[j];
+			sint64 b = x[j] - x[i];
+			bool topLeft = a > 0 || (a == 0 && b > 0);
+
+			triangle.a[i] = a;
+			triangle.b[i] = b;
+			triangle.c[i] = (y[j] - y[i]) * x[i] - (x[j] - x[i]) * y[i] - (topLeft ? 0 : 1);
+		}
+
+		float64 attributes[3][4] = {};
+		if (shading == SoftwareShading::PerVertexColor)
+		{
+			uint32 colors[3];
+			for (uint32 i = 0; i < 3; i++)
+			{
+				colors[i] = *to<const uint32*>(vertexData[i] + sizeof(float32x2));
+				for (uint32 channel = 0; channel < 4; channel++)
+					attributes[i][channel] = float64((colors[i] >> (channel * 8)) & 0xFF);
+			}
+
+			triangle.flatColor = colors[0];
+			triangle.isFlatColor = colors[0] == colors[1] && colors[0] == colors[2];
+		}
+		else
+		{
+			for (uint32 i = 0; i < 3; i++)
+			{
+				uint16x2 texcoord = *to<const uint16x2*>(vertexData[i] + sizeof(float32x2));
+				attributes[i][0] = float64(texcoord.x) / 65535.0 * texture->width - 0.5;
+				attributes[i][1] = float64(texcoord.y) / 65535.0 * texture->height - 0.5;
+			}
+		}
+
+		// Attribute planes from floating point positions, shifted to pixel centers.
+		float64 dx1 = positions[1].x - positions[0].x, dy1 = positions[1].y - positions[0].y;
+		float64 dx2 = positions[2].x - positions[0].x, dy2 = positions[2].y - positions[0].y;
+		float64 planeArea = dx1 * dy2 - dx2 * dy1;
+		if (planeArea == 0.0)
+			planeArea = 1.0;
+
+		float64 bases[4], stepsX[4], stepsY[4];
+		for (uint32 channel = 0; channel < 4; channel++)
+		{
+			float64 da1 = attributes[1][channel] - attributes[0][channel];
+			float64 da2 = attributes[2][channel] - attributes[0][channel];
+			stepsX[channel] = (da1 * dy2 - da2 * dy1) / planeArea;
+			stepsY[channel] = (da2 * dx1 - da1 * dx2) / planeArea;
+			bases[channel] = attributes[0][channel] +
+				stepsX[channel] * (0.5 - positions[0].x) + stepsY[channel] * (0.5 - positions[0].y);
+
+			triangle.attributeBase[channel] = float32(bases[channel]);
+			triangle.attributeDX[channel] = float32(stepsX[channel]);
+			triangle.attributeDY[channel] = float32(stepsY[channel]);
+		}
+
+		// Texel aligned 1:1 mapping is blitted directly without filtering.
+		triangle.isTexelAligned = false;
+		if (shading == SoftwareShading::TexturedUnorm)
+		{
+			constexpr float64 epsilon = 1.0 / 512.0;
+			float64 offsetX = float64(FloorToSInt64(bases[0] + 0.5));
+			float64 offsetY = float64(FloorToSInt64(bases[1] + 0.5));
+
+			triangle.isTexelAligned =
+				IsNearlyEqual(stepsX[0] * (right - left), float64(right - left), epsilon) &&
+				IsNearlyEqual(stepsY[1] * (bottom - top), float64(bottom - top), epsilon) &&
+				IsNearlyEqual(stepsY[0] * (bottom - top), 0.0, epsilon) &&
+				IsNearlyEqual(stepsX[1] * (right - left), 0.0, epsilon) &&
+				IsNearlyEqual(bases[0] + stepsX[0] * left, offsetX + left, epsilon) &&
+				IsNearlyEqual(bases[1] + stepsY[1] * top, offsetY + top, epsilon);
+			triangle.texelOffsetX = sint32(offsetX);
+			triangle.texelOffsetY = sint32(offsetY);
+		}
+
+		drawTop = min(drawTop, top);
+		drawBottom = max(drawBottom, bottom);
+		pixelCount += uint64(right - left) * uint64(bottom - top);
+	}
+
+	if (triangles.isEmpty())
+		return;
+
+	DrawCall drawCall;
+	drawCall.shading = shading;
+	drawCall.blending = blending;
+	drawCall.target = renderTarget;
+	drawCall.texture = texture;
+	drawCall.triangles = triangles;
+	drawCall.triangleCount = triangles.getSize();
+
+	// Every band walks the whole triangle list, so primitive order inside a band is preserved.
+	WorkerPool &workerPool = WorkerPool::Global;
+	sint32 rowCount = drawBottom - drawTop;
+	uint32 bandCount = min<uint32>(workerPool.getConcurrency() * 4, uint32(intdivceil(rowCount, minBandHeight)));
+	if (pixelCount < parallelPixelCountThreshold || bandCount <= 1)
+	{
+		RasterizeBand(drawCall, drawTop, drawBottom);
+		return;
+	}
+
+	sint32 bandHeight = intdivceil(rowCount, sint32(bandCount));
+	auto rasterizeBands = [&drawCall, drawTop, drawBottom, bandHeight](uint32 begin, uint32 end)
+	{
+		for (uint32 band = begin; band < end; band++)
+		{
+			sint32 bandTop = drawTop + sint32(band) * bandHeight;
+			RasterizeBand(drawCall, bandTop, min(bandTop + bandHeight, drawBottom));
+		}
+	};
+	workerPool.parallelFor(bandCount, 1, rasterizeBands);
+}
+
+void SoftwareRasterizer::RasterizeBand(const DrawCall& drawCall, sint32 bandTop, sint32 bandBottom)
+{
+	SoftwareSurface &target = *drawCall.target;
+
+	for (uint32 triangleIndex = 0; triangleIndex < drawCall.triangleCount; triangleIndex++)
+	{
+		const Triangle &triangle = drawCall.triangles[triangleIndex];
+
+		sint32 top = max(triangle.top, bandTop);
+		sint32 bottom = min(triangle.bottom, bandBottom);
+
+		for (sint32 y = top; y < bottom; y++)
+		{
+			// Exact span from the edge functions: a * (x * 256 + 128) + b * py + c >= 0.
+			sint64 py = sint64(y) * subpixelScale + subpixelScale / 2;
+			sint64 left = triangle.left, right = triangle.right;
+
+			for (uint32 i = 0; i < 3; i++)
+			{
+				sint64 a = triangle.a[i];
+				sint64 k = triangle.b[i] * py + triangle.c[i];
+				sint64 t = -(a * (subpixelScale / 2) + k);
+
+				if (a > 0)
+					left = max(left, CeilDiv(t, a * subpixelScale));
+				else if (a < 0)
+					right = min(right, FloorDiv(-t, -a * subpixelScale) + 1);
+				else if (k < 0)
+					right = left;
+			}
+
+			if (left >= right)
+				continue;
+
+			sint32 spanLeft = sint32(left), spanRight = sint32(right);
+			uint32 *row = target.getRow(uint32(y));
+
+			float32 start[4];
+			for (uint32 channel = 0; channel < 4; channel++)
+			{
+				start[channel] = triangle.attributeBase[channel] +
+					triangle.attributeDX[channel] * float32(spanLeft) +
+					triangle.attributeDY[channel] * float32(y);
+			}
+
+			if (drawCall.shading == SoftwareShading::PerVertexColor)
+			{
+				if (triangle.isFlatColor)
+					FillSpanFlat(row, spanLeft, spanRight, triangle.flatColor, drawCall.blending);
+				else
+					FillSpanGradient(row, spanLeft, spanRight, start, triangle.attributeDX, drawCall.blending);
+				continue;
+			}
+
+			SoftwareSurface &texture = *drawCall.texture;
+			sint32 texelY = y + triangle.texelOffsetY;
+			sint32 texelLeft = spanLeft + triangle.texelOffsetX;
+			sint32 texelRight = spanRight + triangle.texelOffsetX;
+
+			if (triangle.isTexelAligned && texelY >= 0 && texelY < sint32(texture.height) &&
+				texelLeft >= 0 && texelRight <= sint32(texture.width))
+			{
+				CopySpanBlend(row, spanLeft, spanRight,
+					texture.getRow(uint32(texelY)) + triangle.texelOffsetX, drawCall.blending);
+			}
+			else
+			{
+				SampleSpan(row, spanLeft, spanRight, texture,
+					start[0], start[1], triangle.attributeDX[0], triangle.attributeDX[1], drawCall.blending);
+			}
+		}
+	}
+}
\ No newline at end of file
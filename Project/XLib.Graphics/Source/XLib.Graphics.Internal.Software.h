@@ -0,0 +1,115 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Color.h>
+#include <XLib.Vectors.h>
+#include <XLib.Math.Matrix2x3.h>
+#include <XLib.Containers.Vector.h>
+
+namespace XLib::Graphics::Internal
+{
+	// RGBA8 surface of the software device. Storage and rows are cache line aligned.
+
+	struct SoftwareSurface
+	{
+		byte *pixels;
+		uint32 width, height;
+		uint32 rowPitch;
+
+		inline uint32* getRow(uint32 y) { return (uint32*)(pixels + uintptr(rowPitch) * y); }
+	};
+
+	class SoftwareSurfacePtr : public XLib::NonCopyable
+	{
+	private:
+		SoftwareSurface *surface = nullptr;
+
+	public:
+		SoftwareSurfacePtr() = default;
+		inline ~SoftwareSurfacePtr() { destroy(); }
+
+		inline SoftwareSurfacePtr(SoftwareSurfacePtr&& that) : surface(that.surface) { that.surface = nullptr; }
+		inline SoftwareSurfacePtr& operator = (SoftwareSurfacePtr&& that) { swap(surface, that.surface); return *this; }
+
+		bool create(uint32 width, uint32 height);
+		void destroy();
+
+		inline SoftwareSurface* get() { return surface; }
+		inline bool isInitialized() { return surface ? true : false; }
+	};
+
+	enum class SoftwareShading : uint8
+	{
+		PerVertexColor = 0,
+		TexturedUnorm = 1,
+	};
+
+	enum class SoftwareBlending : uint8
+	{
+		Default = 0,
+		StraightToPremultiplied = 1,
+		Premultiplied = 2,
+	};
+
+	// Triangle rasterizer that mirrors the fixed pipeline state of the hardware device:
+	// clockwise front faces, top-left fill rule, scissor test, bilinear clamp sampling
+	// and blend states of the hardware device.
+	// Vertices are read as float32x2 position followed by uint32 color or uint16x2 texcoord.
+
+	class SoftwareRasterizer : public XLib::NonCopyable
+	{
+	private:
+		struct Triangle
+		{
+			// Edge functions in 24.8 fixed point, top-left rule bias is folded into c.
+			sint64 a[3], b[3], c[3];
+			sint32 left, top, right, bottom;
+
+			// Attribute planes evaluated at pixel centers: color channels or texel coordinates.
+			float32 attributeBase[4];
+			float32 attributeDX[4];
+			float32 attributeDY[4];
+
+			uint32 flatColor;
+			sint32 texelOffsetX, texelOffsetY;
+			bool isFlatColor;
+			bool isTexelAligned;
+		};
+
+		struct DrawCall;
+
+		SoftwareSurface *renderTarget = nullptr;
+		SoftwareSurface *texture = nullptr;
+		rectu32 viewport = {};
+		rectu32 scissorRect = {};
+		Matrix2x3 transform = {};
+		SoftwareBlending blending = SoftwareBlending::Default;
+
+		Vector<Triangle> triangles;
+
+		static void RasterizeBand(const DrawCall& drawCall, sint32 top, sint32 bottom);
+
+	public:
+		SoftwareRasterizer() = default;
+		~SoftwareRasterizer() = default;
+
+		void initialize();
+
+		inline void setRenderTarget(SoftwareSurface* surface) { renderTarget = surface; }
+		inline void setTexture(SoftwareSurface* surface) { texture = surface; }
+		inline void setViewport(const rectu32& rect) { viewport = rect; }
+		inline void setScissorRect(const rectu32& rect) { scissorRect = rect; }
+		inline void setTransform(const Matrix2x3& matrix) { transform = matrix; }
+		inline void setBlending(SoftwareBlending mode) { blending = mode; }
+
+		void clear(SoftwareSurface* surface, Color color);
+		void upload(SoftwareSurface* surface, const rectu32& region, const void* srcData, uint32 srcDataStride);
+		void download(SoftwareSurface* surface, const rectu32& region, void* dstData, uint32 dstDataStride);
+		void copy(SoftwareSurface* dstSurface, SoftwareSurface* srcSurface, uint32x2 dstLocation, const rectu32& srcRegion);
+
+		// Count is of indices when they are given.
+		void drawTriangles(SoftwareShading shading, bool strip,
+			const void* vertices, uint32 vertexStride, uint32 count, const uint16* indices = nullptr);
+	};
+}
\ No newline at end of file
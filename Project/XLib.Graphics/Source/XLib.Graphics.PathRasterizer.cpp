@@ -0,0 +1,602 @@
+#include <immintrin.h>
+
+#include <XLib.Util.h>
+#include <XLib.Heap.h>
+#include <XLib.Memory.h>
+#include <XLib.Debug.h>
+#include <XLib.Math.h>
+#include <XLib.Vectors.Arithmetics.h>
+#include <XLib.Vectors.Math.h>
+#include <XLib.Benchmark.h>
+#include <XLib.System.Threading.WorkerPool.h>
+#include <XLib.System.Profiler.h>
+
+#include "XLib.Graphics.PathRasterizer.h"
+
+using namespace XLib;
+using namespace XLib::Graphics;
+
+static constexpr uint32 minBandHeight = 16;
+static constexpr uint32 minBandPixelCount = 128 * 128;
+
+struct FillContext
+{
+	const float32x2 *edges;		// Pairs of edge points relative to filled rect.
+	const uint32 *bandEdges;	// Indices of edges crossing each band, in band order.
+	const uint32 *bandEdgeOffsets;
+	uint32 width;
+	uint32 height;
+	uint32 bandHeight;
+	uint32 accumulationStride;
+	byte *dstData;				// At left top of filled rect.
+	uint32 dstDataStride;
+	__m128 colorChannels[3];
+	__m128 colorAlpha;
+	__m128i opaqueColor;		// Color with full alpha, for fully covered pixels of opaque fill.
+	bool opaque;
+	FillRule rule;
+};
+
+// Accumulation ===============================================================================//
+
+static inline uint32 CeilToU32(float32 value)
+{
+	uint32 result = uint32(value);
+	return float32(result) < value ? result + 1 : result;
+}
+
+// Edge covers part of every pixel it crosses in a row and whole pixels to the right of it.
+// Area of edge inside pixel goes to that pixel and the rest of row height to the next one, so
+// prefix sum along row gives coverage (as in font-rs). Edge x must be in [0, width].
+static void AccumulateEdge(float32* accumulation, uint32 stride, float32 bandTop, uint32 bandHeight,
+	float32x2 start, float32x2 end)
+{
+	if (start.y == end.y)
+		return;
+
+	float32 direction = 1.0f;
+	if (start.y > end.y)
+	{
+		swap(start, end);
+		direction = -1.0f;
+	}
+
+	float32 bandBottom = bandTop + float32(bandHeight);
+	if (end.y <= bandTop || start.y >= bandBottom)
+		return;
+
+	float32 dxdy = (end.x - start.x) / (end.y - start.y);
+	float32 top = max(start.y, bandTop);
+	float32 bottom = min(end.y, bandBottom);
+	float32 x = max(start.x + (top - start.y) * dxdy, 0.0f);
+
+	uint32 rowBegin = uint32(top - bandTop);
+	uint32 rowEnd = min(CeilToU32(bottom - bandTop), bandHeight);
+
+	for (uint32 row = rowBegin; row < rowEnd; row++)
+	{
+		float32 rowTop = bandTop + float32(row);
+		float32 dy = min(rowTop + 1.0f, bottom) - max(rowTop, top);
+		float32 nextX = max(x + dxdy * dy, 0.0f);
+		float32 d = dy * direction;
+
+		float32 left = min(x, nextX);
+		float32 right = max(x, nextX);
+		uint32 leftIndex = uint32(left);
+		uint32 rightIndex = CeilToU32(right);
+		float32 *acc = accumulation + uintptr(row) * stride;
+
+		if (rightIndex <= leftIndex + 1)
+		{
+			float32 middle = 0.5f * (x + nextX) - float32(leftIndex);
+			acc[leftIndex] += d - d * middle;
+			acc[leftIndex + 1] += d * middle;
+		}
+		else
+		{
+			float32 inverseWidth = 1.0f / (right - left);
+			float32 leftFraction = left - float32(leftIndex);
+			float32 rightFraction = right - float32(rightIndex) + 1.0f;
+			float32 leftArea = 0.5f * inverseWidth * (1.0f - leftFraction) * (1.0f - leftFraction);
+			float32 rightArea = 0.5f * inverseWidth * rightFraction * rightFraction;
+
+			acc[leftIndex] += d * leftArea;
+			if (rightIndex == leftIndex + 2)
+			{
+				acc[leftIndex + 1] += d * (1.0f - leftArea - rightArea);
+			}
+			else
+			{
+				float32 area = inverseWidth * (1.5f - leftFraction);
+				acc[leftIndex + 1] += d * (area - leftArea);
+				for (uint32 i = leftIndex + 2; i < rightIndex - 1; i++)
+					acc[i] += d * inverseWidth;
+				area += float32(rightIndex - leftIndex - 3) * inverseWidth;
+				acc[rightIndex - 1] += d * (1.0f - area - rightArea);
+			}
+			acc[rightIndex] += d * rightArea;
+		}
+
+		x = nextX;
+	}
+}
+
+// Parts of edge outside of [0, width] are moved onto the nearest side, which keeps coverage
+// of pixels inside.
+static void AccumulateClippedEdge(float32* accumulation, uint32 stride, float32 bandTop, uint32 bandHeight,
+	float32 width, float32x2 start, float32x2 end)
+{
+	float32 splits[4] = { 0.0f, 1.0f, 1.0f, 1.0f };
+	uint32 splitCount = 1;
+
+	float32 dx = end.x - start.x;
+	if ((start.x < 0.0f) != (end.x < 0.0f))
+		splits[splitCount++] = -start.x / dx;
+	if ((start.x > width) != (end.x > width))
+		splits[splitCount++] = (width - start.x) / dx;
+	if (splitCount == 3 && splits[1] > splits[2])
+		swap(splits[1], splits[2]);
+	splits[splitCount] = 1.0f;
+
+	float32x2 delta = end - start;
+	float32x2 pieceStart = start;
+	for (uint32 i = 1; i <= splitCount; i++)
+	{
+		float32x2 pieceEnd = i == splitCount ? end : start + delta * splits[i];
+		AccumulateEdge(accumulation, stride, bandTop, bandHeight,
+			float32x2(Math::Clamp(pieceStart.x, 0.0f, width), pieceStart.y),
+			float32x2(Math::Clamp(pieceEnd.x, 0.0f, width), pieceEnd.y));
+		pieceStart = pieceEnd;
+	}
+}
+
+// Fill =======================================================================================//
+
+// Straight alpha source-over of four pixels. Channels are blended as premultiplied and
+// divided by result alpha.
+static inline __m128i BlendPixels(const FillContext& context, __m128i dst, __m128 coverage)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 inverse255 = _mm_set1_ps(1.0f / 255.0f);
+
+	__m128 srcAlpha = _mm_mul_ps(coverage, context.colorAlpha);
+	__m128 dstAlpha = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(dst, 24)), inverse255);
+	__m128 dstWeight = _mm_mul_ps(dstAlpha, _mm_sub_ps(one, srcAlpha));
+	__m128 resultAlpha = _mm_add_ps(srcAlpha, dstWeight);
+
+	// Result alpha is zero only together with both weights.
+	__m128 inverseResultAlpha = _mm_div_ps(one, _mm_max_ps(resultAlpha, _mm_set1_ps(1.0e-6f)));
+	__m128 srcScale = _mm_mul_ps(srcAlpha, inverseResultAlpha);
+	__m128 dstScale = _mm_mul_ps(dstWeight, inverseResultAlpha);
+
+	__m128i result = _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(resultAlpha, _mm_set1_ps(255.0f))), 24);
+	for (uint32 i = 0; i < 3; i++)
+	{
+		__m128 dstChannel = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(dst, i * 8), byteMask));
+		__m128 channel = _mm_add_ps(_mm_mul_ps(context.colorChannels[i], srcScale), _mm_mul_ps(dstChannel, dstScale));
+		result = _mm_or_si128(result, _mm_slli_epi32(_mm_cvtps_epi32(channel), i * 8));
+	}
+	return result;
+}
+
+static inline __m128 GetCoverage(__m128 sum, FillRule rule)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), sum);
+
+	if (rule == FillRule::NonZero)
+		return _mm_min_ps(magnitude, one);
+
+	// Winding modulo two, folded so that odd windings are covered.
+	__m128 half = _mm_mul_ps(magnitude, _mm_set1_ps(0.5f));
+	__m128 remainder = _mm_sub_ps(magnitude, _mm_add_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(half)),
+		_mm_cvtepi32_ps(_mm_cvttps_epi32(half))));
+	return _mm_sub_ps(one, _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(remainder, one)));
+}
+
+// Prefix sum of accumulation row gives winding of pixels. Row is cleared while it is read.
+static void FillRow(const FillContext& context, float32* acc, uint32* dstRow)
+{
+	const __m128 zero = _mm_setzero_ps();
+	__m128 carry = zero;
+
+	uint32 width = context.width;
+	for (uint32 x = 0; x < width; x += 4)
+	{
+		__m128 sum = _mm_load_ps(acc + x);
+		_mm_store_ps(acc + x, zero);
+		sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4)));
+		sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 8)));
+		sum = _mm_add_ps(sum, carry);
+		carry = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+
+		__m128 coverage = GetCoverage(sum, context.rule);
+		int coveredMask = _mm_movemask_ps(_mm_cmpgt_ps(coverage, _mm_set1_ps(0.5f / 255.0f)));
+		if (!coveredMask)
+			continue;
+
+		// Last group may be partial, its pixels are blended through temporary storage.
+		uint32 pixelCount = min<uint32>(width - x, 4);
+		if (pixelCount < 4)
+		{
+			uint32 pixels[4] = {};
+			Memory::Copy(pixels, dstRow + x, pixelCount * 4);
+			_mm_storeu_si128((__m128i*)pixels, BlendPixels(context, _mm_loadu_si128((__m128i*)pixels), coverage));
+			Memory::Copy(dstRow + x, pixels, pixelCount * 4);
+			continue;
+		}
+
+		__m128i *dst = (__m128i*)(dstRow + x);
+		if (context.opaque && _mm_movemask_ps(_mm_cmpge_ps(coverage, _mm_set1_ps(1.0f - 0.5f / 255.0f))) == 0xF)
+			_mm_storeu_si128(dst, context.opaqueColor);
+		else
+			_mm_storeu_si128(dst, BlendPixels(context, _mm_loadu_si128(dst), coverage));
+	}
+
+	// Accumulation past last pixel is not read, but has to be cleared for next row.
+	for (uint32 x = (width + 3) & ~3u; x < context.accumulationStride; x++)
+		acc[x] = 0.0f;
+}
+
+static void FillBands(void* contextPtr, uint32 begin, uint32 end)
+{
+	const FillContext &context = *(const FillContext*)contextPtr;
+
+	uint32 stride = context.accumulationStride;
+	uint32 bandHeight = min(context.bandHeight, context.height);
+	HeapPtr<float32> accumulationBuffer(uintptr(stride) * bandHeight + 4);
+
+	// Rows are read with aligned loads.
+	float32 *accumulation = to<float32*>((uintptr((float32*)accumulationBuffer) + 15) & ~uintptr(15));
+	Memory::Set(accumulation, 0, uintptr(stride) * bandHeight * sizeof(float32));
+
+	for (uint32 band = begin; band < end; band++)
+	{
+		uint32 bandBegin = band * context.bandHeight;
+		uint32 rowCount = min(bandHeight, context.height - bandBegin);
+		float32 bandTop = float32(bandBegin);
+
+		for (uint32 i = context.bandEdgeOffsets[band]; i < context.bandEdgeOffsets[band + 1]; i++)
+		{
+			uint32 edgeIndex = context.bandEdges[i];
+			AccumulateClippedEdge(accumulation, stride, bandTop, rowCount, float32(context.width),
+				context.edges[edgeIndex * 2], context.edges[edgeIndex * 2 + 1]);
+		}
+
+		for (uint32 row = 0; row < rowCount; row++)
+		{
+			FillRow(context, accumulation + uintptr(row) * stride,
+				to<uint32*>(context.dstData + uintptr(context.dstDataStride) * (bandBegin + row)));
+		}
+	}
+}
+
+// PathRasterizer ===============================================================================//
+
+void PathRasterizer::addEdge(float32x2 start, float32x2 end)
+{
+	if (start.y == end.y)
+		return;
+
+	if (edges.isEmpty())
+		bounds = rectf32(start, start);
+
+	bounds.left = min(bounds.left, min(start.x, end.x));
+	bounds.top = min(bounds.top, min(start.y, end.y));
+	bounds.right = max(bounds.right, max(start.x, end.x));
+	bounds.bottom = max(bounds.bottom, max(start.y, end.y));
+
+	edges.pushBack({ start, end });
+}
+
+uint32 PathRasterizer::getArcSegmentCount(float32x2 radius, float32 angle) const
+{
+	// Chord of angle step deviates from circle of radius r by r * (1 - cos(step / 2)).
+	float32 maxRadius = max(radius.x, radius.y);
+	if (maxRadius <= tolerance)
+		return 1;
+
+	float32 step = 2.0f * Math::Acos(1.0f - tolerance / maxRadius);
+	float32 count = min(angle < 0.0f ? -angle : angle, Math::PiF32 * 2.0f) / step;
+	return Math::Clamp(CeilToU32(count), 1u, MaxArcSegmentCount);
+}
+
+void PathRasterizer::reset()
+{
+	edges.clear();
+	bounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+	subpathOpen = false;
+}
+
+void PathRasterizer::moveTo(float32x2 point)
+{
+	close();
+
+	subpathStart = point;
+	currentPoint = point;
+	subpathOpen = true;
+}
+
+void PathRasterizer::lineTo(float32x2 point)
+{
+	if (!subpathOpen)
+	{
+		moveTo(point);
+		return;
+	}
+
+	addEdge(currentPoint, point);
+	currentPoint = point;
+}
+
+void PathRasterizer::arcTo(float32x2 center, float32x2 radius, float32 startAngle, float32 endAngle)
+{
+	uint32 segmentCount = getArcSegmentCount(radius, endAngle - startAngle);
+	float32 angleStep = (endAngle - startAngle) / float32(segmentCount);
+
+	lineTo(center + float32x2(Math::Cos(startAngle), Math::Sin(startAngle)) * radius);
+	for (uint32 i = 1; i <= segmentCount; i++)
+	{
+		float32 angle = startAngle + angleStep * float32(i);
+		lineTo(center + float32x2(Math::Cos(angle), Math::Sin(angle)) * radius);
+	}
+}
+
+void PathRasterizer::close()
+{
+	if (!subpathOpen)
+		return;
+
+	addEdge(currentPoint, subpathStart);
+	currentPoint = subpathStart;
+	subpathOpen = false;
+}
+
+void PathRasterizer::addRect(const rectf32& rect, bool reversed)
+{
+	moveTo(rect.leftTop);
+	if (!reversed)
+	{
+		lineTo(float32x2(rect.right, rect.top));
+		lineTo(rect.rightBottom);
+		lineTo(float32x2(rect.left, rect.bottom));
+	}
+	else
+	{
+		lineTo(float32x2(rect.left, rect.bottom));
+		lineTo(rect.rightBottom);
+		lineTo(float32x2(rect.right, rect.top));
+	}
+	close();
+}
+
+void PathRasterizer::addEllipse(float32x2 center, float32x2 radius, bool reversed)
+{
+	moveTo(float32x2(center.x + radius.x, center.y));
+	arcTo(center, radius, 0.0f, reversed ? -2.0f * Math::PiF32 : 2.0f * Math::PiF32);
+	close();
+}
+
+void PathRasterizer::addEllipseBorder(float32x2 center, float32x2 radius, float32 width)
+{
+	float32 w = width * 0.5f;
+	if (w <= 0.0f)
+		return;
+
+	// Contours are offset along ellipse normal, inner one goes backwards to cut hole.
+	radius = float32x2(max(radius.x, 1.0e-3f), max(radius.y, 1.0e-3f));
+	uint32 segmentCount = getArcSegmentCount(radius + float32x2(w, w), 2.0f * Math::PiF32);
+	float32 angleStep = 2.0f * Math::PiF32 / float32(segmentCount);
+
+	for (uint32 contour = 0; contour < 2; contour++)
+	{
+		float32 offset = contour ? -w : w;
+		float32 direction = contour ? -1.0f : 1.0f;
+
+		for (uint32 i = 0; i < segmentCount; i++)
+		{
+			float32 angle = angleStep * float32(i) * direction;
+			float32x2 cosSin(Math::Cos(angle), Math::Sin(angle));
+			float32x2 normal = VectorMath::Normalize(float32x2(cosSin.x * radius.y, cosSin.y * radius.x));
+			float32x2 point = center + cosSin * radius + normal * offset;
+
+			if (i)
+				lineTo(point);
+			else
+				moveTo(point);
+		}
+		close();
+	}
+}
+
+void PathRasterizer::addLine(float32x2 start, float32x2 end, float32 width,
+	bool roundedStart, bool roundedEnd)
+{
+	float32x2 direction = end - start;
+	float32 length = VectorMath::Length(direction);
+	if (length <= 0.0f)
+		return;
+
+	float32 halfWidth = width * 0.5f;
+	float32x2 forward = direction * (halfWidth / length);
+	float32x2 side = VectorMath::NormalLeft(forward);
+
+	// Caps are half ellipses with axes along side and forward vectors.
+	auto addCap = [&](float32x2 center, float32x2 axisX, float32x2 axisY)
+	{
+		uint32 segmentCount = getArcSegmentCount(float32x2(halfWidth, halfWidth), Math::PiF32);
+		for (uint32 i = 1; i < segmentCount; i++)
+		{
+			float32 angle = Math::PiF32 * float32(i) / float32(segmentCount);
+			lineTo(center + axisX * Math::Cos(angle) + axisY * Math::Sin(angle));
+		}
+	};
+
+	moveTo(start + side);
+	lineTo(end + side);
+	if (roundedEnd)
+		addCap(end, side, forward);
+	lineTo(end - side);
+	lineTo(start - side);
+	if (roundedStart)
+		addCap(start, -side, -forward);
+	close();
+}
+
+void PathRasterizer::fill(void* data, uint32 dataStride, uint32x2 size, Color color, FillRule rule)
+{
+	close();
+
+	if (edges.isEmpty() || !color.a || !size.x || !size.y)
+		return;
+
+	ProfileFunction();
+
+	if (!dataStride)
+		dataStride = size.x * 4;
+
+	// Everything left of rect still adds cover to its rows, so left side is clipped at zero only.
+	rectu32 rect(
+		0, uint32(Math::Clamp(bounds.top, 0.0f, float32(size.y))),
+		min(CeilToU32(max(bounds.right, 0.0f)), size.x),
+		min(CeilToU32(max(bounds.bottom, 0.0f)), size.y));
+	rect.left = min(uint32(max(bounds.left, 0.0f)), rect.right);
+
+	if (rect.left >= rect.right || rect.top >= rect.bottom)
+		return;
+
+	uint32 width = rect.getWidth();
+	uint32 height = rect.getHeight();
+	uint32 bandHeight = max(minBandHeight, intdivceil(minBandPixelCount, width));
+	uint32 bandCount = intdivceil(height, bandHeight);
+
+	// Edges are binned to bands they cross by counting sort, so band does not walk whole path.
+	uint32 edgeCount = edges.getSize();
+	HeapPtr<float32x2> relativeEdges(edgeCount * 2);
+	HeapPtr<uint32> edgeBandRanges(edgeCount * 2);
+	HeapPtr<uint32> bandEdgeOffsets(bandCount + 1);
+	Memory::Set(bandEdgeOffsets, 0, (bandCount + 1) * sizeof(uint32));
+
+	float32x2 origin(rect.leftTop);
+	float32 inverseBandHeight = 1.0f / float32(bandHeight);
+	for (uint32 i = 0; i < edgeCount; i++)
+	{
+		float32x2 start = edges[i].start - origin;
+		float32x2 end = edges[i].end - origin;
+		relativeEdges[i * 2 + 0] = start;
+		relativeEdges[i * 2 + 1] = end;
+
+		float32 top = Math::Clamp(min(start.y, end.y) * inverseBandHeight, 0.0f, float32(bandCount));
+		float32 bottom = Math::Clamp(max(start.y, end.y) * inverseBandHeight, 0.0f, float32(bandCount));
+		uint32 firstBand = min(uint32(top), bandCount);
+		uint32 lastBand = min(CeilToU32(bottom), bandCount);
+
+		edgeBandRanges[i * 2 + 0] = firstBand;
+		edgeBandRanges[i * 2 + 1] = lastBand;
+		for (uint32 band = firstBand; band < lastBand; band++)
+			bandEdgeOffsets[band + 1]++;
+	}
+
+	for (uint32 band = 0; band < bandCount; band++)
+		bandEdgeOffsets[band + 1] += bandEdgeOffsets[band];
+
+	HeapPtr<uint32> bandEdges(max(bandEdgeOffsets[bandCount], 1u));
+	HeapPtr<uint32> bandEdgeCursors(bandCount);
+	Memory::Copy(bandEdgeCursors, bandEdgeOffsets, bandCount * sizeof(uint32));
+	for (uint32 i = 0; i < edgeCount; i++)
+	{
+		for (uint32 band = edgeBandRanges[i * 2 + 0]; band < edgeBandRanges[i * 2 + 1]; band++)
+			bandEdges[bandEdgeCursors[band]++] = i;
+	}
+
+	FillContext context;
+	context.edges = relativeEdges;
+	context.bandEdges = bandEdges;
+	context.bandEdgeOffsets = bandEdgeOffsets;
+	context.width = width;
+	context.height = height;
+	context.bandHeight = bandHeight;
+	context.accumulationStride = (width + 2 + 3) & ~3u;
+	context.dstData = to<byte*>(data) + uintptr(dataStride) * rect.top + rect.left * 4;
+	context.dstDataStride = dataStride;
+	context.colorChannels[0] = _mm_set1_ps(float32(color.r));
+	context.colorChannels[1] = _mm_set1_ps(float32(color.g));
+	context.colorChannels[2] = _mm_set1_ps(float32(color.b));
+	context.colorAlpha = _mm_set1_ps(float32(color.a) / 255.0f);
+	context.opaqueColor = _mm_set1_epi32(sint32(color.rgba));
+	context.opaque = color.a == 255;
+	context.rule = rule;
+
+	WorkerPool::Global.parallelFor(bandCount, 1, FillBands, &context);
+}
+
+// Benchmark ==================================================================================//
+
+void PathRasterizer::RunBenchmark()
+{
+	static constexpr uint32 iterationCount = 4;
+	static constexpr uint32 caseCount = 4;
+	static constexpr const char* caseNames[caseCount] =
+		{ "4096 small ellipses", "large ellipse", "64 rect borders", "256 rounded lines" };
+
+	// Geometry below is laid out for 4k.
+	const BenchmarkImageSize &imageSize = Benchmark::ImageSizes[0];
+	HeapPtr<uint32> image(uintptr(imageSize.size.x) * imageSize.size.y);
+
+	Benchmark::LogHeader("Path rasterizer", imageSize.name);
+
+	PathRasterizer rasterizer;
+
+	for (uint32 caseIndex = 0; caseIndex < caseCount; caseIndex++)
+	{
+		rasterizer.reset();
+		float32 area = 0.0f;
+
+		switch (caseIndex)
+		{
+			case 0:
+				for (uint32 i = 0; i < 4096; i++)
+				{
+					float32x2 center(float32(i % 64) * 60.0f + 30.5f, float32(i / 64) * 33.75f + 17.0f);
+					rasterizer.addEllipse(center, float32x2(14.0f, 9.5f));
+					area += Math::PiF32 * 14.0f * 9.5f;
+				}
+				break;
+
+			case 1:
+				rasterizer.addEllipse(float32x2(1920.3f, 1080.7f), float32x2(1800.0f, 1000.0f));
+				area = Math::PiF32 * 1800.0f * 1000.0f;
+				break;
+
+			case 2:
+				for (uint32 i = 0; i < 64; i++)
+				{
+					rectf32 outer(float32(i) * 20.0f + 0.5f, float32(i) * 10.0f + 0.5f,
+						3840.0f - float32(i) * 20.0f - 0.5f, 2160.0f - float32(i) * 10.0f - 0.5f);
+					rectf32 inner(outer.left + 4.0f, outer.top + 4.0f, outer.right - 4.0f, outer.bottom - 4.0f);
+					rasterizer.addRect(outer);
+					rasterizer.addRect(inner, true);
+					area += outer.getWidth() * outer.getHeight() - inner.getWidth() * inner.getHeight();
+				}
+				break;
+
+			case 3:
+				for (uint32 i = 0; i < 256; i++)
+				{
+					float32x2 start(float32(i) * 15.0f, 0.0f), end(3840.0f - float32(i) * 15.0f, 2160.0f);
+					rasterizer.addLine(start, end, 6.0f, true, true);
+					area += VectorMath::Length(end - start) * 6.0f;
+				}
+				break;
+		}
+
+		Memory::Set(image, 0, uintptr(imageSize.size.x) * imageSize.size.y * 4);
+
+		// Throughput is of covered pixels.
+		auto kernel = [&]() { rasterizer.fill(image, 0, imageSize.size, Color(40, 120, 220, 200)); };
+		float32 time = Benchmark::MeasureTime(iterationCount, kernel);
+		Benchmark::LogResult(time, float64(area), 0.0, "%-20s %6u edges",
+			caseNames[caseIndex], rasterizer.getEdgeCount());
+	}
+}
\ No newline at end of file
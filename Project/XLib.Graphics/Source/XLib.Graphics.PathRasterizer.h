@@ -0,0 +1,83 @@
+#pragma once
+
+#include <XLib.Types.h>
+#include <XLib.NonCopyable.h>
+#include <XLib.Vectors.h>
+#include <XLib.Color.h>
+#include <XLib.Containers.Vector.h>
+
+namespace XLib::Graphics
+{
+	enum class FillRule : uint8
+	{
+		NonZero = 0,
+		EvenOdd,
+	};
+
+	// CPU scanline rasterizer with exact area coverage. Every path edge adds signed area it
+	// covers in each pixel to float accumulation buffer, prefix sum along row then gives
+	// coverage of every pixel, so anti-aliasing does not depend on sample count. Arcs and
+	// ellipses are flattened to lines within tolerance, number of segments follows radius.
+	// Target rows are split into bands, which are accumulated and filled on worker pool.
+	//
+	// Path is in target pixel space, pixel centers are at half coordinates.
+
+	class PathRasterizer : public NonCopyable
+	{
+	public:
+		static constexpr float32 DefaultTolerance = 0.02f;		// Max distance of flattened curve from exact one, in pixels.
+		static constexpr uint32 MaxArcSegmentCount = 1024;
+
+	private:
+		struct Edge
+		{
+			float32x2 start;
+			float32x2 end;
+		};
+
+		Vector<Edge> edges;
+		rectf32 bounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float32x2 subpathStart = { 0.0f, 0.0f };
+		float32x2 currentPoint = { 0.0f, 0.0f };
+		float32 tolerance = DefaultTolerance;
+		bool subpathOpen = false;
+
+		void addEdge(float32x2 start, float32x2 end);
+		uint32 getArcSegmentCount(float32x2 radius, float32 angle) const;
+
+	public:
+		PathRasterizer() = default;
+		~PathRasterizer() = default;
+
+		// Clears path, tolerance is kept.
+		void reset();
+		inline void setTolerance(float32 tolerance) { this->tolerance = tolerance; }
+
+		// Subpaths are closed implicitly when next one is started or path is filled.
+		void moveTo(float32x2 point);
+		void lineTo(float32x2 point);
+		// Elliptic arc from start to end angle, angles grow from +x towards +y. Current point is
+		// joined with arc start by line.
+		void arcTo(float32x2 center, float32x2 radius, float32 startAngle, float32 endAngle);
+		void close();
+
+		// Closed subpaths. Reversed ones cut holes in same direction ones with non-zero rule.
+		void addRect(const rectf32& rect, bool reversed = false);
+		void addEllipse(float32x2 center, float32x2 radius, bool reversed = false);
+		// Same outline as GeometryGenerator::drawEllipseBorder, border is centered on ellipse.
+		void addEllipseBorder(float32x2 center, float32x2 radius, float32 width);
+		// Same outline as GeometryGenerator::drawLine.
+		void addLine(float32x2 start, float32x2 end, float32 width,
+			bool roundedStart = false, bool roundedEnd = false);
+
+		// Source-over of color with alpha scaled by coverage to straight alpha RGBA8 image.
+		void fill(void* data, uint32 dataStride, uint32x2 size, Color color, FillRule rule = FillRule::NonZero);
+
+		inline bool isEmpty() const { return edges.isEmpty(); }
+		inline uint32 getEdgeCount() const { return edges.getSize(); }
+		inline const rectf32& getBounds() const { return bounds; }
+
+		// Logs fill throughput for small and large ellipses, rect borders and lines at 4k.
+		static void RunBenchmark();
+	};
+}
\ No newline at end of file
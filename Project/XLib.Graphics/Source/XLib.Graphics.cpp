@@ -1,10 +1,15 @@
+#ifdef _WIN32
 #include <d3d11.h>
 #include <dxgi1_3.h>
+#endif
 
 #include <XLib.Util.h>
 #include <XLib.Memory.h>
+#include <XLib.Debug.h>
+#ifdef _WIN32
 #include <XLib.Platform.D3D11.Helpers.h>
 #include <XLib.Platform.DXGI.Helpers.h>
+#endif
 
 #include "XLib.Graphics.h"
 #include "XLib.Graphics.Internal.Shaders.h"
@@ -14,6 +19,12 @@ using namespace XLib::Platform;
 using namespace XLib::Graphics;
 using namespace XLib::Graphics::Internal;
 
+COMPtr<IDXGIFactory1> Device::dxgiFactory;
+
+#ifdef _WIN32
+
+// Only software device is available on other platforms, Direct3D 11 paths are compiled for Windows.
+
 static_assert(
 	uint32(PrimitiveType::Points) == D3D11_PRIMITIVE_TOPOLOGY_POINTLIST &&
 	uint32(PrimitiveType::LineList) == D3D11_PRIMITIVE_TOPOLOGY_LINELIST &&
@@ -22,8 +33,6 @@ static_assert(
 	uint32(PrimitiveType::TriangleStrip) == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP,
 	"invalid PrimitiveType value");
 
-COMPtr<IDXGIFactory1> Device::dxgiFactory;
-
 struct TransformConstants
 {
 	float32x4 tranfromRow0;
@@ -36,8 +45,15 @@ struct TransformConstants
 	}
 };
 
-bool Device::initialize()
+#endif
+
+bool Device::initialize(DeviceType type)
 {
+	this->type = type;
+	if (type == DeviceType::Software)
+		return initializeSoftware();
+
+#ifdef _WIN32
 	D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL(0);
 	D3D_FEATURE_LEVEL requestedFeatureLevel = D3D_FEATURE_LEVEL_10_0;
 
@@ -87,7 +103,17 @@ bool Device::initialize()
 		&D3D11BlendDesc(
 			D3D11_BLEND_SRC_ALPHA, D3D11_BLEND_OP_ADD, D3D11_BLEND_INV_SRC_ALPHA,
 			D3D11_BLEND_ONE, D3D11_BLEND_OP_ADD, D3D11_BLEND_ONE),
-		d3dDefaultBlendState.initRef());
+		d3dBlendStates[uint8(BlendState::Default)].initRef());
+	d3dDevice->CreateBlendState(
+		&D3D11BlendDesc(
+			D3D11_BLEND_SRC_ALPHA, D3D11_BLEND_OP_ADD, D3D11_BLEND_INV_SRC_ALPHA,
+			D3D11_BLEND_ONE, D3D11_BLEND_OP_ADD, D3D11_BLEND_INV_SRC_ALPHA),
+		d3dBlendStates[uint8(BlendState::StraightToPremultiplied)].initRef());
+	d3dDevice->CreateBlendState(
+		&D3D11BlendDesc(
+			D3D11_BLEND_ONE, D3D11_BLEND_OP_ADD, D3D11_BLEND_INV_SRC_ALPHA,
+			D3D11_BLEND_ONE, D3D11_BLEND_OP_ADD, D3D11_BLEND_INV_SRC_ALPHA),
+		d3dBlendStates[uint8(BlendState::Premultiplied)].initRef());
 
 	d3dDevice->CreateBuffer(
 		&D3D11BufferDesc(sizeof(TransformConstants), D3D11_BIND_CONSTANT_BUFFER),
@@ -99,54 +125,135 @@ bool Device::initialize()
 	transform = Matrix2x3::Identity();
 	transformUpToDate = false;
 
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Device::initializeSoftware()
+{
+	softwareRasterizer.initialize();
+
+	transform = Matrix2x3::Identity();
+	transformUpToDate = false;
+
 	return true;
 }
 
 void Device::clear(RenderTarget& renderTarget, Color color)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.clear(renderTarget.softwareTarget, color);
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->ClearRenderTargetView(renderTarget.d3dRTV, to<float32*>(&color.toF32x4()));
+#endif
 }
 
 void Device::setRenderTarget(RenderTarget& renderTarget)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.setRenderTarget(renderTarget.softwareTarget);
+		return;
+	}
+
+#ifdef _WIN32
 	ID3D11RenderTargetView *d3dRTVs = renderTarget.d3dRTV;
 	d3dContext->OMSetRenderTargets(1, &d3dRTVs, nullptr);
+#endif
 }
 
 void Device::setViewport(const rectu32& viewport)
 {
 	this->viewport = viewport;
 	transformUpToDate = false;
+
+	if (isSoftware())
+		softwareRasterizer.setViewport(viewport);
 }
 
 void Device::setScissorRect(const rectu32& rect)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.setScissorRect(rect);
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->RSSetScissorRects(1, &D3D11Rect(rect.left, rect.top, rect.right, rect.bottom));
+#endif
 }
 
 void Device::setTransform2D(const Matrix2x3& transform)
 {
 	this->transform = transform;
 	transformUpToDate = false;
+
+	if (isSoftware())
+		softwareRasterizer.setTransform(transform);
 }
 
 void Device::setTexture(Texture& texture, uint32 slot)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.setTexture(texture.softwareSurface.get());
+		return;
+	}
+
+#ifdef _WIN32
 	ID3D11ShaderResourceView *d3dSRVs[] = { texture.d3dSRV };
 	d3dContext->PSSetShaderResources(0, 1, d3dSRVs);
+#endif
 }
 
 void Device::setCustomEffectConstants(const void* data, uint32 size)
 {
 	Memory::Copy(customEffectConstantsBuffer, data, size);
+	if (isSoftware())
+		return;
+
+#ifdef _WIN32
 	d3dContext->UpdateSubresource(d3dCustomEffectConstantBuffer,
 		0, nullptr, customEffectConstantsBuffer, 0, 0);
+#endif
 }
 
 void Device::uploadBuffer(Buffer& buffer, const void* srcData, uint32 baseOffset, uint32 size)
 {
+	if (isSoftware())
+	{
+		Memory::Copy(buffer.softwareData + baseOffset, srcData, size);
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->UpdateSubresource(buffer.d3dBuffer, 0,
 		&D3D11Box(baseOffset, baseOffset + size), srcData, 0, 0);
+#endif
+}
+
+void Device::appendBuffer(Buffer& buffer, const void* srcData, uint32 baseOffset, uint32 size)
+{
+	if (isSoftware())
+	{
+		Memory::Copy(buffer.softwareData + baseOffset, srcData, size);
+		return;
+	}
+
+#ifdef _WIN32
+	D3D11_MAPPED_SUBRESOURCE d3dMappedSubresource = {};
+	d3dContext->Map(buffer.d3dBuffer, 0, baseOffset ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD,
+		0, &d3dMappedSubresource);
+	Memory::Copy(to<byte*>(d3dMappedSubresource.pData) + baseOffset, srcData, size);
+	d3dContext->Unmap(buffer.d3dBuffer, 0);
+#endif
 }
 
 void Device::uploadTexture(Texture& texture, const rectu32& region,
@@ -155,13 +262,29 @@ void Device::uploadTexture(Texture& texture, const rectu32& region,
 	if (!srcDataStride)
 		srcDataStride = region.getWidth() * 4;
 
+	if (isSoftware())
+	{
+		softwareRasterizer.upload(texture.softwareSurface.get(), region, srcData, srcDataStride);
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->UpdateSubresource(texture.d3dTexture, 0,
 		&D3D11Box(region.left, region.right, region.top, region.bottom), srcData, srcDataStride, 0);
+#endif
 }
 
 void Device::downloadTexture(Texture& texture, const rectu32& region,
 	void* dstData, uint32 dstDataStride)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.download(texture.softwareSurface.get(), region,
+			dstData, dstDataStride ? dstDataStride : region.getWidth() * 4);
+		return;
+	}
+
+#ifdef _WIN32
 	uint32 width = region.getWidth();
 	uint32 height = region.getHeight();
 
@@ -188,16 +311,49 @@ void Device::downloadTexture(Texture& texture, const rectu32& region,
 	}
 
 	d3dContext->Unmap(d3dStagingTexture, 0);
+#endif
 }
 
 void Device::copyTexture(Texture& dstTexture, Texture& srcTexture, uint32x2 dstLocation, const rectu32& srcRegion)
 {
+	if (isSoftware())
+	{
+		softwareRasterizer.copy(dstTexture.softwareSurface.get(),
+			srcTexture.softwareSurface.get(), dstLocation, srcRegion);
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->CopySubresourceRegion(dstTexture.d3dTexture, 0, dstLocation.x, dstLocation.y, 0,
 		srcTexture.d3dTexture, 0, &D3D11Box(srcRegion.left, srcRegion.right, srcRegion.top, srcRegion.bottom));
+#endif
 }
 
-void Device::draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBuffer,
-	uint32 baseOffset, uint32 vertexStride, uint32 vertexCount)
+void Device::setBlendState(BlendState state)
+{
+	blendState = state;
+
+	if (isSoftware())
+	{
+		switch (state)
+		{
+			case BlendState::StraightToPremultiplied:
+				softwareRasterizer.setBlending(SoftwareBlending::StraightToPremultiplied);
+				break;
+
+			case BlendState::Premultiplied:
+				softwareRasterizer.setBlending(SoftwareBlending::Premultiplied);
+				break;
+
+			default:
+				softwareRasterizer.setBlending(SoftwareBlending::Default);
+		}
+	}
+}
+
+#ifdef _WIN32
+
+bool Device::setupDraw2D(PrimitiveType primitiveType, Effect effect)
 {
 	ID3D11InputLayout *d3dIL = nullptr;
 	ID3D11VertexShader *d3dVS = nullptr;
@@ -223,7 +379,7 @@ void Device::draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBu
 			break;
 
 		default:
-			return;
+			return false;
 	}
 
 	d3dContext->IASetInputLayout(d3dIL);
@@ -253,11 +409,48 @@ void Device::draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBu
 
 	d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY(primitiveType));
 	d3dContext->RSSetState(d3dDefaultRasterizerState);
-	d3dContext->OMSetBlendState(d3dDefaultBlendState, nullptr, 0xFFFFFFFF);
+	d3dContext->OMSetBlendState(d3dBlendStates[uint8(blendState)], nullptr, 0xFFFFFFFF);
 
 	d3dContext->RSSetViewports(1, &D3D11ViewPort(float32(viewport.left), float32(viewport.top),
 		float32(viewport.right - viewport.left), float32(viewport.bottom - viewport.top)));
 
+	return true;
+}
+
+#endif
+
+void Device::draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBuffer,
+	uint32 baseOffset, uint32 vertexStride, uint32 vertexCount)
+{
+	if (isSoftware())
+	{
+		if (primitiveType != PrimitiveType::TriangleList && primitiveType != PrimitiveType::TriangleStrip)
+			return;
+
+		SoftwareShading shading;
+		switch (effect)
+		{
+			case Effect::PerVertexColor:
+				shading = SoftwareShading::PerVertexColor;
+				break;
+
+			case Effect::TexturedUnorm:
+				shading = SoftwareShading::TexturedUnorm;
+				break;
+
+			default:
+				return;
+		}
+
+		softwareRasterizer.drawTriangles(shading, primitiveType == PrimitiveType::TriangleStrip,
+			vertexBuffer.softwareData + baseOffset, vertexStride, vertexCount);
+		return;
+	}
+
+#ifdef _WIN32
+	if (!setupDraw2D(primitiveType, effect))
+		return;
+
 	{
 		ID3D11Buffer *d3dBuffer = vertexBuffer.d3dBuffer;
 		UINT stride = vertexStride;
@@ -266,11 +459,69 @@ void Device::draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBu
 	}
 
 	d3dContext->Draw(vertexCount, 0);
+#endif
+}
+
+void Device::drawIndexed2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBuffer,
+	uint32 baseOffset, uint32 vertexStride, Buffer& indexBuffer, uint32 indexBaseOffset, uint32 indexCount)
+{
+	if (isSoftware())
+	{
+		if (primitiveType != PrimitiveType::TriangleList && primitiveType != PrimitiveType::TriangleStrip)
+			return;
+
+		SoftwareShading shading;
+		switch (effect)
+		{
+			case Effect::PerVertexColor:
+				shading = SoftwareShading::PerVertexColor;
+				break;
+
+			case Effect::TexturedUnorm:
+				shading = SoftwareShading::TexturedUnorm;
+				break;
+
+			default:
+				return;
+		}
+
+		softwareRasterizer.drawTriangles(shading, primitiveType == PrimitiveType::TriangleStrip,
+			vertexBuffer.softwareData + baseOffset, vertexStride, indexCount,
+			to<const uint16*>(indexBuffer.softwareData + indexBaseOffset));
+		return;
+	}
+
+#ifdef _WIN32
+	if (!setupDraw2D(primitiveType, effect))
+		return;
+
+	{
+		ID3D11Buffer *d3dBuffer = vertexBuffer.d3dBuffer;
+		UINT stride = vertexStride;
+		UINT offset = baseOffset;
+		d3dContext->IASetVertexBuffers(0, 1, &d3dBuffer, &stride, &offset);
+	}
+
+	d3dContext->IASetIndexBuffer(indexBuffer.d3dBuffer, DXGI_FORMAT_R16_UINT, indexBaseOffset);
+	d3dContext->DrawIndexed(indexCount, 0, 0);
+#endif
 }
 
 void Device::draw2D(PrimitiveType primitiveType, CustomEffect& effect, Buffer& vertexBuffer,
 	uint32 baseOffset, uint32 vertexStride, uint32 vertexCount)
 {
+	// Custom pixel shaders have no software implementation, so such draws are skipped.
+	if (isSoftware())
+	{
+		if (!customEffectDrawSkipReported)
+		{
+			customEffectDrawSkipReported = true;
+			Debug::Warning("custom effect draws are not supported by software device and are skipped");
+		}
+		return;
+	}
+
+#ifdef _WIN32
 	d3dContext->IASetInputLayout(effect.d3dIL);
 	d3dContext->VSSetShader(effect.d3dVS, nullptr, 0);
 	d3dContext->PSSetShader(effect.d3dPS, nullptr, 0);
@@ -302,7 +553,7 @@ void Device::draw2D(PrimitiveType primitiveType, CustomEffect& effect, Buffer& v
 
 	d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY(primitiveType));
 	d3dContext->RSSetState(d3dDefaultRasterizerState);
-	d3dContext->OMSetBlendState(d3dDefaultBlendState, nullptr, 0xFFFFFFFF);
+	d3dContext->OMSetBlendState(d3dBlendStates[uint8(blendState)], nullptr, 0xFFFFFFFF);
 
 	d3dContext->RSSetViewports(1, &D3D11ViewPort(float32(viewport.left), float32(viewport.top),
 		float32(viewport.right - viewport.left), float32(viewport.bottom - viewport.top)));
@@ -315,11 +566,16 @@ void Device::draw2D(PrimitiveType primitiveType, CustomEffect& effect, Buffer& v
 	}
 
 	d3dContext->Draw(vertexCount, 0);
+#endif
 }
 
 bool Device::createCustomEffect(CustomEffect& effect, Effect defaultInputLayoutEffect,
 	const void* psBytecode, uint32 psBytecodeSize)
 {
+	if (isSoftware())
+		return false;
+
+#ifdef _WIN32
 	ID3D11InputLayout *d3dIL = nullptr;
 	ID3D11VertexShader *d3dVS = nullptr;
 
@@ -340,17 +596,47 @@ bool Device::createCustomEffect(CustomEffect& effect, Effect defaultInputLayoutE
 	}
 
 	return effect.inititalize(d3dDevice, d3dIL, d3dVS, psBytecode, psBytecodeSize);
+#else
+	return false;
+#endif
 }
 
 // Buffer ===================================================================================//
 
 bool Buffer::initialize(ID3D11Device* d3dDevice, uint32 size, const void* initialData)
 {
+#ifdef _WIN32
 	d3dDevice->CreateBuffer(
 		&D3D11BufferDesc(size, D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER),
 		initialData ? &D3D11SubresourceData(initialData, size, 0) : nullptr,
 		d3dBuffer.initRef());
 
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Buffer::initializeDynamic(ID3D11Device* d3dDevice, uint32 size)
+{
+#ifdef _WIN32
+	d3dDevice->CreateBuffer(
+		&D3D11BufferDesc(size, D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER, 0, 0,
+			D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE),
+		nullptr, d3dBuffer.initRef());
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Buffer::initializeSoftware(uint32 size, const void* initialData)
+{
+	softwareData = HeapPtr<byte>(size);
+	if (initialData)
+		Memory::Copy(softwareData, initialData, size);
+
 	return true;
 }
 
@@ -359,6 +645,7 @@ bool Buffer::initialize(ID3D11Device* d3dDevice, uint32 size, const void* initia
 bool Texture::initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 	const void* initialData, uint32 initialDataStride, bool enableRenderTarget)
 {
+#ifdef _WIN32
 	UINT bindFlags = D3D11_BIND_SHADER_RESOURCE;
 	if (enableRenderTarget)
 		bindFlags |= D3D11_BIND_RENDER_TARGET;
@@ -369,6 +656,31 @@ bool Texture::initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 		d3dTexture.initRef());
 	d3dDevice->CreateShaderResourceView(d3dTexture, nullptr, d3dSRV.initRef());
 
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Texture::initializeSoftware(uint32 width, uint32 height,
+	const void* initialData, uint32 initialDataStride)
+{
+	if (!softwareSurface.create(width, height))
+		return false;
+
+	if (initialData)
+	{
+		if (!initialDataStride)
+			initialDataStride = width * 4;
+
+		SoftwareSurface *surface = softwareSurface.get();
+		for (uint32 y = 0; y < height; y++)
+		{
+			Memory::Copy(surface->getRow(y),
+				to<const byte*>(initialData) + uintptr(initialDataStride) * y, width * 4);
+		}
+	}
+
 	return true;
 }
 
@@ -376,9 +688,13 @@ bool Texture::initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 
 bool RenderTarget::initialize(ID3D11Device* d3dDevice, ID3D11Texture2D* d3dTexture)
 {
+#ifdef _WIN32
 	d3dDevice->CreateRenderTargetView(d3dTexture, nullptr, d3dRTV.initRef());
 
 	return true;
+#else
+	return false;
+#endif
 }
 
 // TextureRenderTarget ======================================================================//
@@ -386,10 +702,23 @@ bool RenderTarget::initialize(ID3D11Device* d3dDevice, ID3D11Texture2D* d3dTextu
 bool TextureRenderTarget::initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 	const void* initialData, uint32 initialDataStride)
 {
+#ifdef _WIN32
 	Texture::initialize(d3dDevice, width, height, initialData, initialDataStride, true);
 	RenderTarget::initialize(d3dDevice, Texture::getD3D11Texture2D());
 
 	return true;
+#else
+	return false;
+#endif
+}
+
+bool TextureRenderTarget::initializeSoftware(uint32 width, uint32 height,
+	const void* initialData, uint32 initialDataStride)
+{
+	if (!Texture::initializeSoftware(width, height, initialData, initialDataStride))
+		return false;
+
+	return RenderTarget::initializeSoftware(Texture::getSoftwareSurface());
 }
 
 // WindowRenderTarget =======================================================================//
@@ -397,6 +726,7 @@ bool TextureRenderTarget::initialize(ID3D11Device* d3dDevice, uint32 width, uint
 bool WindowRenderTarget::initialize(ID3D11Device* d3dDevice,
 	IDXGIFactory1* dxgiFactory, void* hWnd, uint32 width, uint32 height)
 {
+#ifdef _WIN32
 	dxgiFactory->CreateSwapChain(d3dDevice,
 		&DXGISwapChainDesc(HWND(hWnd), width, height), dxgiSwapChain.initRef());
 
@@ -404,10 +734,14 @@ bool WindowRenderTarget::initialize(ID3D11Device* d3dDevice,
 	dxgiSwapChain->GetBuffer(0, d3dBackTexture.uuid(), d3dBackTexture.voidInitRef());
 
 	return RenderTarget::initialize(d3dDevice, d3dBackTexture);
+#else
+	return false;
+#endif
 }
 
 bool WindowRenderTarget::resize(ID3D11Device* d3dDevice, uint32 width, uint32 height)
 {
+#ifdef _WIN32
 	RenderTarget::~RenderTarget();
 
 	dxgiSwapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
@@ -416,11 +750,16 @@ bool WindowRenderTarget::resize(ID3D11Device* d3dDevice, uint32 width, uint32 he
 	dxgiSwapChain->GetBuffer(0, d3dBackTexture.uuid(), d3dBackTexture.voidInitRef());
 
 	return RenderTarget::initialize(d3dDevice, d3dBackTexture);
+#else
+	return false;
+#endif
 }
 
 void WindowRenderTarget::present(bool sync)
 {
+#ifdef _WIN32
 	dxgiSwapChain->Present(sync ? 1 : 0, 0);
+#endif
 }
 
 // CustomEffect =============================================================================//
@@ -436,10 +775,14 @@ bool CustomEffect::inititalize(ID3D11Device* d3dDevice, uint32 ilElementCount,
 bool CustomEffect::inititalize(ID3D11Device* d3dDevice, ID3D11InputLayout* d3dIL,
 	ID3D11VertexShader* d3dVS, const void* psBytecode, uint32 psBytecodeSize)
 {
+#ifdef _WIN32
 	d3dDevice->CreatePixelShader(psBytecode, psBytecodeSize, nullptr, d3dPS.initRef());
 
 	this->d3dIL = d3dIL;
 	this->d3dVS = d3dVS;
 
 	return true;
+#else
+	return false;
+#endif
 }
\ No newline at end of file
@@ -2,11 +2,14 @@
 
 #include <XLib.Types.h>
 #include <XLib.NonCopyable.h>
+#include <XLib.Heap.h>
 #include <XLib.Color.h>
 #include <XLib.Vectors.h>
 #include <XLib.Platform.COMPtr.h>
 #include <XLib.Math.Matrix2x3.h>
 
+#include "XLib.Graphics.Internal.Software.h"
+
 struct ID3D11Device;
 struct ID3D11DeviceContext;
 struct ID3D11InputLayout;
@@ -25,6 +28,12 @@ struct IDXGISwapChain;
 
 namespace XLib::Graphics
 {
+	enum class DeviceType : uint8
+	{
+		Hardware = 0,
+		Software = 1,
+	};
+
 	enum class PrimitiveType : uint8
 	{
 		None = 0,
@@ -43,6 +52,13 @@ namespace XLib::Graphics
 		TexturedUnorm = 3,
 	};
 
+	enum class BlendState : uint8
+	{
+		Default = 0,				// Color SRC_ALPHA/INV_SRC_ALPHA, alpha ONE/ONE.
+		StraightToPremultiplied,	// Straight alpha source over premultiplied target.
+		Premultiplied,				// Premultiplied source over premultiplied target.
+	};
+
 	enum class CustomEffectInputLayoutElementType
 	{
 		None = 0,
@@ -83,8 +99,11 @@ namespace XLib::Graphics
 
 	private:
 		XLib::Platform::COMPtr<ID3D11Buffer> d3dBuffer;
+		XLib::HeapPtr<byte> softwareData;
 
 		bool initialize(ID3D11Device* d3dDevice, uint32 size, const void* initialData);
+		bool initializeDynamic(ID3D11Device* d3dDevice, uint32 size);
+		bool initializeSoftware(uint32 size, const void* initialData);
 
 	public:
 		Buffer() = default;
@@ -101,12 +120,16 @@ namespace XLib::Graphics
 	private:
 		XLib::Platform::COMPtr<ID3D11Texture2D> d3dTexture;
 		XLib::Platform::COMPtr<ID3D11ShaderResourceView> d3dSRV;
+		Internal::SoftwareSurfacePtr softwareSurface;
 
 	protected:
 		bool initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 			const void* initialData, uint32 initialDataStride, bool enableRenderTarget);
+		bool initializeSoftware(uint32 width, uint32 height,
+			const void* initialData, uint32 initialDataStride);
 
 		inline ID3D11Texture2D* getD3D11Texture2D() { return d3dTexture; }
+		inline Internal::SoftwareSurface* getSoftwareSurface() { return softwareSurface.get(); }
 
 	public:
 		Texture() = default;
@@ -118,15 +141,17 @@ namespace XLib::Graphics
 		inline void destroy() { this->~Texture(); }
 	};
 
-	class RenderTarget abstract : public XLib::NonCopyable
+	class RenderTarget XLIB_ABSTRACT : public XLib::NonCopyable
 	{
 		friend class Device;
 
 	private:
 		XLib::Platform::COMPtr<ID3D11RenderTargetView> d3dRTV;
+		Internal::SoftwareSurface *softwareTarget = nullptr;
 
 	protected:
 		bool initialize(ID3D11Device* d3dDevice, ID3D11Texture2D* d3dTexture);
+		inline bool initializeSoftware(Internal::SoftwareSurface* surface) { softwareTarget = surface; return true; }
 
 	public:
 		RenderTarget() = default;
@@ -145,6 +170,8 @@ namespace XLib::Graphics
 	private:
 		bool initialize(ID3D11Device* d3dDevice, uint32 width, uint32 height,
 			const void* initialData, uint32 initialDataStride);
+		bool initializeSoftware(uint32 width, uint32 height,
+			const void* initialData, uint32 initialDataStride);
 
 	public:
 		TextureRenderTarget() = default;
@@ -225,7 +252,7 @@ namespace XLib::Graphics
 
 		XLib::Platform::COMPtr<ID3D11RasterizerState> d3dDefaultRasterizerState;
 		XLib::Platform::COMPtr<ID3D11SamplerState> d3dDefaultSamplerState;
-		XLib::Platform::COMPtr<ID3D11BlendState> d3dDefaultBlendState;
+		XLib::Platform::COMPtr<ID3D11BlendState> d3dBlendStates[3];
 
 		XLib::Platform::COMPtr<ID3D11Buffer> d3dTransformConstantBuffer;
 		XLib::Platform::COMPtr<ID3D11Buffer> d3dCustomEffectConstantBuffer;
@@ -235,9 +262,19 @@ namespace XLib::Graphics
 		rectu32 viewport = {};
 		XLib::Matrix2x3 transform = {};
 		bool transformUpToDate = false;
+		BlendState blendState = BlendState::Default;
+
+		DeviceType type = DeviceType::Hardware;
+		Internal::SoftwareRasterizer softwareRasterizer;
+		bool customEffectDrawSkipReported = false;
+
+		bool initializeSoftware();
+		bool setupDraw2D(PrimitiveType primitiveType, Effect effect);
 
 	public:
-		bool initialize();
+		// Hardware device is Direct3D 11 one, so elsewhere than on Windows only software
+		// device can be initialized.
+		bool initialize(DeviceType type = DeviceType::Hardware);
 
 		void clear(RenderTarget& renderTarget, Color color);
 		void setRenderTarget(RenderTarget& renderTarget);
@@ -246,31 +283,40 @@ namespace XLib::Graphics
 		void setTransform2D(const Matrix2x3& transform);
 		void setTexture(Texture& texture, uint32 slot = 0);
 		void setCustomEffectConstants(const void* data, uint32 size);
+		void setBlendState(BlendState state);
 
 		void uploadBuffer(Buffer& buffer, const void* srcData, uint32 baseOffset, uint32 size);
+		// Writes to dynamic buffer without waiting for draws that read it, so region must not be
+		// used by them. Zero base offset discards previous contents, so ring buffer restarts
+		// from beginning when it wraps.
+		void appendBuffer(Buffer& buffer, const void* srcData, uint32 baseOffset, uint32 size);
 		void uploadTexture(Texture& texture, const rectu32& region, const void* srcData, uint32 srcDataStride = 0);
 		void downloadTexture(Texture& texture, const rectu32& region, void* dstData, uint32 dstDataStride = 0);
 		void copyTexture(Texture& dstTexture, Texture& srcTexture, uint32x2 dstLocation, const rectu32& srcRegion);
 
 		void draw2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBuffer,
 			uint32 baseOffset, uint32 vertexStride, uint32 vertexCount);
+		// Software device has no custom effects, it skips such draws and warns about first one.
 		void draw2D(PrimitiveType primitiveType, CustomEffect& effect, Buffer& vertexBuffer,
 			uint32 baseOffset, uint32 vertexStride, uint32 vertexCount);
+		// Indices are 16 bit and relative to vertex base offset.
 		void drawIndexed2D(PrimitiveType primitiveType, Effect effect, Buffer& vertexBuffer,
-			uint32 baseOffset, uint32 vertexStride, uint32 vertexCount);
+			uint32 baseOffset, uint32 vertexStride, Buffer& indexBuffer, uint32 indexBaseOffset, uint32 indexCount);
 
 		inline bool createBuffer(Buffer& buffer, uint32 size, const void* initialData = nullptr)
-			{ return buffer.initialize(d3dDevice, size, initialData); }
+			{ return isSoftware() ? buffer.initializeSoftware(size, initialData) : buffer.initialize(d3dDevice, size, initialData); }
+		inline bool createDynamicBuffer(Buffer& buffer, uint32 size)
+			{ return isSoftware() ? buffer.initializeSoftware(size, nullptr) : buffer.initializeDynamic(d3dDevice, size); }
 		inline bool createTexture(Texture& texture, uint32 width, uint32 height, const void* initialData = nullptr, uint32 initialDataStride = 0)
-			{ return texture.initialize(d3dDevice, width, height, initialData, initialDataStride, false); }
+			{ return isSoftware() ? texture.initializeSoftware(width, height, initialData, initialDataStride) : texture.initialize(d3dDevice, width, height, initialData, initialDataStride, false); }
 		inline bool createTextureRenderTarget(TextureRenderTarget& textureRenderTarget, uint32 width, uint32 height, const void* initialData = nullptr, uint32 initialDataStride = 0)
-			{ return textureRenderTarget.initialize(d3dDevice, width, height, initialData, initialDataStride); }
+			{ return isSoftware() ? textureRenderTarget.initializeSoftware(width, height, initialData, initialDataStride) : textureRenderTarget.initialize(d3dDevice, width, height, initialData, initialDataStride); }
 		inline bool createWindowRenderTarget(WindowRenderTarget& renderTarget, void* hWnd, uint32 width, uint32 height)
-			{ return renderTarget.initialize(d3dDevice, dxgiFactory, hWnd, width, height); }
+			{ return isSoftware() ? false : renderTarget.initialize(d3dDevice, dxgiFactory, hWnd, width, height); }
 		inline bool resizeWindowRenderTarget(WindowRenderTarget& renderTarget, uint32 width, uint32 height)
-			{ return renderTarget.resize(d3dDevice, width, height); }			
+			{ return isSoftware() ? false : renderTarget.resize(d3dDevice, width, height); }			
 		inline bool createCustomEffect(CustomEffect& effect, uint32 ilElementCount, const CustomEffectInputLayoutElement* ilElements, const void* vsBytecode, uint32 vsBytecodeSize, const void* psBytecode, uint32 psBytecodeSize)
-			{ return effect.inititalize(d3dDevice, ilElementCount, ilElements, vsBytecode, vsBytecodeSize, psBytecode, psBytecodeSize); }
+			{ return isSoftware() ? false : effect.inititalize(d3dDevice, ilElementCount, ilElements, vsBytecode, vsBytecodeSize, psBytecode, psBytecodeSize); }
 		bool createCustomEffect(CustomEffect& effect, Effect defaultInputLayoutEffect, const void* psBytecode, uint32 psBytecodeSize);
 
 		template <typename Type>
@@ -282,6 +328,9 @@ namespace XLib::Graphics
 
 		static constexpr uint32 GetCustomEffectConstantsSizeLimit() { return customEffectConstantsSizeLimit; }
 
+		inline DeviceType getType() { return type; }
+		inline bool isSoftware() { return type == DeviceType::Software; }
+
 		inline ID3D11Device* getD3Device() { return d3dDevice.get(); }
 		inline ID3D11DeviceContext* getD3DeviceContext() { return d3dContext.get(); }
 	};
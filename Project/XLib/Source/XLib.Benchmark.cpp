@@ -0,0 +1,63 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "XLib.Benchmark.h"
+
+#include "XLib.Debug.h"
+#include "XLib.Random.h"
+#include "XLib.System.Threading.WorkerPool.h"
+
+using namespace XLib;
+
+const BenchmarkImageSize Benchmark::ImageSizes[ImageSizeCount] =
+{
+	{ uint32x2(3840, 2160), "4k" },
+	{ uint32x2(MaxImageWidth, MaxImageHeight), "8k" },
+};
+
+void Benchmark::FillRandom(uint32* data, uintptr count)
+{
+	Random random(1);
+	for (uintptr i = 0; i < count; i++)
+		data[i] = random.getU32();
+}
+
+void Benchmark::LogHeader(const char* name, const char* details)
+{
+	char message[256];
+	if (details)
+		sprintf_s(message, "%s benchmark: %s, %u threads", name, details, WorkerPool::Global.getConcurrency());
+	else
+		sprintf_s(message, "%s benchmark: %u threads", name, WorkerPool::Global.getConcurrency());
+	Debug::Log(message);
+}
+
+void Benchmark::LogResult(float32 time, float64 pixelCount, float64 byteCount, const char* caseFormat, ...)
+{
+	char caseName[128];
+	va_list args;
+	va_start(args, caseFormat);
+	vsprintf_s(caseName, caseFormat, args);
+	va_end(args);
+
+	char pixelRate[32] = "", byteRate[32] = "";
+	if (pixelCount > 0.0)
+		sprintf_s(pixelRate, ", %8.1f Mpixels/s", pixelCount / float64(time) / 1.0e6);
+	if (byteCount > 0.0)
+		sprintf_s(byteRate, ", %6.2f GB/s", byteCount / float64(time) / 1.0e9);
+
+	char message[256];
+	sprintf_s(message, "  %-28s %8.2f ms%s%s", caseName, time * 1000.0f, pixelRate, byteRate);
+	Debug::Log(message);
+}
+
+void Benchmark::Log(const char* format, ...)
+{
+	char message[256];
+	va_list args;
+	va_start(args, format);
+	vsprintf_s(message, format, args);
+	va_end(args);
+
+	Debug::Log(message);
+}
\ No newline at end of file
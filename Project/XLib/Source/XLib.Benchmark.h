@@ -0,0 +1,48 @@
+#pragma once
+
+#include "XLib.Types.h"
+#include "XLib.Vectors.h"
+#include "XLib.System.Timer.h"
+
+namespace XLib
+{
+	struct BenchmarkImageSize
+	{
+		uint32x2 size;
+		const char *name;
+	};
+
+	// Setup, timing and reporting shared by RunBenchmark() functions, so they only supply kernels.
+	// Images are allocated once for largest size, smaller sizes use the same rows.
+
+	class Benchmark XLIB_ABSTRACT final
+	{
+	public:
+		static constexpr uint32 ImageSizeCount = 2;
+		static constexpr uint32 MaxImageWidth = 7680;
+		static constexpr uint32 MaxImageHeight = 4320;
+		static constexpr uintptr MaxImagePixelCount = uintptr(MaxImageWidth) * MaxImageHeight;
+
+		static const BenchmarkImageSize ImageSizes[ImageSizeCount];	// 4k and 8k.
+
+		static void FillRandom(uint32* data, uintptr count);
+
+		// Kernel is run once to warm up, returns average time of iterations in seconds.
+		template <typename Kernel>
+		static inline float32 MeasureTime(uint32 iterationCount, Kernel& kernel)
+		{
+			kernel();
+
+			TimerRecord startRecord = Timer::GetRecord();
+			for (uint32 i = 0; i < iterationCount; i++)
+				kernel();
+			return Timer::GetTimeDelta(startRecord) / float32(iterationCount);
+		}
+
+		// "<name> benchmark: <details>, <N> threads". Details may be null.
+		static void LogHeader(const char* name, const char* details = nullptr);
+		// Case name, time and throughput. Zero pixel or byte count omits its column.
+		static void LogResult(float32 time, float64 pixelCount, float64 byteCount, const char* caseFormat, ...);
+		static void Log(const char* format, ...);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,1186 @@
+#include <emmintrin.h>
+#include <string.h>
+
+#include "XLib.Compression.Deflate.h"
+
+#include "XLib.Util.h"
+#include "XLib.Heap.h"
+#include "XLib.Memory.h"
+#include "XLib.Debug.h"
+
+using namespace XLib;
+
+static constexpr uint32 LiteralLengthCodeCount = 286;
+static constexpr uint32 DistanceCodeCount = 30;
+static constexpr uint32 CodeLengthCodeCount = 19;
+static constexpr uint32 FixedLiteralLengthCodeCount = 288;
+static constexpr uint32 FixedDistanceCodeCount = 32;
+static constexpr uint32 EndOfBlock = 256;
+static constexpr uint32 MaxCodeLength = 15;
+static constexpr uint32 MaxCodeLengthCodeLength = 7;
+
+static constexpr uint32 MinMatchLength = 4;	// Matches are found by hash of 4 bytes.
+static constexpr uint32 MaxMatchLength = 258;
+static constexpr uint32 WindowSize = 1 << 15;
+static constexpr uint32 WindowMask = WindowSize - 1;
+static constexpr uint32 HashBits = 15;
+static constexpr uint32 ChainDepthLimit = 8;
+static constexpr uint32 NiceMatchLength = 128;
+static constexpr uint32 BlockSymbolLimit = 1 << 14;
+static constexpr uint32 StoredBlockSizeLimit = 0xFFFF;
+static constexpr uint32 NoPosition = uint32(-1);
+
+static constexpr uint16 LengthBases[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static constexpr uint8 LengthExtraBits[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static constexpr uint16 DistanceBases[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static constexpr uint8 DistanceExtraBits[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+static constexpr uint8 CodeLengthCodeOrder[CodeLengthCodeCount] =
+{
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+};
+
+static inline uint32 Load32(const byte* data) { uint32 value; memcpy(&value, data, 4); return value; }
+static inline uint64 Load64(const byte* data) { uint64 value; memcpy(&value, data, 8); return value; }
+static inline void Store32(byte* data, uint32 value) { memcpy(data, &value, 4); }
+static inline void Store64(byte* data, uint64 value) { memcpy(data, &value, 8); }
+
+static inline uint32 ReverseBits(uint32 value, uint32 bitCount)
+{
+	uint32 result = 0;
+	for (uint32 i = 0; i < bitCount; i++, value >>= 1)
+		result = (result << 1) | (value & 1);
+	return result;
+}
+
+// Adler32 ==================================================================================//
+
+static constexpr uint32 AdlerBase = 65521;
+static constexpr uint32 AdlerBlockSize = 5552;	// Largest block, sums of which can't overflow.
+
+uint32 Adler32::Compute(const void* data, uintptr size, uint32 seed)
+{
+	uint32 a = seed & 0xFFFF;
+	uint32 b = seed >> 16;
+
+	const byte *current = (const byte*)data;
+	while (size)
+	{
+		uint32 blockSize = uint32(min<uintptr>(size, AdlerBlockSize));
+		size -= blockSize;
+
+		for (; blockSize >= 4; blockSize -= 4, current += 4)
+		{
+			a += current[0]; b += a;
+			a += current[1]; b += a;
+			a += current[2]; b += a;
+			a += current[3]; b += a;
+		}
+		for (; blockSize; blockSize--, current++)
+		{
+			a += *current;
+			b += a;
+		}
+
+		a %= AdlerBase;
+		b %= AdlerBase;
+	}
+
+	return a | (b << 16);
+}
+
+uint32 Adler32::Combine(uint32 first, uint32 second, uintptr secondSize)
+{
+	uint32 remainder = uint32(secondSize % AdlerBase);
+	uint32 a = first & 0xFFFF;
+	uint32 b = (remainder * a) % AdlerBase;
+	a += (second & 0xFFFF) + AdlerBase - 1;
+	b += (first >> 16) + (second >> 16) + AdlerBase - remainder;
+
+	if (a >= AdlerBase) a -= AdlerBase;
+	if (a >= AdlerBase) a -= AdlerBase;
+	if (b >= AdlerBase * 2) b -= AdlerBase * 2;
+	if (b >= AdlerBase) b -= AdlerBase;
+
+	return a | (b << 16);
+}
+
+// Huffman codes ============================================================================//
+
+struct SymbolFrequency
+{
+	uint32 key;		// Frequency, then code length.
+	uint32 symbol;
+};
+
+// In place minimum redundancy code lengths (Moffat and Katajainen) of items sorted by
+// ascending frequency. Item count must be at least two.
+static void ComputeMinimumRedundancyLengths(SymbolFrequency* items, sint32 count)
+{
+	items[0].key += items[1].key;
+	sint32 root = 0, leaf = 2;
+	for (sint32 next = 1; next < count - 1; next++)
+	{
+		if (leaf >= count || items[root].key < items[leaf].key)
+		{
+			items[next].key = items[root].key;
+			items[root++].key = next;
+		}
+		else
+			items[next].key = items[leaf++].key;
+
+		if (leaf >= count || (root < next && items[root].key < items[leaf].key))
+		{
+			items[next].key += items[root].key;
+			items[root++].key = next;
+		}
+		else
+			items[next].key += items[leaf++].key;
+	}
+
+	items[count - 2].key = 0;
+	for (sint32 next = count - 3; next >= 0; next--)
+		items[next].key = items[items[next].key].key + 1;
+
+	sint32 available = 1, used = 0, depth = 0;
+	root = count - 2;
+	sint32 next = count - 1;
+	while (available > 0)
+	{
+		while (root >= 0 && sint32(items[root].key) == depth)
+		{
+			used++;
+			root--;
+		}
+		while (available > used)
+		{
+			items[next--].key = depth;
+			available--;
+		}
+		available = used * 2;
+		depth++;
+		used = 0;
+	}
+}
+
+// Length limited code lengths. At least two symbols always get codes, so codes are complete.
+static void BuildCodeLengths(const uint32* frequencies, uint32 symbolCount, uint32 maxLength, uint8* lengths)
+{
+	SymbolFrequency items[LiteralLengthCodeCount];
+	uint32 itemCount = 0;
+
+	for (uint32 i = 0; i < symbolCount; i++)
+	{
+		lengths[i] = 0;
+		if (frequencies[i])
+			items[itemCount++] = { frequencies[i], i };
+	}
+	for (uint32 i = 0; itemCount < 2; i++)
+	{
+		if (!frequencies[i])
+			items[itemCount++] = { 1, i };
+	}
+
+	for (uint32 i = 1; i < itemCount; i++)
+	{
+		SymbolFrequency item = items[i];
+		uint32 j = i;
+		for (; j > 0 && items[j - 1].key > item.key; j--)
+			items[j] = items[j - 1];
+		items[j] = item;
+	}
+
+	ComputeMinimumRedundancyLengths(items, sint32(itemCount));
+
+	// Codes longer than limit are shortened and Kraft sum is restored by lengthening others.
+	uint32 lengthCounts[33] = {};
+	for (uint32 i = 0; i < itemCount; i++)
+		lengthCounts[min<uint32>(items[i].key, 32)]++;
+	for (uint32 length = maxLength + 1; length <= 32; length++)
+		lengthCounts[maxLength] += lengthCounts[length];
+
+	uint32 total = 0;
+	for (uint32 length = maxLength; length > 0; length--)
+		total += lengthCounts[length] << (maxLength - length);
+	while (total != (1u << maxLength))
+	{
+		lengthCounts[maxLength]--;
+		for (uint32 length = maxLength - 1; length > 0; length--)
+		{
+			if (lengthCounts[length])
+			{
+				lengthCounts[length]--;
+				lengthCounts[length + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// Most frequent symbols get shortest codes.
+	uint32 index = itemCount;
+	for (uint32 length = 1; length <= maxLength; length++)
+	{
+		for (uint32 i = lengthCounts[length]; i; i--)
+			lengths[items[--index].symbol] = uint8(length);
+	}
+}
+
+// Canonical codes, bit reversed as deflate streams are written from least significant bit.
+static void BuildCodes(const uint8* lengths, uint32 symbolCount, uint16* codes)
+{
+	uint32 lengthCounts[MaxCodeLength + 1] = {};
+	for (uint32 i = 0; i < symbolCount; i++)
+		lengthCounts[lengths[i]]++;
+	lengthCounts[0] = 0;
+
+	uint32 nextCodes[MaxCodeLength + 1];
+	uint32 code = 0;
+	for (uint32 length = 1; length <= MaxCodeLength; length++)
+	{
+		code = (code + lengthCounts[length - 1]) << 1;
+		nextCodes[length] = code;
+	}
+
+	for (uint32 i = 0; i < symbolCount; i++)
+	{
+		if (lengths[i])
+			codes[i] = uint16(ReverseBits(nextCodes[lengths[i]]++, lengths[i]));
+	}
+}
+
+// Deflate ==================================================================================//
+
+namespace
+{
+	struct DeflateCodeTables
+	{
+		uint8 lengthCodes[256];		// Of length - 3.
+		uint8 distanceCodes[512];	// Of distance - 1 below 256, then of (distance - 1) >> 7.
+
+		DeflateCodeTables()
+		{
+			for (uint32 code = 0; code < countof(LengthBases); code++)
+			{
+				for (uint32 i = 0; i < (1u << LengthExtraBits[code]); i++)
+					lengthCodes[min<uint32>(LengthBases[code] - 3 + i, 255)] = uint8(code);
+			}
+
+			for (uint32 code = 0; code < countof(DistanceBases); code++)
+			{
+				for (uint32 i = 0; i < (1u << DistanceExtraBits[code]); i++)
+				{
+					uint32 distance = DistanceBases[code] - 1 + i;
+					distanceCodes[distance < 256 ? distance : 256 + (distance >> 7)] = uint8(code);
+				}
+			}
+		}
+
+		inline uint32 getDistanceCode(uint32 distance) const
+		{
+			distance--;
+			return distance < 256 ? distanceCodes[distance] : distanceCodes[256 + (distance >> 7)];
+		}
+	};
+
+	struct DeflateSymbol
+	{
+		uint16 literalOrLength;
+		uint16 distance;	// Zero for literal.
+	};
+
+	struct DeflateState
+	{
+		uint32 head[1 << HashBits];
+		uint32 previous[WindowSize];
+		uint32 literalLengthFrequencies[LiteralLengthCodeCount];
+		uint32 distanceFrequencies[DistanceCodeCount];
+		DeflateSymbol symbols[BlockSymbolLimit];
+		uint32 symbolCount;
+	};
+
+	struct BitWriter
+	{
+		byte *output;
+		uint64 bits;
+		uint32 bitCount;
+
+		// Count must be at most 32 and value must not have bits above it.
+		inline void put(uint32 value, uint32 count)
+		{
+			bits |= uint64(value) << bitCount;
+			bitCount += count;
+			if (bitCount >= 32)
+			{
+				Store32(output, uint32(bits));
+				output += 4;
+				bits >>= 32;
+				bitCount -= 32;
+			}
+		}
+
+		inline void alignToByte()
+		{
+			for (; bitCount > 0; bitCount = bitCount > 8 ? bitCount - 8 : 0)
+			{
+				*output++ = byte(bits);
+				bits >>= 8;
+			}
+			bits = 0;
+		}
+	};
+}
+
+static inline uint32 Hash(uint32 value)
+{
+	return (value * 0x9E3779B1) >> (32 - HashBits);
+}
+
+static inline uint32 MatchLength(const byte* a, const byte* b, uint32 maxLength)
+{
+	uint32 length = 0;
+	for (; length + 16 <= maxLength; length += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + length));
+		__m128i y = _mm_loadu_si128((const __m128i*)(b + length));
+		uint32 mismatchMask = uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) ^ 0xFFFF;
+		if (mismatchMask)
+			return length + ctz(mismatchMask);
+	}
+	while (length < maxLength && a[length] == b[length])
+		length++;
+	return length;
+}
+
+static void WriteStoredBlocks(BitWriter& writer, const byte* data, uint32 size, bool final)
+{
+	do
+	{
+		uint32 blockSize = min(size, StoredBlockSizeLimit);
+		size -= blockSize;
+
+		writer.put(final && !size ? 1 : 0, 1);
+		writer.put(0, 2);
+		writer.alignToByte();
+
+		Store32(writer.output, blockSize | ((blockSize ^ 0xFFFF) << 16));
+		Memory::Copy(writer.output + 4, data, blockSize);
+		writer.output += 4 + blockSize;
+		data += blockSize;
+	} while (size);
+}
+
+static void WriteBlock(DeflateState& state, const DeflateCodeTables& tables,
+	BitWriter& writer, const byte* data, uint32 size, bool final)
+{
+	state.literalLengthFrequencies[EndOfBlock]++;
+
+	uint8 literalLengthLengths[LiteralLengthCodeCount];
+	uint8 distanceLengths[DistanceCodeCount];
+	BuildCodeLengths(state.literalLengthFrequencies, LiteralLengthCodeCount, MaxCodeLength, literalLengthLengths);
+	BuildCodeLengths(state.distanceFrequencies, DistanceCodeCount, MaxCodeLength, distanceLengths);
+
+	uint32 literalLengthCount = LiteralLengthCodeCount;
+	while (literalLengthCount > 257 && !literalLengthLengths[literalLengthCount - 1])
+		literalLengthCount--;
+	uint32 distanceCount = DistanceCodeCount;
+	while (distanceCount > 1 && !distanceLengths[distanceCount - 1])
+		distanceCount--;
+
+	// Code lengths of both codes are run length coded with code length code symbols 0-18.
+	uint8 lengths[LiteralLengthCodeCount + DistanceCodeCount];
+	Memory::Copy(lengths, literalLengthLengths, literalLengthCount);
+	Memory::Copy(lengths + literalLengthCount, distanceLengths, distanceCount);
+	uint32 lengthCount = literalLengthCount + distanceCount;
+
+	uint8 runSymbols[LiteralLengthCodeCount + DistanceCodeCount];
+	uint8 runExtraValues[LiteralLengthCodeCount + DistanceCodeCount];
+	uint32 runSymbolCount = 0;
+	uint32 codeLengthFrequencies[CodeLengthCodeCount] = {};
+
+	auto emitRunSymbol = [&](uint32 symbol, uint32 extraValue)
+	{
+		runSymbols[runSymbolCount] = uint8(symbol);
+		runExtraValues[runSymbolCount] = uint8(extraValue);
+		runSymbolCount++;
+		codeLengthFrequencies[symbol]++;
+	};
+
+	for (uint32 i = 0; i < lengthCount;)
+	{
+		uint32 length = lengths[i];
+		uint32 runLength = 1;
+		while (i + runLength < lengthCount && lengths[i + runLength] == length)
+			runLength++;
+		i += runLength;
+
+		if (length == 0)
+		{
+			for (; runLength >= 11; runLength -= min<uint32>(runLength, 138))
+				emitRunSymbol(18, min<uint32>(runLength, 138) - 11);
+			if (runLength >= 3)
+			{
+				emitRunSymbol(17, runLength - 3);
+				runLength = 0;
+			}
+		}
+		else
+		{
+			emitRunSymbol(length, 0);
+			runLength--;
+			for (; runLength >= 3; runLength -= min<uint32>(runLength, 6))
+				emitRunSymbol(16, min<uint32>(runLength, 6) - 3);
+		}
+		for (; runLength; runLength--)
+			emitRunSymbol(length, 0);
+	}
+
+	uint8 codeLengthLengths[CodeLengthCodeCount];
+	BuildCodeLengths(codeLengthFrequencies, CodeLengthCodeCount, MaxCodeLengthCodeLength, codeLengthLengths);
+	uint32 codeLengthCount = CodeLengthCodeCount;
+	while (codeLengthCount > 4 && !codeLengthLengths[CodeLengthCodeOrder[codeLengthCount - 1]])
+		codeLengthCount--;
+
+	// Block is stored if dynamic coding does not make it smaller.
+	uint64 dynamicBitCount = 3 + 5 + 5 + 4 + 3 * codeLengthCount +
+		codeLengthFrequencies[16] * 2 + codeLengthFrequencies[17] * 3 + codeLengthFrequencies[18] * 7;
+	for (uint32 i = 0; i < CodeLengthCodeCount; i++)
+		dynamicBitCount += uint64(codeLengthFrequencies[i]) * codeLengthLengths[i];
+	for (uint32 i = 0; i < LiteralLengthCodeCount; i++)
+	{
+		uint32 extraBitCount = i > EndOfBlock ? LengthExtraBits[i - 257] : 0;
+		dynamicBitCount += uint64(state.literalLengthFrequencies[i]) * (literalLengthLengths[i] + extraBitCount);
+	}
+	for (uint32 i = 0; i < DistanceCodeCount; i++)
+		dynamicBitCount += uint64(state.distanceFrequencies[i]) * (distanceLengths[i] + DistanceExtraBits[i]);
+
+	uint32 storedBlockCount = max<uint32>((size + StoredBlockSizeLimit - 1) / StoredBlockSizeLimit, 1);
+	uint64 storedBitCount = uint64(storedBlockCount) * (3 + 7 + 32) + uint64(size) * 8;
+
+	if (storedBitCount <= dynamicBitCount)
+	{
+		WriteStoredBlocks(writer, data, size, final);
+		return;
+	}
+
+	writer.put(final ? 1 : 0, 1);
+	writer.put(2, 2);
+	writer.put(literalLengthCount - 257, 5);
+	writer.put(distanceCount - 1, 5);
+	writer.put(codeLengthCount - 4, 4);
+	for (uint32 i = 0; i < codeLengthCount; i++)
+		writer.put(codeLengthLengths[CodeLengthCodeOrder[i]], 3);
+
+	uint16 codeLengthCodes[CodeLengthCodeCount];
+	BuildCodes(codeLengthLengths, CodeLengthCodeCount, codeLengthCodes);
+	for (uint32 i = 0; i < runSymbolCount; i++)
+	{
+		uint32 symbol = runSymbols[i];
+		writer.put(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+		if (symbol >= 16)
+			writer.put(runExtraValues[i], symbol == 16 ? 2 : (symbol == 17 ? 3 : 7));
+	}
+
+	uint16 literalLengthCodes[LiteralLengthCodeCount];
+	uint16 distanceCodes[DistanceCodeCount];
+	BuildCodes(literalLengthLengths, LiteralLengthCodeCount, literalLengthCodes);
+	BuildCodes(distanceLengths, DistanceCodeCount, distanceCodes);
+
+	for (uint32 i = 0; i < state.symbolCount; i++)
+	{
+		DeflateSymbol symbol = state.symbols[i];
+		if (!symbol.distance)
+		{
+			writer.put(literalLengthCodes[symbol.literalOrLength], literalLengthLengths[symbol.literalOrLength]);
+			continue;
+		}
+
+		uint32 lengthCode = tables.lengthCodes[symbol.literalOrLength - 3];
+		writer.put(literalLengthCodes[257 + lengthCode], literalLengthLengths[257 + lengthCode]);
+		writer.put(symbol.literalOrLength - LengthBases[lengthCode], LengthExtraBits[lengthCode]);
+
+		uint32 distanceCode = tables.getDistanceCode(symbol.distance);
+		writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+		writer.put(symbol.distance - DistanceBases[distanceCode], DistanceExtraBits[distanceCode]);
+	}
+
+	writer.put(literalLengthCodes[EndOfBlock], literalLengthLengths[EndOfBlock]);
+}
+
+static inline void ResetBlock(DeflateState& state)
+{
+	Memory::Set(state.literalLengthFrequencies, 0, sizeof(state.literalLengthFrequencies));
+	Memory::Set(state.distanceFrequencies, 0, sizeof(state.distanceFrequencies));
+	state.symbolCount = 0;
+}
+
+uintptr Deflate::GetMaxCompressedSize(uintptr size)
+{
+	// Every block is at most as large as stored one: 5 bytes per stored block of at most
+	// 64 KB. Blocks are ended at least every BlockSymbolLimit bytes.
+	return size + size / 2048 + 64;
+}
+
+uintptr Deflate::Compress(const void* data, uintptr _size, void* buffer, bool final)
+{
+	Debug::CrashCondition(_size >= NoPosition, DbgMsgFmt("data is too large"));
+
+	static const DeflateCodeTables tables;
+
+	HeapPtr<DeflateState> statePtr(1);
+	DeflateState &state = *statePtr;
+	Memory::Set(state.head, 0xFF, sizeof(state.head));
+	ResetBlock(state);
+
+	const byte *source = (const byte*)data;
+	const uint32 size = uint32(_size);
+	BitWriter writer = { (byte*)buffer, 0, 0 };
+
+	uint32 position = 0, blockStart = 0;
+	while (position < size)
+	{
+		uint32 bestLength = 0, bestDistance = 0;
+		uint32 remainingSize = size - position;
+
+		if (remainingSize >= MinMatchLength)
+		{
+			uint32 value = Load32(source + position);
+			uint32 hash = Hash(value);
+			uint32 candidate = state.head[hash];
+			state.head[hash] = position;
+			state.previous[position & WindowMask] = candidate;
+
+			uint32 maxLength = min(remainingSize, MaxMatchLength);
+			for (uint32 depth = ChainDepthLimit; depth && candidate != NoPosition &&
+				position - candidate <= WindowSize; depth--)
+			{
+				if (source[candidate + bestLength] == source[position + bestLength] &&
+					Load32(source + candidate) == value)
+				{
+					uint32 length = MatchLength(source + candidate, source + position, maxLength);
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = position - candidate;
+						if (length >= NiceMatchLength || length == maxLength)
+							break;
+					}
+				}
+
+				// Chain link may be overwritten by newer position, chain ends then.
+				uint32 next = state.previous[candidate & WindowMask];
+				if (next >= candidate)
+					break;
+				candidate = next;
+			}
+		}
+
+		DeflateSymbol &symbol = state.symbols[state.symbolCount++];
+		if (bestLength >= MinMatchLength)
+		{
+			symbol.literalOrLength = uint16(bestLength);
+			symbol.distance = uint16(bestDistance);
+			state.literalLengthFrequencies[257 + tables.lengthCodes[bestLength - 3]]++;
+			state.distanceFrequencies[tables.getDistanceCode(bestDistance)]++;
+
+			uint32 matchEnd = position + bestLength;
+			uint32 hashEnd = min(matchEnd, size - MinMatchLength + 1);
+			for (position++; position < hashEnd; position++)
+			{
+				uint32 hash = Hash(Load32(source + position));
+				state.previous[position & WindowMask] = state.head[hash];
+				state.head[hash] = position;
+			}
+			position = matchEnd;
+		}
+		else
+		{
+			symbol.literalOrLength = source[position];
+			symbol.distance = 0;
+			state.literalLengthFrequencies[source[position]]++;
+			position++;
+		}
+
+		if (state.symbolCount == BlockSymbolLimit)
+		{
+			WriteBlock(state, tables, writer, source + blockStart, position - blockStart, final && position == size);
+			ResetBlock(state);
+			blockStart = position;
+		}
+	}
+
+	if (state.symbolCount || (final && !size))
+		WriteBlock(state, tables, writer, source + blockStart, position - blockStart, final);
+
+	if (!final)
+	{
+		// Sync flush, empty stored block.
+		writer.put(0, 3);
+		writer.alignToByte();
+		Store32(writer.output, 0xFFFF0000);
+		writer.output += 4;
+	}
+	writer.alignToByte();
+
+	return writer.output - (byte*)buffer;
+}
+
+// Inflate ==================================================================================//
+
+static constexpr uint32 FastDecodeBits = 10;
+
+namespace
+{
+	struct HuffmanDecoder
+	{
+		uint16 fastEntries[1 << FastDecodeBits];	// (symbol << 4) | length, zero for longer codes.
+		uint16 lengthCounts[MaxCodeLength + 1];
+		uint16 sortedSymbols[FixedLiteralLengthCodeCount];
+	};
+
+	struct FixedHuffmanDecoders
+	{
+		HuffmanDecoder literalLength;
+		HuffmanDecoder distance;
+
+		FixedHuffmanDecoders();
+	};
+
+	struct BitReader
+	{
+		const byte *input;
+		const byte *inputEnd;
+		uint64 bits;
+		uint32 bitCount;
+		uint32 paddingBitCount;		// Zero bits appended after end of data.
+
+		// Fills bit buffer to at least 56 bits.
+		inline void refill()
+		{
+			if (inputEnd - input >= 8)
+			{
+				bits |= Load64(input) << bitCount;
+				input += (63 - bitCount) >> 3;
+				bitCount |= 56;
+				return;
+			}
+
+			for (; bitCount <= 56; bitCount += 8)
+			{
+				if (input < inputEnd)
+					bits |= uint64(*input++) << bitCount;
+				else
+					paddingBitCount += 8;
+			}
+		}
+
+		inline uint32 get(uint32 count)
+		{
+			uint32 value = uint32(bits) & ((1u << count) - 1);
+			consume(count);
+			return value;
+		}
+
+		inline void consume(uint32 count)
+		{
+			bits >>= count;
+			bitCount -= count;
+		}
+
+		inline bool isOverrun() const { return paddingBitCount > bitCount; }
+		inline uintptr getRemainingBitCount() const
+		{
+			return uintptr(inputEnd - input) * 8 + bitCount - paddingBitCount;
+		}
+	};
+}
+
+static bool BuildDecoder(HuffmanDecoder& decoder, const uint8* lengths, uint32 symbolCount)
+{
+	Memory::Set(decoder.lengthCounts, 0, sizeof(decoder.lengthCounts));
+	for (uint32 i = 0; i < symbolCount; i++)
+		decoder.lengthCounts[lengths[i]]++;
+	decoder.lengthCounts[0] = 0;
+
+	// Over-subscribed codes are invalid. Incomplete ones are accepted and unused codes
+	// fail on decode.
+	sint32 left = 1;
+	uint32 offsets[MaxCodeLength + 1];
+	offsets[1] = 0;
+	for (uint32 length = 1; length <= MaxCodeLength; length++)
+	{
+		left = (left << 1) - decoder.lengthCounts[length];
+		if (left < 0)
+			return false;
+		if (length < MaxCodeLength)
+			offsets[length + 1] = offsets[length] + decoder.lengthCounts[length];
+	}
+
+	for (uint32 i = 0; i < symbolCount; i++)
+	{
+		if (lengths[i])
+			decoder.sortedSymbols[offsets[lengths[i]]++] = uint16(i);
+	}
+
+	Memory::Set(decoder.fastEntries, 0, sizeof(decoder.fastEntries));
+	uint32 code = 0, index = 0;
+	for (uint32 length = 1; length <= FastDecodeBits; length++, code <<= 1)
+	{
+		for (uint32 i = 0; i < decoder.lengthCounts[length]; i++, code++)
+		{
+			uint16 entry = uint16((decoder.sortedSymbols[index++] << 4) | length);
+			for (uint32 j = ReverseBits(code, length); j < (1 << FastDecodeBits); j += 1 << length)
+				decoder.fastEntries[j] = entry;
+		}
+	}
+
+	return true;
+}
+
+FixedHuffmanDecoders::FixedHuffmanDecoders()
+{
+	uint8 lengths[FixedLiteralLengthCodeCount];
+	for (uint32 i = 0; i < FixedLiteralLengthCodeCount; i++)
+		lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+	BuildDecoder(literalLength, lengths, FixedLiteralLengthCodeCount);
+
+	for (uint32 i = 0; i < FixedDistanceCodeCount; i++)
+		lengths[i] = 5;
+	BuildDecoder(distance, lengths, FixedDistanceCodeCount);
+}
+
+// Bit buffer must hold at least 15 bits. Returns -1 for invalid code.
+static inline sint32 DecodeSymbol(BitReader& reader, const HuffmanDecoder& decoder)
+{
+	uint32 entry = decoder.fastEntries[uint32(reader.bits) & ((1 << FastDecodeBits) - 1)];
+	if (entry)
+	{
+		reader.consume(entry & 0xF);
+		return sint32(entry >> 4);
+	}
+
+	// Long codes are decoded canonically bit by bit.
+	uint32 code = 0, first = 0, index = 0;
+	for (uint32 length = 1; length <= MaxCodeLength; length++)
+	{
+		code |= uint32(reader.bits >> (length - 1)) & 1;
+		uint32 count = decoder.lengthCounts[length];
+		if (code - first < count)
+		{
+			reader.consume(length);
+			return decoder.sortedSymbols[index + code - first];
+		}
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+// Bit buffer is dropped, so reader input points to stored data afterwards.
+static bool ReadStoredBlockHeader(BitReader& reader, uint32& size)
+{
+	reader.consume(reader.bitCount & 7);
+	if (reader.isOverrun())
+		return false;
+
+	const byte *input = reader.input - (reader.bitCount - reader.paddingBitCount) / 8;
+	if (reader.inputEnd - input < 4)
+		return false;
+
+	uint32 header = Load32(input);
+	size = header & 0xFFFF;
+	if ((header >> 16) != (size ^ 0xFFFF))
+		return false;
+	input += 4;
+
+	if (uintptr(reader.inputEnd - input) < size)
+		return false;
+
+	reader.input = input;
+	reader.bits = 0;
+	reader.bitCount = 0;
+	reader.paddingBitCount = 0;
+	return true;
+}
+
+static bool InflateStoredBlock(BitReader& reader, byte* output, uintptr outputCapacity, uintptr& outputPosition)
+{
+	uint32 size = 0;
+	if (!ReadStoredBlockHeader(reader, size) || outputCapacity - outputPosition < size)
+		return false;
+
+	Memory::Copy(output + outputPosition, reader.input, size);
+	outputPosition += size;
+	reader.input += size;
+	return true;
+}
+
+enum class InflateBlockResult
+{
+	Error = 0,
+	Finished,
+	OutputFull,
+};
+
+// Resumable decoding stops before symbol that might not fit to output, leaving reader at it.
+template <bool resumable>
+static InflateBlockResult InflateHuffmanBlock(BitReader& reader, const HuffmanDecoder& literalLengthDecoder,
+	const HuffmanDecoder& distanceDecoder, byte* output, uintptr outputCapacity, uintptr& outputPosition)
+{
+	uintptr position = outputPosition;
+
+	for (;;)
+	{
+		if (resumable && outputCapacity - position < MaxMatchLength)
+		{
+			outputPosition = position;
+			return InflateBlockResult::OutputFull;
+		}
+
+		// Longest symbol with extra bits and distance take 48 bits.
+		reader.refill();
+
+		sint32 symbol = DecodeSymbol(reader, literalLengthDecoder);
+		if (symbol < 0)
+			return InflateBlockResult::Error;
+
+		if (symbol < 256)
+		{
+			if (position == outputCapacity)
+				return InflateBlockResult::Error;
+			output[position++] = byte(symbol);
+			continue;
+		}
+		if (symbol == EndOfBlock)
+			break;
+
+		uint32 lengthCode = uint32(symbol) - 257;
+		if (lengthCode >= countof(LengthBases))
+			return InflateBlockResult::Error;
+		uint32 length = LengthBases[lengthCode] + reader.get(LengthExtraBits[lengthCode]);
+
+		sint32 distanceCode = DecodeSymbol(reader, distanceDecoder);
+		if (distanceCode < 0 || distanceCode >= sint32(DistanceCodeCount))
+			return InflateBlockResult::Error;
+		uint32 distance = DistanceBases[distanceCode] + reader.get(DistanceExtraBits[distanceCode]);
+
+		if (distance > position || length > outputCapacity - position)
+			return InflateBlockResult::Error;
+
+		byte *destination = output + position;
+		const byte *source = destination - distance;
+		if (distance >= 8 && outputCapacity - position >= length + 8)
+		{
+			// Source is always at least 8 bytes behind, so every word is already written.
+			for (uint32 i = 0; i < length; i += 8)
+				Store64(destination + i, Load64(source + i));
+		}
+		else if (distance == 1)
+			Memory::Set(destination, *source, length);
+		else
+		{
+			for (uint32 i = 0; i < length; i++)
+				destination[i] = source[i];
+		}
+		position += length;
+	}
+
+	outputPosition = position;
+	return InflateBlockResult::Finished;
+}
+
+static bool ReadDynamicDecoders(BitReader& reader,
+	HuffmanDecoder& literalLengthDecoder, HuffmanDecoder& distanceDecoder)
+{
+	reader.refill();
+	uint32 literalLengthCount = reader.get(5) + 257;
+	uint32 distanceCount = reader.get(5) + 1;
+	uint32 codeLengthCount = reader.get(4) + 4;
+	if (literalLengthCount > LiteralLengthCodeCount || distanceCount > DistanceCodeCount)
+		return false;
+
+	uint8 codeLengthLengths[CodeLengthCodeCount] = {};
+	for (uint32 i = 0; i < codeLengthCount; i++)
+	{
+		reader.refill();
+		codeLengthLengths[CodeLengthCodeOrder[i]] = uint8(reader.get(3));
+	}
+
+	HuffmanDecoder codeLengthDecoder;
+	if (!BuildDecoder(codeLengthDecoder, codeLengthLengths, CodeLengthCodeCount))
+		return false;
+
+	uint8 lengths[LiteralLengthCodeCount + DistanceCodeCount];
+	uint32 lengthCount = literalLengthCount + distanceCount;
+	for (uint32 i = 0; i < lengthCount;)
+	{
+		reader.refill();
+		sint32 symbol = DecodeSymbol(reader, codeLengthDecoder);
+		if (symbol < 0)
+			return false;
+
+		if (symbol < 16)
+		{
+			lengths[i++] = uint8(symbol);
+			continue;
+		}
+
+		uint8 repeatedLength = 0;
+		uint32 repeatCount = 0;
+		if (symbol == 16)
+		{
+			if (i == 0)
+				return false;
+			repeatedLength = lengths[i - 1];
+			repeatCount = 3 + reader.get(2);
+		}
+		else if (symbol == 17)
+			repeatCount = 3 + reader.get(3);
+		else
+			repeatCount = 11 + reader.get(7);
+
+		if (repeatCount > lengthCount - i)
+			return false;
+		for (; repeatCount; repeatCount--)
+			lengths[i++] = repeatedLength;
+	}
+
+	if (!lengths[EndOfBlock])
+		return false;
+
+	return BuildDecoder(literalLengthDecoder, lengths, literalLengthCount) &&
+		BuildDecoder(distanceDecoder, lengths + literalLengthCount, distanceCount);
+}
+
+static const FixedHuffmanDecoders& GetFixedDecoders()
+{
+	static const FixedHuffmanDecoders fixedDecoders;
+	return fixedDecoders;
+}
+
+bool Inflate::Decompress(const void* data, uintptr dataSize,
+	void* _output, uintptr outputCapacity, uintptr& outputSize)
+{
+	const FixedHuffmanDecoders &fixedDecoders = GetFixedDecoders();
+
+	BitReader reader = { (const byte*)data, (const byte*)data + dataSize, 0, 0, 0 };
+	byte *output = (byte*)_output;
+	uintptr outputPosition = 0;
+	outputSize = 0;
+
+	HuffmanDecoder literalLengthDecoder, distanceDecoder;
+
+	for (;;)
+	{
+		reader.refill();
+		bool final = reader.get(1) != 0;
+		uint32 type = reader.get(2);
+
+		bool result = false;
+		switch (type)
+		{
+			case 0:
+				result = InflateStoredBlock(reader, output, outputCapacity, outputPosition);
+				break;
+
+			case 1:
+				result = InflateHuffmanBlock<false>(reader, fixedDecoders.literalLength, fixedDecoders.distance,
+					output, outputCapacity, outputPosition) == InflateBlockResult::Finished;
+				break;
+
+			case 2:
+				result = ReadDynamicDecoders(reader, literalLengthDecoder, distanceDecoder) &&
+					InflateHuffmanBlock<false>(reader, literalLengthDecoder, distanceDecoder,
+						output, outputCapacity, outputPosition) == InflateBlockResult::Finished;
+				break;
+		}
+
+		if (!result || reader.isOverrun())
+			return false;
+		if (final || reader.getRemainingBitCount() < 8)
+			break;
+	}
+
+	outputSize = outputPosition;
+	return true;
+}
+
+// InflateStream ============================================================================//
+
+static constexpr uint32 StreamBufferSize = WindowSize * 3;	// Window and decoded data.
+
+struct InflateStream::State
+{
+	enum class Phase : uint8
+	{
+		BlockHeader = 0,
+		StoredBlock,
+		HuffmanBlock,
+		Finished,
+	};
+
+	BitReader reader;
+	HuffmanDecoder literalLengthDecoder;
+	HuffmanDecoder distanceDecoder;
+	const HuffmanDecoder *currentLiteralLengthDecoder;
+	const HuffmanDecoder *currentDistanceDecoder;
+	uint32 storedBlockRemainingSize;
+	Phase phase;
+	bool finalBlock;
+
+	uintptr bufferSize;
+	uintptr bufferReadPosition;
+	byte buffer[StreamBufferSize];
+
+	bool decode();
+	void endBlock();
+};
+
+void InflateStream::State::endBlock()
+{
+	phase = (finalBlock || reader.getRemainingBitCount() < 8) ? Phase::Finished : Phase::BlockHeader;
+}
+
+// Decodes until buffer can't take longest match or stream ends.
+bool InflateStream::State::decode()
+{
+	while (phase != Phase::Finished && StreamBufferSize - bufferSize >= MaxMatchLength)
+	{
+		switch (phase)
+		{
+			case Phase::BlockHeader:
+			{
+				reader.refill();
+				finalBlock = reader.get(1) != 0;
+				uint32 type = reader.get(2);
+
+				bool result = false;
+				switch (type)
+				{
+					case 0:
+						result = ReadStoredBlockHeader(reader, storedBlockRemainingSize);
+						phase = Phase::StoredBlock;
+						break;
+
+					case 1:
+						currentLiteralLengthDecoder = &GetFixedDecoders().literalLength;
+						currentDistanceDecoder = &GetFixedDecoders().distance;
+						phase = Phase::HuffmanBlock;
+						result = true;
+						break;
+
+					case 2:
+						result = ReadDynamicDecoders(reader, literalLengthDecoder, distanceDecoder);
+						currentLiteralLengthDecoder = &literalLengthDecoder;
+						currentDistanceDecoder = &distanceDecoder;
+						phase = Phase::HuffmanBlock;
+						break;
+				}
+
+				if (!result || reader.isOverrun())
+					return false;
+				break;
+			}
+
+			case Phase::StoredBlock:
+			{
+				uint32 size = uint32(min<uintptr>(storedBlockRemainingSize, StreamBufferSize - bufferSize));
+				Memory::Copy(buffer + bufferSize, reader.input, size);
+				reader.input += size;
+				bufferSize += size;
+				storedBlockRemainingSize -= size;
+
+				if (!storedBlockRemainingSize)
+					endBlock();
+				break;
+			}
+
+			case Phase::HuffmanBlock:
+			{
+				InflateBlockResult result = InflateHuffmanBlock<true>(reader,
+					*currentLiteralLengthDecoder, *currentDistanceDecoder, buffer, StreamBufferSize, bufferSize);
+				if (result == InflateBlockResult::Error || reader.isOverrun())
+					return false;
+
+				if (result == InflateBlockResult::Finished)
+					endBlock();
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+void InflateStream::initialize(const void* data, uintptr dataSize)
+{
+	if (!state)
+		state = Heap::Allocate<State>();
+
+	state->reader = { (const byte*)data, (const byte*)data + dataSize, 0, 0, 0 };
+	state->currentLiteralLengthDecoder = nullptr;
+	state->currentDistanceDecoder = nullptr;
+	state->storedBlockRemainingSize = 0;
+	state->phase = State::Phase::BlockHeader;
+	state->finalBlock = false;
+	state->bufferSize = 0;
+	state->bufferReadPosition = 0;
+}
+
+void InflateStream::destroy()
+{
+	if (state)
+	{
+		Heap::Release(state);
+		state = nullptr;
+	}
+}
+
+bool InflateStream::read(void* _output, uintptr outputCapacity, uintptr& outputSize)
+{
+	byte *output = (byte*)_output;
+	outputSize = 0;
+
+	for (;;)
+	{
+		uintptr size = min(state->bufferSize - state->bufferReadPosition, outputCapacity - outputSize);
+		Memory::Copy(output + outputSize, state->buffer + state->bufferReadPosition, size);
+		state->bufferReadPosition += size;
+		outputSize += size;
+
+		if (outputSize == outputCapacity || state->phase == State::Phase::Finished)
+			return true;
+
+		// Everything decoded is passed to output, only window is kept for back references.
+		if (StreamBufferSize - state->bufferSize < MaxMatchLength)
+		{
+			Memory::Move(state->buffer, state->buffer + state->bufferSize - WindowSize, WindowSize);
+			state->bufferSize = WindowSize;
+			state->bufferReadPosition = WindowSize;
+		}
+
+		if (!state->decode())
+			return false;
+	}
+}
+
+bool InflateStream::isFinished() const
+{
+	return state->phase == State::Phase::Finished && state->bufferReadPosition == state->bufferSize;
+}
\ No newline at end of file
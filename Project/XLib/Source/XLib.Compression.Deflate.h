@@ -0,0 +1,67 @@
+#pragma once
+
+#include "XLib.Types.h"
+#include "XLib.NonCopyable.h"
+
+namespace XLib
+{
+	class Adler32
+	{
+	private:
+		uint32 value = 1;
+
+	public:
+		static uint32 Compute(const void* data, uintptr size, uint32 seed = 1);
+		// Checksum of two concatenated parts computed from checksums of the parts.
+		static uint32 Combine(uint32 first, uint32 second, uintptr secondSize);
+
+		inline void process(const void* data, uintptr size) { value = Compute(data, size, value); }
+		inline uint32 getValue() { return value; }
+		inline void reset() { value = 1; }
+	};
+
+	// Raw deflate stream (RFC 1951) compressor. Greedy LZ77 matching on hash chains, every
+	// block is coded with dynamic Huffman codes or stored if that is smaller.
+
+	struct Deflate XLIB_ABSTRACT final
+	{
+		static uintptr GetMaxCompressedSize(uintptr size);
+
+		// Data is compressed independently of anything before it. Non final part ends with
+		// empty stored block (sync flush), so it is byte aligned and parts compressed on
+		// different threads can be concatenated to single stream. Size must be below 4 GB.
+		static uintptr Compress(const void* data, uintptr size, void* buffer, bool final);
+	};
+
+	struct Inflate XLIB_ABSTRACT final
+	{
+		// Decompresses blocks until final block ends or data ends at block boundary. Output
+		// buffer is used as window, so back references can't point before its beginning.
+		// Returns false on corrupt data or if output does not fit to buffer.
+		static bool Decompress(const void* data, uintptr dataSize,
+			void* output, uintptr outputCapacity, uintptr& outputSize);
+	};
+
+	// Inflate of data that is whole in memory, with output taken in parts of any size, so
+	// output does not have to be held at once. Stops at the same point as Inflate.
+
+	class InflateStream : public NonCopyable
+	{
+	private:
+		struct State;
+
+		State *state = nullptr;
+
+	public:
+		InflateStream() = default;
+		inline ~InflateStream() { destroy(); }
+
+		// Data is referenced, not copied.
+		void initialize(const void* data, uintptr dataSize);
+		void destroy();
+
+		// Output is filled completely unless stream ends. Returns false on corrupt data.
+		bool read(void* output, uintptr outputCapacity, uintptr& outputSize);
+		bool isFinished() const;
+	};
+}
\ No newline at end of file
@@ -6,13 +6,13 @@
 
 namespace XLib
 {
-	struct CyclicQueueStoragePolicy abstract final
+	struct CyclicQueueStoragePolicy XLIB_ABSTRACT final
 	{
-		struct InternalHeap abstract final {};
-		struct External abstract final {};
+		struct InternalHeap XLIB_ABSTRACT final {};
+		struct External XLIB_ABSTRACT final {};
 
 		template <uint32 storageSize>
-		struct InternalStatic abstract final {};
+		struct InternalStatic XLIB_ABSTRACT final {};
 	};
 
 	template <typename Type, typename StoragePolicy = CyclicQueueStoragePolicy::InternalHeap>
@@ -7,16 +7,16 @@
 
 namespace XLib
 {
-	struct VectorHeapUsagePolicy abstract final
+	struct VectorHeapUsagePolicy XLIB_ABSTRACT final
 	{
-		class SingleDynamicHeapBuffer abstract final {};
+		class SingleDynamicHeapBuffer XLIB_ABSTRACT final {};
 
 		template <uint32 minSizeLog2, uint32 maxSizeLog2>
-		class MultipleStaticHeapBuffers abstract final
+		class MultipleStaticHeapBuffers XLIB_ABSTRACT final
 			{ static_assert(minSizeLog2 <= maxSizeLog2, "invalid params"); };
 
 		template <uint32 bufferSize>
-		class StaticBuffer abstract final {};
+		class StaticBuffer XLIB_ABSTRACT final {};
 	};
 
 	template <typename Type, typename HeapUsagePolicy =
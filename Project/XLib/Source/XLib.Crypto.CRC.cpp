@@ -1,6 +1,14 @@
+#include <immintrin.h>
+#include <stdio.h>
+
 #include "XLib.Crypto.CRC.h"
 
 #include "XLib.Util.h"
+#include "XLib.Heap.h"
+#include "XLib.Debug.h"
+#include "XLib.System.CPU.h"
+#include "XLib.Benchmark.h"
+#include "XLib.System.Threading.WorkerPool.h"
 
 using namespace XLib;
 
@@ -100,82 +108,467 @@ uint16 CRC16::Compute(const void* data, uintptr size, uint16 initValue)
 	return crc;
 }
 
+
+// Shared ===================================================================================//
+
+// Slicing by 16: sixteen bytes are processed per step with tables, where values[k][b] is CRC
+// of byte b followed by k zero bytes. Powers are x^(8 * 2^k) mod P, so CRC can be shifted
+// over any length in logarithmic number of multiplications.
+
+static inline uint32 LoadBE32(const byte* data)
+{
+	return (uint32(data[0]) << 24) | (uint32(data[1]) << 16) | (uint32(data[2]) << 8) | uint32(data[3]);
+}
+
+// Most significant bit is highest degree.
+static uint32 MultiplyModP(uint32 a, uint32 b, uint32 polynomial)
+{
+	uint32 result = 0;
+	for (uint32 i = 0; i < 32; i++)
+	{
+		result = (result << 1) ^ (polynomial & (0 - (result >> 31)));
+		if (a & (0x80000000 >> i))
+			result ^= b;
+	}
+	return result;
+}
+
+// Least significant bit is highest degree.
+static uint32 MultiplyModPReflected(uint32 a, uint32 b, uint32 polynomial)
+{
+	uint32 result = 0;
+	for (uint32 i = 0; i < 32; i++)
+	{
+		if (a & (0x80000000 >> i))
+			result ^= b;
+		b = (b >> 1) ^ (polynomial & (0 - (b & 1)));
+	}
+	return result;
+}
+
+struct CRC32Tables
+{
+	uint32 values[16][256];
+	uint32 powers[64];
+	uint64 foldConstants[2][2];		// x^(128 + 64) and x^128, x^(512 + 64) and x^512 mod P.
+
+	CRC32Tables(uint32 polynomial)
+	{
+		for (uint32 i = 0; i < 256; i++)
+		{
+			uint32 crc = i << 24;
+			for (uint32 j = 0; j < 8; j++)
+				crc = (crc << 1) ^ (polynomial & (0 - (crc >> 31)));
+			values[0][i] = crc;
+		}
+		for (uint32 i = 0; i < 256; i++)
+		{
+			for (uint32 j = 1; j < 16; j++)
+				values[j][i] = (values[j - 1][i] << 8) ^ values[0][values[j - 1][i] >> 24];
+		}
+
+		powers[0] = 1 << 8;
+		for (uint32 i = 1; i < 64; i++)
+			powers[i] = MultiplyModP(powers[i - 1], powers[i - 1], polynomial);
+
+		static constexpr uint32 foldDegrees[2][2] = { { 192, 128 }, { 576, 512 } };
+		for (uint32 i = 0; i < 2; i++)
+		{
+			for (uint32 j = 0; j < 2; j++)
+			{
+				uint32 power = 1;
+				for (uint32 k = 0; k < foldDegrees[i][j]; k++)
+					power = (power << 1) ^ (polynomial & (0 - (power >> 31)));
+				foldConstants[i][j] = power;
+			}
+		}
+	}
+
+	inline uint32 shift(uint32 crc, uint64 size, uint32 polynomial) const
+	{
+		for (uint32 i = 0; size; i++, size >>= 1)
+		{
+			if (size & 1)
+				crc = MultiplyModP(crc, powers[i], polynomial);
+		}
+		return crc;
+	}
+};
+
+struct CRC32ReflectedTables
+{
+	uint32 values[16][256];
+	uint32 powers[64];
+
+	CRC32ReflectedTables(uint32 polynomial)
+	{
+		for (uint32 i = 0; i < 256; i++)
+		{
+			uint32 crc = i;
+			for (uint32 j = 0; j < 8; j++)
+				crc = (crc >> 1) ^ (polynomial & (0 - (crc & 1)));
+			values[0][i] = crc;
+		}
+		for (uint32 i = 0; i < 256; i++)
+		{
+			for (uint32 j = 1; j < 16; j++)
+				values[j][i] = (values[j - 1][i] >> 8) ^ values[0][values[j - 1][i] & 0xFF];
+		}
+
+		powers[0] = 0x80000000 >> 8;
+		for (uint32 i = 1; i < 64; i++)
+			powers[i] = MultiplyModPReflected(powers[i - 1], powers[i - 1], polynomial);
+	}
+
+	inline uint32 shift(uint32 crc, uint64 size, uint32 polynomial) const
+	{
+		for (uint32 i = 0; size; i++, size >>= 1)
+		{
+			if (size & 1)
+				crc = MultiplyModPReflected(crc, powers[i], polynomial);
+		}
+		return crc;
+	}
+};
+
+static uint32 ComputeReflected_Slicing16(const uint32 (&table)[16][256], uint32 crc, const byte* current, const byte* end)
+{
+	for (; current + 16 <= end; current += 16)
+	{
+		uint32 word0 = *(const uint32*)current ^ crc;
+		uint32 word1 = *(const uint32*)(current + 4);
+		uint32 word2 = *(const uint32*)(current + 8);
+		uint32 word3 = *(const uint32*)(current + 12);
+		crc = table[15][word0 & 0xFF] ^ table[14][(word0 >> 8) & 0xFF] ^
+			table[13][(word0 >> 16) & 0xFF] ^ table[12][word0 >> 24] ^
+			table[11][word1 & 0xFF] ^ table[10][(word1 >> 8) & 0xFF] ^
+			table[9][(word1 >> 16) & 0xFF] ^ table[8][word1 >> 24] ^
+			table[7][word2 & 0xFF] ^ table[6][(word2 >> 8) & 0xFF] ^
+			table[5][(word2 >> 16) & 0xFF] ^ table[4][word2 >> 24] ^
+			table[3][word3 & 0xFF] ^ table[2][(word3 >> 8) & 0xFF] ^
+			table[1][(word3 >> 16) & 0xFF] ^ table[0][word3 >> 24];
+	}
+	for (; current < end; current++)
+		crc = (crc >> 8) ^ table[0][(crc ^ *current) & 0xFF];
+
+	return crc;
+}
+
+// CRC32 ====================================================================================//
+
+// Polynomial is not reflected and there is no inversion, seed is initial value. Kernels take
+// and return raw CRC.
+
+static constexpr uint32 CRC32Polynomial = 0x04C11DB7;
+
+using CRC32Kernel = uint32(*)(uint32 crc, const byte* current, const byte* end);
+
+static const CRC32Tables& GetCRC32Tables()
+{
+	static const CRC32Tables tables(CRC32Polynomial);
+	return tables;
+}
+
+static uint32 CRC32_Bytewise(uint32 crc, const byte* current, const byte* end)
+{
+	const uint32 (&table)[16][256] = GetCRC32Tables().values;
+
+	for (; current < end; current++)
+		crc = (crc << 8) ^ table[0][uint8((crc >> 24) ^ *current)];
+
+	return crc;
+}
+
+static uint32 CRC32_Slicing16(uint32 crc, const byte* current, const byte* end)
+{
+	const uint32 (&table)[16][256] = GetCRC32Tables().values;
+
+	for (; current + 16 <= end; current += 16)
+	{
+		uint32 word0 = LoadBE32(current) ^ crc;
+		uint32 word1 = LoadBE32(current + 4);
+		uint32 word2 = LoadBE32(current + 8);
+		uint32 word3 = LoadBE32(current + 12);
+		crc = table[15][word0 >> 24] ^ table[14][(word0 >> 16) & 0xFF] ^
+			table[13][(word0 >> 8) & 0xFF] ^ table[12][word0 & 0xFF] ^
+			table[11][word1 >> 24] ^ table[10][(word1 >> 16) & 0xFF] ^
+			table[9][(word1 >> 8) & 0xFF] ^ table[8][word1 & 0xFF] ^
+			table[7][word2 >> 24] ^ table[6][(word2 >> 16) & 0xFF] ^
+			table[5][(word2 >> 8) & 0xFF] ^ table[4][word2 & 0xFF] ^
+			table[3][word3 >> 24] ^ table[2][(word3 >> 16) & 0xFF] ^
+			table[1][(word3 >> 8) & 0xFF] ^ table[0][word3 & 0xFF];
+	}
+	for (; current < end; current++)
+		crc = (crc << 8) ^ table[0][uint8((crc >> 24) ^ *current)];
+
+	return crc;
+}
+
+static inline __m128i FoldCRC32(__m128i value, __m128i constants, __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(
+		_mm_clmulepi64_si128(value, constants, 0x11),
+		_mm_clmulepi64_si128(value, constants, 0x00)), data);
+}
+
+// Folding with carry-less multiplication. Blocks are byte swapped, so bit i of register is
+// coefficient of x^i. Folded value V = H * x^64 + L followed by n bits of data is congruent
+// to H * (x^(n + 64) mod P) + L * (x^n mod P), which fits in 96 bits, so four lanes advance
+// by 64 bytes per step with no reduction. Last 128-bit value, which has same CRC as data
+// folded into it, and remaining bytes are finished by tables.
+static uint32 CRC32_PCLMUL(uint32 crc, const byte* current, const byte* end)
+{
+	if (end - current < 128)
+		return CRC32_Slicing16(crc, current, end);
+
+	const CRC32Tables &tables = GetCRC32Tables();
+	const __m128i byteSwap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i fold1 = _mm_set_epi64x(sint64(tables.foldConstants[0][0]), sint64(tables.foldConstants[0][1]));
+	const __m128i fold4 = _mm_set_epi64x(sint64(tables.foldConstants[1][0]), sint64(tables.foldConstants[1][1]));
+
+	// Raw CRC is initial value of register, same as xor with first four bytes.
+	__m128i x0 = _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)current), byteSwap),
+		_mm_set_epi32(sint32(crc), 0, 0, 0));
+	__m128i x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 16)), byteSwap);
+	__m128i x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 32)), byteSwap);
+	__m128i x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 48)), byteSwap);
+	current += 64;
+
+	for (; current + 64 <= end; current += 64)
+	{
+		x0 = FoldCRC32(x0, fold4, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)current), byteSwap));
+		x1 = FoldCRC32(x1, fold4, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 16)), byteSwap));
+		x2 = FoldCRC32(x2, fold4, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 32)), byteSwap));
+		x3 = FoldCRC32(x3, fold4, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(current + 48)), byteSwap));
+	}
+
+	__m128i x = FoldCRC32(FoldCRC32(FoldCRC32(x0, fold1, x1), fold1, x2), fold1, x3);
+	for (; current + 16 <= end; current += 16)
+		x = FoldCRC32(x, fold1, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)current), byteSwap));
+
+	alignas(16) byte folded[16];
+	_mm_store_si128((__m128i*)folded, _mm_shuffle_epi8(x, byteSwap));
+
+	crc = CRC32_Slicing16(0, folded, folded + 16);
+	return CRC32_Slicing16(crc, current, end);
+}
+
+static CRC32Kernel GetCRC32Kernel()
+{
+	// PCLMULQDQ came after SSSE3, which is needed for byte swap.
+	static const CRC32Kernel kernel = CPU::SupportsPCLMULQDQ() ? CRC32_PCLMUL : CRC32_Slicing16;
+	return kernel;
+}
+
 uint32 CRC32::Compute(const void* data, uintptr size, uint32 initValue)
 {
-	static const uint32 table[256] =
-	{
-		0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
-		0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
-		0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61,
-		0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd,
-		0x4c11db70, 0x48d0c6c7, 0x4593e01e, 0x4152fda9,
-		0x5f15adac, 0x5bd4b01b, 0x569796c2, 0x52568b75,
-		0x6a1936c8, 0x6ed82b7f, 0x639b0da6, 0x675a1011,
-		0x791d4014, 0x7ddc5da3, 0x709f7b7a, 0x745e66cd,
-		0x9823b6e0, 0x9ce2ab57, 0x91a18d8e, 0x95609039,
-		0x8b27c03c, 0x8fe6dd8b, 0x82a5fb52, 0x8664e6e5,
-		0xbe2b5b58, 0xbaea46ef, 0xb7a96036, 0xb3687d81,
-		0xad2f2d84, 0xa9ee3033, 0xa4ad16ea, 0xa06c0b5d,
-		0xd4326d90, 0xd0f37027, 0xddb056fe, 0xd9714b49,
-		0xc7361b4c, 0xc3f706fb, 0xceb42022, 0xca753d95,
-		0xf23a8028, 0xf6fb9d9f, 0xfbb8bb46, 0xff79a6f1,
-		0xe13ef6f4, 0xe5ffeb43, 0xe8bccd9a, 0xec7dd02d,
-		0x34867077, 0x30476dc0, 0x3d044b19, 0x39c556ae,
-		0x278206ab, 0x23431b1c, 0x2e003dc5, 0x2ac12072,
-		0x128e9dcf, 0x164f8078, 0x1b0ca6a1, 0x1fcdbb16,
-		0x018aeb13, 0x054bf6a4, 0x0808d07d, 0x0cc9cdca,
-		0x7897ab07, 0x7c56b6b0, 0x71159069, 0x75d48dde,
-		0x6b93dddb, 0x6f52c06c, 0x6211e6b5, 0x66d0fb02,
-		0x5e9f46bf, 0x5a5e5b08, 0x571d7dd1, 0x53dc6066,
-		0x4d9b3063, 0x495a2dd4, 0x44190b0d, 0x40d816ba,
-		0xaca5c697, 0xa864db20, 0xa527fdf9, 0xa1e6e04e,
-		0xbfa1b04b, 0xbb60adfc, 0xb6238b25, 0xb2e29692,
-		0x8aad2b2f, 0x8e6c3698, 0x832f1041, 0x87ee0df6,
-		0x99a95df3, 0x9d684044, 0x902b669d, 0x94ea7b2a,
-		0xe0b41de7, 0xe4750050, 0xe9362689, 0xedf73b3e,
-		0xf3b06b3b, 0xf771768c, 0xfa325055, 0xfef34de2,
-		0xc6bcf05f, 0xc27dede8, 0xcf3ecb31, 0xcbffd686,
-		0xd5b88683, 0xd1799b34, 0xdc3abded, 0xd8fba05a,
-		0x690ce0ee, 0x6dcdfd59, 0x608edb80, 0x644fc637,
-		0x7a089632, 0x7ec98b85, 0x738aad5c, 0x774bb0eb,
-		0x4f040d56, 0x4bc510e1, 0x46863638, 0x42472b8f,
-		0x5c007b8a, 0x58c1663d, 0x558240e4, 0x51435d53,
-		0x251d3b9e, 0x21dc2629, 0x2c9f00f0, 0x285e1d47,
-		0x36194d42, 0x32d850f5, 0x3f9b762c, 0x3b5a6b9b,
-		0x0315d626, 0x07d4cb91, 0x0a97ed48, 0x0e56f0ff,
-		0x1011a0fa, 0x14d0bd4d, 0x19939b94, 0x1d528623,
-		0xf12f560e, 0xf5ee4bb9, 0xf8ad6d60, 0xfc6c70d7,
-		0xe22b20d2, 0xe6ea3d65, 0xeba91bbc, 0xef68060b,
-		0xd727bbb6, 0xd3e6a601, 0xdea580d8, 0xda649d6f,
-		0xc423cd6a, 0xc0e2d0dd, 0xcda1f604, 0xc960ebb3,
-		0xbd3e8d7e, 0xb9ff90c9, 0xb4bcb610, 0xb07daba7,
-		0xae3afba2, 0xaafbe615, 0xa7b8c0cc, 0xa379dd7b,
-		0x9b3660c6, 0x9ff77d71, 0x92b45ba8, 0x9675461f,
-		0x8832161a, 0x8cf30bad, 0x81b02d74, 0x857130c3,
-		0x5d8a9099, 0x594b8d2e, 0x5408abf7, 0x50c9b640,
-		0x4e8ee645, 0x4a4ffbf2, 0x470cdd2b, 0x43cdc09c,
-		0x7b827d21, 0x7f436096, 0x7200464f, 0x76c15bf8,
-		0x68860bfd, 0x6c47164a, 0x61043093, 0x65c52d24,
-		0x119b4be9, 0x155a565e, 0x18197087, 0x1cd86d30,
-		0x029f3d35, 0x065e2082, 0x0b1d065b, 0x0fdc1bec,
-		0x3793a651, 0x3352bbe6, 0x3e119d3f, 0x3ad08088,
-		0x2497d08d, 0x2056cd3a, 0x2d15ebe3, 0x29d4f654,
-		0xc5a92679, 0xc1683bce, 0xcc2b1d17, 0xc8ea00a0,
-		0xd6ad50a5, 0xd26c4d12, 0xdf2f6bcb, 0xdbee767c,
-		0xe3a1cbc1, 0xe760d676, 0xea23f0af, 0xeee2ed18,
-		0xf0a5bd1d, 0xf464a0aa, 0xf9278673, 0xfde69bc4,
-		0x89b8fd09, 0x8d79e0be, 0x803ac667, 0x84fbdbd0,
-		0x9abc8bd5, 0x9e7d9662, 0x933eb0bb, 0x97ffad0c,
-		0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668,
-		0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4,
-	};
+	const byte *current = (const byte*)data;
+	return GetCRC32Kernel()(initValue, current, current + size);
+}
 
-	uint32 crc = initValue;
+uint32 CRC32::Combine(uint32 crcA, uint32 crcB, uint64 sizeB)
+{
+	// CRC of B with seed A is A shifted over B plus CRC of B with zero seed.
+	return GetCRC32Tables().shift(crcA, sizeB, CRC32Polynomial) ^ crcB;
+}
 
-	byte *current = (byte*)data;
-	byte *end = current + size;
+// CRC32IEEE ================================================================================//
+
+static constexpr uint32 CRC32IEEEPolynomial = 0xEDB88320;
+
+static const CRC32ReflectedTables& GetCRC32IEEETables()
+{
+	static const CRC32ReflectedTables tables(CRC32IEEEPolynomial);
+	return tables;
+}
+
+uint32 CRC32IEEE::Compute(const void* data, uintptr size, uint32 initValue)
+{
+	const byte *current = (const byte*)data;
+	return ~ComputeReflected_Slicing16(GetCRC32IEEETables().values, ~initValue, current, current + size);
+}
+
+// Inversions of both parts cancel out, as in zlib crc32_combine.
+uint32 CRC32IEEE::Combine(uint32 crcA, uint32 crcB, uint64 sizeB)
+{
+	return GetCRC32IEEETables().shift(crcA, sizeB, CRC32IEEEPolynomial) ^ crcB;
+}
+
+// CRC32C ===================================================================================//
+
+static constexpr uint32 CRC32CPolynomial = 0x82F63B78;
+
+// SSE4.2 crc32 has latency of three cycles and throughput of one, so large blocks are split
+// into three streams computed together, which are then joined by shifting.
+static constexpr uintptr CRC32CStreamSize = 4096;
+
+struct CRC32CTables : CRC32ReflectedTables
+{
+	uint32 streamShifts[2];		// Shifts over one and two streams.
+
+	CRC32CTables() : CRC32ReflectedTables(CRC32CPolynomial)
+	{
+		streamShifts[0] = shift(0x80000000, CRC32CStreamSize, CRC32CPolynomial);
+		streamShifts[1] = shift(0x80000000, CRC32CStreamSize * 2, CRC32CPolynomial);
+	}
+};
+
+using CRC32CKernel = uint32(*)(uint32 crc, const byte* current, const byte* end);
+
+static const CRC32CTables& GetCRC32CTables()
+{
+	static const CRC32CTables tables;
+	return tables;
+}
+
+static uint32 CRC32C_Slicing16(uint32 crc, const byte* current, const byte* end)
+{
+	return ComputeReflected_Slicing16(GetCRC32CTables().values, crc, current, end);
+}
+
+#if defined(_WIN64) || defined(__LP64__)
+using CRC32CWord = uint64;
+static inline uint32 CRC32CStep(uint32 crc, const byte* data) { return uint32(_mm_crc32_u64(crc, *(const uint64*)data)); }
+#else
+using CRC32CWord = uint32;
+static inline uint32 CRC32CStep(uint32 crc, const byte* data) { return _mm_crc32_u32(crc, *(const uint32*)data); }
+#endif
+
+static uint32 CRC32C_SSE42(uint32 crc, const byte* current, const byte* end)
+{
+	if (end - current >= sintptr(CRC32CStreamSize * 3))
+	{
+		const CRC32CTables &tables = GetCRC32CTables();
+
+		for (; current + CRC32CStreamSize * 3 <= end; current += CRC32CStreamSize * 3)
+		{
+			uint32 crc0 = crc, crc1 = 0, crc2 = 0;
+			for (uintptr i = 0; i < CRC32CStreamSize; i += sizeof(CRC32CWord))
+			{
+				crc0 = CRC32CStep(crc0, current + i);
+				crc1 = CRC32CStep(crc1, current + CRC32CStreamSize + i);
+				crc2 = CRC32CStep(crc2, current + CRC32CStreamSize * 2 + i);
+			}
+			crc = MultiplyModPReflected(crc0, tables.streamShifts[1], CRC32CPolynomial) ^
+				MultiplyModPReflected(crc1, tables.streamShifts[0], CRC32CPolynomial) ^ crc2;
+		}
+	}
+
+	for (; current + sizeof(CRC32CWord) <= end; current += sizeof(CRC32CWord))
+		crc = CRC32CStep(crc, current);
 	for (; current < end; current++)
-		crc = (crc << 8) ^ table[uint8((crc >> 24) ^ *current)];
+		crc = _mm_crc32_u8(crc, *current);
+
+	return crc;
+}
+
+static CRC32CKernel GetCRC32CKernel()
+{
+	static const CRC32CKernel kernel = CPU::SupportsSSE42() ? CRC32C_SSE42 : CRC32C_Slicing16;
+	return kernel;
+}
+
+uint32 CRC32C::Compute(const void* data, uintptr size, uint32 initValue)
+{
+	const byte *current = (const byte*)data;
+	return ~GetCRC32CKernel()(~initValue, current, current + size);
+}
+
+uint32 CRC32C::Combine(uint32 crcA, uint32 crcB, uint64 sizeB)
+{
+	return GetCRC32CTables().shift(crcA, sizeB, CRC32CPolynomial) ^ crcB;
+}
+
+// Benchmark ================================================================================//
+
+namespace
+{
+	struct ParallelCRC32Context
+	{
+		const byte *data;
+		uintptr size;
+		uintptr chunkSize;
+		uint32 *chunkCRCs;
+	};
+}
+
+static void ComputeCRC32Chunks(void* context, uint32 begin, uint32 end)
+{
+	const ParallelCRC32Context &parallel = *to<ParallelCRC32Context*>(context);
+
+	for (uint32 i = begin; i < end; i++)
+	{
+		uintptr offset = uintptr(i) * parallel.chunkSize;
+		parallel.chunkCRCs[i] = CRC32::Compute(parallel.data + offset, min(parallel.chunkSize, parallel.size - offset));
+	}
+}
 
+// Chunks are checksummed on worker pool and joined in order.
+static uint32 ComputeCRC32Parallel(const byte* data, uintptr size, uint32* chunkCRCs, uintptr chunkSize)
+{
+	ParallelCRC32Context context = { data, size, chunkSize, chunkCRCs };
+	uint32 chunkCount = uint32(intdivceil(size, chunkSize));
+	WorkerPool::Global.parallelFor(chunkCount, 1, ComputeCRC32Chunks, &context);
+
+	uint32 crc = 0;
+	for (uint32 i = 0; i < chunkCount; i++)
+		crc = CRC32::Combine(crc, chunkCRCs[i], min(chunkSize, size - uintptr(i) * chunkSize));
 	return crc;
+}
+
+void CRC32::RunBenchmark()
+{
+	struct Kernel
+	{
+		const char *name;
+		CRC32Kernel kernel;
+		uint32 initValue;
+		uint32 referenceIndex;
+		bool supported;
+	};
+
+	static constexpr uintptr dataSize = 256 << 20;
+	static constexpr uintptr chunkSize = 4 << 20;
+	static constexpr uint32 iterationCount = 4;
+
+	static const Kernel kernels[] =
+	{
+		{ "CRC32 bytewise",      CRC32_Bytewise,      0, 0, true },
+		{ "CRC32 slicing by 16", CRC32_Slicing16,     0, 0, true },
+		{ "CRC32 PCLMULQDQ",     CRC32_PCLMUL,        0, 0, CPU::SupportsPCLMULQDQ() },
+		{ "CRC32C slicing by 16", CRC32C_Slicing16, ~0u, 3, true },
+		{ "CRC32C SSE4.2",       CRC32C_SSE42,      ~0u, 3, CPU::SupportsSSE42() },
+	};
+	static constexpr uint32 kernelCount = countof(kernels);
+
+	HeapPtr<byte> data(dataSize);
+	HeapPtr<uint32> chunkCRCs(intdivceil(dataSize, chunkSize));
+	Benchmark::FillRandom(to<uint32*>(data), dataSize / 4);
+
+	char details[32];
+	sprintf_s(details, "%u MB", uint32(dataSize >> 20));
+	Benchmark::LogHeader("CRC", details);
+
+	uint32 results[kernelCount] = {};
+	for (uint32 kernelIndex = 0; kernelIndex < kernelCount; kernelIndex++)
+	{
+		const Kernel &kernel = kernels[kernelIndex];
+		if (!kernel.supported)
+			continue;
+
+		auto run = [&]() { results[kernelIndex] = kernel.kernel(kernel.initValue, data, data + dataSize); };
+		float32 time = Benchmark::MeasureTime(iterationCount, run);
+		Benchmark::LogResult(time, 0.0, float64(dataSize), "%s", kernel.name);
+
+		if (results[kernelIndex] != results[kernel.referenceIndex])
+			Debug::Warning(DbgMsgFmt("CRC kernel result mismatch"));
+	}
+
+	uint32 parallelResult = 0;
+	auto run = [&]() { parallelResult = ComputeCRC32Parallel(data, dataSize, chunkCRCs, chunkSize); };
+	float32 time = Benchmark::MeasureTime(iterationCount, run);
+	Benchmark::LogResult(time, 0.0, float64(dataSize), "CRC32 parallel chunks");
+
+	if (parallelResult != results[0])
+		Debug::Warning(DbgMsgFmt("CRC parallel result mismatch"));
 }
\ No newline at end of file
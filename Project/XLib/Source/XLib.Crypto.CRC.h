@@ -42,6 +42,10 @@ namespace XLib
 		static inline uint16 Compute(const Type& data) { return Compute(&data, sizeof(data)); }
 	};
 
+	// CRC-32 with polynomial 0x04C11DB7, not reflected and not inverted, seed is initial value.
+	// Used by project files and autosave journal, so it must not change. Computed with
+	// carry-less multiplication when supported, otherwise with slicing by 16.
+
 	class CRC32
 	{
 	private:
@@ -49,6 +53,56 @@ namespace XLib
 
 	public:
 		static uint32 Compute(const void* data, uintptr size, uint32 seed = 0);
+		// CRC of A followed by B from CRC of A and CRC of B computed with default seed, so
+		// large buffers can be checksummed in parallel chunks.
+		static uint32 Combine(uint32 crcA, uint32 crcB, uint64 sizeB);
+
+		// Logs throughput of every 32-bit CRC kernel and of parallel chunks.
+		static void RunBenchmark();
+
+		inline void process(const void* data, uintptr size) { value = Compute(data, size, value); }
+		inline uint32 getValue() { return value; }
+		inline void reset() { value = 0; }
+
+		template <typename Type>
+		inline void process(const Type& data) { process(&data, sizeof(data)); }
+		template <typename Type>
+		static inline uint32 Compute(const Type& data) { return Compute(&data, sizeof(data)); }
+	};
+
+	// Standard reflected CRC-32 (polynomial 0xEDB88320) with inverted initial and final value,
+	// as in zlib, gzip and PNG. Seed is previous result, so data can be processed in parts.
+
+	class CRC32IEEE
+	{
+	private:
+		uint32 value = 0;
+
+	public:
+		static uint32 Compute(const void* data, uintptr size, uint32 seed = 0);
+		static uint32 Combine(uint32 crcA, uint32 crcB, uint64 sizeB);
+
+		inline void process(const void* data, uintptr size) { value = Compute(data, size, value); }
+		inline uint32 getValue() { return value; }
+		inline void reset() { value = 0; }
+
+		template <typename Type>
+		inline void process(const Type& data) { process(&data, sizeof(data)); }
+		template <typename Type>
+		static inline uint32 Compute(const Type& data) { return Compute(&data, sizeof(data)); }
+	};
+
+	// CRC-32C (Castagnoli, reflected polynomial 0x82F63B78) with inverted initial and final
+	// value, as in iSCSI and ext4. Computed with SSE4.2 crc32 instruction when supported.
+
+	class CRC32C
+	{
+	private:
+		uint32 value = 0;
+
+	public:
+		static uint32 Compute(const void* data, uintptr size, uint32 seed = 0);
+		static uint32 Combine(uint32 crcA, uint32 crcB, uint64 sizeB);
 
 		inline void process(const void* data, uintptr size) { value = Compute(data, size, value); }
 		inline uint32 getValue() { return value; }
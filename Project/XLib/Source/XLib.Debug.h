@@ -1,6 +1,13 @@
 #pragma once
 
+#include "XLib.Types.h"
+
+#ifdef _MSC_VER
 #define DbgMsgHead __FUNCTION__##"(): "
+#else
+// __FUNCTION__ is not a string literal outside of MSVC.
+#define DbgMsgHead __FILE__ ": "
+#endif
 #define DbgMsgFmt(message) (DbgMsgHead message)
 #define SysErrorDbgMsgFmt DbgMsgHead
 
@@ -19,7 +26,7 @@ namespace XLib
 		virtual void put(DebugOutputType type, const char* message);
 	};*/
 
-	struct Debug abstract final
+	struct Debug XLIB_ABSTRACT final
 	{
 		static void Log(const char* message);
 		static void Crash(const char* message);
@@ -49,7 +49,7 @@ namespace XLib
 		static_assert(sizeof(MethodPointer<DummyClass>) == sizeof(void*), "invalid environment");
 
 		template <uint methodPointerSize, class Class>
-		struct MethodPointerConverter abstract
+		struct MethodPointerConverter XLIB_ABSTRACT
 		{
 			static inline void Convert(Class* _object, MethodPointer<Class> _method,
 				DummyClass*& targetObject, MethodPointer<DummyClass>& targetMethod)
@@ -60,7 +60,7 @@ namespace XLib
 
 		// single inheritance
 		template <class Class>
-		class MethodPointerConverter<sizeof(void*), Class> abstract
+		class MethodPointerConverter<sizeof(void*), Class> XLIB_ABSTRACT
 		{
 		public:
 			static inline void Convert(Class* _object, MethodPointer<Class> _method,
@@ -84,7 +84,7 @@ namespace XLib
 		//		uint32 vtableIndex
 		// replace code pointer with our dummy method that returns adjusted this
 		template <class Class>
-		class MethodPointerConverter<sizeof(void*) + sizeof(uint32) * 2, Class> abstract
+		class MethodPointerConverter<sizeof(void*) + sizeof(uint32) * 2, Class> XLIB_ABSTRACT
 		{
 		public:
 			static inline void Convert(Class* _object, MethodPointer<Class> _method,
@@ -121,7 +121,7 @@ namespace XLib
 		// for some reasons single inheritance with virtual methods in derived class
 		//    without __single_inheritance flag specified is treated 
 		template <class Class>
-		class MethodPointerConverter<sizeof(void*) + sizeof(uint32), Class> abstract
+		class MethodPointerConverter<sizeof(void*) + sizeof(uint32), Class> XLIB_ABSTRACT
 		{
 		public:
 			static inline void Convert(Class* _object, MethodPointer<Class> _method,
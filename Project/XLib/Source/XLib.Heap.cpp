@@ -1,14 +1,18 @@
 #include <Windows.h>
 
 #include "XLib.Heap.h"
+#include "XLib.System.Threading.Atomics.h"
 
 using namespace XLib;
 
+static volatile uint64 allocationCount = 0;
+
 void* Heap::Allocate(uintptr size)
 {
 	if (!size)
 		return nullptr;
 
+	Atomics::Increment(allocationCount);
 	void *ptr = HeapAlloc(GetProcessHeap(), 0, size);
 	if (!ptr)
 		throw;
@@ -18,6 +22,7 @@ void* Heap::ReAllocate(void* ptr, uintptr size)
 {
 	if (size)
 	{
+		Atomics::Increment(allocationCount);
 		void *newPtr = ptr ? HeapReAlloc(GetProcessHeap(), 0, ptr, size) : HeapAlloc(GetProcessHeap(), 0, size);
 		if (!newPtr)
 			throw;
@@ -35,4 +40,8 @@ bool Heap::ReAllocateInplace(void* ptr, uintptr size)
 void Heap::Release(void* ptr)
 {
 	HeapFree(GetProcessHeap(), 0, ptr);
+}
+uint64 Heap::GetAllocationCount()
+{
+	return allocationCount;
 }
\ No newline at end of file
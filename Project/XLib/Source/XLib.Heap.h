@@ -6,13 +6,16 @@
 
 namespace XLib
 {
-	struct Heap abstract final
+	struct Heap XLIB_ABSTRACT final
 	{
 		static void* Allocate(uintptr size);
 		static void* ReAllocate(void* ptr, uintptr size);
 		static bool ReAllocateInplace(void* ptr, uintptr size);
 		static void Release(void* ptr);
 
+		// Number of Allocate and ReAllocate calls returning memory since process start.
+		static uint64 GetAllocationCount();
+
 		template <typename Type>
 		static Type* Allocate(uintptr count = 1) { return to<Type*>(Allocate(sizeof(Type) * count)); }
 	};
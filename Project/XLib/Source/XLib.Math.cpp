@@ -8,4 +8,7 @@ float32 Math::Sqrt(float32 arg) { return sqrtf(arg); }
 float32 Math::Sin(float32 arg) { return sinf(arg); }
 float32 Math::Cos(float32 arg) { return cosf(arg); }
 float32 Math::Tan(float32 arg) { return tanf(arg); }
+float32 Math::Asin(float32 arg) { return asinf(arg); }
+float32 Math::Acos(float32 arg) { return acosf(arg); }
+float32 Math::Atan(float32 arg) { return atanf(arg); }
 float32 Math::Pow(float32 value, float32 power) { return powf(value, power); }
\ No newline at end of file
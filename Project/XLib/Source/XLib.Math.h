@@ -5,7 +5,7 @@
 
 namespace XLib
 {
-	class Math abstract final
+	class Math XLIB_ABSTRACT final
 	{
 	public:
 		template <typename type> static constexpr inline type Clamp(type val, type minValue, type maxValue)
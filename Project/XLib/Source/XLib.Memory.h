@@ -4,7 +4,7 @@
 
 namespace XLib
 {
-	class Memory abstract final
+	class Memory XLIB_ABSTRACT final
 	{
 	public:
 		static void Set(void* memory, byte value, uintptr size);
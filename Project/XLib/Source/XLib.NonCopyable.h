@@ -1,8 +1,10 @@
 #pragma once
 
+#include "XLib.Types.h"
+
 namespace XLib
 {
-	class NonCopyable abstract
+	class NonCopyable XLIB_ABSTRACT
 	{
 		NonCopyable(const NonCopyable&) = delete;
 		NonCopyable& operator = (const NonCopyable&) = delete;
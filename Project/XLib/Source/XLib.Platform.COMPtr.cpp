@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include <Unknwn.h>
 
 #include "XLib.Platform.COMPtr.h"
@@ -10,4 +12,14 @@ void XLib::Platform::Internal::IUnknown_AddRef(void* ptr)
 void XLib::Platform::Internal::IUnknown_Release(void* ptr)
 {
 	((IUnknown*)ptr)->Release();
-}
\ No newline at end of file
+}
+
+#else
+
+#include "XLib.Platform.COMPtr.h"
+
+// There are no COM objects outside of Windows, so pointers stay null and are never released.
+void XLib::Platform::Internal::IUnknown_AddRef(void* ptr) {}
+void XLib::Platform::Internal::IUnknown_Release(void* ptr) {}
+
+#endif
\ No newline at end of file
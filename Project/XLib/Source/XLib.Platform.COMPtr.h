@@ -1,6 +1,8 @@
 #pragma once
 
+#ifdef _WIN32
 #include <guiddef.h>
+#endif
 
 #include "XLib.NonCopyable.h"
 
@@ -72,7 +74,9 @@ namespace XLib::Platform
 				Internal::IUnknown_AddRef(ptr);
 		}
 
+#ifdef _WIN32
 		inline GUID uuid() { return __uuidof(Type); }
+#endif
 
 		inline bool isInitialized() { return ptr ? true : false; }
 	};
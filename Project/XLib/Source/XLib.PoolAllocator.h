@@ -8,12 +8,12 @@
 
 namespace XLib
 {
-	struct PoolAllocatorHeapUsagePolicy abstract final
+	struct PoolAllocatorHeapUsagePolicy XLIB_ABSTRACT final
 	{
-		class SingleDynamicChunk abstract final {};	// elements can be rebased
+		class SingleDynamicChunk XLIB_ABSTRACT final {};	// elements can be rebased
 
 		template <uint32 minBufferSizeLog2, uint32 maxBufferSizeLog2>
-		class MultipleStaticChunks abstract final // elements are static
+		class MultipleStaticChunks XLIB_ABSTRACT final // elements are static
 			{ static_assert(minBufferSizeLog2 <= maxBufferSizeLog2, "invalid params"); };
 	};
 
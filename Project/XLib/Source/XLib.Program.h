@@ -4,7 +4,7 @@
 
 namespace XLib
 {
-	struct Program abstract final
+	struct Program XLIB_ABSTRACT final
 	{
 		static void Run();
 	};
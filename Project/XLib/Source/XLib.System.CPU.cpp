@@ -0,0 +1,44 @@
+#include <intrin.h>
+
+#include "XLib.System.CPU.h"
+
+using namespace XLib;
+
+struct CPUFeatures
+{
+	bool sse42 = false;
+	bool pclmulqdq = false;
+	bool avx2 = false;
+
+	CPUFeatures()
+	{
+		int info[4] = {};
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		if (maxLeaf < 1)
+			return;
+		__cpuid(info, 1);
+		sse42 = (info[2] & (1 << 20)) != 0;
+		pclmulqdq = (info[2] & (1 << 1)) != 0;
+
+		// AVX state must be enabled by OS (OSXSAVE and XCR0 bits 1, 2).
+		bool osAVXSupport = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+			(_xgetbv(0) & 0x6) == 0x6;
+
+		if (maxLeaf < 7 || !osAVXSupport)
+			return;
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+};
+
+static const CPUFeatures& GetCPUFeatures()
+{
+	static CPUFeatures features;
+	return features;
+}
+
+bool CPU::SupportsSSE42() { return GetCPUFeatures().sse42; }
+bool CPU::SupportsPCLMULQDQ() { return GetCPUFeatures().pclmulqdq; }
+bool CPU::SupportsAVX2() { return GetCPUFeatures().avx2; }
\ No newline at end of file
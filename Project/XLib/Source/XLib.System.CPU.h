@@ -0,0 +1,14 @@
+#pragma once
+
+#include "XLib.Types.h"
+
+namespace XLib
+{
+	class CPU XLIB_ABSTRACT final
+	{
+	public:
+		static bool SupportsSSE42();
+		static bool SupportsPCLMULQDQ();
+		static bool SupportsAVX2();
+	};
+}
\ No newline at end of file
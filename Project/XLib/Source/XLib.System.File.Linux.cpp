@@ -0,0 +1,333 @@
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "XLib.System.File.h"
+
+#include "XLib.Util.h"
+#include "XLib.Debug.h"
+
+// Linux backend of File and FileMapping. Handles store file descriptor plus one, so zero
+// descriptor is not confused with closed file. Mapping handle is not used. Names are
+// converted from UTF-32 to UTF-8.
+
+using namespace XLib;
+
+// read() and write() transfer at most this much at once anyway.
+static constexpr uintptr MaxTransferSize = 1 << 30;
+
+static inline int GetDescriptor(void* handle) { return int(sintptr(handle) - 1); }
+static inline void* GetHandle(int descriptor) { return (void*)(sintptr(descriptor) + 1); }
+
+static inline uintptr GetViewSize(const void* view, const void* data, uint64 size)
+{
+	return uintptr((const byte*)data - (const byte*)view) + uintptr(size);
+}
+
+static bool ConvertName(const wchar* name, char* buffer, uint32 bufferSize)
+{
+	uint32 length = 0;
+	for (; *name; name++)
+	{
+		uint32 c = uint32(*name);
+		uint32 size = c < 0x80 ? 1 : (c < 0x800 ? 2 : (c < 0x10000 ? 3 : 4));
+		if (length + size >= bufferSize || c > 0x10FFFF)
+			return false;
+
+		if (size == 1)
+		{
+			buffer[length++] = char(c);
+			continue;
+		}
+
+		static constexpr byte leadBytes[5] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+		buffer[length] = char(leadBytes[size] | (c >> (6 * (size - 1))));
+		for (uint32 i = 1; i < size; i++)
+			buffer[length + i] = char(0x80 | ((c >> (6 * (size - 1 - i))) & 0x3F));
+		length += size;
+	}
+	buffer[length] = 0;
+	return true;
+}
+
+static int GetOpenFlags(FileAccessMode accessMode, FileOpenMode openMode)
+{
+	int flags = O_CLOEXEC;
+	switch (accessMode)
+	{
+		case FileAccessMode::Read:		flags |= O_RDONLY;	break;
+		case FileAccessMode::Write:		flags |= O_WRONLY;	break;
+		case FileAccessMode::ReadWrite:	flags |= O_RDWR;	break;
+	}
+	if (openMode == FileOpenMode::Override)
+		flags |= O_CREAT | O_TRUNC;
+	return flags;
+}
+
+static void ApplyAccessHint(int descriptor, FileAccessHint hint)
+{
+	if (hint == FileAccessHint::Sequential)
+		posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+	else if (hint == FileAccessHint::Random)
+		posix_fadvise(descriptor, 0, 0, POSIX_FADV_RANDOM);
+}
+
+bool File::open(const char* name, FileAccessMode accessMode, FileOpenMode openMode, FileAccessHint hint)
+{
+	close();
+
+	int descriptor = ::open(name, GetOpenFlags(accessMode, openMode), 0644);
+	if (descriptor < 0)
+		return false;
+
+	ApplyAccessHint(descriptor, hint);
+	handle = GetHandle(descriptor);
+	return true;
+}
+
+bool File::open(const wchar* name, FileAccessMode accessMode, FileOpenMode openMode, FileAccessHint hint)
+{
+	char convertedName[PATH_MAX];
+	if (!ConvertName(name, convertedName, sizeof(convertedName)))
+		return false;
+	return open(convertedName, accessMode, openMode, hint);
+}
+
+void File::close()
+{
+	if (handle)
+		::close(GetDescriptor(handle));
+	handle = nullptr;
+}
+
+bool File::read(void* buffer, uintptr size)
+{
+	uintptr readSize = 0;
+	if (!read(buffer, size, readSize))
+		return false;
+	return readSize == size;
+}
+
+bool File::read(void* buffer, uintptr bufferSize, uintptr& readSize)
+{
+	readSize = 0;
+	while (readSize < bufferSize)
+	{
+		ssize_t result = ::read(GetDescriptor(handle), (byte*)buffer + readSize,
+			min(bufferSize - readSize, MaxTransferSize));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		if (result == 0)
+			break;
+		readSize += uintptr(result);
+	}
+	return true;
+}
+
+bool File::write(const void* buffer, uintptr size)
+{
+	for (uintptr writtenSize = 0; writtenSize < size;)
+	{
+		ssize_t result = ::write(GetDescriptor(handle), (const byte*)buffer + writtenSize,
+			min(size - writtenSize, MaxTransferSize));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		writtenSize += uintptr(result);
+	}
+	return true;
+}
+
+void File::flush()
+{
+	if (fsync(GetDescriptor(handle)) != 0)
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+}
+
+bool File::readAt(uint64 offset, void* buffer, uintptr bufferSize, uintptr& readSize)
+{
+	readSize = 0;
+	while (readSize < bufferSize)
+	{
+		ssize_t result = pread(GetDescriptor(handle), (byte*)buffer + readSize,
+			min(bufferSize - readSize, MaxTransferSize), off_t(offset + readSize));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		if (result == 0)
+			break;
+		readSize += uintptr(result);
+	}
+	return true;
+}
+
+bool File::writeAt(uint64 offset, const void* buffer, uintptr size)
+{
+	for (uintptr writtenSize = 0; writtenSize < size;)
+	{
+		ssize_t result = pwrite(GetDescriptor(handle), (const byte*)buffer + writtenSize,
+			min(size - writtenSize, MaxTransferSize), off_t(offset + writtenSize));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		writtenSize += uintptr(result);
+	}
+	return true;
+}
+
+void File::prefetch(uint64 offset, uint64 size)
+{
+	posix_fadvise(GetDescriptor(handle), off_t(offset), off_t(size), POSIX_FADV_WILLNEED);
+}
+
+uint64 File::getSize()
+{
+	struct stat status;
+	if (fstat(GetDescriptor(handle), &status) != 0)
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		return uint64(-1);
+	}
+	return uint64(status.st_size);
+}
+
+uint64 File::getPosition()
+{
+	off_t position = lseek(GetDescriptor(handle), 0, SEEK_CUR);
+	return position < 0 ? uint64(-1) : uint64(position);
+}
+
+uint64 File::setPosition(sint64 offset, FilePosition origin)
+{
+	static_assert(uint32(FilePosition::Begin) == SEEK_SET && uint32(FilePosition::Current) == SEEK_CUR &&
+		uint32(FilePosition::End) == SEEK_END, "FilePosition must match lseek origins");
+
+	off_t position = lseek(GetDescriptor(handle), off_t(offset), int(origin));
+	if (position < 0)
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		return uint64(-1);
+	}
+	return uint64(position);
+}
+
+// FileMapping ==============================================================================//
+
+bool FileMapping::open(const wchar* name, FileAccessMode accessMode, uint64 _offset, uint64 _size)
+{
+	close();
+
+	char convertedName[PATH_MAX];
+	if (!ConvertName(name, convertedName, sizeof(convertedName)))
+		return false;
+
+	writable = accessMode != FileAccessMode::Read;
+	int descriptor = ::open(convertedName, writable ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC), 0644);
+	if (descriptor < 0)
+		return false;
+	fileHandle = GetHandle(descriptor);
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0)
+	{
+		close();
+		return false;
+	}
+
+	uint64 fileSize = uint64(status.st_size);
+	uint64 viewEnd = _size ? _offset + _size : fileSize;
+	if (viewEnd <= _offset || (!writable && viewEnd > fileSize) ||
+		(writable && viewEnd > fileSize && ftruncate(descriptor, off_t(viewEnd)) != 0))
+	{
+		close();
+		return false;
+	}
+
+	uint64 pageSize = uint64(sysconf(_SC_PAGESIZE));
+	uint64 viewOffset = _offset - _offset % pageSize;
+	uint64 viewSize = viewEnd - viewOffset;
+
+	void *mappedView = MAP_FAILED;
+	if (viewSize <= uintptr(-1))
+	{
+		mappedView = mmap(nullptr, size_t(viewSize), writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+			MAP_SHARED, descriptor, off_t(viewOffset));
+	}
+	if (mappedView == MAP_FAILED)
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		close();
+		return false;
+	}
+
+	view = mappedView;
+	data = (byte*)view + (_offset - viewOffset);
+	size = viewEnd - _offset;
+	offset = _offset;
+	return true;
+}
+
+void FileMapping::close()
+{
+	if (view)
+		munmap(view, GetViewSize(view, data, size));
+	if (fileHandle)
+		::close(GetDescriptor(fileHandle));
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+	view = nullptr;
+	data = nullptr;
+	size = 0;
+	offset = 0;
+	writable = false;
+}
+
+bool FileMapping::flush()
+{
+	if (!writable)
+		return true;
+
+	if (msync(view, GetViewSize(view, data, size), MS_SYNC) != 0 || fsync(GetDescriptor(fileHandle)) != 0)
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		return false;
+	}
+	return true;
+}
+
+void FileMapping::prefetch(uint64 rangeOffset, uint64 rangeSize)
+{
+	if (rangeOffset >= size)
+		return;
+
+	// madvise needs page aligned address.
+	uintptr begin = uintptr((byte*)data + rangeOffset);
+	uintptr alignedBegin = max(begin - begin % uintptr(sysconf(_SC_PAGESIZE)), uintptr(view));
+	uintptr end = begin + uintptr(min(rangeSize, size - rangeOffset));
+	madvise((void*)alignedBegin, end - alignedBegin, MADV_WILLNEED);
+}
+
+#endif
\ No newline at end of file
@@ -1,7 +1,11 @@
+#ifdef _WIN32
+
 #include <Windows.h>
 
 #include "XLib.System.File.h"
 
+#include "XLib.Util.h"
+
 #include "XLib.Debug.h"
 
 using namespace XLib;
@@ -17,10 +21,45 @@ static_assert(DWORD(FilePosition::Begin) == FILE_BEGIN, "FilePosition::Begin mus
 static_assert(DWORD(FilePosition::Current) == FILE_CURRENT, "FilePosition::Current must be equal to FILE_CURRENT");
 static_assert(DWORD(FilePosition::End) == FILE_END, "FilePosition::End must be equal to FILE_END");
 
-bool File::open(const char* name, FileAccessMode accessMode, FileOpenMode openMode)
+// ReadFile and WriteFile take 32 bit sizes, so larger transfers are split.
+static constexpr uintptr MaxTransferSize = 1 << 30;
+
+static inline DWORD GetAccessHintFlags(FileAccessHint hint)
+{
+	switch (hint)
+	{
+		case FileAccessHint::Sequential:	return FILE_FLAG_SEQUENTIAL_SCAN;
+		case FileAccessHint::Random:		return FILE_FLAG_RANDOM_ACCESS;
+		default:							return 0;
+	}
+}
+
+static inline OVERLAPPED MakeOverlapped(uint64 offset)
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = DWORD(offset);
+	overlapped.OffsetHigh = DWORD(offset >> 32);
+	return overlapped;
+}
+
+bool File::open(const char* name, FileAccessMode accessMode, FileOpenMode openMode, FileAccessHint hint)
 {
-	handle = CreateFileA(name, DWORD(accessMode), 0, nullptr, DWORD(openMode), FILE_ATTRIBUTE_NORMAL, nullptr);
-	return handle != INVALID_HANDLE_VALUE;
+	close();
+	handle = CreateFileA(name, DWORD(accessMode), 0, nullptr, DWORD(openMode),
+		FILE_ATTRIBUTE_NORMAL | GetAccessHintFlags(hint), nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		handle = nullptr;
+	return handle != nullptr;
+}
+
+bool File::open(const wchar* name, FileAccessMode accessMode, FileOpenMode openMode, FileAccessHint hint)
+{
+	close();
+	handle = CreateFileW(name, DWORD(accessMode), 0, nullptr, DWORD(openMode),
+		FILE_ATTRIBUTE_NORMAL | GetAccessHintFlags(hint), nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		handle = nullptr;
+	return handle != nullptr;
 }
 
 void File::close()
@@ -30,15 +69,11 @@ void File::close()
 	handle = nullptr;
 }
 
-bool File::read(void* buffer, uint32 size)
+bool File::read(void* buffer, uintptr size)
 {
-	DWORD readSize = 0;
-	BOOL result = ReadFile(handle, buffer, size, &readSize, nullptr);
-	if (!result)
-	{
-		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+	uintptr readSize = 0;
+	if (!read(buffer, size, readSize))
 		return false;
-	}
 	if (readSize != size)
 	{
 		// Debug::Warning(...);
@@ -47,33 +82,88 @@ bool File::read(void* buffer, uint32 size)
 	return true;
 }
 
-bool File::read(void* buffer, uint32 bufferSize, uint32& readSize)
+bool File::read(void* buffer, uintptr bufferSize, uintptr& readSize)
 {
-	DWORD _readSize = 0;
-	BOOL result = ReadFile(handle, buffer, bufferSize, &_readSize, nullptr);
-	if (!result)
+	readSize = 0;
+	while (readSize < bufferSize)
 	{
-		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
-		return false;
+		DWORD chunkSize = DWORD(min(bufferSize - readSize, MaxTransferSize));
+		DWORD chunkReadSize = 0;
+		BOOL result = ReadFile(handle, (byte*)buffer + readSize, chunkSize, &chunkReadSize, nullptr);
+		if (!result)
+		{
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		readSize += chunkReadSize;
+		if (chunkReadSize != chunkSize)
+			break;
 	}
-	readSize = _readSize;
 	return true;
 }
 
-bool File::write(const void* buffer, uint32 size)
+bool File::write(const void* buffer, uintptr size)
 {
-	DWORD writtenSize = 0;
-	BOOL result = WriteFile(handle, buffer, size, &writtenSize, nullptr);
-	if (!result)
+	for (uintptr writtenSize = 0; writtenSize < size;)
 	{
-		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
-		return false;
+		DWORD chunkSize = DWORD(min(size - writtenSize, MaxTransferSize));
+		DWORD chunkWrittenSize = 0;
+		BOOL result = WriteFile(handle, (const byte*)buffer + writtenSize, chunkSize, &chunkWrittenSize, nullptr);
+		if (!result)
+		{
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		if (chunkWrittenSize != chunkSize)
+			return false;
+		writtenSize += chunkSize;
+	}
+	return true;
+}
+
+bool File::readAt(uint64 offset, void* buffer, uintptr bufferSize, uintptr& readSize)
+{
+	readSize = 0;
+	while (readSize < bufferSize)
+	{
+		OVERLAPPED overlapped = MakeOverlapped(offset + readSize);
+		DWORD chunkSize = DWORD(min(bufferSize - readSize, MaxTransferSize));
+		DWORD chunkReadSize = 0;
+		if (!ReadFile(handle, (byte*)buffer + readSize, chunkSize, &chunkReadSize, &overlapped))
+		{
+			if (GetLastError() == ERROR_HANDLE_EOF)
+				break;
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		readSize += chunkReadSize;
+		if (chunkReadSize != chunkSize)
+			break;
+	}
+	return true;
+}
+
+bool File::writeAt(uint64 offset, const void* buffer, uintptr size)
+{
+	for (uintptr writtenSize = 0; writtenSize < size;)
+	{
+		OVERLAPPED overlapped = MakeOverlapped(offset + writtenSize);
+		DWORD chunkSize = DWORD(min(size - writtenSize, MaxTransferSize));
+		DWORD chunkWrittenSize = 0;
+		if (!WriteFile(handle, (const byte*)buffer + writtenSize, chunkSize, &chunkWrittenSize, &overlapped))
+		{
+			Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+			return false;
+		}
+		if (chunkWrittenSize != chunkSize)
+			return false;
+		writtenSize += chunkSize;
 	}
-	if (writtenSize != size)
-		return false;
 	return true;
 }
 
+void File::prefetch(uint64 offset, uint64 size) {}
+
 void File::flush()
 {
 	if (!FlushFileBuffers(handle))
@@ -113,4 +203,105 @@ uint64 File::setPosition(sint64 offset, FilePosition origin)
 		return uint64(-1);
 	}
 	return postion.QuadPart;
-}
\ No newline at end of file
+}
+
+// FileMapping ==============================================================================//
+
+bool FileMapping::open(const wchar* name, FileAccessMode accessMode, uint64 _offset, uint64 _size)
+{
+	close();
+
+	writable = accessMode != FileAccessMode::Read;
+	fileHandle = CreateFileW(name, writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+		FILE_SHARE_READ, nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		close();
+		return false;
+	}
+
+	uint64 viewEnd = _size ? _offset + _size : uint64(fileSize.QuadPart);
+	if (viewEnd <= _offset || (!writable && viewEnd > uint64(fileSize.QuadPart)))
+	{
+		close();
+		return false;
+	}
+
+	// Mapping larger than file extends it.
+	uint64 mappingSize = max(viewEnd, uint64(fileSize.QuadPart));
+	mappingHandle = CreateFileMappingW(fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+		DWORD(mappingSize >> 32), DWORD(mappingSize), nullptr);
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	uint64 viewOffset = _offset - _offset % systemInfo.dwAllocationGranularity;
+	uint64 viewSize = viewEnd - viewOffset;
+
+	if (mappingHandle && viewSize <= uintptr(-1))
+	{
+		view = MapViewOfFile(mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+			DWORD(viewOffset >> 32), DWORD(viewOffset), SIZE_T(viewSize));
+	}
+	if (!view)
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		close();
+		return false;
+	}
+
+	data = (byte*)view + (_offset - viewOffset);
+	size = viewEnd - _offset;
+	offset = _offset;
+	return true;
+}
+
+void FileMapping::close()
+{
+	if (view)
+		UnmapViewOfFile(view);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+	view = nullptr;
+	data = nullptr;
+	size = 0;
+	offset = 0;
+	writable = false;
+}
+
+bool FileMapping::flush()
+{
+	if (!writable)
+		return true;
+
+	if (!FlushViewOfFile(data, SIZE_T(size)) || !FlushFileBuffers(fileHandle))
+	{
+		Debug::LogLastSystemError(SysErrorDbgMsgFmt);
+		return false;
+	}
+	return true;
+}
+
+void FileMapping::prefetch(uint64 rangeOffset, uint64 rangeSize)
+{
+	if (rangeOffset >= size)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (byte*)data + rangeOffset;
+	range.NumberOfBytes = SIZE_T(min(rangeSize, size - rangeOffset));
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#endif
\ No newline at end of file
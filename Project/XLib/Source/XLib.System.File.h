@@ -25,6 +25,14 @@ namespace XLib
 		End = 2,
 	};
 
+	// Tells system how file is going to be read, so it can tune readahead.
+	enum class FileAccessHint : uint32
+	{
+		Normal = 0,
+		Sequential,
+		Random,
+	};
+
 	class File : public NonCopyable
 	{
 	private:
@@ -47,18 +55,29 @@ namespace XLib
 		}
 
 		bool open(const char* name, FileAccessMode accessMode,
-			FileOpenMode openMode = FileOpenMode::OpenExisting);
+			FileOpenMode openMode = FileOpenMode::OpenExisting, FileAccessHint hint = FileAccessHint::Normal);
+		bool open(const wchar* name, FileAccessMode accessMode,
+			FileOpenMode openMode = FileOpenMode::OpenExisting, FileAccessHint hint = FileAccessHint::Normal);
 		void close();
 
-		bool read(void* buffer, uint32 size);
-		bool read(void* buffer, uint32 bufferSize, uint32& readSize);
-		bool write(const void* buffer, uint32 size);
+		bool read(void* buffer, uintptr size);
+		bool read(void* buffer, uintptr bufferSize, uintptr& readSize);
+		bool write(const void* buffer, uintptr size);
 		void flush();
 
+		// Positional access, current position is not used and is undefined afterwards.
+		// Can be called from multiple threads at once. Read stops at end of file.
+		bool readAt(uint64 offset, void* buffer, uintptr bufferSize, uintptr& readSize);
+		bool writeAt(uint64 offset, const void* buffer, uintptr size);
+
+		// Readahead hint, range is loaded to system cache in background. No-op on Windows,
+		// where only hint given to open() affects readahead.
+		void prefetch(uint64 offset, uint64 size);
+
 		template <typename Type>
 		inline bool read(Type& value)
 		{
-			uint32 readSize = 0;
+			uintptr readSize = 0;
 			bool result = read(&value, sizeof(Type), readSize);
 			return readSize == sizeof(Type) && result;
 		}
@@ -75,4 +94,41 @@ namespace XLib
 		inline bool isInitialized() { return handle ? true : false; }
 		inline void* getHandle() { return handle; }
 	};
+
+	// View of file range mapped to memory. Pages are loaded by system on first access, so only
+	// touched parts of file are read. Read only views need existing non empty file, read-write
+	// views create file if needed and extend it with zeros to cover whole view.
+
+	class FileMapping : public NonCopyable
+	{
+	private:
+		void *fileHandle;
+		void *mappingHandle;
+		void *view;		// Starts at offset aligned to allocation granularity.
+		void *data;
+		uint64 size;
+		uint64 offset;
+		bool writable;
+
+	public:
+		inline FileMapping() : fileHandle(nullptr), mappingHandle(nullptr),
+			view(nullptr), data(nullptr), size(0), offset(0), writable(false) {}
+		inline ~FileMapping() { close(); }
+
+		// Zero size maps range from offset to end of file. Access mode is Read or ReadWrite.
+		bool open(const wchar* name, FileAccessMode accessMode = FileAccessMode::Read,
+			uint64 offset = 0, uint64 size = 0);
+		void close();
+
+		// Writes dirty pages of view and file metadata to disk.
+		bool flush();
+		// Readahead hint for range relative to view.
+		void prefetch(uint64 offset, uint64 size);
+
+		inline const void* getData() { return data; }
+		inline void* getMutableData() { return data; }
+		inline uint64 getSize() { return size; }
+		inline uint64 getOffset() { return offset; }
+		inline bool isInitialized() { return data ? true : false; }
+	};
 }
\ No newline at end of file
@@ -0,0 +1,370 @@
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "XLib.System.FileIOQueue.h"
+
+#include "XLib.Util.h"
+#include "XLib.Heap.h"
+#include "XLib.Debug.h"
+#include "XLib.System.Threading.h"
+#include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.Threading.CyclicQueue.h"
+
+using namespace XLib;
+
+namespace
+{
+	struct Request
+	{
+		File *file;		// nullptr stops I/O thread.
+		void *buffer;
+		uint64 offset;
+		uintptr size;
+		uint64 userData;
+		bool write;
+	};
+
+	using RequestQueue = ThreadSafeCyclicQueue<Request, 8, ThreadSafeQueueType::MultipleProducersMultipleConsumers>;
+	using CompletionQueue = ThreadSafeCyclicQueue<FileIOCompletion, 8, ThreadSafeQueueType::MultipleProducersMultipleConsumers>;
+
+	static_assert(FileIOQueue::MaxDepth <= 1 << 8, "queues must fit all requests in flight");
+}
+
+// Kernel queue =============================================================================//
+
+#ifdef __linux__
+
+namespace
+{
+	// Shared rings of io_uring, mapped from kernel. Ring entries are user data slot indices,
+	// slots keep what is needed to build completion.
+
+	struct KernelQueue
+	{
+		struct Slot
+		{
+			uint64 userData;
+			uintptr size;
+			bool write;
+		};
+
+		int descriptor;
+
+		void *sqRing;
+		uintptr sqRingSize;
+		volatile uint32 *sqHead;
+		volatile uint32 *sqTail;
+		uint32 sqRingMask;
+		uint32 *sqArray;
+		io_uring_sqe *sqes;
+		uintptr sqesSize;
+
+		void *cqRing;
+		uintptr cqRingSize;
+		volatile uint32 *cqHead;
+		volatile uint32 *cqTail;
+		uint32 cqRingMask;
+		io_uring_cqe *cqes;
+
+		Slot slots[FileIOQueue::MaxDepth];
+		uint32 freeSlots[FileIOQueue::MaxDepth];
+		uint32 freeSlotCount;
+
+		bool initialize(uint32 depth);
+		void destroy();
+		void submit(const Request& request);
+		bool takeCompletion(FileIOCompletion& completion, bool wait);
+	};
+}
+
+static inline int IOUringSetup(uint32 entries, io_uring_params* params)
+{
+	return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static inline int IOUringEnter(int descriptor, uint32 submitCount, uint32 waitCount, uint32 flags)
+{
+	return int(syscall(__NR_io_uring_enter, descriptor, submitCount, waitCount, flags, nullptr, 0));
+}
+
+bool KernelQueue::initialize(uint32 depth)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	descriptor = IOUringSetup(depth, &params);
+	if (descriptor < 0)
+		return false;
+
+	// IORING_OP_READ and IORING_OP_WRITE came with same kernel as this feature.
+	if (!(params.features & IORING_FEAT_RW_CUR_POS) || params.sq_entries < depth)
+	{
+		close(descriptor);
+		return false;
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMapping)
+		sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		descriptor, IORING_OFF_SQ_RING);
+	cqRing = singleMapping ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_CQ_RING);
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		descriptor, IORING_OFF_SQES);
+
+	if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (sqRing != MAP_FAILED)
+			munmap(sqRing, sqRingSize);
+		if (!singleMapping && cqRing != MAP_FAILED)
+			munmap(cqRing, cqRingSize);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, sqesSize);
+		close(descriptor);
+		return false;
+	}
+
+	byte *sq = (byte*)sqRing;
+	sqHead = (volatile uint32*)(sq + params.sq_off.head);
+	sqTail = (volatile uint32*)(sq + params.sq_off.tail);
+	sqRingMask = *(uint32*)(sq + params.sq_off.ring_mask);
+	sqArray = (uint32*)(sq + params.sq_off.array);
+
+	byte *cq = (byte*)cqRing;
+	cqHead = (volatile uint32*)(cq + params.cq_off.head);
+	cqTail = (volatile uint32*)(cq + params.cq_off.tail);
+	cqRingMask = *(uint32*)(cq + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	freeSlotCount = depth;
+	for (uint32 i = 0; i < depth; i++)
+		freeSlots[i] = depth - 1 - i;
+
+	return true;
+}
+
+void KernelQueue::destroy()
+{
+	munmap(sqes, sqesSize);
+	if (cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	munmap(sqRing, sqRingSize);
+	close(descriptor);
+}
+
+// Requests in flight never exceed ring size, so submission slot is always free.
+void KernelQueue::submit(const Request& request)
+{
+	uint32 slotIndex = freeSlots[--freeSlotCount];
+	Slot &slot = slots[slotIndex];
+	slot.userData = request.userData;
+	slot.size = request.size;
+	slot.write = request.write;
+
+	uint32 tail = *sqTail;
+	uint32 index = tail & sqRingMask;
+	io_uring_sqe &sqe = sqes[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe.fd = int(sintptr(request.file->getHandle()) - 1);	// Handle is descriptor plus one.
+	sqe.off = request.offset;
+	sqe.addr = uint64(uintptr(request.buffer));
+	sqe.len = uint32(request.size);
+	sqe.user_data = slotIndex;
+	sqArray[index] = index;
+	Atomics::StoreRelease(*sqTail, tail + 1);
+
+	while (IOUringEnter(descriptor, 1, 0, 0) < 0 && errno == EINTR) {}
+}
+
+bool KernelQueue::takeCompletion(FileIOCompletion& completion, bool wait)
+{
+	uint32 head = *cqHead;
+	while (head == Atomics::LoadAcquire(*cqTail))
+	{
+		if (!wait)
+			return false;
+		if (IOUringEnter(descriptor, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+			return false;
+	}
+
+	const io_uring_cqe &cqe = cqes[head & cqRingMask];
+	uint32 slotIndex = uint32(cqe.user_data);
+	sint32 result = cqe.res;
+	Atomics::StoreRelease(*cqHead, head + 1);
+
+	const Slot &slot = slots[slotIndex];
+	completion.userData = slot.userData;
+	completion.transferredSize = result > 0 ? uintptr(result) : 0;
+	completion.succeeded = result >= 0 && (!slot.write || uintptr(result) == slot.size);
+	freeSlots[freeSlotCount++] = slotIndex;
+	return true;
+}
+
+#endif
+
+// FileIOQueue ==============================================================================//
+
+struct FileIOQueue::State
+{
+	static constexpr uint32 ioThreadCount = 2;
+
+	uint32 depth;
+	uint32 inFlightCount;
+	bool kernelQueueUsed;
+
+#ifdef __linux__
+	KernelQueue kernelQueue;
+#endif
+
+	Thread ioThreads[ioThreadCount];
+	RequestQueue requests;
+	CompletionQueue completions;
+};
+
+// Fallback I/O threads execute requests with blocking positional access.
+static void ExecuteRequest(const Request& request, FileIOCompletion& completion)
+{
+	completion.userData = request.userData;
+	completion.transferredSize = 0;
+
+	if (request.write)
+	{
+		completion.succeeded = request.file->writeAt(request.offset, request.buffer, request.size);
+		completion.transferredSize = completion.succeeded ? request.size : 0;
+	}
+	else
+	{
+		completion.succeeded = request.file->readAt(request.offset,
+			request.buffer, request.size, completion.transferredSize);
+	}
+}
+
+void FileIOQueue::initialize(uint32 depth, bool allowKernelQueue)
+{
+	destroy();
+
+	Debug::CrashCondition(!depth || depth > MaxDepth, DbgMsgFmt("invalid depth"));
+
+	state = Heap::Allocate<State>();
+	construct(*state);
+	state->depth = depth;
+	state->inFlightCount = 0;
+	state->kernelQueueUsed = false;
+
+#ifdef __linux__
+	if (allowKernelQueue && state->kernelQueue.initialize(depth))
+	{
+		state->kernelQueueUsed = true;
+		return;
+	}
+#endif
+
+	for (Thread &thread : state->ioThreads)
+		thread.create(IOThreadMain, state);
+}
+
+void FileIOQueue::destroy()
+{
+	if (!state)
+		return;
+
+	FileIOCompletion completion;
+	while (takeCompletion(completion)) {}
+
+#ifdef __linux__
+	if (state->kernelQueueUsed)
+		state->kernelQueue.destroy();
+#endif
+
+	if (!state->kernelQueueUsed)
+	{
+		Request stopRequest = {};
+		for (uint32 i = 0; i < State::ioThreadCount; i++)
+			state->requests.enqueue(stopRequest);
+		for (Thread &thread : state->ioThreads)
+		{
+			thread.wait();
+			thread.destroy();
+		}
+	}
+
+	state->~State();
+	Heap::Release(state);
+	state = nullptr;
+}
+
+bool FileIOQueue::submit(File& file, bool write, uint64 offset, void* buffer, uintptr size, uint64 userData)
+{
+	Debug::CrashCondition(size > MaxRequestSize, DbgMsgFmt("request is too large"));
+
+	if (state->inFlightCount == state->depth)
+		return false;
+	state->inFlightCount++;
+
+	Request request = { &file, buffer, offset, size, userData, write };
+
+#ifdef __linux__
+	if (state->kernelQueueUsed)
+	{
+		state->kernelQueue.submit(request);
+		return true;
+	}
+#endif
+
+	state->requests.enqueue(request);
+	return true;
+}
+
+bool FileIOQueue::takeCompletion(FileIOCompletion& completion, bool wait)
+{
+	if (!state->inFlightCount)
+		return false;
+
+#ifdef __linux__
+	if (state->kernelQueueUsed)
+	{
+		if (!state->kernelQueue.takeCompletion(completion, wait))
+			return false;
+		state->inFlightCount--;
+		return true;
+	}
+#endif
+
+	// Owner is the only consumer, so queue can't become empty after check.
+	if (!wait && state->completions.isEmpty())
+		return false;
+
+	completion = state->completions.dequeue();
+	state->inFlightCount--;
+	return true;
+}
+
+uint32 FileIOQueue::getInFlightCount() const { return state->inFlightCount; }
+uint32 FileIOQueue::getDepth() const { return state->depth; }
+bool FileIOQueue::isKernelQueue() const { return state->kernelQueueUsed; }
+
+uint32 XLIB_STDCALL FileIOQueue::IOThreadMain(State* state)
+{
+	for (;;)
+	{
+		Request request = state->requests.dequeue();
+		if (!request.file)
+			break;
+
+		FileIOCompletion completion;
+		ExecuteRequest(request, completion);
+		state->completions.enqueue(completion);
+	}
+	return 0;
+}
\ No newline at end of file
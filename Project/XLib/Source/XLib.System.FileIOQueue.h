@@ -0,0 +1,59 @@
+#pragma once
+
+#include "XLib.Types.h"
+#include "XLib.NonCopyable.h"
+#include "XLib.System.File.h"
+
+namespace XLib
+{
+	struct FileIOCompletion
+	{
+		uint64 userData;
+		uintptr transferredSize;	// Read is short at end of file.
+		bool succeeded;
+	};
+
+	// Asynchronous positional reads and writes with completion queue, so disk I/O overlaps
+	// with compute. On Linux requests go to io_uring. Where it is not available (and on
+	// Windows) they are executed by own I/O threads, not by worker pool, as they block.
+	// Completions come in order requests finish. Queue is owned by single thread.
+
+	class FileIOQueue : public NonCopyable
+	{
+	public:
+		static constexpr uint32 MaxDepth = 256;
+		static constexpr uintptr MaxRequestSize = 1 << 30;
+
+	private:
+		struct State;
+
+		State *state = nullptr;
+
+		static uint32 XLIB_STDCALL IOThreadMain(State* state);
+		bool submit(File& file, bool write, uint64 offset, void* buffer, uintptr size, uint64 userData);
+
+	public:
+		FileIOQueue() = default;
+		inline ~FileIOQueue() { destroy(); }
+
+		// Depth is limit of requests in flight.
+		void initialize(uint32 depth = 64, bool allowKernelQueue = true);
+		// Waits for requests in flight, their completions are dropped.
+		void destroy();
+
+		// Return false if depth requests are in flight, completion has to be taken first.
+		// Buffer must stay valid until completion of request is taken.
+		inline bool submitRead(File& file, uint64 offset, void* buffer, uintptr size, uint64 userData)
+			{ return submit(file, false, offset, buffer, size, userData); }
+		inline bool submitWrite(File& file, uint64 offset, const void* buffer, uintptr size, uint64 userData)
+			{ return submit(file, true, offset, (void*)buffer, size, userData); }
+
+		// Returns false if nothing is in flight, or if nothing finished yet and wait is false.
+		bool takeCompletion(FileIOCompletion& completion, bool wait = true);
+
+		uint32 getInFlightCount() const;
+		uint32 getDepth() const;
+		bool isKernelQueue() const;
+		inline bool isInitialized() const { return state != nullptr; }
+	};
+}
\ No newline at end of file
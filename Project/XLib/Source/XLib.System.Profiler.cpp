@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "XLib.System.Profiler.h"
+#include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.File.h"
+#include "XLib.Containers.Vector.h"
+#include "XLib.Heap.h"
+#include "XLib.Util.h"
+
+using namespace XLib;
+
+static constexpr uint32 ThreadRingSize = 1 << Profiler::ThreadRingSizeLog2;
+static constexpr sint16 RootScope = -1;
+static constexpr sint16 UntrackedScope = -2;
+
+namespace
+{
+	// Single producer single consumer ring. Events are dropped when ring is full, so recording
+	// thread never waits for collector.
+	struct ThreadRing
+	{
+		ProfilerEvent events[ThreadRingSize];
+		volatile uint32 writeIndex;
+		volatile uint32 readIndex;
+		volatile uint64 droppedEventCount;
+		const char *volatile name;
+
+		// Owner thread only. Space for ends of recorded scopes is kept free, so begin and end
+		// are either both recorded or both dropped together with everything nested.
+		uint32 openScopeCount;
+		uint32 droppedScopeDepth;
+	};
+
+	struct ScopeNode
+	{
+		const char *name;
+		sint16 parent;
+		sint16 firstChild;
+		sint16 nextSibling;
+		uint16 depth;
+		uint16 threadIndex;
+
+		uint64 frameTicks;
+		uint32 frameCallCount;
+		float32 timeHistory[Profiler::FrameHistoryLength];
+		uint16 callCountHistory[Profiler::FrameHistoryLength];
+	};
+
+	struct OpenScope
+	{
+		sint16 node;
+		TimerRecord beginTime;
+	};
+
+	// Collector side state of thread. Scopes may stay open between frames.
+	struct CollectorThread
+	{
+		OpenScope stack[Profiler::MaxScopeDepth];
+		uint32 depth;
+		uint32 captureBaseDepth;	// Scopes opened before capture started.
+		sint16 firstRoot;
+	};
+
+	struct CapturedEvent
+	{
+		TimerRecord time;
+		const char *name;
+		uint64 value;
+		ProfilerEventType type;		// None marks frame start.
+		uint8 threadIndex;
+	};
+}
+
+static ThreadRing *volatile threadRings[Profiler::MaxThreadCount] = {};
+static volatile uint32 threadCount = 0;
+static thread_local ThreadRing *currentThreadRing = nullptr;
+static thread_local bool currentThreadRejected = false;
+
+// Collector state, main thread only.
+static ScopeNode scopeNodes[Profiler::MaxScopeCount];
+static uint32 scopeNodeCount = 0;
+static CollectorThread collectorThreads[Profiler::MaxThreadCount];
+static bool collectorThreadsInitialized = false;
+static ProfilerCounterStats counters[Profiler::MaxCounterCount];
+static uint32 counterCount = 0;
+static float32 frameTimeHistory[Profiler::FrameHistoryLength] = {};
+static uint32 completedFrameCount = 0;
+static TimerRecord frameStartTime = 0;
+
+static Vector<CapturedEvent> capturedEvents;
+static bool capturing = false;
+
+// Recording ====================================================================================//
+
+static ThreadRing* GetThreadRing()
+{
+	ThreadRing *ring = currentThreadRing;
+	if (ring || currentThreadRejected)
+		return ring;
+
+	uint32 index = Atomics::Increment(threadCount) - 1;
+	if (index >= Profiler::MaxThreadCount)
+	{
+		currentThreadRejected = true;
+		return nullptr;
+	}
+
+	ring = Heap::Allocate<ThreadRing>();
+	construct(*ring);
+	Atomics::StoreRelease(threadRings[index], ring);
+
+	currentThreadRing = ring;
+	return ring;
+}
+
+static inline bool TryRecord(ThreadRing& ring, uint32 requiredFreeCount,
+	ProfilerEventType type, const char* name, uint64 value)
+{
+	uint32 writeIndex = ring.writeIndex;
+	uint32 freeCount = ThreadRingSize - (writeIndex - Atomics::LoadAcquire(ring.readIndex));
+	if (freeCount < requiredFreeCount)
+		return false;
+
+	ProfilerEvent &event = ring.events[writeIndex & (ThreadRingSize - 1)];
+	event.time = Timer::GetRecord();
+	event.name = name;
+	event.value = value;
+	event.type = type;
+
+	Atomics::StoreRelease(ring.writeIndex, writeIndex + 1);
+	return true;
+}
+
+void Profiler::BeginScope(const char* name)
+{
+	ThreadRing *ring = GetThreadRing();
+	if (!ring)
+		return;
+
+	if (ring->droppedScopeDepth ||
+		!TryRecord(*ring, ring->openScopeCount + 2, ProfilerEventType::ScopeBegin, name, 0))
+	{
+		ring->droppedScopeDepth++;
+		ring->droppedEventCount++;
+		return;
+	}
+	ring->openScopeCount++;
+}
+
+void Profiler::EndScope()
+{
+	ThreadRing *ring = currentThreadRing;
+	if (!ring)
+		return;
+
+	if (ring->droppedScopeDepth)
+	{
+		ring->droppedScopeDepth--;
+		return;
+	}
+
+	TryRecord(*ring, 1, ProfilerEventType::ScopeEnd, nullptr, 0);
+	ring->openScopeCount--;
+}
+
+void Profiler::RecordCounter(const char* name, uint64 value)
+{
+	ThreadRing *ring = GetThreadRing();
+	if (!ring)
+		return;
+
+	if (!TryRecord(*ring, ring->openScopeCount + 1, ProfilerEventType::Counter, name, value))
+		ring->droppedEventCount++;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	if (ThreadRing *ring = GetThreadRing())
+		ring->name = name;
+}
+
+// Collection ===================================================================================//
+
+static sint16 FindScopeNode(uint16 threadIndex, sint16 parent, uint16 depth, const char* name)
+{
+	if (parent == UntrackedScope)
+		return UntrackedScope;
+
+	sint16 *link = parent == RootScope ?
+		&collectorThreads[threadIndex].firstRoot : &scopeNodes[parent].firstChild;
+	while (*link >= 0)
+	{
+		ScopeNode &node = scopeNodes[*link];
+		if (node.name == name || strcmp(node.name, name) == 0)
+			return *link;
+		link = &node.nextSibling;
+	}
+
+	if (scopeNodeCount >= Profiler::MaxScopeCount)
+		return UntrackedScope;
+
+	sint16 index = sint16(scopeNodeCount++);
+	ScopeNode &node = scopeNodes[index];
+	construct(node);
+	node.name = name;
+	node.parent = parent;
+	node.firstChild = -1;
+	node.nextSibling = -1;
+	node.depth = depth;
+	node.threadIndex = threadIndex;
+
+	*link = index;
+	return index;
+}
+
+static void SetCounter(const char* name, uint64 value)
+{
+	for (uint32 i = 0; i < counterCount; i++)
+	{
+		if (counters[i].name == name || strcmp(counters[i].name, name) == 0)
+		{
+			counters[i].value = value;
+			return;
+		}
+	}
+
+	if (counterCount < Profiler::MaxCounterCount)
+		counters[counterCount++] = { name, value };
+}
+
+static void CaptureEvent(uint16 threadIndex, const ProfilerEvent& event)
+{
+	if (capturedEvents.getSize() >= Profiler::MaxCaptureEventCount)
+		return;
+
+	CapturedEvent &capturedEvent = capturedEvents.allocateBack();
+	capturedEvent.time = event.time;
+	capturedEvent.name = event.name;
+	capturedEvent.value = event.value;
+	capturedEvent.type = event.type;
+	capturedEvent.threadIndex = uint8(threadIndex);
+}
+
+static void ProcessEvent(uint16 threadIndex, const ProfilerEvent& event)
+{
+	CollectorThread &thread = collectorThreads[threadIndex];
+
+	switch (event.type)
+	{
+		case ProfilerEventType::ScopeBegin:
+		{
+			// Scopes deeper than stack are counted only in their parents.
+			sint16 parent = RootScope;
+			if (thread.depth > Profiler::MaxScopeDepth)
+				parent = UntrackedScope;
+			else if (thread.depth)
+				parent = thread.stack[thread.depth - 1].node;
+
+			if (thread.depth < Profiler::MaxScopeDepth)
+			{
+				OpenScope &scope = thread.stack[thread.depth];
+				scope.node = FindScopeNode(threadIndex, parent, uint16(thread.depth), event.name);
+				scope.beginTime = event.time;
+			}
+			thread.depth++;
+
+			if (capturing)
+				CaptureEvent(threadIndex, event);
+			break;
+		}
+
+		case ProfilerEventType::ScopeEnd:
+		{
+			if (!thread.depth)
+				break;
+			thread.depth--;
+
+			if (thread.depth < Profiler::MaxScopeDepth)
+			{
+				OpenScope &scope = thread.stack[thread.depth];
+				if (scope.node >= 0)
+				{
+					scopeNodes[scope.node].frameTicks += event.time - scope.beginTime;
+					scopeNodes[scope.node].frameCallCount++;
+				}
+			}
+
+			if (thread.depth < thread.captureBaseDepth)
+				thread.captureBaseDepth = thread.depth;
+			else if (capturing)
+				CaptureEvent(threadIndex, event);
+			break;
+		}
+
+		case ProfilerEventType::Counter:
+			SetCounter(event.name, event.value);
+			if (capturing)
+				CaptureEvent(threadIndex, event);
+			break;
+	}
+}
+
+void Profiler::NextFrame()
+{
+	if (!collectorThreadsInitialized)
+	{
+		for (CollectorThread &thread : collectorThreads)
+			thread.firstRoot = -1;
+		collectorThreadsInitialized = true;
+	}
+
+	TimerRecord frameEndTime = Timer::GetRecord();
+
+	uint32 registeredThreadCount = min(Atomics::LoadAcquire(threadCount), MaxThreadCount);
+	for (uint32 i = 0; i < registeredThreadCount; i++)
+	{
+		ThreadRing *ring = Atomics::LoadAcquire(threadRings[i]);
+		if (!ring)
+			continue;
+
+		uint32 readIndex = ring->readIndex;
+		uint32 writeIndex = Atomics::LoadAcquire(ring->writeIndex);
+		for (; readIndex != writeIndex; readIndex++)
+			ProcessEvent(uint16(i), ring->events[readIndex & (ThreadRingSize - 1)]);
+		Atomics::StoreRelease(ring->readIndex, readIndex);
+	}
+
+	uint32 slot = completedFrameCount % FrameHistoryLength;
+	frameTimeHistory[slot] = frameStartTime ? Timer::GetTimeDelta(frameStartTime, frameEndTime) : 0.0f;
+	for (uint32 i = 0; i < scopeNodeCount; i++)
+	{
+		ScopeNode &node = scopeNodes[i];
+		node.timeHistory[slot] = Timer::GetTimeDelta(0, node.frameTicks);
+		node.callCountHistory[slot] = uint16(min<uint32>(node.frameCallCount, 0xFFFF));
+		node.frameTicks = 0;
+		node.frameCallCount = 0;
+	}
+
+	completedFrameCount++;
+	frameStartTime = frameEndTime;
+
+	if (capturing)
+	{
+		ProfilerEvent frameEvent = {};
+		frameEvent.time = frameEndTime;
+		frameEvent.type = ProfilerEventType::None;
+		CaptureEvent(0, frameEvent);
+	}
+}
+
+// Statistics ===================================================================================//
+
+static inline uint32 GetHistoryFrameCount()
+{
+	return min(completedFrameCount, Profiler::FrameHistoryLength);
+}
+
+static void CollectScopeStats(sint16 nodeIndex, ProfilerScopeStats* stats, uint32 maxCount, uint32& count)
+{
+	uint32 frameCount = GetHistoryFrameCount();
+	uint32 lastSlot = (completedFrameCount - 1) % Profiler::FrameHistoryLength;
+
+	for (; nodeIndex >= 0 && count < maxCount; nodeIndex = scopeNodes[nodeIndex].nextSibling)
+	{
+		const ScopeNode &node = scopeNodes[nodeIndex];
+
+		float32 timeSum = 0.0f, maxTime = 0.0f;
+		uint32 callCountSum = 0;
+		for (uint32 i = 0; i < frameCount; i++)
+		{
+			timeSum += node.timeHistory[i];
+			maxTime = max(maxTime, node.timeHistory[i]);
+			callCountSum += node.callCountHistory[i];
+		}
+
+		ProfilerScopeStats &nodeStats = stats[count++];
+		nodeStats.name = node.name;
+		nodeStats.depth = node.depth;
+		nodeStats.threadIndex = node.threadIndex;
+		nodeStats.lastTime = node.timeHistory[lastSlot];
+		nodeStats.averageTime = timeSum / float32(frameCount);
+		nodeStats.maxTime = maxTime;
+		nodeStats.averageCallCount = float32(callCountSum) / float32(frameCount);
+
+		CollectScopeStats(node.firstChild, stats, maxCount, count);
+	}
+}
+
+uint32 Profiler::GetFrameBreakdown(ProfilerScopeStats* stats, uint32 maxCount)
+{
+	if (!completedFrameCount || !collectorThreadsInitialized)
+		return 0;
+
+	uint32 count = 0;
+	for (uint32 i = 0; i < MaxThreadCount; i++)
+		CollectScopeStats(collectorThreads[i].firstRoot, stats, maxCount, count);
+	return count;
+}
+
+uint32 Profiler::GetCounters(ProfilerCounterStats* stats, uint32 maxCount)
+{
+	uint32 count = min(counterCount, maxCount);
+	for (uint32 i = 0; i < count; i++)
+		stats[i] = counters[i];
+	return count;
+}
+
+const char* Profiler::GetThreadName(uint32 threadIndex)
+{
+	if (threadIndex >= min(Atomics::LoadAcquire(threadCount), MaxThreadCount))
+		return nullptr;
+
+	ThreadRing *ring = Atomics::LoadAcquire(threadRings[threadIndex]);
+	return ring ? ring->name : nullptr;
+}
+
+float32 Profiler::GetAverageFrameTime()
+{
+	uint32 frameCount = GetHistoryFrameCount();
+	float32 timeSum = 0.0f;
+	for (uint32 i = 0; i < frameCount; i++)
+		timeSum += frameTimeHistory[i];
+	return frameCount ? timeSum / float32(frameCount) : 0.0f;
+}
+
+float32 Profiler::GetMaxFrameTime()
+{
+	float32 maxTime = 0.0f;
+	for (uint32 i = 0; i < GetHistoryFrameCount(); i++)
+		maxTime = max(maxTime, frameTimeHistory[i]);
+	return maxTime;
+}
+
+uint64 Profiler::GetDroppedEventCount()
+{
+	uint64 droppedEventCount = 0;
+	uint32 registeredThreadCount = min(Atomics::LoadAcquire(threadCount), MaxThreadCount);
+	for (uint32 i = 0; i < registeredThreadCount; i++)
+	{
+		if (ThreadRing *ring = Atomics::LoadAcquire(threadRings[i]))
+			droppedEventCount += ring->droppedEventCount;
+	}
+	return droppedEventCount;
+}
+
+// Capture ======================================================================================//
+
+namespace
+{
+	class JsonWriter : public NonCopyable
+	{
+	private:
+		File &file;
+		char buffer[64 * 1024];
+		uint32 size = 0;
+		bool failed = false;
+
+	public:
+		inline JsonWriter(File& file) : file(file) {}
+
+		void flush()
+		{
+			if (size && !file.write(buffer, size))
+				failed = true;
+			size = 0;
+		}
+
+		template <typename ... Args>
+		void print(const char* format, Args ... args)
+		{
+			if (sizeof(buffer) - size < 256)
+				flush();
+			int length = snprintf(buffer + size, sizeof(buffer) - size, format, args ...);
+			if (length > 0)
+				size += min(uint32(length), uint32(sizeof(buffer)) - size - 1);
+		}
+
+		// Names come from code, but quotes and backslashes are still escaped.
+		void printString(const char* string)
+		{
+			if (sizeof(buffer) - size < 512)
+				flush();
+
+			buffer[size++] = '"';
+			for (uint32 i = 0; string[i] && i < 250; i++)
+			{
+				char c = string[i];
+				if (c == '"' || c == '\\')
+					buffer[size++] = '\\';
+				buffer[size++] = uint8(c) < 0x20 ? ' ' : c;
+			}
+			buffer[size++] = '"';
+		}
+
+		inline bool isFailed() const { return failed; }
+	};
+}
+
+void Profiler::StartCapture()
+{
+	capturedEvents.clear();
+	for (CollectorThread &thread : collectorThreads)
+		thread.captureBaseDepth = thread.depth;
+	capturing = true;
+}
+
+bool Profiler::StopCapture(const wchar* filename)
+{
+	capturing = false;
+
+	File file;
+	if (!file.open(filename, FileAccessMode::Write, FileOpenMode::Override, FileAccessHint::Sequential))
+	{
+		capturedEvents.takeBuffer();
+		return false;
+	}
+
+	// Events recorded before capture started may be collected after it, so time base is the
+	// earliest captured event.
+	const CapturedEvent *events = capturedEvents;
+	uint32 eventCount = capturedEvents.getSize();
+	TimerRecord baseTime = eventCount ? events[0].time : 0;
+	for (uint32 i = 0; i < eventCount; i++)
+		baseTime = min(baseTime, events[i].time);
+
+	float64 ticksPerMicrosecond = float64(Timer::GetFrequency()) * 1.0e-6;
+
+	JsonWriter writer(file);
+	writer.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	uint32 registeredThreadCount = min(Atomics::LoadAcquire(threadCount), MaxThreadCount);
+	for (uint32 i = 0; i < registeredThreadCount; i++)
+	{
+		const char *name = GetThreadName(i);
+		char defaultName[32];
+		sprintf_s(defaultName, "Thread %u", i);
+
+		writer.print("{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", i);
+		writer.printString(name ? name : defaultName);
+		writer.print("}}");
+		writer.print(i + 1 < registeredThreadCount || eventCount ? ",\n" : "\n");
+	}
+
+	for (uint32 i = 0; i < eventCount; i++)
+	{
+		const CapturedEvent &event = events[i];
+		float64 timestamp = float64(event.time - baseTime) / ticksPerMicrosecond;
+
+		switch (event.type)
+		{
+			case ProfilerEventType::None:
+				writer.print("{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"Frame\"}",
+					event.threadIndex, timestamp);
+				break;
+
+			case ProfilerEventType::ScopeBegin:
+				writer.print("{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", event.threadIndex, timestamp);
+				writer.printString(event.name);
+				writer.print("}");
+				break;
+
+			case ProfilerEventType::ScopeEnd:
+				writer.print("{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", event.threadIndex, timestamp);
+				break;
+
+			case ProfilerEventType::Counter:
+				writer.print("{\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", event.threadIndex, timestamp);
+				writer.printString(event.name);
+				writer.print(",\"args\":{\"value\":%llu}}", (unsigned long long)event.value);
+				break;
+		}
+		writer.print(i + 1 < eventCount ? ",\n" : "\n");
+	}
+
+	writer.print("]}\n");
+	writer.flush();
+
+	capturedEvents.takeBuffer();	// Releases capture memory.
+	return !writer.isFailed();
+}
+
+bool Profiler::IsCapturing()
+{
+	return capturing;
+}
\ No newline at end of file
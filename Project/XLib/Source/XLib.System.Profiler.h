@@ -0,0 +1,111 @@
+#pragma once
+
+#include "XLib.Types.h"
+#include "XLib.NonCopyable.h"
+#include "XLib.System.Timer.h"
+
+// Scoped profiler. Every thread records begin, end and counter events to its own ring buffer
+// without locks, main thread collects them once per frame to per-frame hierarchy of scopes and
+// optionally to capture, which is saved as Chrome trace event JSON (chrome://tracing).
+//
+// Macros compile to nothing when XLIB_PROFILER_DISABLED is defined. Scope and counter names
+// must be string literals, they are stored by pointer.
+
+#ifndef XLIB_PROFILER_DISABLED
+
+#define XLibProfilerConcat2(a, b) a##b
+#define XLibProfilerConcat(a, b) XLibProfilerConcat2(a, b)
+
+#define ProfileScope(name)			XLib::ProfilerScope XLibProfilerConcat(profilerScope, __LINE__)(name)
+#define ProfileFunction()			ProfileScope(__FUNCTION__)
+#define ProfileCounter(name, value)	XLib::Profiler::RecordCounter(name, uint64(value))
+#define ProfileThreadName(name)		XLib::Profiler::SetThreadName(name)
+#define ProfileNextFrame()			XLib::Profiler::NextFrame()
+
+#else
+
+#define ProfileScope(name)
+#define ProfileFunction()
+#define ProfileCounter(name, value)
+#define ProfileThreadName(name)
+#define ProfileNextFrame()
+
+#endif
+
+namespace XLib
+{
+	enum class ProfilerEventType : uint8
+	{
+		None = 0,
+		ScopeBegin,
+		ScopeEnd,
+		Counter,
+	};
+
+	struct ProfilerEvent
+	{
+		TimerRecord time;
+		const char *name;		// nullptr for scope end.
+		uint64 value;			// Counter value.
+		ProfilerEventType type;
+	};
+
+	struct ProfilerScopeStats
+	{
+		const char *name;
+		uint16 depth;
+		uint16 threadIndex;
+		float32 lastTime;			// Seconds spent in scope during last frame.
+		float32 averageTime;		// Over frame history.
+		float32 maxTime;
+		float32 averageCallCount;
+	};
+
+	struct ProfilerCounterStats
+	{
+		const char *name;
+		uint64 value;			// Last recorded.
+	};
+
+	class Profiler XLIB_ABSTRACT final
+	{
+	public:
+		static constexpr uint32 ThreadRingSizeLog2 = 14;
+		static constexpr uint32 MaxThreadCount = 32;
+		static constexpr uint32 MaxScopeDepth = 32;
+		static constexpr uint32 MaxScopeCount = 256;		// Distinct scope paths, deeper scopes are dropped.
+		static constexpr uint32 MaxCounterCount = 64;
+		static constexpr uint32 FrameHistoryLength = 64;
+		static constexpr uint32 MaxCaptureEventCount = 4 * 1024 * 1024;
+
+	public:
+		static void BeginScope(const char* name);
+		static void EndScope();
+		static void RecordCounter(const char* name, uint64 value);
+		static void SetThreadName(const char* name);
+
+		// Called by main thread between frames. Collects events of all threads and closes
+		// frame statistics.
+		static void NextFrame();
+
+		// Scopes are listed depth first, grouped by thread. Returns number of scopes written.
+		static uint32 GetFrameBreakdown(ProfilerScopeStats* stats, uint32 maxCount);
+		static uint32 GetCounters(ProfilerCounterStats* stats, uint32 maxCount);
+		static const char* GetThreadName(uint32 threadIndex);
+		static float32 GetAverageFrameTime();
+		static float32 GetMaxFrameTime();
+		static uint64 GetDroppedEventCount();
+
+		// Events collected between start and stop are saved. Capture stops by itself when full.
+		static void StartCapture();
+		static bool StopCapture(const wchar* filename);
+		static bool IsCapturing();
+	};
+
+	class ProfilerScope : public NonCopyable
+	{
+	public:
+		inline ProfilerScope(const char* name) { Profiler::BeginScope(name); }
+		inline ~ProfilerScope() { Profiler::EndScope(); }
+	};
+}
\ No newline at end of file
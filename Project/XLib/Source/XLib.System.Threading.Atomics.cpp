@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include <Windows.h>
 #include <intrin.h>
 
@@ -22,4 +24,7 @@ uint16 Atomics::Core<sizeof(uint16)>::Or(volatile uint16* target, uint16 value)
 
 void Atomics::FenceAcquire() { _ReadBarrier(); }
 void Atomics::FenceRelease() { _WriteBarrier(); }
-void Atomics::FenceFull() { MemoryBarrier(); }
\ No newline at end of file
+void Atomics::FenceAcquireRelease() { _ReadWriteBarrier(); }
+void Atomics::FenceFull() { MemoryBarrier(); }
+
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "XLib.Types.h"
+#include "XLib.System.Threading.Futex.h"
 
 /*
 	+-------------------------------+-----------------------------------+
@@ -26,76 +27,33 @@
 
 namespace XLib
 {
-	class Atomics abstract
+	class Atomics XLIB_ABSTRACT
 	{
 	private:
 		template <uint32 size> struct Core;
 
-		template <> struct Core<sizeof(uint16)> abstract
-		{
-			using Type = uint16;
-
-			static uint16 Add(volatile uint16* target, uint16 value);
-			static uint16 Sub(volatile uint16* target, uint16 value);
-			static uint16 Exchange(volatile uint16* target, uint16 value);
-			static uint16 Increment(volatile uint16* target);
-			static uint16 Decrement(volatile uint16* target);
-			static bool CompareExchange(volatile uint16* target, uint16 exchange, uint16 comparand);
-			static uint16 And(volatile uint16* target, uint16 value);
-			static uint16 Or(volatile uint16* target, uint16 value);
-			static uint16 Xor(volatile uint16* target, uint16 value);
-		};
-		template <> struct Core<sizeof(uint32)> abstract
-		{
-			using Type = uint32;
-
-			static uint32 Add(volatile uint32* target, uint32 value);
-			static uint32 Sub(volatile uint32* target, uint32 value);
-			static uint32 Exchange(volatile uint32* target, uint32 value);
-			static uint32 Increment(volatile uint32* target);
-			static uint32 Decrement(volatile uint32* target);
-			static bool CompareExchange(volatile uint32* target, uint32 exchange, uint32 comparand);
-			static uint32 And(volatile uint32* target, uint32 value);
-			static uint32 Or(volatile uint32* target, uint32 value);
-			static uint32 Xor(volatile uint32* target, uint32 value);
-		};
-		template <> struct Core<sizeof(uint64)> abstract
-		{
-			using Type = uint64;
-
-			static uint64 Add(volatile uint64* target, uint64 value);
-			static uint64 Sub(volatile uint64* target, uint64 value);
-			static uint64 Exchange(volatile uint64* target, uint64 value);
-			static uint64 Increment(volatile uint64* target);
-			static uint64 Decrement(volatile uint64* target);
-			static bool CompareExchange(volatile uint64* target, uint64 exchange, uint64 comparand);
-			static uint64 And(volatile uint64* target, uint64 value);
-			static uint64 Or(volatile uint64* target, uint64 value);
-			static uint64 Xor(volatile uint64* target, uint64 value);
-		};
-
 	public:
-		template <typename Type> static inline Type Add(volatile Type& target, Type value) { return Core<sizeof(Type)>::Add((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline Type Sub(volatile Type& target, Type value) { return Core<sizeof(Type)>::Sub((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline Type Exchange(volatile Type& target, Type value) { return Core<sizeof(Type)>::Exchange((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline Type And(volatile Type& target, Type value) { return Core<sizeof(Type)>::And((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline Type Or(volatile Type& target, Type value) { return Core<sizeof(Type)>::Or((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline Type Xor(volatile Type& target, Type value) { return Core<sizeof(Type)>::Xor((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value)); }
-		template <typename Type> static inline bool CompareExchange(volatile Type& target, Type exchange, Type comparand) { return Core<sizeof(Type)>::CompareExchange((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(exchange), Core<sizeof(Type)>::Type(comparand)); }
-		template <typename Type> static inline Type Increment(volatile Type& target) { return Core<sizeof(Type)>::Increment((Core<sizeof(Type)>::Type*)&target); }
-		template <typename Type> static inline Type Decrement(volatile Type& target) { return Core<sizeof(Type)>::Decrement((Core<sizeof(Type)>::Type*)&target); }
+		template <typename Type> static inline Type Add(volatile Type& target, Type value) { return Core<sizeof(Type)>::Add((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline Type Sub(volatile Type& target, Type value) { return Core<sizeof(Type)>::Sub((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline Type Exchange(volatile Type& target, Type value) { return Core<sizeof(Type)>::Exchange((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline Type And(volatile Type& target, Type value) { return Core<sizeof(Type)>::And((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline Type Or(volatile Type& target, Type value) { return Core<sizeof(Type)>::Or((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline Type Xor(volatile Type& target, Type value) { return Core<sizeof(Type)>::Xor((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(value)); }
+		template <typename Type> static inline bool CompareExchange(volatile Type& target, Type exchange, Type comparand) { return Core<sizeof(Type)>::CompareExchange((typename Core<sizeof(Type)>::Type*)&target, typename Core<sizeof(Type)>::Type(exchange), typename Core<sizeof(Type)>::Type(comparand)); }
+		template <typename Type> static inline Type Increment(volatile Type& target) { return Core<sizeof(Type)>::Increment((typename Core<sizeof(Type)>::Type*)&target); }
+		template <typename Type> static inline Type Decrement(volatile Type& target) { return Core<sizeof(Type)>::Decrement((typename Core<sizeof(Type)>::Type*)&target); }
 		template <typename Type> static inline Type Load(volatile Type& target) { return target; }
 		template <typename Type> static inline void Store(volatile Type& target, Type value) { target = value; }
 		template <typename Type> static inline Type LoadAcquire(volatile Type& target)
 		{
+			Type value = target;
 			FenceAcquire();
-			Type value = Type(Core<sizeof(Type)>::Load((Core<sizeof(Type)>::Type*)&target));
 			return value;
 		}
 		template <typename Type> static inline void StoreRelease(volatile Type& target, Type value)
 		{
-			Core<sizeof(Type)>::Store((Core<sizeof(Type)>::Type*)&target, Core<sizeof(Type)>::Type(value));
 			FenceRelease();
+			target = value;
 		}
 
 		static void FenceAcquire();
@@ -104,13 +62,58 @@ namespace XLib
 		static void FenceFull();
 	};
 
+	// Core is implemented per platform with full barrier read-modify-write operations.
+
+	template <> struct Atomics::Core<sizeof(uint16)> XLIB_ABSTRACT
+	{
+		using Type = uint16;
+
+		static uint16 Add(volatile uint16* target, uint16 value);
+		static uint16 Sub(volatile uint16* target, uint16 value);
+		static uint16 Exchange(volatile uint16* target, uint16 value);
+		static uint16 Increment(volatile uint16* target);
+		static uint16 Decrement(volatile uint16* target);
+		static bool CompareExchange(volatile uint16* target, uint16 exchange, uint16 comparand);
+		static uint16 And(volatile uint16* target, uint16 value);
+		static uint16 Or(volatile uint16* target, uint16 value);
+		static uint16 Xor(volatile uint16* target, uint16 value);
+	};
+	template <> struct Atomics::Core<sizeof(uint32)> XLIB_ABSTRACT
+	{
+		using Type = uint32;
+
+		static uint32 Add(volatile uint32* target, uint32 value);
+		static uint32 Sub(volatile uint32* target, uint32 value);
+		static uint32 Exchange(volatile uint32* target, uint32 value);
+		static uint32 Increment(volatile uint32* target);
+		static uint32 Decrement(volatile uint32* target);
+		static bool CompareExchange(volatile uint32* target, uint32 exchange, uint32 comparand);
+		static uint32 And(volatile uint32* target, uint32 value);
+		static uint32 Or(volatile uint32* target, uint32 value);
+		static uint32 Xor(volatile uint32* target, uint32 value);
+	};
+	template <> struct Atomics::Core<sizeof(uint64)> XLIB_ABSTRACT
+	{
+		using Type = uint64;
+
+		static uint64 Add(volatile uint64* target, uint64 value);
+		static uint64 Sub(volatile uint64* target, uint64 value);
+		static uint64 Exchange(volatile uint64* target, uint64 value);
+		static uint64 Increment(volatile uint64* target);
+		static uint64 Decrement(volatile uint64* target);
+		static bool CompareExchange(volatile uint64* target, uint64 exchange, uint64 comparand);
+		static uint64 And(volatile uint64* target, uint64 value);
+		static uint64 Or(volatile uint64* target, uint64 value);
+		static uint64 Xor(volatile uint64* target, uint64 value);
+	};
+
 	template <typename Type>
 	struct Atomic
 	{
 		static_assert(sizeof(Type) == 2 || sizeof(Type) == 4 || sizeof(Type) == 8,
 			"XLib.System.Threading.Atomic type must be 2/4/8 bytes width");
 
-		__declspec(align(sizeof(Type))) volatile Type value;
+		alignas(sizeof(Type)) volatile Type value;
 
 		Atomic() = default;
 		inline Atomic(Type _value) : value(_value) {}
@@ -138,6 +141,10 @@ namespace XLib
 			Atomics::Store(value, a);
 		}
 
-		inline void busyWait(Type waitValue) { while (value != waitValue) {} }
+		inline void busyWait(Type waitValue)
+		{
+			for (SpinBackoff backoff; value != waitValue;)
+				backoff.spinOrYield();
+		}
 	};
 }
\ No newline at end of file
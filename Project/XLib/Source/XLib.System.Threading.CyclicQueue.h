@@ -3,7 +3,7 @@
 #include "XLib.Types.h"
 #include "XLib.NonCopyable.h"
 #include "XLib.System.Threading.Atomics.h"
-#include "XLib.System.Threading.Event.h"
+#include "XLib.System.Threading.Futex.h"
 
 // TODO:
 //		1. swap front and back (wrong notation)
@@ -19,88 +19,96 @@ namespace XLib
 		MultipleProducersSingleConsumer = MultipleProducersMultipleConsumers,
 	};
 
-	template <typename Type, uint32 sizeLog2, ThreadSafeQueueType type, uint32 spinCount = 1000>
+	// Blocking queues. Full and empty waits spin with backoff and then park on index futex.
+	// Index updates are full barrier operations, so waiter counts can be checked after them
+	// without missing parked thread.
+
+	template <typename Type, uint32 sizeLog2, ThreadSafeQueueType type>
 	class ThreadSafeCyclicQueue { static_assert(true, "Wrong ThreadSafeQueueType value"); };
 
-	template <typename Type, uint32 sizeLog2, uint32 spinCount>
-	class ThreadSafeCyclicQueue<Type, sizeLog2, ThreadSafeQueueType::SingleProducerSingleConsumer, spinCount> : public NonCopyable
+	template <typename Type, uint32 sizeLog2>
+	class ThreadSafeCyclicQueue<Type, sizeLog2, ThreadSafeQueueType::SingleProducerSingleConsumer> : public NonCopyable
 	{
 	private:
 		static constexpr uint32 size = 1 << sizeLog2;
 
 		Type buffer[size];
-		Event frontEvent, backEvent;
 		volatile uint32 frontIdx, backIdx;
-		volatile bool waitingFront, waitingBack;
+		volatile uint32 frontWaiterCount, backWaiterCount;
 
 	public:
+		inline ThreadSafeCyclicQueue() : frontIdx(0), backIdx(0),
+			frontWaiterCount(0), backWaiterCount(0) {}
+
 		inline void initialize()
 		{
-			frontIdx.value = 0;
-			backIdx.value = 0;
-
-			frontEvent.initialize(false);
-			backEvent.initialize(false);
+			frontIdx = 0;
+			backIdx = 0;
+			frontWaiterCount = 0;
+			backWaiterCount = 0;
 		}
 
 		inline void enqueue(const Type& value)
 		{
-			for (sint32 spin = 0; spin < spinCount; spin++)
+			const uint32 localFrontIdx = frontIdx;
+			for (;;)
 			{
-				if (frontIdx - backIdx < size)
-				{
-					buffer[frontIdx % size] = value;
-					frontIdx++;
-					if (waitingBack)
-						backEvent.set();
-					return;
-				}
+				const uint32 localBackIdx = Atomics::LoadAcquire(backIdx);
+				if (localFrontIdx - localBackIdx < size)
+					break;
+				Futex::WaitWhileEqual(backIdx, localBackIdx, backWaiterCount);
 			}
 
-			waitingFront = true;
+			buffer[localFrontIdx % size] = value;
+			Atomics::Exchange(frontIdx, localFrontIdx + 1);
 
-			if (frontIdx - backIdx < size)
+			if (Atomics::Load(frontWaiterCount))
+				Futex::WakeOne(frontIdx);
+		}
+
+		inline Type dequeue()
+		{
+			const uint32 localBackIdx = backIdx;
+			for (;;)
 			{
-				buffer[frontIdx % size] = value;
-				frontIdx++;
-				if (waitingBack)
-					backEvent.set();
-				waitingFront = false;
-				return;
+				const uint32 localFrontIdx = Atomics::LoadAcquire(frontIdx);
+				if (localFrontIdx != localBackIdx)
+					break;
+				Futex::WaitWhileEqual(frontIdx, localFrontIdx, frontWaiterCount);
 			}
 
-			frontEvent.wait();
+			Type result = buffer[localBackIdx % size];
+			Atomics::Exchange(backIdx, localBackIdx + 1);
 
-			buffer[frontIdx % size] = value;
-			frontIdx++;
-			if (waitingBack)
-				backEvent.set();
-			waitingFront = false;
-		}
+			if (Atomics::Load(backWaiterCount))
+				Futex::WakeOne(backIdx);
 
-		inline Type dequeue();
+			return result;
+		}
 
 		inline uint32 elementCount() { return frontIdx - backIdx; }
 		inline bool isEmpty() { return frontIdx == backIdx; }
 		inline bool isFull() { return frontIdx - backIdx >= size; }
 	};
 
-	template <typename Type, uint32 sizeLog2, uint32 spinCount>
-	class ThreadSafeCyclicQueue<Type, sizeLog2, ThreadSafeQueueType::MultipleProducersMultipleConsumers, spinCount> : public NonCopyable
+	// Slots are claimed with CAS on frontIdx/backIdx and published in claim order through
+	// readyFrontIdx/readyBackIdx. Waiting for publication of previous slot is short, so it only
+	// spins and yields. Parked threads wait on ready indices.
+
+	template <typename Type, uint32 sizeLog2>
+	class ThreadSafeCyclicQueue<Type, sizeLog2, ThreadSafeQueueType::MultipleProducersMultipleConsumers> : public NonCopyable
 	{
 	private:
 		static constexpr uint32 size = 1 << sizeLog2;
-		static_assert(spinCount != 0, "ThreadSafeCyclicQueue spinCount can't be 0");
 
 		Type buffer[size];
-		Event frontEvent, backEvent;
 		Atomic<uint32> frontIdx, backIdx;
 		volatile uint32 readyFrontIdx, readyBackIdx;
-		Atomic<uint16> waitingFrontCount, waitingBackCount;
+		volatile uint32 readyFrontWaiterCount, readyBackWaiterCount;
 
 	public:
 		inline ThreadSafeCyclicQueue() : frontIdx(0), backIdx(0),
-			readyFrontIdx(0), readyBackIdx(0), waitingFrontCount(0), waitingBackCount(0) {}
+			readyFrontIdx(0), readyBackIdx(0), readyFrontWaiterCount(0), readyBackWaiterCount(0) {}
 
 		inline void initialize()
 		{
@@ -108,55 +116,35 @@ namespace XLib
 			backIdx.value = 0;
 			readyFrontIdx = 0;
 			readyBackIdx = 0;
-			waitingFrontCount.value = 0;
-			waitingBackCount.value = 0;
-
-			frontEvent.initialize(false);
-			backEvent.initialize(false);
+			readyFrontWaiterCount = 0;
+			readyBackWaiterCount = 0;
 		}
 
 		inline void enqueue(const Type& value)
 		{
 			for (;;)
 			{
-				uint32 lastLocalReadyBackIdx = readyBackIdx;
-				for (sint32 spin = 0; spin < spinCount; spin++)
-				{
-					uint32 localFrontIdx = frontIdx.load(), localReadyBackIdx = readyBackIdx;
-					if (localFrontIdx - localReadyBackIdx < size)
-					{
-						if (frontIdx.compareExchange(localFrontIdx + 1, localFrontIdx))
-						{
-							buffer[localFrontIdx % size] = value;
-
-							while (readyFrontIdx != localFrontIdx) {}
-							readyFrontIdx++;
-
-							if (waitingBackCount.load())
-								backEvent.set();
-
-							return;
-						}
-						spin = -1;
-					}
-					if (lastLocalReadyBackIdx != localReadyBackIdx)
-					{
-						spin = -1;
-						lastLocalReadyBackIdx = localReadyBackIdx;
-					}
-				}
-
-				frontEvent.reset();
-				waitingFrontCount.increment();
-				if (lastLocalReadyBackIdx != readyBackIdx)
+				// Indices are read in order opposite to their updates, so difference never wraps.
+				const uint32 localReadyBackIdx = Atomics::LoadAcquire(readyBackIdx);
+				const uint32 localFrontIdx = frontIdx.load();
+				if (localFrontIdx - localReadyBackIdx >= size)
 				{
-					frontEvent.set();
-					waitingFrontCount.decrement();
+					Futex::WaitWhileEqual(readyBackIdx, localReadyBackIdx, readyBackWaiterCount);
 					continue;
 				}
+				if (!frontIdx.compareExchange(localFrontIdx + 1, localFrontIdx))
+					continue;
+
+				buffer[localFrontIdx % size] = value;
+
+				for (SpinBackoff backoff; Atomics::LoadAcquire(readyFrontIdx) != localFrontIdx;)
+					backoff.spinOrYield();
+				Atomics::Increment(readyFrontIdx);
+
+				if (Atomics::Load(readyFrontWaiterCount))
+					Futex::WakeAll(readyFrontIdx);
 
-				frontEvent.wait();
-				waitingFrontCount.decrement();
+				return;
 			}
 		}
 
@@ -164,44 +152,27 @@ namespace XLib
 		{
 			for (;;)
 			{
-				uint32 lastLocalReadyFrontIdx = readyFrontIdx;
-				for (sint32 spin = 0; spin < spinCount; spin++)
-				{
-					uint32 localBackIdx = backIdx.load(), localReadyFrontIdx = readyFrontIdx;
-					if (localReadyFrontIdx - localBackIdx > 0)
-					{
-						if (backIdx.compareExchange(localBackIdx + 1, localBackIdx))
-						{
-							Type result = buffer[localBackIdx % size];
-
-							while (readyBackIdx != localBackIdx) {}
-							readyBackIdx++;
-
-							if (waitingFrontCount.load())
-								frontEvent.set();
-
-							return result;
-						}
-						spin = -1;
-					}
-					if (lastLocalReadyFrontIdx != localReadyFrontIdx)
-					{
-						spin = -1;
-						lastLocalReadyFrontIdx = localReadyFrontIdx;
-					}
-				}
-
-				backEvent.reset();
-				waitingBackCount.increment();
-				if (lastLocalReadyFrontIdx != readyFrontIdx)
+				// Indices are read in order opposite to their updates, so difference never wraps.
+				const uint32 localBackIdx = backIdx.load();
+				const uint32 localReadyFrontIdx = Atomics::LoadAcquire(readyFrontIdx);
+				if (localReadyFrontIdx == localBackIdx)
 				{
-					backEvent.set();
-					waitingBackCount.decrement();
+					Futex::WaitWhileEqual(readyFrontIdx, localReadyFrontIdx, readyFrontWaiterCount);
 					continue;
 				}
+				if (!backIdx.compareExchange(localBackIdx + 1, localBackIdx))
+					continue;
+
+				Type result = buffer[localBackIdx % size];
+
+				for (SpinBackoff backoff; Atomics::LoadAcquire(readyBackIdx) != localBackIdx;)
+					backoff.spinOrYield();
+				Atomics::Increment(readyBackIdx);
+
+				if (Atomics::Load(readyBackWaiterCount))
+					Futex::WakeAll(readyBackIdx);
 
-				backEvent.wait();
-				waitingBackCount.decrement();
+				return result;
 			}
 		}
 
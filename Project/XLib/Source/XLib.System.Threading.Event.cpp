@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include <Windows.h>
 
 #include "XLib.System.Threading.Event.h"
@@ -24,4 +26,6 @@ void Event::pulse()
 {
 	Debug::CrashConditionOnDebug(!isInitialized(), DbgMsgFmt("not initialized"));
 	PulseEvent(handle);
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "XLib.System.Threading.Futex.h"
+#include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.Threading.h"
+
+using namespace XLib;
+
+void Futex::WaitWhileEqual(volatile uint32& value, uint32 waitValue, volatile uint32& waiterCount)
+{
+	for (SpinBackoff backoff; backoff.spin();)
+	{
+		if (Atomics::LoadAcquire(value) != waitValue)
+			return;
+	}
+
+	for (;;)
+	{
+		// Waiter is registered before value is rechecked by kernel, so waker that changed
+		// value after this check is guaranteed to see it.
+		Atomics::Increment(waiterCount);
+		Wait(value, waitValue);
+		Atomics::Decrement(waiterCount);
+
+		if (Atomics::LoadAcquire(value) != waitValue)
+			return;
+	}
+}
+
+void SpinBackoff::spinOrYield()
+{
+	if (!spin())
+		Thread::Switch();
+}
\ No newline at end of file
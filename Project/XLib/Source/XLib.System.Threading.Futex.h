@@ -0,0 +1,58 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "XLib.Types.h"
+
+namespace XLib
+{
+	// Blocks thread on 32 bit value until it is woken, without owning any kernel object.
+	// Linux futex and WaitOnAddress on Windows. Wait returns immediately if value differs
+	// from expected one and may return spuriously, so callers always recheck their condition.
+
+	class Futex XLIB_ABSTRACT final
+	{
+	public:
+		static void Wait(volatile uint32& value, uint32 expectedValue);
+		// Returns false on timeout.
+		static bool Wait(volatile uint32& value, uint32 expectedValue, uint32 timeout);
+		static void WakeOne(volatile uint32& value);
+		static void WakeAll(volatile uint32& value);
+
+		// Spins with backoff and then parks until value differs from waitValue. waiterCount
+		// is incremented while parked, so waker may skip wake call when it is zero. Waker
+		// must change value with full barrier operation before checking waiterCount.
+		static void WaitWhileEqual(volatile uint32& value, uint32 waitValue, volatile uint32& waiterCount);
+	};
+
+	// Bounded exponential backoff for spin loops. Every step pauses twice as long as previous
+	// one, after limit is reached caller should park on futex (or yield) instead of spinning.
+
+	class SpinBackoff
+	{
+	private:
+		static constexpr uint32 pauseCountLimit = 1 << 10;
+
+		uint32 pauseCount = 1;
+
+	public:
+		SpinBackoff() = default;
+
+		// Returns false when spin limit is reached.
+		inline bool spin()
+		{
+			if (pauseCount > pauseCountLimit)
+				return false;
+			for (uint32 i = 0; i < pauseCount; i++)
+				_mm_pause();
+			pauseCount <<= 1;
+			return true;
+		}
+
+		// For waits on other thread that can't be parked on, for example on publication in
+		// progress. Yields time slice after limit, so preempted thread can continue.
+		void spinOrYield();
+
+		inline void reset() { pauseCount = 1; }
+	};
+}
\ No newline at end of file
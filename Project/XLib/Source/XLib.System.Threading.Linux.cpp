@@ -0,0 +1,349 @@
+#ifdef __linux__
+
+#include <atomic>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "XLib.System.Threading.h"
+#include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.Threading.Event.h"
+#include "XLib.System.Threading.Futex.h"
+
+#include "XLib.Debug.h"
+
+// Linux backend of XLib threading primitives. Handles point to heap allocated states that
+// start with type tag. Waits spin with bounded backoff first and then park on futex, so no
+// kernel object is owned by any primitive.
+
+using namespace XLib;
+
+namespace
+{
+	enum class HandleType : uint32
+	{
+		Thread = 1,
+		Event = 2,
+	};
+
+	struct HandleState
+	{
+		HandleType type;
+		volatile uint32 referenceCount;
+	};
+
+	struct ThreadState : HandleState
+	{
+		pthread_t thread;
+		ThreadMainProc<void> mainProc;
+		void *args;
+		volatile uint32 resumed;
+		volatile uint32 finished;
+	};
+
+	struct EventState : HandleState
+	{
+		volatile uint32 state;
+		volatile uint32 waiterCount;
+		bool manualReset;
+	};
+}
+
+// Atomics ==================================================================================//
+
+// Read-modify-write operations are sequentially consistent, as on Windows where Interlocked
+// functions are full barriers. __atomic builtins are used as targets are plain volatile words.
+
+#define XLIB_ATOMICS_CORE(Type) \
+	Type Atomics::Core<sizeof(Type)>::Add(volatile Type* target, Type value) { return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Sub(volatile Type* target, Type value) { return __atomic_sub_fetch(target, value, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Exchange(volatile Type* target, Type value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Increment(volatile Type* target) { return __atomic_add_fetch(target, Type(1), __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Decrement(volatile Type* target) { return __atomic_sub_fetch(target, Type(1), __ATOMIC_SEQ_CST); } \
+	bool Atomics::Core<sizeof(Type)>::CompareExchange(volatile Type* target, Type exchange, Type comparand) \
+		{ return __atomic_compare_exchange_n(target, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::And(volatile Type* target, Type value) { return __atomic_fetch_and(target, value, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Or(volatile Type* target, Type value) { return __atomic_fetch_or(target, value, __ATOMIC_SEQ_CST); } \
+	Type Atomics::Core<sizeof(Type)>::Xor(volatile Type* target, Type value) { return __atomic_fetch_xor(target, value, __ATOMIC_SEQ_CST); }
+
+XLIB_ATOMICS_CORE(uint16)
+XLIB_ATOMICS_CORE(uint32)
+XLIB_ATOMICS_CORE(uint64)
+
+#undef XLIB_ATOMICS_CORE
+
+void Atomics::FenceAcquire() { std::atomic_thread_fence(std::memory_order_acquire); }
+void Atomics::FenceRelease() { std::atomic_thread_fence(std::memory_order_release); }
+void Atomics::FenceAcquireRelease() { std::atomic_thread_fence(std::memory_order_acq_rel); }
+void Atomics::FenceFull() { std::atomic_thread_fence(std::memory_order_seq_cst); }
+
+// Futex ====================================================================================//
+
+static inline timespec MillisecondsToTimespec(uint32 milliseconds)
+{
+	timespec result;
+	result.tv_sec = milliseconds / 1000;
+	result.tv_nsec = long(milliseconds % 1000) * 1000000;
+	return result;
+}
+
+static inline uint64 GetMonotonicTime()	// In milliseconds.
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return uint64(time.tv_sec) * 1000 + uint64(time.tv_nsec) / 1000000;
+}
+
+void Futex::Wait(volatile uint32& value, uint32 expectedValue)
+{
+	syscall(SYS_futex, (uint32*)&value, FUTEX_WAIT_PRIVATE, expectedValue, nullptr, nullptr, 0);
+}
+bool Futex::Wait(volatile uint32& value, uint32 expectedValue, uint32 timeout)
+{
+	timespec relativeTimeout = MillisecondsToTimespec(timeout);
+	long result = syscall(SYS_futex, (uint32*)&value, FUTEX_WAIT_PRIVATE, expectedValue, &relativeTimeout, nullptr, 0);
+	return result == 0 || errno != ETIMEDOUT;
+}
+void Futex::WakeOne(volatile uint32& value)
+{
+	syscall(SYS_futex, (uint32*)&value, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+void Futex::WakeAll(volatile uint32& value)
+{
+	syscall(SYS_futex, (uint32*)&value, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Same as Futex::WaitWhileEqual, but with timeout. timeout == uint32(-1) means infinite wait.
+// Returns false on timeout.
+static bool WaitWhileEqual(volatile uint32& value, uint32 waitValue, volatile uint32& waiterCount, uint32 timeout)
+{
+	if (timeout == uint32(-1))
+	{
+		Futex::WaitWhileEqual(value, waitValue, waiterCount);
+		return true;
+	}
+
+	for (SpinBackoff backoff; backoff.spin();)
+	{
+		if (Atomics::LoadAcquire(value) != waitValue)
+			return true;
+	}
+
+	const uint64 deadline = GetMonotonicTime() + timeout;
+
+	for (;;)
+	{
+		const uint64 time = GetMonotonicTime();
+		if (time >= deadline)
+			return false;
+
+		Atomics::Increment(waiterCount);
+		Futex::Wait(value, waitValue, uint32(deadline - time));
+		Atomics::Decrement(waiterCount);
+
+		if (Atomics::LoadAcquire(value) != waitValue)
+			return true;
+	}
+}
+
+// Handles ==================================================================================//
+
+static void ReleaseHandleState(HandleState* state)
+{
+	if (Atomics::Decrement(state->referenceCount) != 0)
+		return;
+
+	switch (state->type)
+	{
+		case HandleType::Thread:	delete (ThreadState*)state;	break;
+		case HandleType::Event:		delete (EventState*)state;	break;
+	}
+}
+
+void ISystemHandle::destroy()
+{
+	if (handle)
+	{
+		HandleState *state = (HandleState*)handle;
+		if (state->type == HandleType::Thread)
+			pthread_detach(((ThreadState*)state)->thread);
+		ReleaseHandleState(state);
+		handle = nullptr;
+	}
+}
+
+// Thread ===================================================================================//
+
+static void FinishThread(void* _state)
+{
+	ThreadState *state = (ThreadState*)_state;
+	Atomics::StoreRelease(state->finished, uint32(1));
+	Futex::WakeAll(state->finished);
+	ReleaseHandleState(state);
+}
+
+static void* ThreadMainWrapper(void* _state)
+{
+	ThreadState *state = (ThreadState*)_state;
+
+	// Also runs when thread is cancelled by terminate().
+	pthread_cleanup_push(FinishThread, state);
+
+	while (!Atomics::LoadAcquire(state->resumed))
+		Futex::Wait(state->resumed, 0);
+
+	state->mainProc(state->args);
+
+	pthread_cleanup_pop(1);
+	return nullptr;
+}
+
+void Thread::_create(ThreadMainProc<void> threadMainProc, void* args, bool suspended)
+{
+	destroy();
+
+	// One reference is owned by handle and one by thread itself.
+	ThreadState *state = new ThreadState;
+	state->type = HandleType::Thread;
+	state->referenceCount = 2;
+	state->mainProc = threadMainProc;
+	state->args = args;
+	state->resumed = suspended ? 0 : 1;
+	state->finished = 0;
+
+	int result = pthread_create(&state->thread, nullptr, ThreadMainWrapper, state);
+	Debug::CrashCondition(result != 0, DbgMsgFmt("pthread_create failed"));
+
+	handle = state;
+}
+void Thread::terminate(uint32 exitCode)
+{
+	// Exit code is not tracked, threads are only waited for.
+	pthread_cancel(((ThreadState*)handle)->thread);
+}
+bool Thread::suspend()
+{
+	// Running thread can't be stopped at arbitrary point with pthreads.
+	return false;
+}
+void Thread::resume()
+{
+	ThreadState *state = (ThreadState*)handle;
+	Atomics::StoreRelease(state->resumed, uint32(1));
+	Futex::WakeOne(state->resumed);
+}
+void Thread::Sleep(uint32 milliseconds)
+{
+	timespec time = MillisecondsToTimespec(milliseconds);
+	while (nanosleep(&time, &time) != 0 && errno == EINTR) {}
+}
+void Thread::Switch() { sched_yield(); }
+uint32 Thread::GetHardwareThreadCount() { return uint32(sysconf(_SC_NPROCESSORS_ONLN)); }
+
+// Event ====================================================================================//
+
+void Event::initialize(bool state, bool manualReset)
+{
+	destroy();
+
+	EventState *eventState = new EventState;
+	eventState->type = HandleType::Event;
+	eventState->referenceCount = 1;
+	eventState->state = state ? 1 : 0;
+	eventState->waiterCount = 0;
+	eventState->manualReset = manualReset;
+	handle = eventState;
+}
+void Event::set()
+{
+	Debug::CrashConditionOnDebug(!isInitialized(), DbgMsgFmt("not initialized"));
+	EventState *state = (EventState*)handle;
+
+	if (Atomics::Exchange(state->state, uint32(1)) == 1)
+		return;
+	if (Atomics::Load(state->waiterCount))
+	{
+		if (state->manualReset)
+			Futex::WakeAll(state->state);
+		else
+			Futex::WakeOne(state->state);
+	}
+}
+void Event::reset()
+{
+	Debug::CrashConditionOnDebug(!isInitialized(), DbgMsgFmt("not initialized"));
+	EventState *state = (EventState*)handle;
+	Atomics::Exchange(state->state, uint32(0));
+}
+void Event::pulse()
+{
+	// As PulseEvent, waiters that have not parked yet may miss the pulse.
+	set();
+	reset();
+}
+
+static bool WaitEvent(EventState* state, uint32 timeout)
+{
+	if (state->manualReset)
+		return WaitWhileEqual(state->state, 0, state->waiterCount, timeout);
+
+	// Auto reset event is consumed by the waiter that manages to reset it.
+	const uint64 deadline = timeout == uint32(-1) ? 0 : GetMonotonicTime() + timeout;
+	for (;;)
+	{
+		if (Atomics::CompareExchange(state->state, uint32(0), uint32(1)))
+			return true;
+
+		uint32 remaining = uint32(-1);
+		if (timeout != uint32(-1))
+		{
+			const uint64 time = GetMonotonicTime();
+			if (time >= deadline)
+				return false;
+			remaining = uint32(deadline - time);
+		}
+		if (!WaitWhileEqual(state->state, 0, state->waiterCount, remaining))
+			return false;
+	}
+}
+
+// WaitableBase =============================================================================//
+
+static bool WaitHandle(void* handle, uint32 timeout)
+{
+	HandleState *state = (HandleState*)handle;
+	switch (state->type)
+	{
+		case HandleType::Thread:
+		{
+			ThreadState *threadState = (ThreadState*)state;
+			// Nobody wakes through waiter count here, thread always wakes all on exit.
+			uint32 waiterCount = 0;
+			return WaitWhileEqual(threadState->finished, 0, waiterCount, timeout);
+		}
+
+		case HandleType::Event:
+			return WaitEvent((EventState*)state, timeout);
+	}
+	return false;
+}
+
+bool WaitableBase::wait() { return WaitHandle(handle, uint32(-1)); }
+bool WaitableBase::wait(uint32 timeout) { return WaitHandle(handle, timeout); }
+
+bool _private::WaitAll(void** handles, uint32 handleCount)
+{
+	for (uint32 i = 0; i < handleCount; i++)
+	{
+		if (!WaitHandle(handles[i], uint32(-1)))
+			return false;
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file
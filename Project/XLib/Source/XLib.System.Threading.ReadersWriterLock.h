@@ -3,12 +3,16 @@
 #include "XLib.Types.h"
 #include "XLib.NonCopyable.h"
 #include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.Threading.Futex.h"
 
 namespace XLib
 {
 	class ScopedReaderLock;
 	class ScopedWriterLock;
 
+	// Lock word holds reader count and writer bit. Contended waits spin with backoff and then
+	// park on lock word futex, unlocks wake parked threads only when there are any.
+
 	class ReadersWriterLock : public NonCopyable
 	{
 		friend ScopedReaderLock;
@@ -18,27 +22,66 @@ namespace XLib
 		static constexpr uint32 writerLockMask = 1 << 31;
 
 		Atomic<uint32> lock;
+		Atomic<uint32> waiterCount;
+
+		inline void park(uint32 lockValue)
+		{
+			waiterCount.increment();
+			Futex::Wait(lock.value, lockValue);
+			waiterCount.decrement();
+		}
+		inline void wake()
+		{
+			if (waiterCount.load())
+				Futex::WakeAll(lock.value);
+		}
 
 		inline void readerLock()
 		{
-			if (lock.increment() >= writerLockMask)
-				while (lock.load() & writerLockMask) {}
+			// Reader is counted even while writer holds lock, so writer can't be reacquired
+			// until it is done.
+			if (lock.increment() < writerLockMask)
+				return;
+
+			SpinBackoff backoff;
+			for (;;)
+			{
+				const uint32 lockValue = lock.load();
+				if (!(lockValue & writerLockMask))
+					break;
+				if (!backoff.spin())
+					park(lockValue);
+			}
+			Atomics::FenceAcquire();
 		}
 		inline void writerLock()
 		{
-			while (!lock.compareExchange(writerLockMask, 0)) {}
+			SpinBackoff backoff;
+			for (;;)
+			{
+				const uint32 lockValue = lock.load();
+				if (lockValue == 0)
+				{
+					if (lock.compareExchange(writerLockMask, 0))
+						return;
+				}
+				else if (!backoff.spin())
+					park(lockValue);
+			}
 		}
 		inline void readerUnlock()
 		{
-			lock.decrement();
+			if (lock.decrement() == 0)
+				wake();
 		}
 		inline void writerUnlock()
 		{
 			lock.sub(writerLockMask);
+			wake();
 		}
 
 	public:
-		inline ReadersWriterLock() : lock(0) {}
+		inline ReadersWriterLock() : lock(0), waiterCount(0) {}
 	};
 
 	class ScopedReaderLock : public NonCopyable
@@ -0,0 +1,679 @@
+#include <immintrin.h>
+#include <stdio.h>
+
+#include "XLib.System.Threading.WorkerPool.h"
+#include "XLib.Util.h"
+#include "XLib.Debug.h"
+#include "XLib.System.Profiler.h"
+
+using namespace XLib;
+
+static constexpr uint32 idleSpinCount = 256;	// Failed job searches before worker goes to sleep.
+static constexpr uint32 helpSpinCount = 64;		// Failed job searches before waiting thread yields.
+
+WorkerPool WorkerPool::Global;
+thread_local WorkerPool::ThreadContext* WorkerPool::CurrentThreadContext = nullptr;
+thread_local WorkerPool::ThreadExitGuard WorkerPool::CurrentThreadExitGuard;
+
+WorkerPool::ThreadExitGuard::~ThreadExitGuard()
+{
+	if (pool)
+		pool->detachThread();
+}
+
+// JobDeque =================================================================================//
+
+// Chase-Lev deque. Only owner thread pushes and pops, any thread may steal. Exchange in pop
+// is full fence, so bottom decrement is visible before top is read.
+
+bool WorkerPool::JobDeque::push(Job* job)
+{
+	sint32 b = bottom.load();
+	sint32 t = top.load();
+	if (b - t >= sint32(countof(jobs)))
+		return false;
+
+	jobs[b & (countof(jobs) - 1)] = job;
+	bottom.storeRelease(b + 1);
+	return true;
+}
+
+WorkerPool::Job* WorkerPool::JobDeque::pop()
+{
+	sint32 b = bottom.load() - 1;
+	bottom.exchange(b);
+	sint32 t = top.load();
+
+	if (t > b)
+	{
+		bottom.store(t);
+		return nullptr;
+	}
+
+	Job *job = jobs[b & (countof(jobs) - 1)];
+	if (t != b)
+		return job;
+
+	// Last job, race with thieves for it.
+	if (!top.compareExchange(t + 1, t))
+		job = nullptr;
+	bottom.store(t + 1);
+	return job;
+}
+
+WorkerPool::Job* WorkerPool::JobDeque::steal()
+{
+	sint32 t = top.loadAcquire();
+	sint32 b = bottom.loadAcquire();
+	if (t >= b)
+		return nullptr;
+
+	Job *job = jobs[t & (countof(jobs) - 1)];
+	if (!top.compareExchange(t + 1, t))
+		return nullptr;
+	return job;
+}
+
+// Scheduler ================================================================================//
+
+uint32 XLIB_STDCALL WorkerPool::WorkerMain(ThreadContext* thread)
+{
+	WorkerPool &pool = *thread->pool;
+	CurrentThreadContext = thread;
+	ProfileThreadName("Worker");
+
+	uint32 idleCount = 0;
+	for (;;)
+	{
+		if (Job *job = pool.findJob(*thread))
+		{
+			pool.executeJob(*thread, job);
+			idleCount = 0;
+			continue;
+		}
+
+		if (pool.shutdown)
+			break;
+
+		if (++idleCount < idleSpinCount)
+		{
+			_mm_pause();
+			continue;
+		}
+		idleCount = 0;
+
+		// Jobs are searched once more after worker is registered as sleeping, so job pushed
+		// concurrently is either found here or its pusher sees sleeping worker and wakes it.
+		thread->sleeping.store(1);
+		pool.sleepingWorkerCount.increment();
+
+		if (Job *job = pool.findJob(*thread))
+		{
+			if (thread->sleeping.exchange(0))
+				pool.sleepingWorkerCount.decrement();
+			pool.executeJob(*thread, job);
+			continue;
+		}
+
+		if (!pool.shutdown)
+			thread->wakeEvent.wait();
+		if (thread->sleeping.exchange(0))
+			pool.sleepingWorkerCount.decrement();
+	}
+
+	return 0;
+}
+
+WorkerPool::ThreadContext* WorkerPool::tryGetThreadContext()
+{
+	ThreadContext *thread = CurrentThreadContext;
+	if (thread && thread->pool == this)
+		return thread;
+
+	// Thread that is not a worker gets its own deque on first use, so workers can steal from it.
+	uint32 index = 0;
+	for (;;)
+	{
+		uint32 slots = externalThreadSlots.load();
+		for (index = 0; index < externalThreadCountLimit; index++)
+		{
+			if (!(slots & (1 << index)))
+				break;
+		}
+		if (index >= externalThreadCountLimit)
+			return nullptr;
+
+		if (externalThreadSlots.compareExchange(slots | (1 << index), slots))
+			break;
+	}
+	Atomics::FenceAcquire();
+
+	thread = &threads[workerCountLimit + index];
+	thread->pool = this;
+	CurrentThreadContext = thread;
+	CurrentThreadExitGuard.pool = this;
+	return thread;
+}
+
+WorkerPool::ThreadContext& WorkerPool::getThreadContext()
+{
+	for (;;)
+	{
+		if (ThreadContext *thread = tryGetThreadContext())
+			return *thread;
+		Thread::Switch();
+	}
+}
+
+WorkerPool::Job* WorkerPool::allocateJob(ThreadContext& thread, JobGroup& group)
+{
+	// Job slots are reused cyclically, slots still in flight are skipped. If all slots are in
+	// flight, other jobs are executed until one of them finishes.
+	Job *job = nullptr;
+	for (;;)
+	{
+		for (uint32 i = 0; i < countof(thread.jobs); i++)
+		{
+			Job *candidate = &thread.jobs[thread.nextJobIndex++ & (countof(thread.jobs) - 1)];
+			if (!candidate->group)
+			{
+				job = candidate;
+				break;
+			}
+		}
+		if (job)
+			break;
+
+		if (Job *otherJob = findJob(thread))
+			executeJob(thread, otherJob);
+		else
+			_mm_pause();
+	}
+
+	job->proc = nullptr;
+	job->rangeProc = nullptr;
+	job->rectProc = nullptr;
+	job->next = nullptr;
+	job->group = &group;
+	return job;
+}
+
+WorkerPool::Job* WorkerPool::findJob(ThreadContext& thread)
+{
+	if (Job *job = thread.deque.pop())
+		return job;
+
+	uint32 threadCount = threadCountLimit;
+
+	// xorshift
+	thread.randomState ^= thread.randomState << 13;
+	thread.randomState ^= thread.randomState >> 17;
+	thread.randomState ^= thread.randomState << 5;
+
+	uint32 start = thread.randomState;
+	for (uint32 i = 0; i < threadCount; i++)
+	{
+		uint32 victimIndex = (start + i) % threadCount;
+		if (victimIndex >= workerCount && victimIndex < workerCountLimit)
+			continue;
+
+		ThreadContext &victim = threads[victimIndex];
+		if (&victim == &thread)
+			continue;
+
+		if (Job *job = victim.deque.steal())
+			return job;
+	}
+
+	return nullptr;
+}
+
+void WorkerPool::pushJob(ThreadContext& thread, Job* job)
+{
+	if (!thread.deque.push(job))
+	{
+		executeJob(thread, job);
+		return;
+	}
+
+	wakeWorker();
+}
+
+void WorkerPool::submitJob(ThreadContext& thread, JobGroup& group, Job* job)
+{
+	group.pendingCount.increment();
+
+	if (group.dependencyCount)
+	{
+		ScopedLock lock(group.lock);
+		if (group.dependencyCount)
+		{
+			job->next = group.heldJobs;
+			group.heldJobs = job;
+			return;
+		}
+	}
+
+	pushJob(thread, job);
+}
+
+void WorkerPool::executeJob(ThreadContext& thread, Job* job)
+{
+	ProfileScope("WorkerPool job");
+
+	JobGroup &group = *job->group;
+
+	if (job->proc)
+	{
+		job->proc(job->context);
+	}
+	else
+	{
+		// Upper half of range is split off as new job until job is no longer than grain.
+		for (;;)
+		{
+			rectu32 &range = job->range;
+			uint32 chunkCountX = intdivceil(range.getWidth(), job->grain.x);
+			uint32 chunkCountY = intdivceil(range.getHeight(), job->grain.y);
+			if (chunkCountX <= 1 && chunkCountY <= 1)
+				break;
+
+			Job *splitJob = allocateJob(thread, group);
+			*splitJob = *job;
+			if (chunkCountX >= chunkCountY)
+			{
+				uint32 middle = range.left + chunkCountX / 2 * job->grain.x;
+				splitJob->range.left = middle;
+				range.right = middle;
+			}
+			else
+			{
+				uint32 middle = range.top + chunkCountY / 2 * job->grain.y;
+				splitJob->range.top = middle;
+				range.bottom = middle;
+			}
+
+			group.pendingCount.increment();
+			pushJob(thread, splitJob);
+		}
+
+		if (job->rangeProc)
+			job->rangeProc(job->context, job->range.left, job->range.right);
+		else
+			job->rectProc(job->context, job->range);
+	}
+
+	Atomics::FenceRelease();
+	job->group = nullptr;
+
+	finishGroupJob(thread, group);
+}
+
+void WorkerPool::finishGroupJob(ThreadContext& thread, JobGroup& group)
+{
+	if (group.pendingCount.decrement())
+		return;
+
+	JobGroup *dependents[JobGroup::dependentCountLimit];
+	uint32 dependentCount = 0;
+	{
+		ScopedLock lock(group.lock);
+		group.finished = true;
+		dependentCount = group.dependentCount;
+		for (uint32 i = 0; i < dependentCount; i++)
+			dependents[i] = group.dependents[i];
+	}
+
+	for (uint32 i = 0; i < dependentCount; i++)
+	{
+		JobGroup &dependent = *dependents[i];
+
+		Job *heldJobs = nullptr;
+		{
+			ScopedLock lock(dependent.lock);
+			dependent.dependencyCount--;
+			if (!dependent.dependencyCount)
+			{
+				heldJobs = dependent.heldJobs;
+				dependent.heldJobs = nullptr;
+			}
+		}
+
+		while (heldJobs)
+		{
+			Job *job = heldJobs;
+			heldJobs = job->next;
+			pushJob(thread, job);
+		}
+
+		// Held dependent is kept open by this reference until its jobs are released.
+		finishGroupJob(thread, dependent);
+	}
+
+	Atomics::FenceRelease();
+	group.done = true;
+}
+
+void WorkerPool::wakeWorker()
+{
+	// Full fence orders pushed job before sleeping worker count read. Pairs with sleeping
+	// worker rechecking queues after registering itself.
+	Atomics::FenceFull();
+	if (!sleepingWorkerCount.load())
+		return;
+
+	for (uint32 i = 0; i < workerCount; i++)
+	{
+		if (threads[i].sleeping.compareExchange(0, 1))
+		{
+			sleepingWorkerCount.decrement();
+			threads[i].wakeEvent.set();
+			return;
+		}
+	}
+}
+
+// WorkerPool ===============================================================================//
+
+void WorkerPool::initialize(uint32 workerCount)
+{
+	ScopedLock lock(initializationLock);
+
+	if (initialized)
+		return;
+
+	if (workerCount == uint32(-1))
+	{
+		uint32 hardwareThreadCount = Thread::GetHardwareThreadCount();
+		workerCount = hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 0;
+	}
+	workerCount = min(workerCount, workerCountLimit);
+
+	shutdown = false;
+	for (uint32 i = 0; i < threadCountLimit; i++)
+	{
+		threads[i].pool = this;
+		threads[i].sleeping.store(0);
+		threads[i].randomState = i * 0x9E3779B9 + 1;
+		threads[i].nextJobIndex = 0;
+		threads[i].deque.top.store(0);
+		threads[i].deque.bottom.store(0);
+		for (Job &job : threads[i].jobs)
+			job.group = nullptr;
+	}
+	sleepingWorkerCount.store(0);
+
+	this->workerCount = workerCount;
+	for (uint32 i = 0; i < workerCount; i++)
+	{
+		threads[i].wakeEvent.initialize(false, false);
+		threads[i].thread.create(WorkerMain, &threads[i]);
+	}
+
+	Atomics::FenceRelease();
+	initialized = true;
+}
+
+void WorkerPool::destroy()
+{
+	ScopedLock lock(initializationLock);
+
+	if (!initialized)
+		return;
+
+	shutdown = true;
+	Atomics::FenceFull();
+	for (uint32 i = 0; i < workerCount; i++)
+		threads[i].wakeEvent.set();
+	for (uint32 i = 0; i < workerCount; i++)
+	{
+		threads[i].thread.wait();
+		threads[i].thread.destroy();
+		threads[i].wakeEvent.destroy();
+	}
+
+	workerCount = 0;
+	initialized = false;
+}
+
+void WorkerPool::detachThread()
+{
+	ThreadContext *thread = CurrentThreadContext;
+	if (!thread || thread->pool != this || thread < threads + workerCountLimit)
+		return;
+
+	// Jobs of thread may still be executed or held by groups, slot is reused only after all of
+	// them are finished.
+	for (;;)
+	{
+		bool jobsInFlight = false;
+		for (Job &job : thread->jobs)
+		{
+			if (job.group)
+			{
+				jobsInFlight = true;
+				break;
+			}
+		}
+		if (!jobsInFlight)
+			break;
+
+		if (Job *job = findJob(*thread))
+			executeJob(*thread, job);
+		else
+			Thread::Switch();
+	}
+
+	CurrentThreadContext = nullptr;
+	CurrentThreadExitGuard.pool = nullptr;
+
+	Atomics::FenceRelease();
+	externalThreadSlots.sub(1 << uint32(thread - threads - workerCountLimit));
+}
+
+void WorkerPool::submit(JobGroup& group, JobProc proc, void* context)
+{
+	if (!initialized)
+		initialize();
+
+	ThreadContext &thread = getThreadContext();
+	Job *job = allocateJob(thread, group);
+	job->proc = proc;
+	job->context = context;
+	submitJob(thread, group, job);
+}
+
+void WorkerPool::addDependency(JobGroup& group, JobGroup& prerequisite)
+{
+	ScopedLock prerequisiteLock(prerequisite.lock);
+	if (prerequisite.finished)
+		return;
+
+	Debug::CrashCondition(prerequisite.dependentCount >= JobGroup::dependentCountLimit,
+		DbgMsgFmt("too many dependent job groups"));
+	prerequisite.dependents[prerequisite.dependentCount++] = &group;
+
+	// Dependent group stays unfinished until prerequisite releases it.
+	ScopedLock groupLock(group.lock);
+	group.dependencyCount++;
+	group.pendingCount.increment();
+}
+
+void WorkerPool::close(JobGroup& group)
+{
+	if (!group.open)
+		return;
+	group.open = false;
+
+	if (!initialized)
+		initialize();
+	finishGroupJob(getThreadContext(), group);
+}
+
+void WorkerPool::wait(JobGroup& group)
+{
+	close(group);
+
+	ThreadContext &thread = getThreadContext();
+
+	uint32 idleCount = 0;
+	while (!group.done)
+	{
+		if (Job *job = findJob(thread))
+		{
+			executeJob(thread, job);
+			idleCount = 0;
+			continue;
+		}
+
+		if (++idleCount < helpSpinCount)
+			_mm_pause();
+		else
+			Thread::Switch();
+	}
+
+	Atomics::FenceAcquire();
+}
+
+void WorkerPool::parallelFor(uint32 count, uint32 grain, RangeProc proc, void* context)
+{
+	if (!count)
+		return;
+	grain = max<uint32>(grain, 1);
+
+	if (!initialized)
+		initialize();
+
+	ThreadContext *thread = nullptr;
+	if (count <= grain || !workerCount || !(thread = tryGetThreadContext()))
+	{
+		proc(context, 0, count);
+		return;
+	}
+
+	JobGroup group;
+	Job *job = allocateJob(*thread, group);
+	job->rangeProc = proc;
+	job->context = context;
+	job->range = rectu32(0, 0, count, 1);
+	job->grain = uint32x2(grain, 1);
+	submitJob(*thread, group, job);
+	wait(group);
+}
+
+void WorkerPool::parallelFor2D(const rectu32& range, uint32x2 grain, RectProc proc, void* context)
+{
+	if (range.left >= range.right || range.top >= range.bottom)
+		return;
+	grain.x = max<uint32>(grain.x, 1);
+	grain.y = max<uint32>(grain.y, 1);
+
+	if (!initialized)
+		initialize();
+
+	ThreadContext *thread = nullptr;
+	if ((range.getWidth() <= grain.x && range.getHeight() <= grain.y) || !workerCount ||
+		!(thread = tryGetThreadContext()))
+	{
+		proc(context, range);
+		return;
+	}
+
+	JobGroup group;
+	Job *job = allocateJob(*thread, group);
+	job->rectProc = proc;
+	job->context = context;
+	job->range = range;
+	job->grain = grain;
+	submitJob(*thread, group, job);
+	wait(group);
+}
+
+// Self test ================================================================================//
+
+namespace
+{
+	struct SelfTestThread
+	{
+		Thread thread;
+		uint32 itemCount;
+		uint64 sum;
+	};
+
+	uint32 XLIB_STDCALL SelfTestThreadMain(SelfTestThread* state)
+	{
+		Atomic<uint64> sum = 0;
+		auto addRange = [&](uint32 begin, uint32 end)
+		{
+			uint64 rangeSum = 0;
+			for (uint32 i = begin; i < end; i++)
+				rangeSum += i;
+			sum.add(rangeSum);
+		};
+		WorkerPool::Global.parallelFor(state->itemCount, 64, addRange);
+
+		state->sum = sum.load();
+		return 0;
+	}
+}
+
+bool WorkerPool::RunSelfTest()
+{
+	static constexpr uint32 roundCount = 8;
+	static constexpr uint32 roundThreadCount = externalThreadCountLimit + 4;
+
+	WorkerPool &pool = Global;
+	if (!pool.initialized)
+		pool.initialize();
+
+	// Calling thread may hold slot of its own, it is kept.
+	ThreadContext *callerThread = CurrentThreadContext;
+	uint32 callerSlots = callerThread && callerThread->pool == &pool && callerThread >= pool.threads + workerCountLimit ?
+		1 << uint32(callerThread - pool.threads - workerCountLimit) : 0;
+
+	bool passed = true;
+	uint32 failedThreadCount = 0;
+
+	for (uint32 round = 0; round < roundCount; round++)
+	{
+		// Rounds with more threads than slots run some parallelFor calls on calling thread
+		// only. Slots of exited threads have to be free after every round.
+		uint32 threadCount = round & 1 ? roundThreadCount : externalThreadCountLimit / 2;
+
+		SelfTestThread threads[roundThreadCount];
+		for (uint32 i = 0; i < threadCount; i++)
+		{
+			threads[i].itemCount = 10000 + round * 1000 + i * 37;
+			threads[i].sum = 0;
+			threads[i].thread.create(SelfTestThreadMain, &threads[i]);
+		}
+
+		for (uint32 i = 0; i < threadCount; i++)
+		{
+			threads[i].thread.wait();
+			threads[i].thread.destroy();
+
+			uint64 n = threads[i].itemCount;
+			if (threads[i].sum != n * (n - 1) / 2)
+				failedThreadCount++;
+		}
+
+		// Thread may be reported finished before its thread local destructors run, so slots
+		// are given a moment to be released.
+		for (uint32 i = 0; i < 100 && (pool.externalThreadSlots.load() & ~callerSlots); i++)
+			Thread::Sleep(10);
+
+		if (pool.externalThreadSlots.load() & ~callerSlots)
+			passed = false;
+	}
+
+	passed &= failedThreadCount == 0;
+
+	char message[256];
+	sprintf_s(message, "Worker pool self test: %u workers, %u rounds of up to %u threads, %u wrong sums, slots %s -> %s",
+		pool.workerCount, roundCount, roundThreadCount, failedThreadCount,
+		pool.externalThreadSlots.load() & ~callerSlots ? "leaked" : "released", passed ? "PASSED" : "FAILED");
+	Debug::Log(message);
+
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "XLib.Types.h"
+#include "XLib.NonCopyable.h"
+#include "XLib.Vectors.h"
+#include "XLib.System.Threading.h"
+#include "XLib.System.Threading.Event.h"
+#include "XLib.System.Threading.Atomics.h"
+#include "XLib.System.Threading.Lock.h"
+
+namespace XLib
+{
+	class JobGroup;
+
+	// Work stealing job scheduler. Every thread has its own Chase-Lev deque. Owner pushes and
+	// pops jobs at the bottom, idle threads steal from the top of random victims, so work is
+	// not serialized on a shared queue. Waiting threads execute jobs instead of blocking, so
+	// jobs and parallelFor calls may be nested freely.
+	//
+	// Threads that are not workers get one of few external slots on first use, and give it back
+	// when they exit. When all slots are taken, parallelFor runs on calling thread only, while
+	// submit and wait yield until slot is free.
+
+	class WorkerPool : public NonCopyable
+	{
+		friend JobGroup;
+
+	public:
+		using JobProc = void(*)(void* context);
+		using RangeProc = void(*)(void* context, uint32 begin, uint32 end);
+		using RectProc = void(*)(void* context, const rectu32& range);
+
+	private:
+		static constexpr uint32 workerCountLimit = 64;
+		static constexpr uint32 externalThreadCountLimit = 8;
+		static constexpr uint32 threadCountLimit = workerCountLimit + externalThreadCountLimit;
+		static constexpr uint32 jobCapacityLog2 = 10;	// Per thread jobs in flight.
+		static constexpr uint32 dequeCapacityLog2 = 12;
+
+		struct Job
+		{
+			JobProc proc;
+			RangeProc rangeProc;
+			RectProc rectProc;
+			void *context;
+			JobGroup *volatile group;	// nullptr when job slot is free.
+			Job *next;
+			rectu32 range;
+			uint32x2 grain;
+		};
+
+		struct JobDeque
+		{
+			Job *volatile jobs[1 << dequeCapacityLog2];
+			Atomic<sint32> top;
+			byte _padding[60];
+			Atomic<sint32> bottom;
+
+			bool push(Job* job);
+			Job* pop();
+			Job* steal();
+		};
+
+		struct ThreadContext
+		{
+			WorkerPool *pool;
+			Thread thread;
+			Event wakeEvent;
+			Atomic<uint32> sleeping;
+			uint32 randomState;
+			uint32 nextJobIndex;
+			JobDeque deque;
+			Job jobs[1 << jobCapacityLog2];
+		};
+
+		// Detaches thread from pool it is attached to when thread exits.
+		struct ThreadExitGuard
+		{
+			WorkerPool *pool = nullptr;
+			~ThreadExitGuard();
+		};
+
+		ThreadContext threads[threadCountLimit];
+		Lock initializationLock;
+		uint32 workerCount = 0;
+		Atomic<uint32> externalThreadSlots = 0;		// Bit per taken slot.
+		Atomic<uint32> sleepingWorkerCount = 0;
+		volatile bool initialized = false;
+		volatile bool shutdown = false;
+
+		static thread_local ThreadContext *CurrentThreadContext;
+		static thread_local ThreadExitGuard CurrentThreadExitGuard;
+
+		static uint32 XLIB_STDCALL WorkerMain(ThreadContext* thread);
+
+		// Returns nullptr when thread is not attached yet and all external slots are taken.
+		ThreadContext* tryGetThreadContext();
+		ThreadContext& getThreadContext();
+		Job* allocateJob(ThreadContext& thread, JobGroup& group);
+		Job* findJob(ThreadContext& thread);
+		void pushJob(ThreadContext& thread, Job* job);
+		void submitJob(ThreadContext& thread, JobGroup& group, Job* job);
+		void executeJob(ThreadContext& thread, Job* job);
+		void finishGroupJob(ThreadContext& thread, JobGroup& group);
+		void wakeWorker();
+
+	public:
+		WorkerPool() = default;
+		inline ~WorkerPool() { destroy(); }
+
+		// workerCount == uint32(-1) means one worker per hardware thread except the calling one.
+		// Pool is initialized on first use if it was not initialized explicitly.
+		void initialize(uint32 workerCount = uint32(-1));
+		void destroy();
+
+		// Gives external slot of calling thread back, after jobs it submitted are finished.
+		// Called automatically when thread exits.
+		void detachThread();
+
+		void submit(JobGroup& group, JobProc proc, void* context);
+		// Jobs of group are not started until prerequisite group is done.
+		// Must be called before jobs are submitted to group.
+		void addDependency(JobGroup& group, JobGroup& prerequisite);
+		// No jobs may be added to group after it is closed.
+		void close(JobGroup& group);
+		// Closes group and executes pending jobs until group is done.
+		void wait(JobGroup& group);
+
+		// Range is recursively split in halves down to grain, so idle threads steal large parts.
+		void parallelFor(uint32 count, uint32 grain, RangeProc proc, void* context);
+		// Same for 2D range (for example of tile coords). Range is split along its longer side.
+		void parallelFor2D(const rectu32& range, uint32x2 grain, RectProc proc, void* context);
+
+		template <typename Function>
+		inline void parallelFor(uint32 count, uint32 grain, Function& function)
+		{
+			parallelFor(count, grain,
+				[](void* context, uint32 begin, uint32 end) { (*(Function*)context)(begin, end); },
+				&function);
+		}
+
+		template <typename Function>
+		inline void parallelFor2D(const rectu32& range, uint32x2 grain, Function& function)
+		{
+			parallelFor2D(range, grain,
+				[](void* context, const rectu32& range) { (*(Function*)context)(range); },
+				&function);
+		}
+
+		inline uint32 getWorkerCount() { return workerCount; }
+		inline uint32 getConcurrency() { return workerCount + 1; }
+
+		static WorkerPool Global;
+
+		// Runs rounds of more short lived threads than there are external slots, all of them
+		// calling parallelFor, and checks results and that slots are given back.
+		static bool RunSelfTest();
+	};
+
+	// Set of jobs that can be waited for. Group may depend on other groups, then its jobs are
+	// held back until all of them are done. Group stays open while jobs are added to it and is
+	// done only after it is closed (or waited for) and all its jobs are finished.
+
+	class JobGroup : public NonCopyable
+	{
+		friend WorkerPool;
+
+	private:
+		static constexpr uint32 dependentCountLimit = 8;
+
+		Lock lock;
+		WorkerPool::Job *heldJobs = nullptr;
+		JobGroup *dependents[dependentCountLimit];
+		uint32 dependentCount = 0;
+		uint32 dependencyCount = 0;		// Unfinished groups this one depends on.
+		Atomic<uint32> pendingCount = 1;	// Unfinished jobs plus one while group is open.
+		volatile bool open = true;
+		volatile bool finished = false;	// Set under lock when pending count reaches zero.
+		volatile bool done = false;		// Set after dependents are released, group may be destroyed then.
+
+	public:
+		JobGroup() = default;
+		~JobGroup() = default;
+
+		inline bool isDone() { return done; }
+	};
+}
\ No newline at end of file
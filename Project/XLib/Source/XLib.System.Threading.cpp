@@ -1,9 +1,14 @@
+#ifdef _WIN32
+
 #include <Windows.h>
 
 #include "XLib.System.Threading.h"
+#include "XLib.System.Threading.Futex.h"
 
 #include "XLib.Debug.h"
 
+#pragma comment(lib, "Synchronization.lib")
+
 using namespace XLib;
 
 struct ThreadMainWrapperArgs
@@ -44,14 +49,20 @@ void Thread::create(Delegate<void> threadMainDelegate, bool suspended)
 	args.ready = false;
 	handle = CreateThread(nullptr, 0, ThreadMainWrapper, (void*)&args, suspended ? CREATE_SUSPENDED : 0, &threadId);
 
-	while (!args.ready)
-		{ }
+	for (SpinBackoff backoff; !args.ready;)
+		backoff.spinOrYield();
 }
 void Thread::terminate(uint32 exitCode) { TerminateThread(handle, exitCode); }
-void Thread::suspend() { SuspendThread(handle); }
+bool Thread::suspend() { return SuspendThread(handle) != DWORD(-1); }
 void Thread::resume() { ResumeThread(handle); }
 void Thread::Sleep(uint32 milliseconds) { ::Sleep(milliseconds); }
 void Thread::Switch() { SwitchToThread(); }
+uint32 Thread::GetHardwareThreadCount()
+{
+	SYSTEM_INFO systemInfo = {};
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwNumberOfProcessors;
+}
 
 bool WaitableBase::wait()
 {
@@ -77,4 +88,21 @@ bool _private::WaitAll(void** handles, uint32 handleCount)
 		return false;
 	}
 	return true;
-}
\ No newline at end of file
+}
+
+// Futex ====================================================================================//
+
+void Futex::Wait(volatile uint32& value, uint32 expectedValue)
+{
+	WaitOnAddress(&value, &expectedValue, sizeof(uint32), INFINITE);
+}
+bool Futex::Wait(volatile uint32& value, uint32 expectedValue, uint32 timeout)
+{
+	if (WaitOnAddress(&value, &expectedValue, sizeof(uint32), timeout))
+		return true;
+	return GetLastError() != ERROR_TIMEOUT;
+}
+void Futex::WakeOne(volatile uint32& value) { WakeByAddressSingle((void*)&value); }
+void Futex::WakeAll(volatile uint32& value) { WakeByAddressAll((void*)&value); }
+
+#endif
\ No newline at end of file
@@ -2,14 +2,18 @@
 
 #include "XLib.Types.h"
 #include "XLib.NonCopyable.h"
+#include "XLib.System.Threading.Futex.h"
+
+#ifdef _MSC_VER
 #include "XLib.Delegate.h"
+#endif
 
 // TODO: create Thread::destroy();
 //       thread fences... lol
 
 namespace XLib
 {
-	class ISystemHandle abstract : public NonCopyable
+	class ISystemHandle XLIB_ABSTRACT : public NonCopyable
 	{
 	protected:
 		void *handle;
@@ -25,14 +29,14 @@ namespace XLib
 	};
 
 	template <typename Type>
-	using ThreadMainProc = uint32(__stdcall*)(Type*);
+	using ThreadMainProc = uint32(XLIB_STDCALL*)(Type*);
 
 	namespace _private
 	{
 		bool WaitAll(void** handles, uint32 handleCount);
 	}
 
-	class WaitableBase abstract : public ISystemHandle
+	class WaitableBase XLIB_ABSTRACT : public ISystemHandle
 	{
 	public:
 		/*template <typename Type>
@@ -45,11 +49,16 @@ namespace XLib
 		bool wait(uint32 timeout);
 	};
 
+	// On Linux suspend() is not supported and returns false, thread can only be created
+	// suspended and resumed.
+	// Delegate based overloads are MSVC only, as Delegate depends on its member pointer layout.
+
 	class Thread : public WaitableBase
 	{
 	private:
 		void _create(ThreadMainProc<void> threadMainProc, void* args, bool suspended);
 
+#ifdef _MSC_VER
 		template <uint32 argsSize>
 		struct ArgsStruct { byte data[argsSize]; };
 
@@ -58,11 +67,11 @@ namespace XLib
 		{
 			RawDelegate threadMainRawDlegate;
 			ArgsStruct<argsSize> *threadMainArgs;
-			bool ready;
+			volatile bool ready;
 		};
 
 		template <uint32 argsSize>
-		static uint32 __stdcall ThreadMainProc_MethodWithArgsWrapper(
+		static uint32 XLIB_STDCALL ThreadMainProc_MethodWithArgsWrapper(
 			ThreadMainProcArgs_MethodWithArgsWrapper<argsSize>* args)
 		{
 			Delegate<void, ArgsStruct<argsSize>> threadMainDelegate(args->threadMainRawDlegate);
@@ -71,22 +80,24 @@ namespace XLib
 			threadMainDelegate.call(threadMainArgs);
 			return 0;
 		}
+#endif
 
 	public:
 		Thread() = default;
 
 		void terminate(uint32 exitCode = 0);
-		void suspend();
+		bool suspend();
 		void resume();
 
-		void create(Delegate<void> threadMainDelegate, bool suspended = false);
-		void create(Delegate<uint32> threadMainDelegate, bool suspended = false);
-
 		template <typename ArgsType>
 		inline void create(ThreadMainProc<ArgsType> threadMainProc,
 			ArgsType* args = nullptr, bool suspended = false)
 			{ _create(ThreadMainProc<void>(threadMainProc), args, suspended); }
 
+#ifdef _MSC_VER
+		void create(Delegate<void> threadMainDelegate, bool suspended = false);
+		void create(Delegate<uint32> threadMainDelegate, bool suspended = false);
+
 		template <typename ArgsType>
 		inline void create(Delegate<void, ArgsType> threadMainDelegate,
 			const ArgsType& sourceArguments, bool suspended = false)
@@ -99,11 +110,14 @@ namespace XLib
 
 			create(ThreadMainProc_MethodWithArgsWrapper, &args, suspended);
 
-			while (!args.ready) {}
+			for (SpinBackoff backoff; !args.ready;)
+				backoff.spinOrYield();
 		}
+#endif
 
 		static void Sleep(uint32 milliseconds);
 		static void Switch();
+		static uint32 GetHardwareThreadCount();
 
 		template <typename Type, uint32 count>
 		static inline void WaitAll(Type(&waitables)[count], uint32 waitableCount)
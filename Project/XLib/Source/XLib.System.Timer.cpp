@@ -23,6 +23,13 @@ float32 Timer::GetTimeDelta(TimerRecord record1, TimerRecord record2)
 	return float32(record2 - record1) / frequency;
 }
 
+uint64 Timer::GetFrequency()
+{
+	uint64 frequency = 0;
+	QueryPerformanceFrequency(PLARGE_INTEGER(&frequency));
+	return frequency;
+}
+
 uint32 Timer::GetCurrentTimeMs()
 {
 	return GetTickCount();
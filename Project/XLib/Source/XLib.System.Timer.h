@@ -6,12 +6,13 @@ namespace XLib
 {
 	using TimerRecord = uint64;
 
-	class Timer abstract final
+	class Timer XLIB_ABSTRACT final
 	{
 	public:
 		static TimerRecord GetRecord();
 		static float32 GetTimeDelta(TimerRecord record1, TimerRecord record2 = Timer::GetRecord());
 		static uint32 GetCurrentTimeMs();
+		static uint64 GetFrequency();	// Timer records per second.
 
 		static inline float32 GetTimeDelta_UpdateRecord(TimerRecord& record)
 		{
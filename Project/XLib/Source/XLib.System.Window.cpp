@@ -14,7 +14,7 @@ MouseState mouseState(WPARAM wParam, LPARAM lParam)
 		wParam & MK_LBUTTON ? true : false, wParam & MK_MBUTTON ? true : false, wParam & MK_RBUTTON ? true : false };
 }
 
-struct Internal::WindowInternal abstract final
+struct Internal::WindowInternal XLIB_ABSTRACT final
 {
 	static LRESULT __stdcall WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	{
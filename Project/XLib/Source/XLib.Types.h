@@ -1,12 +1,29 @@
 #pragma once
 
+// MSVC extensions used across XLib. Other compilers don't need them.
+#ifdef _MSC_VER
+#define XLIB_ABSTRACT abstract
+#define XLIB_STDCALL __stdcall
+#else
+#define XLIB_ABSTRACT
+#define XLIB_STDCALL
+#endif
+
 using uint8 = unsigned char;
 using uint16 = unsigned short int;
+#ifdef _MSC_VER
 using uint32 = unsigned long int;
+#else
+using uint32 = unsigned int;	// long is 64 bit on LP64 platforms
+#endif
 using uint64 = unsigned long long int;
 using sint8 = signed char;
 using sint16 = signed short int;
+#ifdef _MSC_VER
 using sint32 = signed long int;
+#else
+using sint32 = signed int;
+#endif
 using sint64 = signed long long int;
 using float32 = float;
 using float64 = double;
@@ -17,12 +34,15 @@ using sint = signed;
 using byte = uint8;
 using wchar = wchar_t;
 
-#ifdef _WIN64
+#if defined(_WIN64) || defined(__LP64__)
 using uintptr = uint64;
 using sintptr = sint64;
-#else
+#elif defined(_MSC_VER)
 using uintptr = __w64 uint32;
 using sintptr = __w64 sint32;
+#else
+using uintptr = uint32;
+using sintptr = sint32;
 #endif
 
 static_assert(sizeof(uintptr) == sizeof(void*) && sizeof(sintptr) == sizeof(void*), "invalid uintptr/sintptr size");
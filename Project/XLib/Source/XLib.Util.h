@@ -16,9 +16,9 @@ template <typename type> inline void construct(type& value) { new (&value) type(
 #undef offsetof
 #define offsetof(type, field) uintptr(&((type*)nullptr)->field)
 
-template <typename _type> struct removeReference abstract final { using type = _type; };
-template <typename _type> struct removeReference<_type&> abstract final { using type = _type; };
-template <typename _type> struct removeReference<_type&&> abstract final { using type = _type; };
+template <typename _type> struct removeReference XLIB_ABSTRACT final { using type = _type; };
+template <typename _type> struct removeReference<_type&> XLIB_ABSTRACT final { using type = _type; };
+template <typename _type> struct removeReference<_type&&> XLIB_ABSTRACT final { using type = _type; };
 
 template <typename type> inline typename removeReference<type>::type&& move(type&& object) { return (typename removeReference<type>::type&&)object; }
 
@@ -7,7 +7,7 @@
 
 namespace XLib
 {
-	struct VectorMath abstract final
+	struct VectorMath XLIB_ABSTRACT final
 	{
 		static inline float32 Length(const float32x2& v) { return Math::Sqrt(v.x * v.x + v.y * v.y); }
 		static inline float32 Length(const float32x3& v) { return Math::Sqrt(v.x * v.x + v.y * v.y + v.z * v.z); }